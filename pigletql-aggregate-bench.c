@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pigletql-eval.h"
+#include "pigletql-intern.h"
+
+/*
+ * Grouped sums: time per query of returning every tuple as text and summing groups on the client
+ * side, the way results used to be aggregated, versus hash aggregation and streaming aggregation
+ * over input sorted on the group attribute. Counts: counting tuples scanned versus reading the
+ * relation tuple number.
+ *  */
+
+#define BENCH_ROW_NUM (4 * 1000 * 1000)
+#define BENCH_GROUP_NUM 1000
+#define BENCH_QUERY_NUM 5
+#define BENCH_COUNT_NUM (100 * 1000)
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Sum of group sums returned, the same whatever the grouping */
+static uint64_t bench_consume(operator_t *op, uint32_t *row_num)
+{
+    uint64_t sum = 0;
+    *row_num = 0;
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state))) {
+        for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++)
+            sum += batch_get_value(batch, 1, batch->sel[sel_i]);
+        *row_num += batch->sel_num;
+    }
+    op->close(op->state);
+    return sum;
+}
+
+static double bench_client(const relation_t *rel, uint64_t *sum, uint32_t *row_num)
+{
+    uint64_t *group_sums = calloc(BENCH_GROUP_NUM, sizeof(uint64_t));
+    const double start = now_seconds();
+    for (size_t query_i = 0; query_i < BENCH_QUERY_NUM; query_i++) {
+        for (size_t group_i = 0; group_i < BENCH_GROUP_NUM; group_i++)
+            group_sums[group_i] = 0;
+
+        /* Rows are printed the way the REPL prints them and parsed back */
+        operator_t *op = scan_op_create(NULL, rel);
+        op->open(op->state);
+        batch_t *batch = NULL;
+        char line[64];
+        while ((batch = op->next_batch(op->state))) {
+            for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                const uint16_t row_i = batch->sel[sel_i];
+                snprintf(line, sizeof(line), "%u %u\n", batch->columns[0][row_i], batch->columns[2][row_i]);
+                char *end = NULL;
+                const unsigned long group_i = strtoul(line, &end, 10);
+                group_sums[group_i] += strtoul(end, NULL, 10);
+            }
+        }
+        op->close(op->state);
+        op->destroy(op);
+    }
+    const double seconds = (now_seconds() - start) / BENCH_QUERY_NUM;
+
+    *sum = 0;
+    for (size_t group_i = 0; group_i < BENCH_GROUP_NUM; group_i++)
+        *sum += group_sums[group_i];
+    *row_num = BENCH_GROUP_NUM;
+    free(group_sums);
+    return seconds;
+}
+
+static double bench_aggregate(const relation_t *rel, const bool is_stream, uint64_t *sum, uint32_t *row_num)
+{
+    const aggregate_t aggregates[] = {{ .func = AGGREGATE_SUM, .attr_i = 2, .name = intern("sum(val)") }};
+    const uint16_t group_attr_is[] = {is_stream ? 1 : 0};
+    const double start = now_seconds();
+    for (size_t query_i = 0; query_i < BENCH_QUERY_NUM; query_i++) {
+        operator_t *source_op = scan_op_create(NULL, rel);
+        operator_t *op = is_stream ?
+            stream_aggregate_op_create(NULL, source_op, group_attr_is, 1, aggregates, 1) :
+            hash_aggregate_op_create(NULL, source_op, group_attr_is, 1, aggregates, 1);
+        *sum = bench_consume(op, row_num);
+        op->destroy(op);
+    }
+    return (now_seconds() - start) / BENCH_QUERY_NUM;
+}
+
+static double bench_count_scan(const relation_t *rel, uint32_t *tuple_num)
+{
+    const size_t count_num = BENCH_QUERY_NUM;
+    const double start = now_seconds();
+    for (size_t count_i = 0; count_i < count_num; count_i++) {
+        operator_t *op = scan_op_create(NULL, rel);
+        *tuple_num = 0;
+        op->open(op->state);
+        batch_t *batch = NULL;
+        while ((batch = op->next_batch(op->state)))
+            *tuple_num += batch->sel_num;
+        op->close(op->state);
+        op->destroy(op);
+    }
+    return (now_seconds() - start) / count_num;
+}
+
+static double bench_count_op(const relation_t *rel, uint32_t *tuple_num)
+{
+    const char *names[] = {intern("count(*)")};
+    const double start = now_seconds();
+    for (size_t count_i = 0; count_i < BENCH_COUNT_NUM; count_i++) {
+        operator_t *op = count_op_create(NULL, rel, names, 1);
+        op->open(op->state);
+        *tuple_num = op->next_batch(op->state)->columns[0][0];
+        op->close(op->state);
+        op->destroy(op);
+    }
+    return (now_seconds() - start) / BENCH_COUNT_NUM;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* Groups of the first attribute are mixed, groups of the second one sorted */
+    const char *attr_names[] = {"mixed", "sorted", "val"};
+    relation_t *rel = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+    if (!rel) {
+        fprintf(stderr, "Error: failed to create the relation\n");
+        return 1;
+    }
+    for (value_type_t row_i = 0; row_i < BENCH_ROW_NUM; row_i++) {
+        const value_type_t values[] = {row_i % BENCH_GROUP_NUM, row_i / (BENCH_ROW_NUM / BENCH_GROUP_NUM), row_i % 7};
+        relation_append_values(rel, values);
+    }
+
+    printf("%10s %14s %14s %10s\n", "group by", "groups", "ms/query", "speedup");
+
+    uint64_t client_sum = 0, sum = 0;
+    uint32_t row_num = 0;
+    const double client_seconds = bench_client(rel, &client_sum, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "client", row_num, client_seconds * 1e3, 1.0);
+
+    const double hash_seconds = bench_aggregate(rel, false, &sum, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "hash", row_num, hash_seconds * 1e3, client_seconds / hash_seconds);
+    if (sum != client_sum) {
+        fprintf(stderr, "Error: hash aggregation results differ\n");
+        return 1;
+    }
+
+    const double stream_seconds = bench_aggregate(rel, true, &sum, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "stream", row_num, stream_seconds * 1e3, client_seconds / stream_seconds);
+    if (sum != client_sum) {
+        fprintf(stderr, "Error: streaming aggregation results differ\n");
+        return 1;
+    }
+
+    printf("%10s %14s %14s %10s\n", "count", "tuples", "us/query", "speedup");
+
+    uint32_t scan_tuple_num = 0, tuple_num = 0;
+    const double scan_seconds = bench_count_scan(rel, &scan_tuple_num);
+    printf("%10s %14u %14.3f %10.2f\n", "scan", scan_tuple_num, scan_seconds * 1e6, 1.0);
+
+    const double count_seconds = bench_count_op(rel, &tuple_num);
+    printf("%10s %14u %14.3f %10.2f\n", "relation", tuple_num, count_seconds * 1e6, scan_seconds / count_seconds);
+    if (tuple_num != scan_tuple_num) {
+        fprintf(stderr, "Error: counts differ\n");
+        return 1;
+    }
+
+    relation_destroy(rel);
+
+    return 0;
+}
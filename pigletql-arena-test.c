@@ -0,0 +1,86 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pigletql-arena.h"
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* Zeroed and aligned allocations */
+    {
+        arena_t *arena = arena_create();
+        assert(arena);
+
+        char *c = arena_calloc(arena, 1, 1);
+        uint64_t *values = arena_calloc(arena, 16, sizeof(uint64_t));
+        assert(c && values);
+        assert((uintptr_t)values % sizeof(uint64_t) == 0);
+        for (size_t i = 0; i < 16; i++)
+            assert(values[i] == 0);
+
+        /* Empty allocations do not alias */
+        void *empty1 = arena_calloc(arena, 0, sizeof(uint64_t));
+        void *empty2 = arena_calloc(arena, 0, sizeof(uint64_t));
+        assert(empty1 != empty2);
+
+        arena_destroy(arena);
+    }
+
+    /* The last allocation grows in place, others get copied */
+    {
+        arena_t *arena = arena_create();
+
+        uint16_t *array = arena_realloc(arena, NULL, 0, 2 * sizeof(uint16_t));
+        array[0] = 1;
+        array[1] = 2;
+        uint16_t *grown = arena_realloc(arena, array, 2 * sizeof(uint16_t), 64 * sizeof(uint16_t));
+        assert(grown == array);
+
+        char *other = arena_calloc(arena, 8, 1);
+        assert(other);
+        uint16_t *moved = arena_realloc(arena, grown, 64 * sizeof(uint16_t), 128 * sizeof(uint16_t));
+        assert(moved != grown);
+        assert(moved[0] == 1 && moved[1] == 2);
+
+        arena_destroy(arena);
+    }
+
+    /* Large allocations and reset */
+    {
+        arena_t *arena = arena_create();
+
+        const size_t big_size = 1024 * 1024;
+        char *big = arena_calloc(arena, big_size, 1);
+        assert(big);
+        memset(big, 'a', big_size);
+
+        for (size_t i = 0; i < 1000; i++) {
+            char *small = arena_calloc(arena, 100, 1);
+            assert(small);
+            memset(small, 'b', 100);
+        }
+        assert(big[big_size - 1] == 'a');
+
+        /* Memory is reused after a reset */
+        arena_reset(arena);
+        char *after_reset = arena_calloc(arena, 100, 1);
+        assert(after_reset);
+        for (size_t i = 0; i < 100; i++)
+            assert(after_reset[i] == 0);
+
+        arena_destroy(arena);
+    }
+
+    /* No arena means the heap */
+    {
+        char *heap = arena_calloc(NULL, 10, 1);
+        assert(heap);
+        heap = arena_realloc(NULL, heap, 10, 20);
+        assert(heap);
+        arena_free(NULL, heap);
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <assert.h>
+
+#include "pigletql-arena.h"
+
+/* Most statements fit into a single block */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+typedef struct arena_block_t {
+    struct arena_block_t *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) char data[];
+} arena_block_t;
+
+struct arena_t {
+    /* The current block goes first */
+    arena_block_t *blocks;
+
+    /* The last allocation can be grown in place */
+    char *last_ptr;
+};
+
+static arena_block_t *arena_block_create(const size_t size)
+{
+    arena_block_t *block = malloc(sizeof(*block) + size);
+    if (!block)
+        return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+arena_t *arena_create(void)
+{
+    arena_t *arena = calloc(1, sizeof(*arena));
+    if (!arena)
+        goto arena_fail;
+
+    arena->blocks = arena_block_create(ARENA_BLOCK_SIZE);
+    if (!arena->blocks)
+        goto block_fail;
+
+    return arena;
+
+block_fail:
+    free(arena);
+
+arena_fail:
+    return NULL;
+}
+
+void arena_reset(arena_t *arena)
+{
+    /* Keep the first block allocated, it is the one at the end of the list */
+    arena_block_t *block = arena->blocks;
+    while (block->next) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    block->used = 0;
+    arena->blocks = block;
+    arena->last_ptr = NULL;
+}
+
+void arena_destroy(arena_t *arena)
+{
+    if (!arena)
+        return;
+    arena_block_t *block = arena->blocks;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+static size_t arena_align(const size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static void *arena_alloc(arena_t *arena, size_t size)
+{
+    /* Empty allocations still get distinct pointers */
+    size = arena_align(size ? size : 1);
+
+    arena_block_t *block = arena->blocks;
+    if (block->size - block->used < size) {
+        /* Large allocations get a block of their own */
+        const size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = arena_block_create(block_size);
+        assert(block);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    char *ptr = &block->data[block->used];
+    block->used += size;
+    arena->last_ptr = ptr;
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t num, size_t size)
+{
+    if (!arena)
+        return calloc(num, size);
+
+    assert(size == 0 || num <= SIZE_MAX / size);
+    void *ptr = arena_alloc(arena, num * size);
+    memset(ptr, 0, num * size);
+    return ptr;
+}
+
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    if (!arena)
+        return realloc(ptr, new_size);
+
+    if (!ptr)
+        return arena_alloc(arena, new_size);
+
+    /* The last allocation might have enough room after it */
+    arena_block_t *block = arena->blocks;
+    if (ptr == arena->last_ptr) {
+        const size_t offset = (size_t)((char *)ptr - block->data);
+        if (block->size - offset >= new_size) {
+            block->used = offset + arena_align(new_size);
+            return ptr;
+        }
+    }
+
+    void *new_ptr = arena_alloc(arena, new_size);
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    return new_ptr;
+}
+
+void arena_free(arena_t *arena, void *ptr)
+{
+    if (!arena)
+        free(ptr);
+}
@@ -0,0 +1,32 @@
+#ifndef PIGLETQL_ARENA_H
+#define PIGLETQL_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * An arena is a bump allocator for short-lived structures, e.g. everything needed to run a single
+ * statement: the parsed query, the bound query, the plan and operator states. Nothing is freed
+ * separately, all the memory is released at once by resetting the arena.
+ *
+ * Functions below also accept a NULL arena meaning the usual heap allocation.
+ * */
+
+typedef struct arena_t arena_t;
+
+arena_t *arena_create(void);
+
+/* Release everything allocated, keeping a block around for the next use */
+void arena_reset(arena_t *arena);
+
+void arena_destroy(arena_t *arena);
+
+/* Zeroed memory for an array */
+void *arena_calloc(arena_t *arena, size_t num, size_t size);
+
+/* Grow an allocation, the last allocation in an arena is grown in place if possible */
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+
+/* Only heap allocations are freed, arenas release memory on reset */
+void arena_free(arena_t *arena, void *ptr);
+
+#endif //PIGLETQL_ARENA_H
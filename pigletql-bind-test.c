@@ -0,0 +1,190 @@
+#include <assert.h>
+#include <string.h>
+
+#include "pigletql-bind.h"
+
+static catalogue_t *catalogue_create_for_test(void)
+{
+    catalogue_t *cat = catalogue_create();
+    assert(cat);
+
+    {
+        const attr_name_t attr_names[] = {"id", "attr1", "attr2"};
+        const size_t attr_num = ARRAY_SIZE(attr_names);
+        relation_t *rel1 = relation_create(attr_names, attr_num);
+        catalogue_add_relation(cat, "rel1", rel1);
+    }
+
+    {
+        const attr_name_t attr_names[] = {"id2", "attr3"};
+        const size_t attr_num = ARRAY_SIZE(attr_names);
+        relation_t *rel2 = relation_create(attr_names, attr_num);
+        catalogue_add_relation(cat, "rel2", rel2);
+    }
+
+    return cat;
+}
+
+static void select_bind_test(void)
+{
+    /* Attributes from a single relation */
+    {
+        const char *query_str = "SELECT attr2, id FROM rel1 WHERE id > 10 ORDER BY attr2 DESC;";
+
+        catalogue_t *cat = catalogue_create_for_test();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        bound_select_t *bound = bind_select(NULL, cat, &query->as.select);
+        assert(bound);
+
+        assert(bound->rel_num == 1);
+        assert(bound->rels[0] == catalogue_get_relation(cat, "rel1"));
+
+        assert(bound->attr_num == 2);
+        assert(bound->attrs[0].rel_i == 0);
+        assert(bound->attrs[0].attr_i == 2);
+        assert(bound->attrs[1].rel_i == 0);
+        assert(bound->attrs[1].attr_i == 0);
+
+        assert(bound->pred_num == 1);
+        assert(bound->predicates[0].tag == SELECT_ATTR_CONST);
+        assert(bound->predicates[0].op == SELECT_GT);
+        assert(bound_attr_eq(bound->predicates[0].left_attr, bound->attrs[1]));
+        assert(bound->predicates[0].as.right_constant == 10);
+
+        assert(bound->has_order);
+        assert(bound->order_type == SORT_DESC);
+        assert(bound_attr_eq(bound->order_by_attr, bound->attrs[0]));
+
+        bound_select_destroy(bound);
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Attributes from multiple relations */
+    {
+        const char *query_str = "SELECT attr3, attr1 FROM rel1, rel2 WHERE id2 = id AND attr3 < 5;";
+
+        catalogue_t *cat = catalogue_create_for_test();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(parser_parse(parser, scanner, query));
+
+        bound_select_t *bound = bind_select(NULL, cat, &query->as.select);
+        assert(bound);
+
+        assert(bound->rel_num == 2);
+        assert(bound->rels[1] == catalogue_get_relation(cat, "rel2"));
+
+        assert(bound->attr_num == 2);
+        assert(bound->attrs[0].rel_i == 1);
+        assert(bound->attrs[0].attr_i == 1);
+        assert(bound->attrs[1].rel_i == 0);
+        assert(bound->attrs[1].attr_i == 1);
+
+        assert(bound->pred_num == 2);
+        assert(bound->predicates[0].tag == SELECT_ATTR_ATTR);
+        assert(bound->predicates[0].op == SELECT_EQ);
+        assert(bound->predicates[0].left_attr.rel_i == 1);
+        assert(bound->predicates[0].left_attr.attr_i == 0);
+        assert(bound->predicates[0].as.right_attr.rel_i == 0);
+        assert(bound->predicates[0].as.right_attr.attr_i == 0);
+
+        assert(bound->predicates[1].tag == SELECT_ATTR_CONST);
+        assert(bound->predicates[1].op == SELECT_LT);
+        assert(bound->predicates[1].left_attr.rel_i == 1);
+        assert(bound->predicates[1].left_attr.attr_i == 1);
+        assert(bound->predicates[1].as.right_constant == 5);
+
+        assert(!bound->has_order);
+
+        bound_select_destroy(bound);
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Parameters of a prepared select point into the bound query */
+    {
+        const char *query_str = "PREPARE q AS SELECT id FROM rel1 WHERE id > ? AND attr1 = 7 AND attr2 < ?;";
+
+        catalogue_t *cat = catalogue_create_for_test();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(parser_parse(parser, scanner, query));
+
+        bound_select_t *bound = bind_select(NULL, cat, &query->as.prepare.select);
+        assert(bound);
+
+        assert(bound->param_num == 2);
+        assert(bound->pred_num == 3);
+        assert(bound->predicates[0].tag == SELECT_ATTR_CONST);
+        assert(bound->predicates[0].right_param == &bound->params[0]);
+        assert(bound->predicates[1].tag == SELECT_ATTR_CONST);
+        assert(bound->predicates[1].right_param == NULL);
+        assert(bound->predicates[1].as.right_constant == 7);
+        assert(bound->predicates[2].tag == SELECT_ATTR_CONST);
+        assert(bound->predicates[2].right_param == &bound->params[1]);
+
+        bound_select_destroy(bound);
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Aggregates are output where they are listed, counts of all the tuples bind no attribute */
+    {
+        const char *query_str = "SELECT count(*), attr3, sum(attr1) FROM rel1, rel2 GROUP BY attr3;";
+
+        catalogue_t *cat = catalogue_create_for_test();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(parser_parse(parser, scanner, query));
+
+        bound_select_t *bound = bind_select(NULL, cat, &query->as.select);
+        assert(bound);
+
+        assert(bound->has_groups);
+        assert(bound->group_attr_num == 1);
+        assert(bound->group_attrs[0].rel_i == 1 && bound->group_attrs[0].attr_i == 1);
+
+        assert(bound->aggregate_num == 2);
+        assert(bound->aggregates[0].func == AGGREGATE_COUNT);
+        assert(0 == strcmp(bound->aggregates[0].name, "count(*)"));
+        assert(bound->aggregates[1].func == AGGREGATE_SUM);
+        assert(bound->aggregates[1].attr.rel_i == 0 && bound->aggregates[1].attr.attr_i == 1);
+
+        assert(bound->attr_num == 3);
+        assert(bound->attrs[0].rel_i == AGGREGATE_REL_I && bound->attrs[0].attr_i == 0);
+        assert(bound->attrs[1].rel_i == 1 && bound->attrs[1].attr_i == 1);
+        assert(bound->attrs[2].rel_i == AGGREGATE_REL_I && bound->attrs[2].attr_i == 1);
+
+        bound_select_destroy(bound);
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    select_bind_test();
+
+    return 0;
+}
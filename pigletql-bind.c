@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "pigletql-bind.h"
+
+bool bound_attr_eq(const bound_attr_t left, const bound_attr_t right)
+{
+    return left.rel_i == right.rel_i && left.attr_i == right.attr_i;
+}
+
+static bound_attr_t bind_attr(const bound_select_t *bound, const char *attr_name)
+{
+    for (uint16_t rel_i = 0; rel_i < bound->rel_num; rel_i++) {
+        uint16_t attr_i = relation_attr_i_by_name(bound->rels[rel_i], attr_name);
+        if (attr_i != ATTR_NOT_FOUND)
+            return (bound_attr_t){ .rel_i = rel_i, .attr_i = attr_i };
+    }
+    /* should be validated by now */
+    assert(false);
+}
+
+static bound_attr_t bind_attr_token(const bound_select_t *bound, const token_t token)
+{
+    attr_name_t attr_name = {0};
+    strncpy(attr_name, token.start, (size_t)token.length);
+    return bind_attr(bound, attr_name);
+}
+
+static void bind_predicate(const bound_select_t *bound,
+                           const query_predicate_t *predicate,
+                           bound_predicate_t *bound_predicate,
+                           uint16_t *param_i)
+{
+    /* On the left we always get an identifier */
+    assert(predicate->left.type == TOKEN_IDENT);
+    bound_predicate->left_attr = bind_attr_token(bound, predicate->left);
+
+    switch (predicate->op.type) {
+    case TOKEN_GREATER:
+        bound_predicate->op = SELECT_GT;
+        break;
+    case TOKEN_LESS:
+        bound_predicate->op = SELECT_LT;
+        break;
+    case TOKEN_EQUAL:
+        bound_predicate->op = SELECT_EQ;
+        break;
+    default:
+        /* Uknown predicate type */
+        assert(false);
+    }
+
+    /* On the right it's either a constant or another identifier */
+    if (predicate->right.type == TOKEN_IDENT) {
+        bound_predicate->tag = SELECT_ATTR_ATTR;
+        bound_predicate->as.right_attr = bind_attr_token(bound, predicate->right);
+    } else if (predicate->right.type == TOKEN_NUMBER) {
+        bound_predicate->tag = SELECT_ATTR_CONST;
+        bound_predicate->as.right_constant = predicate->right_value;
+    } else if (predicate->right.type == TOKEN_PARAM) {
+        /* Parameters are numbered in the order of predicates */
+        assert(*param_i < bound->param_num);
+        bound_predicate->tag = SELECT_ATTR_CONST;
+        bound_predicate->right_param = &bound->params[(*param_i)++];
+    } else {
+        /* Invalid token */
+        assert(false);
+    }
+}
+
+static void bind_aggregate(const bound_select_t *bound,
+                           const query_aggregate_t *aggregate,
+                           bound_aggregate_t *bound_aggregate)
+{
+    bound_aggregate->func = aggregate->func;
+    bound_aggregate->name = aggregate->name;
+    if (aggregate->func != AGGREGATE_COUNT)
+        bound_aggregate->attr = bind_attr(bound, aggregate->attr_name);
+}
+
+bound_select_t *bind_select(arena_t *arena, catalogue_t *cat, const query_select_t *query)
+{
+    bound_select_t *bound = arena_calloc(arena, 1, sizeof(*bound));
+    if (!bound)
+        goto bound_fail;
+    bound->arena = arena;
+
+    /* Aggregates are output along with attributes */
+    const uint16_t attr_num = query->attr_num + query->aggregate_num;
+    bound->rels = arena_calloc(arena, query->rel_num, sizeof(*bound->rels));
+    bound->attrs = arena_calloc(arena, attr_num, sizeof(*bound->attrs));
+    bound->predicates = arena_calloc(arena, query->pred_num, sizeof(*bound->predicates));
+    bound->params = arena_calloc(arena, query->param_num, sizeof(*bound->params));
+    bound->group_attrs = arena_calloc(arena, query->group_attr_num, sizeof(*bound->group_attrs));
+    bound->aggregates = arena_calloc(arena, query->aggregate_num, sizeof(*bound->aggregates));
+    if (!bound->rels || !bound->attrs || (query->pred_num && !bound->predicates) ||
+        (query->param_num && !bound->params) || (query->group_attr_num && !bound->group_attrs) ||
+        (query->aggregate_num && !bound->aggregates))
+        goto arrays_fail;
+
+    /* Relations are looked up once here */
+    bound->rel_num = query->rel_num;
+    for (uint16_t rel_i = 0; rel_i < query->rel_num; rel_i++) {
+        bound->rels[rel_i] = catalogue_get_relation(cat, query->rel_names[rel_i]);
+        assert(bound->rels[rel_i]);
+    }
+
+    bound->aggregate_num = query->aggregate_num;
+    for (uint16_t aggregate_i = 0; aggregate_i < query->aggregate_num; aggregate_i++)
+        bind_aggregate(bound, &query->aggregates[aggregate_i], &bound->aggregates[aggregate_i]);
+
+    bound->group_attr_num = query->group_attr_num;
+    for (uint16_t attr_i = 0; attr_i < query->group_attr_num; attr_i++)
+        bound->group_attrs[attr_i] = bind_attr(bound, query->group_attr_names[attr_i]);
+    bound->has_groups = query->group_attr_num > 0 || query->aggregate_num > 0;
+
+    /* Aggregates take their positions, attributes fill the rest */
+    bound->attr_num = attr_num;
+    uint16_t next_attr_i = 0, next_aggregate_i = 0;
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++) {
+        if (next_aggregate_i < query->aggregate_num && query->aggregates[next_aggregate_i].output_i == attr_i)
+            bound->attrs[attr_i] = (bound_attr_t){ .rel_i = AGGREGATE_REL_I, .attr_i = next_aggregate_i++ };
+        else
+            bound->attrs[attr_i] = bind_attr(bound, query->attr_names[next_attr_i++]);
+    }
+
+    bound->param_num = query->param_num;
+    bound->pred_num = query->pred_num;
+    uint16_t param_i = 0;
+    for (uint16_t pred_i = 0; pred_i < query->pred_num; pred_i++)
+        bind_predicate(bound, &query->predicates[pred_i], &bound->predicates[pred_i], &param_i);
+
+    bound->has_order = query->has_order;
+    if (query->has_order) {
+        bound->order_by_attr = bind_attr(bound, query->order_by_attr);
+        bound->order_type = query->order_type;
+    }
+
+    bound->has_limit = query->has_limit;
+    bound->limit = query->limit;
+    bound->offset = query->offset;
+
+    return bound;
+
+arrays_fail:
+    bound_select_destroy(bound);
+bound_fail:
+    return NULL;
+}
+
+void bound_select_destroy(bound_select_t *bound)
+{
+    if (!bound)
+        return;
+    arena_t *arena = bound->arena;
+    arena_free(arena, bound->rels);
+    arena_free(arena, bound->attrs);
+    arena_free(arena, bound->predicates);
+    arena_free(arena, bound->params);
+    arena_free(arena, bound->group_attrs);
+    arena_free(arena, bound->aggregates);
+    arena_free(arena, bound);
+}
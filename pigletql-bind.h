@@ -0,0 +1,94 @@
+#ifndef PIGLETQL_BIND_H
+#define PIGLETQL_BIND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+#include "pigletql-eval.h"
+#include "pigletql-catalogue.h"
+#include "pigletql-parser.h"
+
+/*
+ * Binding turns attribute names of a validated query into fixed attribute references, so that
+ * compiled operators never have to look attributes up by name
+ * */
+
+/* An attribute reference: a relation in the FROM list and an attribute of the relation */
+typedef struct bound_attr_t {
+    uint16_t rel_i;
+    uint16_t attr_i;
+} bound_attr_t;
+
+typedef struct bound_predicate_t {
+    select_predicate_tag tag;
+    select_predicate_op op;
+    bound_attr_t left_attr;
+    union {
+        value_type_t right_constant;
+        bound_attr_t right_attr;
+    } as;
+    /* Attribute-constant predicates of prepared statements read the constant from a parameter of the
+     * bound query, NULL for constants given in the query */
+    const value_type_t *right_param;
+} bound_predicate_t;
+
+/* Aggregates are referred to as attributes of a relation of their own, attr_i being the index of an
+ * aggregate of the bound query */
+#define AGGREGATE_REL_I UINT16_MAX
+
+/* Attribute values are never missing, so counts of an attribute are counts of tuples and have no
+ * attribute bound */
+typedef struct bound_aggregate_t {
+    aggregate_func_t func;
+    bound_attr_t attr;
+    /* Name of the output attribute */
+    const char *name;
+} bound_aggregate_t;
+
+typedef struct bound_select_t {
+    /* Arena the bound query is allocated in, NULL for the heap */
+    arena_t *arena;
+
+    /* Relations to get tuples from */
+    relation_t **rels;
+    uint16_t rel_num;
+
+    /* Attributes to output, aggregates included */
+    bound_attr_t *attrs;
+    uint16_t attr_num;
+
+    /* Predicates to apply to tuples */
+    bound_predicate_t *predicates;
+    uint16_t pred_num;
+
+    /* Aggregates of groups of tuples with equal values of group attributes, a single group of all the
+     * tuples if there are no group attributes */
+    bool has_groups;
+    bound_attr_t *group_attrs;
+    uint16_t group_attr_num;
+    bound_aggregate_t *aggregates;
+    uint16_t aggregate_num;
+
+    /* Parameter values, set before operators compiled from the query are opened */
+    value_type_t *params;
+    uint16_t param_num;
+
+    /* Attribute to sort by */
+    bool has_order;
+    bound_attr_t order_by_attr;
+    sort_order_t order_type;
+
+    /* Number of tuples to return and to skip */
+    bool has_limit;
+    value_type_t limit;
+    value_type_t offset;
+} bound_select_t;
+
+bool bound_attr_eq(const bound_attr_t left, const bound_attr_t right);
+
+bound_select_t *bind_select(arena_t *arena, catalogue_t *cat, const query_select_t *query);
+
+void bound_select_destroy(bound_select_t *bound);
+
+#endif //PIGLETQL_BIND_H
@@ -0,0 +1,122 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "pigletql-btree.h"
+
+/* Walk the whole tree checking entries come in (value, tuple id) order, return the number of entries */
+static uint32_t check_ordered(const btree_t *tree)
+{
+    btree_cursor_t cursor = btree_first(tree);
+    value_type_t value = 0, prev_value = 0;
+    uint32_t tuple_i = 0, prev_tuple_i = 0;
+    uint32_t entry_num = 0;
+    while (btree_cursor_next(&cursor, &value, &tuple_i)) {
+        if (entry_num > 0)
+            assert(prev_value < value || (prev_value == value && prev_tuple_i < tuple_i));
+        prev_value = value;
+        prev_tuple_i = tuple_i;
+        entry_num++;
+    }
+    return entry_num;
+}
+
+/* Number of entries with the value given, found starting from the lower bound */
+static uint32_t count_equal(const btree_t *tree, const value_type_t lookup_value)
+{
+    btree_cursor_t cursor = btree_lower_bound(tree, lookup_value);
+    value_type_t value = 0;
+    uint32_t tuple_i = 0;
+    uint32_t entry_num = 0;
+    while (btree_cursor_next(&cursor, &value, &tuple_i) && value == lookup_value)
+        entry_num++;
+    return entry_num;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* An empty tree */
+    {
+        btree_t *tree = btree_create();
+        assert(tree);
+        assert(btree_get_entry_num(tree) == 0);
+        assert(check_ordered(tree) == 0);
+        assert(count_equal(tree, 0) == 0);
+        btree_destroy(tree);
+    }
+
+    /* Entries in order, in reverse and at random, with many duplicates, spanning several levels */
+    for (int pattern = 0; pattern < 3; pattern++) {
+        btree_t *tree = btree_create();
+        const uint32_t entry_num = 200000;
+        const value_type_t distinct_num = 1000;
+
+        srand(42);
+        uint32_t *counts = calloc(distinct_num, sizeof(uint32_t));
+        assert(counts);
+        for (uint32_t entry_i = 0; entry_i < entry_num; entry_i++) {
+            value_type_t value = 0;
+            if (pattern == 0)
+                value = entry_i / (entry_num / distinct_num);
+            else if (pattern == 1)
+                value = distinct_num - 1 - entry_i / (entry_num / distinct_num);
+            else
+                value = (value_type_t)rand() % distinct_num;
+            btree_insert(tree, value, entry_i);
+            counts[value]++;
+        }
+        assert(btree_get_entry_num(tree) == entry_num);
+        assert(check_ordered(tree) == entry_num);
+
+        for (value_type_t value = 0; value < distinct_num; value++)
+            assert(count_equal(tree, value) == counts[value]);
+        assert(count_equal(tree, distinct_num) == 0);
+
+        /* Duplicates keep tuple id order */
+        btree_cursor_t cursor = btree_lower_bound(tree, 7);
+        value_type_t value = 0;
+        uint32_t tuple_i = 0, prev_tuple_i = 0;
+        for (uint32_t entry_i = 0; entry_i < counts[7]; entry_i++) {
+            assert(btree_cursor_next(&cursor, &value, &tuple_i));
+            assert(value == 7);
+            assert(entry_i == 0 || prev_tuple_i < tuple_i);
+            prev_tuple_i = tuple_i;
+        }
+
+        free(counts);
+
+        btree_reset(tree);
+        assert(btree_get_entry_num(tree) == 0);
+        assert(check_ordered(tree) == 0);
+
+        btree_destroy(tree);
+    }
+
+    /* Lower bounds falling between values and at the extremes */
+    {
+        btree_t *tree = btree_create();
+        for (uint32_t entry_i = 0; entry_i < 10000; entry_i++)
+            btree_insert(tree, entry_i * 2 + 1, entry_i);
+        btree_insert(tree, UINT32_MAX, 10000);
+
+        value_type_t value = 0;
+        uint32_t tuple_i = 0;
+        for (value_type_t lookup_value = 0; lookup_value < 20000; lookup_value++) {
+            btree_cursor_t cursor = btree_lower_bound(tree, lookup_value);
+            assert(btree_cursor_next(&cursor, &value, &tuple_i));
+            assert(value == (lookup_value % 2 ? lookup_value : lookup_value + 1));
+            assert(tuple_i == value / 2);
+        }
+
+        btree_cursor_t cursor = btree_lower_bound(tree, 20000);
+        assert(btree_cursor_next(&cursor, &value, &tuple_i));
+        assert(value == UINT32_MAX && tuple_i == 10000);
+        assert(!btree_cursor_next(&cursor, &value, &tuple_i));
+
+        btree_destroy(tree);
+    }
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "pigletql-btree.h"
+
+/* Leaves and inner nodes start with a common header telling them apart */
+typedef struct btree_node_t {
+    bool is_leaf;
+    /* Leaves: number of entries, inner nodes: number of keys, one less than the number of children */
+    uint16_t key_num;
+} btree_node_t;
+
+struct btree_leaf_t {
+    btree_node_t node;
+    value_type_t values[BTREE_NODE_SLOTS];
+    uint32_t tuple_is[BTREE_NODE_SLOTS];
+    struct btree_leaf_t *next;
+};
+
+typedef struct btree_inner_t {
+    btree_node_t node;
+    /* Key i is the first entry of the subtree of child i + 1 */
+    value_type_t values[BTREE_NODE_SLOTS - 1];
+    uint32_t tuple_is[BTREE_NODE_SLOTS - 1];
+    btree_node_t *children[BTREE_NODE_SLOTS];
+} btree_inner_t;
+
+struct btree_t {
+    btree_node_t *root;
+    uint32_t entry_num;
+};
+
+static inline bool btree_key_less(const value_type_t left_value, const uint32_t left_tuple_i,
+                                  const value_type_t right_value, const uint32_t right_tuple_i)
+{
+    return left_value < right_value || (left_value == right_value && left_tuple_i < right_tuple_i);
+}
+
+static btree_leaf_t *btree_leaf_create(void)
+{
+    btree_leaf_t *leaf = calloc(1, sizeof(*leaf));
+    assert(leaf);
+    leaf->node.is_leaf = true;
+    return leaf;
+}
+
+static btree_inner_t *btree_inner_create(void)
+{
+    btree_inner_t *inner = calloc(1, sizeof(*inner));
+    assert(inner);
+    return inner;
+}
+
+static void btree_node_destroy(btree_node_t *node)
+{
+    if (!node->is_leaf) {
+        btree_inner_t *inner = (btree_inner_t *)node;
+        for (uint16_t child_i = 0; child_i <= node->key_num; child_i++)
+            btree_node_destroy(inner->children[child_i]);
+    }
+    free(node);
+}
+
+btree_t *btree_create(void)
+{
+    btree_t *tree = calloc(1, sizeof(*tree));
+    if (!tree)
+        return NULL;
+    tree->root = &btree_leaf_create()->node;
+    return tree;
+}
+
+void btree_destroy(btree_t *tree)
+{
+    if (!tree)
+        return;
+    btree_node_destroy(tree->root);
+    free(tree);
+}
+
+void btree_reset(btree_t *tree)
+{
+    btree_node_destroy(tree->root);
+    tree->root = &btree_leaf_create()->node;
+    tree->entry_num = 0;
+}
+
+uint32_t btree_get_entry_num(const btree_t *tree)
+{
+    return tree->entry_num;
+}
+
+/*
+ * Insertion
+ *  */
+
+/* Index of the child of an inner node the key belongs to */
+static uint16_t btree_inner_child_i(const btree_inner_t *inner, const value_type_t value, const uint32_t tuple_i)
+{
+    uint16_t low = 0, high = inner->node.key_num;
+    while (low < high) {
+        const uint16_t mid = (low + high) / 2;
+        if (btree_key_less(value, tuple_i, inner->values[mid], inner->tuple_is[mid]))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+static void btree_leaf_insert_at(btree_leaf_t *leaf, const uint16_t pos, const value_type_t value,
+                                 const uint32_t tuple_i)
+{
+    const uint16_t tail_num = leaf->node.key_num - pos;
+    memmove(&leaf->values[pos + 1], &leaf->values[pos], tail_num * sizeof(value_type_t));
+    memmove(&leaf->tuple_is[pos + 1], &leaf->tuple_is[pos], tail_num * sizeof(uint32_t));
+    leaf->values[pos] = value;
+    leaf->tuple_is[pos] = tuple_i;
+    leaf->node.key_num++;
+}
+
+/* Insert into a subtree. A node split off to the right is returned along with its first key, NULL if
+ * the subtree root did not have to split. Nodes split when appending at their very end are left
+ * full, so entries inserted in order pack leaves densely. */
+static btree_node_t *btree_node_insert(btree_node_t *node, const value_type_t value, const uint32_t tuple_i,
+                                       value_type_t *split_value, uint32_t *split_tuple_i)
+{
+    if (node->is_leaf) {
+        btree_leaf_t *leaf = (btree_leaf_t *)node;
+        uint16_t pos = leaf->node.key_num;
+        while (pos > 0 && btree_key_less(value, tuple_i, leaf->values[pos - 1], leaf->tuple_is[pos - 1]))
+            pos--;
+
+        if (leaf->node.key_num < BTREE_NODE_SLOTS) {
+            btree_leaf_insert_at(leaf, pos, value, tuple_i);
+            return NULL;
+        }
+
+        const uint16_t left_num = pos == BTREE_NODE_SLOTS ? BTREE_NODE_SLOTS : BTREE_NODE_SLOTS / 2;
+        btree_leaf_t *right = btree_leaf_create();
+        right->node.key_num = BTREE_NODE_SLOTS - left_num;
+        memcpy(right->values, &leaf->values[left_num], right->node.key_num * sizeof(value_type_t));
+        memcpy(right->tuple_is, &leaf->tuple_is[left_num], right->node.key_num * sizeof(uint32_t));
+        leaf->node.key_num = left_num;
+        right->next = leaf->next;
+        leaf->next = right;
+
+        if (pos < left_num)
+            btree_leaf_insert_at(leaf, pos, value, tuple_i);
+        else
+            btree_leaf_insert_at(right, pos - left_num, value, tuple_i);
+
+        *split_value = right->values[0];
+        *split_tuple_i = right->tuple_is[0];
+        return &right->node;
+    }
+
+    btree_inner_t *inner = (btree_inner_t *)node;
+    const uint16_t child_i = btree_inner_child_i(inner, value, tuple_i);
+    value_type_t child_split_value = 0;
+    uint32_t child_split_tuple_i = 0;
+    btree_node_t *child_split = btree_node_insert(inner->children[child_i], value, tuple_i,
+                                                  &child_split_value, &child_split_tuple_i);
+    if (!child_split)
+        return NULL;
+
+    /* Lay keys and children out with the new ones in place, then either keep them or split them in two */
+    const uint16_t key_num = inner->node.key_num;
+    value_type_t values[BTREE_NODE_SLOTS];
+    uint32_t tuple_is[BTREE_NODE_SLOTS];
+    btree_node_t *children[BTREE_NODE_SLOTS + 1];
+    memcpy(values, inner->values, child_i * sizeof(value_type_t));
+    memcpy(tuple_is, inner->tuple_is, child_i * sizeof(uint32_t));
+    values[child_i] = child_split_value;
+    tuple_is[child_i] = child_split_tuple_i;
+    memcpy(&values[child_i + 1], &inner->values[child_i], (key_num - child_i) * sizeof(value_type_t));
+    memcpy(&tuple_is[child_i + 1], &inner->tuple_is[child_i], (key_num - child_i) * sizeof(uint32_t));
+    memcpy(children, inner->children, (child_i + 1) * sizeof(btree_node_t *));
+    children[child_i + 1] = child_split;
+    memcpy(&children[child_i + 2], &inner->children[child_i + 1], (key_num - child_i) * sizeof(btree_node_t *));
+
+    if (key_num + 1 < BTREE_NODE_SLOTS) {
+        memcpy(inner->values, values, (key_num + 1) * sizeof(value_type_t));
+        memcpy(inner->tuple_is, tuple_is, (key_num + 1) * sizeof(uint32_t));
+        memcpy(inner->children, children, (key_num + 2) * sizeof(btree_node_t *));
+        inner->node.key_num = key_num + 1;
+        return NULL;
+    }
+
+    /* The key in the middle moves up, keys to the right of it go to the new node */
+    const uint16_t mid = child_i + 1 == BTREE_NODE_SLOTS ? BTREE_NODE_SLOTS - 1 : BTREE_NODE_SLOTS / 2;
+    btree_inner_t *right = btree_inner_create();
+    right->node.key_num = BTREE_NODE_SLOTS - 1 - mid;
+    memcpy(right->values, &values[mid + 1], right->node.key_num * sizeof(value_type_t));
+    memcpy(right->tuple_is, &tuple_is[mid + 1], right->node.key_num * sizeof(uint32_t));
+    memcpy(right->children, &children[mid + 1], (right->node.key_num + 1) * sizeof(btree_node_t *));
+
+    memcpy(inner->values, values, mid * sizeof(value_type_t));
+    memcpy(inner->tuple_is, tuple_is, mid * sizeof(uint32_t));
+    memcpy(inner->children, children, (mid + 1) * sizeof(btree_node_t *));
+    inner->node.key_num = mid;
+
+    *split_value = values[mid];
+    *split_tuple_i = tuple_is[mid];
+    return &right->node;
+}
+
+void btree_insert(btree_t *tree, const value_type_t value, const uint32_t tuple_i)
+{
+    value_type_t split_value = 0;
+    uint32_t split_tuple_i = 0;
+    btree_node_t *split = btree_node_insert(tree->root, value, tuple_i, &split_value, &split_tuple_i);
+    if (split) {
+        btree_inner_t *root = btree_inner_create();
+        root->node.key_num = 1;
+        root->values[0] = split_value;
+        root->tuple_is[0] = split_tuple_i;
+        root->children[0] = tree->root;
+        root->children[1] = split;
+        tree->root = &root->node;
+    }
+    tree->entry_num++;
+}
+
+/*
+ * Lookups
+ *  */
+
+btree_cursor_t btree_first(const btree_t *tree)
+{
+    const btree_node_t *node = tree->root;
+    while (!node->is_leaf)
+        node = ((const btree_inner_t *)node)->children[0];
+    return (btree_cursor_t) { .leaf = (const btree_leaf_t *)node, .entry_i = 0 };
+}
+
+btree_cursor_t btree_lower_bound(const btree_t *tree, const value_type_t value)
+{
+    /* Tuple ids start with 0, so (value, 0) is the smallest key with the value */
+    const btree_node_t *node = tree->root;
+    while (!node->is_leaf) {
+        const btree_inner_t *inner = (const btree_inner_t *)node;
+        node = inner->children[btree_inner_child_i(inner, value, 0)];
+    }
+
+    const btree_leaf_t *leaf = (const btree_leaf_t *)node;
+    uint16_t low = 0, high = leaf->node.key_num;
+    while (low < high) {
+        const uint16_t mid = (low + high) / 2;
+        if (leaf->values[mid] < value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    /* Entries past the end of the leaf continue in the next one */
+    return (btree_cursor_t) { .leaf = leaf, .entry_i = low };
+}
+
+bool btree_cursor_next(btree_cursor_t *cursor, value_type_t *value, uint32_t *tuple_i)
+{
+    while (cursor->leaf && cursor->entry_i == cursor->leaf->node.key_num) {
+        cursor->leaf = cursor->leaf->next;
+        cursor->entry_i = 0;
+    }
+    if (!cursor->leaf)
+        return false;
+
+    *value = cursor->leaf->values[cursor->entry_i];
+    *tuple_i = cursor->leaf->tuple_is[cursor->entry_i];
+    cursor->entry_i++;
+    return true;
+}
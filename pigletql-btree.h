@@ -0,0 +1,48 @@
+#ifndef PIGLETQL_BTREE_H
+#define PIGLETQL_BTREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+
+/*
+ * A B+tree maps attribute values to ids of tuples holding them. Entries are (value, tuple id) pairs
+ * kept in order, so tuples with equal values follow each other in the order of their ids. Entries
+ * live in leaves linked left to right for range scans. There are no deletions, relations only grow.
+ * */
+
+/* Maximum number of entries in a leaf, and of children of an inner node */
+#define BTREE_NODE_SLOTS 64
+
+typedef struct btree_t btree_t;
+
+typedef struct btree_leaf_t btree_leaf_t;
+
+/* A position of an entry in a tree, valid until the next insertion */
+typedef struct btree_cursor_t {
+    const btree_leaf_t *leaf;
+    uint16_t entry_i;
+} btree_cursor_t;
+
+btree_t *btree_create(void);
+
+void btree_destroy(btree_t *tree);
+
+void btree_insert(btree_t *tree, const value_type_t value, const uint32_t tuple_i);
+
+/* Drop all the entries */
+void btree_reset(btree_t *tree);
+
+uint32_t btree_get_entry_num(const btree_t *tree);
+
+/* A cursor at the first entry of the tree */
+btree_cursor_t btree_first(const btree_t *tree);
+
+/* A cursor at the first entry with a value not less than the value given */
+btree_cursor_t btree_lower_bound(const btree_t *tree, const value_type_t value);
+
+/* Read the entry at the cursor and move the cursor to the next one, false if there are no entries left */
+bool btree_cursor_next(btree_cursor_t *cursor, value_type_t *value, uint32_t *tuple_i);
+
+#endif //PIGLETQL_BTREE_H
@@ -1,5 +1,9 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "pigletql-def.h"
 #include "pigletql-catalogue.h"
@@ -38,5 +42,149 @@ int main(int argc, char *argv[])
         catalogue_destroy(cat);
     }
 
+    /* Indexes are kept by relations, the catalogue knows their names and what they index */
+    {
+        catalogue_t *cat = catalogue_create();
+        assert(cat);
+
+        const attr_name_t attr_names[] = {"id", "attr1"};
+        relation_t *rel1 = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        catalogue_add_relation(cat, "rel1", rel1);
+        relation_append_values(rel1, (value_type_t[]){1, 10});
+
+        assert(!catalogue_has_index(cat, "idx1"));
+        assert(!catalogue_add_index(cat, "idx1", "no rel", 1, INDEX_BTREE));
+        assert(!catalogue_has_index(cat, "idx1"));
+
+        assert(catalogue_add_index(cat, "idx1", "rel1", 1, INDEX_BTREE));
+        assert(catalogue_has_index(cat, "idx1"));
+        assert(!catalogue_has_index(cat, "rel1"));
+        assert(catalogue_has_attr_index(cat, "rel1", 1, INDEX_BTREE));
+        assert(!catalogue_has_attr_index(cat, "rel1", 1, INDEX_HASH));
+        assert(!catalogue_has_attr_index(cat, "rel1", 0, INDEX_BTREE));
+        const btree_t *index = relation_get_index(rel1, 1);
+        assert(index);
+        assert(!relation_get_index(rel1, 0));
+
+        /* A hash index over the same attribute */
+        assert(catalogue_add_index(cat, "idx2", "rel1", 1, INDEX_HASH));
+        assert(catalogue_has_attr_index(cat, "rel1", 1, INDEX_HASH));
+        const hash_index_t *hash_index = relation_get_hash_index(rel1, 1);
+        assert(hash_index);
+        assert(!relation_get_hash_index(rel1, 0));
+
+        /* Tuples present before and after the indexes were created */
+        relation_append_values(rel1, (value_type_t[]){2, 20});
+        assert(btree_get_entry_num(index) == 2);
+        assert(hash_index_get_entry_num(hash_index) == 2);
+
+        catalogue_destroy(cat);
+    }
+
+    /* Thousands of relations, each with an index of its own */
+    {
+        catalogue_t *cat = catalogue_create();
+        assert(cat);
+
+        const attr_name_t attr_names[] = {"id", "attr1"};
+        const uint32_t rel_num = 5000;
+        rel_name_t rel_name = {0}, index_name = {0};
+        for (uint32_t rel_i = 0; rel_i < rel_num; rel_i++) {
+            snprintf(rel_name, sizeof(rel_name), "rel%u", rel_i);
+            relation_t *rel = relation_create(attr_names, ARRAY_SIZE(attr_names));
+            assert(catalogue_add_relation(cat, rel_name, rel) == rel);
+            relation_append_values(rel, (value_type_t[]){rel_i, 0});
+
+            snprintf(index_name, sizeof(index_name), "idx%u", rel_i);
+            assert(catalogue_add_index(cat, index_name, rel_name, rel_i % 2, INDEX_HASH));
+        }
+
+        for (uint32_t rel_i = 0; rel_i < rel_num; rel_i++) {
+            snprintf(rel_name, sizeof(rel_name), "rel%u", rel_i);
+            relation_t *rel = catalogue_get_relation(cat, rel_name);
+            assert(rel && relation_get_value(rel, 0, 0) == rel_i);
+            assert(catalogue_has_attr_index(cat, rel_name, rel_i % 2, INDEX_HASH));
+            assert(!catalogue_has_attr_index(cat, rel_name, (rel_i + 1) % 2, INDEX_HASH));
+            assert(!catalogue_has_attr_index(cat, rel_name, rel_i % 2, INDEX_BTREE));
+
+            snprintf(index_name, sizeof(index_name), "idx%u", rel_i);
+            assert(catalogue_has_index(cat, index_name));
+        }
+        assert(!catalogue_get_relation(cat, "rel5000"));
+        assert(!catalogue_has_index(cat, "idx5000"));
+        assert(!catalogue_has_attr_index(cat, "rel5000", 0, INDEX_HASH));
+
+        /* Names are taken once, the relation there stays */
+        relation_t *rel = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        assert(!catalogue_add_relation(cat, "rel42", rel));
+        relation_destroy(rel);
+        assert(relation_get_value(catalogue_get_relation(cat, "rel42"), 0, 0) == 42);
+        assert(!catalogue_add_index(cat, "idx42", "rel43", 0, INDEX_BTREE));
+        assert(!relation_get_index(catalogue_get_relation(cat, "rel43"), 0));
+
+        catalogue_destroy(cat);
+    }
+
+    /* Relations and indexes saved to a directory come back when it's opened */
+    {
+        char dir[] = "/tmp/pigletql-catalogue-test-XXXXXX";
+        assert(mkdtemp(dir));
+
+        /* Nothing saved yet */
+        catalogue_t *cat = catalogue_open(dir);
+        assert(cat);
+        assert(!catalogue_get_relation(cat, "rel1"));
+
+        const char *attr_names[] = {"id", "attr1"};
+        relation_t *rel1 = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+        catalogue_add_relation(cat, "rel1", rel1);
+        for (value_type_t i = 0; i < 1000; i++)
+            relation_append_values(rel1, (value_type_t[]){i, i % 7});
+        assert(catalogue_add_index(cat, "idx1", "rel1", 1, INDEX_HASH));
+        assert(catalogue_save(cat, dir));
+        catalogue_destroy(cat);
+
+        for (int run = 0; run < 2; run++) {
+            cat = catalogue_open(dir);
+            assert(cat);
+            rel1 = catalogue_get_relation(cat, "rel1");
+            assert(rel1);
+            assert(relation_get_layout(rel1) == LAYOUT_COLUMNS);
+            assert(relation_get_tuple_num(rel1) == 1000 + run);
+            assert(relation_get_value(rel1, 999, 0) == 999 && relation_get_value(rel1, 999, 1) == 999 % 7);
+            assert(catalogue_has_index(cat, "idx1"));
+            assert(catalogue_has_attr_index(cat, "rel1", 1, INDEX_HASH));
+            assert(hash_index_get_entry_num(relation_get_hash_index(rel1, 1)) == 1000 + run);
+
+            /* Unchanged relations are not written again */
+            char rel_path[sizeof(dir) + 32];
+            snprintf(rel_path, sizeof(rel_path), "%s/rel1.rel", dir);
+            struct stat before, after;
+            assert(stat(rel_path, &before) == 0);
+            assert(catalogue_save(cat, dir));
+            assert(stat(rel_path, &after) == 0);
+            assert(before.st_ino == after.st_ino);
+
+            /* Saving over the files mapped */
+            relation_append_values(rel1, (value_type_t[]){5000, 1});
+            assert(catalogue_save(cat, dir));
+            catalogue_destroy(cat);
+        }
+
+        /* Garbage instead of a relation file */
+        char path[sizeof(dir) + 32];
+        snprintf(path, sizeof(path), "%s/rel1.rel", dir);
+        FILE *file = fopen(path, "w");
+        assert(file);
+        fputs("not a relation", file);
+        fclose(file);
+        assert(!catalogue_open(dir));
+
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/catalogue", dir);
+        unlink(path);
+        rmdir(dir);
+    }
+
     return 0;
 }
@@ -1,42 +1,107 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "pigletql-catalogue.h"
+#include "pigletql-names.h"
+
+struct index_record_t;
 
 typedef struct record_t {
     rel_name_t name;
     relation_t *relation;
+    /* Catalogue relations only ever grow, so a relation saved with as many tuples as it has now is
+     * saved already */
+    bool is_saved;
+    uint32_t saved_tuple_num;
+    /* Indexes over the relation */
+    struct index_record_t *index_list;
     struct record_t *next;
 } record_t;
 
+/* Indexes themselves belong to relations, the catalogue only knows what they index */
+typedef struct index_record_t {
+    rel_name_t name;
+    record_t *rel_record;
+    uint16_t attr_i;
+    index_type_t type;
+    /* Next index over the same relation */
+    struct index_record_t *rel_next;
+    struct index_record_t *next;
+} index_record_t;
+
+/* Records by name. Records never move, so their names stay valid in name tables and pointers to
+ * records and their relations stay valid too. */
 typedef struct catalogue_t {
+    name_table_t records;
+    name_table_t index_records;
+    /* Both lists are kept in the order of creation for saving */
     record_t *record_list;
+    record_t **record_tail;
+    index_record_t *index_record_list;
+    index_record_t **index_record_tail;
+    /* The directory records were last saved to or opened from, NULL if none */
+    char *saved_dir;
 } catalogue_t;
 
+/* The catalogue file lists relations and indexes a line each */
+#define CATALOGUE_FILE_NAME "catalogue"
+#define CATALOGUE_FILE_HEADER "pigletql catalogue 1"
+/* Relation files are named after relations */
+#define RELATION_FILE_SUFFIX ".rel"
+
+/* Names are cut to fit records, so that record names are always zero-terminated */
+static void *catalogue_get_record(const name_table_t *table, const char *name)
+{
+    return name_table_get(table, name, strnlen(name, MAX_REL_NAME_LEN - 1));
+}
+
+static bool catalogue_add_record(name_table_t *table, char *record_name, const char *name, void *record)
+{
+    const size_t len = strnlen(name, MAX_REL_NAME_LEN - 1);
+    memcpy(record_name, name, len);
+    record_name[len] = '\0';
+    return name_table_add(table, record_name, len, record);
+}
+
 catalogue_t *catalogue_create(void)
 {
     catalogue_t *cat = calloc(1, sizeof(*cat));
     if (!cat)
         return NULL;
+    cat->record_tail = &cat->record_list;
+    cat->index_record_tail = &cat->index_record_list;
 
     return cat;
 }
 
 void catalogue_destroy(catalogue_t *cat)
 {
-    for (record_t **this = &cat->record_list; *this; this = &(*this)->next) {
-        relation_destroy((*this)->relation);
-        free(*this);
+    for (record_t *this = cat->record_list; this;) {
+        record_t *next = this->next;
+        relation_destroy(this->relation);
+        free(this);
+        this = next;
+    }
+    for (index_record_t *this = cat->index_record_list; this;) {
+        index_record_t *next = this->next;
+        free(this);
+        this = next;
     }
+    name_table_destroy(&cat->records);
+    name_table_destroy(&cat->index_records);
+    free(cat->saved_dir);
     free(cat);
 }
 
 relation_t *catalogue_get_relation(catalogue_t *cat, const rel_name_t rel_name)
 {
-    for (record_t **this = &cat->record_list; *this; this = &(*this)->next)
-        if (0 == strncmp((*this)->name, rel_name, MAX_REL_NAME_LEN))
-            return (*this)->relation;
-    return NULL;
+    record_t *record = catalogue_get_record(&cat->records, rel_name);
+    return record ? record->relation : NULL;
 }
 
 relation_t *catalogue_add_relation(catalogue_t *cat, const rel_name_t rel_name, relation_t *rel)
@@ -44,12 +109,193 @@ relation_t *catalogue_add_relation(catalogue_t *cat, const rel_name_t rel_name,
     record_t *record = calloc(1, sizeof(*record));
     if (!record)
         return NULL;
-    strncpy(record->name, rel_name, MAX_REL_NAME_LEN);
     record->relation = rel;
 
-    record_t **this = &cat->record_list;
-    for (; *this; this = &(*this)->next);
-    *this = record;
+    if (!catalogue_add_record(&cat->records, record->name, rel_name, record)) {
+        free(record);
+        return NULL;
+    }
+
+    *cat->record_tail = record;
+    cat->record_tail = &record->next;
 
     return rel;
 }
+
+bool catalogue_has_index(catalogue_t *cat, const rel_name_t index_name)
+{
+    return catalogue_get_record(&cat->index_records, index_name) != NULL;
+}
+
+bool catalogue_has_attr_index(catalogue_t *cat, const rel_name_t rel_name, const uint16_t attr_i,
+                              const index_type_t type)
+{
+    const record_t *rel_record = catalogue_get_record(&cat->records, rel_name);
+    if (!rel_record)
+        return false;
+    for (index_record_t *this = rel_record->index_list; this; this = this->rel_next)
+        if (this->attr_i == attr_i && this->type == type)
+            return true;
+    return false;
+}
+
+bool catalogue_add_index(catalogue_t *cat, const rel_name_t index_name, const rel_name_t rel_name,
+                         const uint16_t attr_i, const index_type_t type)
+{
+    record_t *rel_record = catalogue_get_record(&cat->records, rel_name);
+    if (!rel_record)
+        return false;
+    relation_t *rel = rel_record->relation;
+
+    index_record_t *record = calloc(1, sizeof(*record));
+    if (!record)
+        return false;
+    record->rel_record = rel_record;
+    record->attr_i = attr_i;
+    record->type = type;
+
+    if (!catalogue_add_record(&cat->index_records, record->name, index_name, record)) {
+        free(record);
+        return false;
+    }
+
+    *cat->index_record_tail = record;
+    cat->index_record_tail = &record->next;
+    record->rel_next = rel_record->index_list;
+    rel_record->index_list = record;
+
+    switch (type) {
+    case INDEX_BTREE:
+        relation_create_index(rel, attr_i);
+        return true;
+    case INDEX_HASH:
+        relation_create_hash_index(rel, attr_i);
+        return true;
+    }
+    assert(false);
+}
+
+static void catalogue_relation_path(char *path, const size_t path_size, const char *dir, const rel_name_t rel_name)
+{
+    snprintf(path, path_size, "%s/%.*s" RELATION_FILE_SUFFIX, dir, MAX_REL_NAME_LEN, rel_name);
+}
+
+static bool catalogue_write_file(catalogue_t *cat, FILE *file)
+{
+    fprintf(file, "%s\n", CATALOGUE_FILE_HEADER);
+    for (record_t *this = cat->record_list; this; this = this->next)
+        fprintf(file, "relation %s\n", this->name);
+    for (index_record_t *this = cat->index_record_list; this; this = this->next)
+        fprintf(file, "index %s %s %u %s\n", this->name, this->rel_record->name, this->attr_i,
+                this->type == INDEX_HASH ? "hash" : "btree");
+    return !ferror(file) && fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+/* Remember relations as saved to the directory given as they are now */
+static bool catalogue_mark_saved(catalogue_t *cat, const char *dir)
+{
+    if (!cat->saved_dir || 0 != strcmp(cat->saved_dir, dir)) {
+        char *saved_dir = strdup(dir);
+        if (!saved_dir)
+            return false;
+        free(cat->saved_dir);
+        cat->saved_dir = saved_dir;
+    }
+    for (record_t *this = cat->record_list; this; this = this->next) {
+        this->is_saved = true;
+        this->saved_tuple_num = relation_get_tuple_num(this->relation);
+    }
+    return true;
+}
+
+bool catalogue_save(catalogue_t *cat, const char *dir)
+{
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+        return false;
+
+    const size_t path_size = strlen(dir) + MAX_REL_NAME_LEN + sizeof(CATALOGUE_FILE_NAME RELATION_FILE_SUFFIX ".tmp") + 1;
+    char path[path_size];
+    const bool is_saved_dir = cat->saved_dir && 0 == strcmp(cat->saved_dir, dir);
+    for (record_t *this = cat->record_list; this; this = this->next) {
+        /* Relations unchanged since they were saved to the same directory are skipped */
+        if (is_saved_dir && this->is_saved && this->saved_tuple_num == relation_get_tuple_num(this->relation))
+            continue;
+        catalogue_relation_path(path, path_size, dir, this->name);
+        if (!relation_save(this->relation, path))
+            return false;
+    }
+
+    /* The catalogue file is replaced last, pointing at relation files saved already */
+    char tmp_path[path_size];
+    snprintf(path, path_size, "%s/" CATALOGUE_FILE_NAME, dir);
+    snprintf(tmp_path, path_size, "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "w");
+    if (!file)
+        return false;
+    const bool is_written = catalogue_write_file(cat, file);
+    if (fclose(file) != 0 || !is_written || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    return catalogue_mark_saved(cat, dir);
+}
+
+static bool catalogue_read_file(catalogue_t *cat, const char *dir, FILE *file)
+{
+    char line[3 * MAX_REL_NAME_LEN + 64];
+    if (!fgets(line, sizeof(line), file) || strncmp(line, CATALOGUE_FILE_HEADER "\n", sizeof(line)) != 0)
+        return false;
+
+    const size_t path_size = strlen(dir) + MAX_REL_NAME_LEN + sizeof(RELATION_FILE_SUFFIX) + 1;
+    char path[path_size];
+    while (fgets(line, sizeof(line), file)) {
+        rel_name_t name = {0}, rel_name = {0};
+        char type[8] = {0};
+        unsigned attr_i = 0;
+        if (sscanf(line, "relation %255s", name) == 1) {
+            catalogue_relation_path(path, path_size, dir, name);
+            relation_t *rel = relation_open(path);
+            if (!rel)
+                return false;
+            if (!catalogue_add_relation(cat, name, rel)) {
+                relation_destroy(rel);
+                return false;
+            }
+        } else if (sscanf(line, "index %255s %255s %u %7s", name, rel_name, &attr_i, type) == 4) {
+            relation_t *rel = catalogue_get_relation(cat, rel_name);
+            if (!rel || attr_i >= relation_get_attr_num(rel))
+                return false;
+            const index_type_t index_type = 0 == strcmp(type, "hash") ? INDEX_HASH : INDEX_BTREE;
+            if (!catalogue_add_index(cat, name, rel_name, (uint16_t)attr_i, index_type))
+                return false;
+        } else {
+            return false;
+        }
+    }
+    return !ferror(file);
+}
+
+catalogue_t *catalogue_open(const char *dir)
+{
+    catalogue_t *cat = catalogue_create();
+    if (!cat)
+        return NULL;
+
+    char path[strlen(dir) + sizeof("/" CATALOGUE_FILE_NAME)];
+    sprintf(path, "%s/" CATALOGUE_FILE_NAME, dir);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        if (errno == ENOENT)
+            return cat;
+        catalogue_destroy(cat);
+        return NULL;
+    }
+
+    const bool is_read = catalogue_read_file(cat, dir, file) && catalogue_mark_saved(cat, dir);
+    fclose(file);
+    if (!is_read) {
+        catalogue_destroy(cat);
+        return NULL;
+    }
+    return cat;
+}
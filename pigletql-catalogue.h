@@ -12,8 +12,41 @@ catalogue_t *catalogue_create(void);
 
 void catalogue_destroy(catalogue_t *catalogue);
 
+/*
+ * Relations and indexes are found by name in hash tables, so schemas with many relations cost no more
+ * per lookup than small ones.
+ * */
+
+/* Relations returned stay where they are for as long as the catalogue, so callers look names up once
+ * and keep the relations. NULL if there's no such relation. */
 relation_t *catalogue_get_relation(catalogue_t *catalogue, const rel_name_t rel_name);
 
+/* Add a relation owned by the catalogue from now on, NULL if the name is taken */
 relation_t *catalogue_add_relation(catalogue_t *catalogue, const rel_name_t rel_name, relation_t *rel);
 
+/* Index names share the length limit of relation names, but live in a namespace of their own */
+bool catalogue_has_index(catalogue_t *catalogue, const rel_name_t index_name);
+
+/* Is there an index of the type given over an attribute of a relation? */
+bool catalogue_has_attr_index(catalogue_t *catalogue, const rel_name_t rel_name, const uint16_t attr_i,
+                              const index_type_t type);
+
+/* Index an attribute of a relation under the name given, false if there's no such relation or the
+ * index name is taken */
+bool catalogue_add_index(catalogue_t *catalogue, const rel_name_t index_name, const rel_name_t rel_name,
+                         const uint16_t attr_i, const index_type_t type);
+
+/*
+ * Catalogues are persisted to a directory: a file per relation, see relation_save(), and a catalogue
+ * file listing relations and indexes. Indexes are rebuilt when the catalogue is opened.
+ * */
+
+/* Save the relations and the catalogue file, creating the directory if needed. Relations that have not
+ * grown since they were saved to or opened from the same directory are not written again. */
+bool catalogue_save(catalogue_t *catalogue, const char *dir);
+
+/* Open a catalogue saved to a directory, an empty one if nothing was saved there yet. Relation files
+ * get mapped. NULL if the files saved cannot be read. */
+catalogue_t *catalogue_open(const char *dir);
+
 #endif //PIGLETQL_CATALOGUE_H
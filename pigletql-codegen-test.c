@@ -0,0 +1,134 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pigletql-codegen.h"
+
+/* Count tuples and sum attribute values returned, checking every row against predicates */
+static uint32_t consume_batches(operator_t *op, uint64_t *sum)
+{
+    uint32_t row_num = 0;
+    *sum = 0;
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state))) {
+        assert(batch->attr_num == 2);
+        assert(0 == strcmp(batch->attr_names[0], "attr2"));
+        assert(0 == strcmp(batch->attr_names[1], "id"));
+        for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+            const uint16_t row_i = batch->sel[sel_i];
+            *sum += batch->columns[0][row_i];
+            row_num++;
+        }
+    }
+    op->close(op->state);
+    return row_num;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    assert(!codegen_is_enabled());
+    codegen_set_enabled(true);
+    assert(codegen_is_enabled());
+    codegen_set_enabled(false);
+
+    /* attr2, id of tuples where attr1 = constant and id > attr2 */
+    const codegen_predicate_t predicates[] = {
+        { .tag = SELECT_ATTR_CONST, .op = SELECT_EQ, .left_attr_i = 1 },
+        { .tag = SELECT_ATTR_ATTR, .op = SELECT_GT, .left_attr_i = 0, .right_attr_i = 2 },
+    };
+    const uint16_t out_attr_is[] = {2, 0};
+
+    const compiled_pipeline_fn pipeline_fn = codegen_pipeline(predicates, ARRAY_SIZE(predicates),
+                                                              out_attr_is, ARRAY_SIZE(out_attr_is));
+    if (!pipeline_fn) {
+        fprintf(stderr, "No C compiler found, skipping code generation checks\n");
+        return 0;
+    }
+    assert(codegen_get_compile_num() == 1);
+
+    /* Pipelines of the same shape share modules whatever the constants are */
+    assert(pipeline_fn == codegen_pipeline(predicates, ARRAY_SIZE(predicates), out_attr_is,
+                                           ARRAY_SIZE(out_attr_is)));
+    assert(codegen_get_compile_num() == 1);
+
+    /* Compiled pipelines return the same tuples over both layouts, more than a batch of them */
+    for (relation_layout_t layout = LAYOUT_ROWS; layout <= LAYOUT_COLUMNS; layout++) {
+        const char *attr_names[] = {"id", "attr1", "attr2"};
+        relation_t *relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+        const uint32_t tuple_num = 10 * BATCH_SIZE + 17;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i % 3, tuple_i % 2 ? tuple_i / 2 : tuple_i + 1};
+            relation_append_values(relation, values);
+        }
+
+        for (value_type_t constant = 0; constant < 4; constant++) {
+            uint32_t expected_num = 0;
+            uint64_t expected_sum = 0;
+            for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+                const value_type_t attr2 = tuple_i % 2 ? tuple_i / 2 : tuple_i + 1;
+                if (tuple_i % 3 == constant && tuple_i > attr2) {
+                    expected_num++;
+                    expected_sum += attr2;
+                }
+            }
+
+            operator_t *op = compiled_op_create(NULL, relation, pipeline_fn, (value_type_t[]){constant, 0}, 2,
+                                                out_attr_is, ARRAY_SIZE(out_attr_is));
+            assert(op);
+
+            /* Twice to check reopening */
+            for (int run = 0; run < 2; run++) {
+                uint64_t sum = 0;
+                assert(consume_batches(op, &sum) == expected_num);
+                assert(sum == expected_sum);
+            }
+
+            /* Tuples */
+            op->open(op->state);
+            uint32_t tuples_received = 0;
+            tuple_t *tuple = NULL;
+            while ((tuple = op->next(op->state))) {
+                assert(tuple_get_attr_num(tuple) == 2);
+                assert(tuple_get_attr_value(tuple, "id") % 3 == constant);
+                assert(tuple_get_attr_value(tuple, "id") > tuple_get_attr_value(tuple, "attr2"));
+                tuples_received++;
+            }
+            assert(tuples_received == expected_num);
+            op->close(op->state);
+
+            op->destroy(op);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Empty relations */
+    {
+        const char *attr_names[] = {"id", "attr1", "attr2"};
+        relation_t *relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+        operator_t *op = compiled_op_create(NULL, relation, pipeline_fn, (value_type_t[]){0, 0}, 2,
+                                            out_attr_is, ARRAY_SIZE(out_attr_is));
+        op->open(op->state);
+        assert(!op->next_batch(op->state));
+        op->close(op->state);
+        op->destroy(op);
+        relation_destroy(relation);
+    }
+
+    /* No compiler means no function, and failures are not retried */
+    {
+        setenv("CC", "/nonexistent/cc", 1);
+        const uint16_t other_out_attr_is[] = {1};
+        assert(!codegen_pipeline(predicates, 1, other_out_attr_is, ARRAY_SIZE(other_out_attr_is)));
+        assert(codegen_get_compile_num() == 2);
+        assert(!codegen_pipeline(predicates, 1, other_out_attr_is, ARRAY_SIZE(other_out_attr_is)));
+        assert(codegen_get_compile_num() == 2);
+        unsetenv("CC");
+    }
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include "pigletql-codegen.h"
+#include "pigletql-names.h"
+
+/* Generated code declares types of its own, so make sure they are what pigletql-def.h says */
+#define CODEGEN_VALUE_TYPE "uint32_t"
+_Static_assert(sizeof(value_type_t) == sizeof(uint32_t) && (value_type_t)-1 > 0,
+               "generated code assumes 32-bit unsigned values");
+
+#define CODEGEN_SYMBOL "pigletql_pipeline"
+
+typedef struct codegen_module_t {
+    char *source;
+    /* NULL if compilation failed */
+    void *handle;
+    compiled_pipeline_fn fn;
+} codegen_module_t;
+
+static bool codegen_enabled;
+/* Modules by source. Modules loaded are never unloaded, functions might be referenced by operators. */
+static name_table_t codegen_modules;
+static uint32_t codegen_compile_num;
+
+void codegen_set_enabled(const bool is_enabled)
+{
+    codegen_enabled = is_enabled;
+}
+
+bool codegen_is_enabled(void)
+{
+    return codegen_enabled;
+}
+
+uint32_t codegen_get_compile_num(void)
+{
+    return codegen_compile_num;
+}
+
+/*
+ * Source generation
+ *  */
+
+static const char *codegen_op_str(const select_predicate_op op)
+{
+    switch (op) {
+    case SELECT_GT:
+        return ">";
+    case SELECT_LT:
+        return "<";
+    case SELECT_EQ:
+        return "==";
+    }
+    assert(false);
+}
+
+/* The loop is emitted for the stride given, a literal one lets the compiler vectorize columnar scans */
+static void codegen_emit_loop(FILE *out,
+                              const codegen_predicate_t *predicates,
+                              const uint16_t predicate_num,
+                              const uint16_t *out_attr_is,
+                              const uint16_t out_attr_num,
+                              const bool *is_attr_used,
+                              const uint16_t attr_num,
+                              const char *stride)
+{
+    fprintf(out, "        for (; tuple_i < end_tuple_i && row_num < %d; tuple_i++) {\n", BATCH_SIZE);
+    fprintf(out, "            const size_t offset = (size_t)tuple_i * %s;\n", stride);
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        if (is_attr_used[attr_i])
+            fprintf(out, "            const value_type_t value_%u = attr_%u[offset];\n", attr_i, attr_i);
+
+    /* Rows are written anyway and only counted when passing, so there are no branches */
+    fprintf(out, "            const unsigned passes = 1");
+    for (uint16_t pred_i = 0; pred_i < predicate_num; pred_i++) {
+        const codegen_predicate_t *predicate = &predicates[pred_i];
+        if (predicate->tag == SELECT_ATTR_CONST)
+            fprintf(out, " & (value_%u %s constant_%u)", predicate->left_attr_i,
+                    codegen_op_str(predicate->op), pred_i);
+        else
+            fprintf(out, " & (value_%u %s value_%u)", predicate->left_attr_i,
+                    codegen_op_str(predicate->op), predicate->right_attr_i);
+    }
+    fprintf(out, ";\n");
+
+    for (uint16_t out_attr_i = 0; out_attr_i < out_attr_num; out_attr_i++)
+        fprintf(out, "            out_%u[row_num] = value_%u;\n", out_attr_i, out_attr_is[out_attr_i]);
+    fprintf(out, "            row_num += passes;\n");
+    fprintf(out, "        }\n");
+}
+
+static char *codegen_pipeline_source(const codegen_predicate_t *predicates,
+                                     const uint16_t predicate_num,
+                                     const uint16_t *out_attr_is,
+                                     const uint16_t out_attr_num)
+{
+    /* Only attributes used get loaded */
+    uint16_t attr_num = 0;
+    for (uint16_t pred_i = 0; pred_i < predicate_num; pred_i++) {
+        if (predicates[pred_i].left_attr_i >= attr_num)
+            attr_num = predicates[pred_i].left_attr_i + 1;
+        if (predicates[pred_i].tag == SELECT_ATTR_ATTR && predicates[pred_i].right_attr_i >= attr_num)
+            attr_num = predicates[pred_i].right_attr_i + 1;
+    }
+    for (uint16_t out_attr_i = 0; out_attr_i < out_attr_num; out_attr_i++)
+        if (out_attr_is[out_attr_i] >= attr_num)
+            attr_num = out_attr_is[out_attr_i] + 1;
+
+    bool *is_attr_used = calloc(attr_num + 1, sizeof(bool));
+    assert(is_attr_used);
+    for (uint16_t pred_i = 0; pred_i < predicate_num; pred_i++) {
+        is_attr_used[predicates[pred_i].left_attr_i] = true;
+        if (predicates[pred_i].tag == SELECT_ATTR_ATTR)
+            is_attr_used[predicates[pred_i].right_attr_i] = true;
+    }
+    for (uint16_t out_attr_i = 0; out_attr_i < out_attr_num; out_attr_i++)
+        is_attr_used[out_attr_is[out_attr_i]] = true;
+
+    char *source = NULL;
+    size_t source_size = 0;
+    FILE *out = open_memstream(&source, &source_size);
+    assert(out);
+
+    fprintf(out, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    fprintf(out, "typedef %s value_type_t;\n\n", CODEGEN_VALUE_TYPE);
+    fprintf(out, "uint16_t %s(const value_type_t *const *attr_values, const uint32_t stride,\n", CODEGEN_SYMBOL);
+    fprintf(out, "    const value_type_t *constants, uint32_t *next_tuple_i, const uint32_t end_tuple_i,\n");
+    fprintf(out, "    value_type_t *const *out_columns)\n{\n");
+
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        if (is_attr_used[attr_i])
+            fprintf(out, "    const value_type_t *const attr_%u = attr_values[%u];\n", attr_i, attr_i);
+    for (uint16_t pred_i = 0; pred_i < predicate_num; pred_i++)
+        if (predicates[pred_i].tag == SELECT_ATTR_CONST)
+            fprintf(out, "    const value_type_t constant_%u = constants[%u];\n", pred_i, pred_i);
+    for (uint16_t out_attr_i = 0; out_attr_i < out_attr_num; out_attr_i++)
+        fprintf(out, "    value_type_t *const out_%u = out_columns[%u];\n", out_attr_i, out_attr_i);
+
+    fprintf(out, "    uint16_t row_num = 0;\n");
+    fprintf(out, "    uint32_t tuple_i = *next_tuple_i;\n");
+    fprintf(out, "    if (stride == 1) {\n");
+    codegen_emit_loop(out, predicates, predicate_num, out_attr_is, out_attr_num, is_attr_used, attr_num, "1");
+    fprintf(out, "    } else {\n");
+    codegen_emit_loop(out, predicates, predicate_num, out_attr_is, out_attr_num, is_attr_used, attr_num, "stride");
+    fprintf(out, "    }\n");
+    fprintf(out, "    *next_tuple_i = tuple_i;\n");
+    fprintf(out, "    return row_num;\n}\n");
+
+    fclose(out);
+    free(is_attr_used);
+    return source;
+}
+
+/*
+ * Compilation
+ *  */
+
+/* Compile the source in a temporary directory removed right after loading the module */
+static void *codegen_compile(const char *source)
+{
+    codegen_compile_num++;
+
+    const char *tmp_dir = getenv("TMPDIR");
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s/pigletql-codegen-XXXXXX", tmp_dir && *tmp_dir ? tmp_dir : "/tmp");
+    if (!mkdtemp(dir))
+        return NULL;
+
+    char source_path[4200], module_path[4200];
+    snprintf(source_path, sizeof(source_path), "%s/pipeline.c", dir);
+    snprintf(module_path, sizeof(module_path), "%s/pipeline.so", dir);
+
+    void *handle = NULL;
+    FILE *source_file = fopen(source_path, "w");
+    if (!source_file)
+        goto source_fail;
+    const bool is_written = fputs(source, source_file) >= 0;
+    if (fclose(source_file) != 0 || !is_written)
+        goto compile_fail;
+
+    const char *cc = getenv("CC");
+    char command[16384];
+    snprintf(command, sizeof(command), "%s -std=gnu11 -O2 -fPIC -shared -o '%s' '%s' >/dev/null 2>&1",
+             cc && *cc ? cc : "cc", module_path, source_path);
+    if (system(command) != 0)
+        goto compile_fail;
+
+    handle = dlopen(module_path, RTLD_NOW | RTLD_LOCAL);
+
+    unlink(module_path);
+compile_fail:
+    unlink(source_path);
+source_fail:
+    rmdir(dir);
+    return handle;
+}
+
+compiled_pipeline_fn codegen_pipeline(const codegen_predicate_t *predicates,
+                                      const uint16_t predicate_num,
+                                      const uint16_t *out_attr_is,
+                                      const uint16_t out_attr_num)
+{
+    char *source = codegen_pipeline_source(predicates, predicate_num, out_attr_is, out_attr_num);
+    const size_t source_len = strlen(source);
+
+    codegen_module_t *module = name_table_get(&codegen_modules, source, source_len);
+    if (module) {
+        free(source);
+        return module->fn;
+    }
+
+    module = calloc(1, sizeof(*module));
+    assert(module);
+    module->source = source;
+    module->handle = codegen_compile(source);
+    if (module->handle)
+        *(void **)&module->fn = dlsym(module->handle, CODEGEN_SYMBOL);
+    const bool is_added = name_table_add(&codegen_modules, module->source, source_len, module);
+    assert(is_added);
+    (void) is_added;
+
+    return module->fn;
+}
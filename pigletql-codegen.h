@@ -0,0 +1,43 @@
+#ifndef PIGLETQL_CODEGEN_H
+#define PIGLETQL_CODEGEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+#include "pigletql-eval.h"
+
+/*
+ * Code generation turns a pipeline of selections and projections over a scan into C source of a
+ * single compiled_pipeline_fn (see pigletql-eval.h). The source is compiled into a shared object by
+ * the compiler in $CC, cc by default, and the object is then loaded with dlopen.
+ *
+ * Modules are cached by their source, which only depends on the shape of the pipeline: constants
+ * are given at runtime, so queries differing in constants share modules. Failed compilations are
+ * cached as well, callers fall back to interpreting operators then.
+ * */
+
+typedef struct codegen_predicate_t {
+    select_predicate_tag tag;
+    select_predicate_op op;
+    /* Relation attribute indices, the right one is only compared by attribute-attribute predicates */
+    uint16_t left_attr_i;
+    uint16_t right_attr_i;
+} codegen_predicate_t;
+
+/* Pipelines are only compiled when code generation is enabled, it's disabled by default */
+void codegen_set_enabled(const bool is_enabled);
+
+bool codegen_is_enabled(void);
+
+/* A function writing out_attr_is of tuples passing all the predicates, the constant of attribute-constant
+ * predicate i is constants[i]. NULL if the module could not be compiled or loaded. */
+compiled_pipeline_fn codegen_pipeline(const codegen_predicate_t *predicates,
+                                      const uint16_t predicate_num,
+                                      const uint16_t *out_attr_is,
+                                      const uint16_t out_attr_num);
+
+/* Number of modules compiled so far, including failed attempts, useful for checking the cache */
+uint32_t codegen_get_compile_num(void);
+
+#endif //PIGLETQL_CODEGEN_H
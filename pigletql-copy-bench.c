@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pigletql-copy.h"
+#include "pigletql-parser.h"
+#include "pigletql-pool.h"
+
+/*
+ * Loading a CSV file: rows per second of COPY with a single worker and with a worker per CPU, versus
+ * parsing an INSERT statement per row the way the REPL does.
+ *  */
+
+#define BENCH_ROW_NUM (10 * 1000 * 1000)
+#define BENCH_INSERT_ROW_NUM (100 * 1000)
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static relation_t *bench_relation(void)
+{
+    const char *attr_names[] = {"a1", "a2", "a3"};
+    relation_t *rel = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+    if (!rel) {
+        fprintf(stderr, "Error: failed to create the relation\n");
+        exit(1);
+    }
+    return rel;
+}
+
+static double bench_copy(const char *path, pool_t *pool)
+{
+    relation_t *rel = bench_relation();
+    copy_result_t result;
+    const double start = now_seconds();
+    if (!copy_from_file(rel, path, pool, &result) || result.tuple_num != BENCH_ROW_NUM) {
+        fprintf(stderr, "Error: failed to copy '%s'\n", path);
+        exit(1);
+    }
+    const double seconds = now_seconds() - start;
+    relation_destroy(rel);
+    return BENCH_ROW_NUM / seconds;
+}
+
+static double bench_insert(void)
+{
+    relation_t *rel = bench_relation();
+    arena_t *arena = arena_create();
+    char line[128];
+    const double start = now_seconds();
+    for (uint32_t row_i = 0; row_i < BENCH_INSERT_ROW_NUM; row_i++) {
+        snprintf(line, sizeof(line), "insert into rel1 values (%u, %u, %u);", row_i, row_i * 7, row_i * 13);
+        scanner_t *scanner = scanner_create(arena, line);
+        parser_t *parser = parser_create(arena);
+        query_t *query = query_create(arena);
+        if (!parser_parse(parser, scanner, query)) {
+            fprintf(stderr, "Error: failed to parse '%s'\n", line);
+            exit(1);
+        }
+        relation_append_values(rel, query->as.insert.values);
+        arena_reset(arena);
+    }
+    const double seconds = now_seconds() - start;
+    arena_destroy(arena);
+    relation_destroy(rel);
+    return BENCH_INSERT_ROW_NUM / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    char path[] = "/tmp/pigletql-copy-bench-XXXXXX";
+    const int fd = mkstemp(path);
+    FILE *file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        fprintf(stderr, "Error: failed to create a file\n");
+        return 1;
+    }
+    srand(42);
+    for (uint32_t row_i = 0; row_i < BENCH_ROW_NUM; row_i++)
+        fprintf(file, "%u,%u,%d\n", row_i, row_i * 7, rand());
+    fclose(file);
+
+    printf("%10s %14s %10s\n", "load", "rows/s", "speedup");
+
+    const double insert_rate = bench_insert();
+    printf("%10s %14.0f %10.2f\n", "insert", insert_rate, 1.0);
+
+    const double copy_rate = bench_copy(path, NULL);
+    printf("%10s %14.0f %10.2f\n", "copy", copy_rate, copy_rate / insert_rate);
+
+    const uint16_t cpu_num = pool_cpu_num();
+    if (cpu_num > 1) {
+        pool_t *pool = pool_create(cpu_num);
+        const double parallel_rate = bench_copy(path, pool);
+        pool_destroy(pool);
+        printf("%7u th %14.0f %10.2f\n", cpu_num, parallel_rate, parallel_rate / insert_rate);
+    }
+
+    unlink(path);
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "pigletql-copy.h"
+
+/* Parse a whole string, false unless there's a single value taking all of it */
+static bool parse_string(const char *str, value_type_t *value)
+{
+    const char *pos = str;
+    const char *end = str + strlen(str);
+    return copy_parse_value(&pos, end, value) && pos == end;
+}
+
+static void write_file(const char *path, const char *content)
+{
+    FILE *file = fopen(path, "w");
+    assert(file);
+    assert(fputs(content, file) >= 0);
+    assert(fclose(file) == 0);
+}
+
+static relation_t *create_relation(const relation_layout_t layout)
+{
+    const char *attr_names[] = {"a1", "a2", "a3"};
+    relation_t *rel = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+    assert(rel);
+    return rel;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* Values of every length, parsed both close to the end of the data and far from it */
+    {
+        value_type_t value = 0;
+        char buf[64];
+        value_type_t expected = 0;
+        for (int digit_num = 1; digit_num <= 10; digit_num++) {
+            expected = expected * 10 + (value_type_t)(digit_num % 10);
+            snprintf(buf, sizeof(buf), "%"PRI_VALUE, expected);
+            assert(parse_string(buf, &value) && value == expected);
+
+            snprintf(buf, sizeof(buf), "%"PRI_VALUE",123456789", expected);
+            const char *pos = buf;
+            assert(copy_parse_value(&pos, buf + strlen(buf), &value) && value == expected);
+            assert(*pos == ',');
+        }
+
+        assert(parse_string("0", &value) && value == 0);
+        assert(parse_string("00000000000000000042", &value) && value == 42);
+        assert(parse_string("4294967295", &value) && value == UINT32_MAX);
+        assert(!parse_string("4294967296", &value));
+        assert(!parse_string("99999999999999", &value));
+        assert(!parse_string("", &value));
+
+        const char *str = "x12345678";
+        const char *pos = str;
+        assert(!copy_parse_value(&pos, str + strlen(str), &value));
+        assert(pos == str);
+
+        /* Characters right around digits, including ones carrying into the next byte */
+        str = "1234567/";
+        pos = str;
+        assert(copy_parse_value(&pos, str + strlen(str), &value) && value == 1234567 && *pos == '/');
+        str = "12:34567890";
+        pos = str;
+        assert(copy_parse_value(&pos, str + strlen(str), &value) && value == 12 && *pos == ':');
+        str = "1\xff" "2345678";
+        pos = str;
+        assert(copy_parse_value(&pos, str + strlen(str), &value) && value == 1 && pos == str + 1);
+    }
+
+    /* CSV and TSV files, blank lines and no newline at the very end */
+    {
+        char path[] = "/tmp/pigletql-copy-test-XXXXXX";
+        const int fd = mkstemp(path);
+        assert(fd >= 0);
+        close(fd);
+
+        write_file(path, "1,2,3\n4, 5 ,6\r\n\n7\t8\t9");
+        for (int layout = LAYOUT_ROWS; layout <= LAYOUT_COLUMNS; layout++) {
+            relation_t *rel = create_relation(layout);
+            copy_result_t result;
+            assert(copy_from_file(rel, path, NULL, &result));
+            assert(result.tuple_num == 3);
+            assert(relation_get_tuple_num(rel) == 3);
+            for (uint32_t tuple_i = 0; tuple_i < 3; tuple_i++)
+                for (uint16_t attr_i = 0; attr_i < 3; attr_i++)
+                    assert(relation_get_value(rel, tuple_i, attr_i) == tuple_i * 3 + attr_i + 1);
+            relation_destroy(rel);
+        }
+
+        /* An empty file */
+        write_file(path, "");
+        relation_t *rel = create_relation(LAYOUT_ROWS);
+        copy_result_t result;
+        assert(copy_from_file(rel, path, NULL, &result));
+        assert(result.tuple_num == 0);
+
+        /* Bad lines leave the relation as it was */
+        relation_append_values(rel, (value_type_t[]){1, 2, 3});
+        write_file(path, "1,2,3\n4,5\n");
+        assert(!copy_from_file(rel, path, NULL, &result));
+        assert(result.error_line == 2);
+        write_file(path, "1,2,3\n4,5,6\n\n7,8,9,10\n");
+        assert(!copy_from_file(rel, path, NULL, &result));
+        assert(result.error_line == 4);
+        write_file(path, "1,2,3\n4;5;6\n");
+        assert(!copy_from_file(rel, path, NULL, &result));
+        assert(result.error_line == 2);
+        write_file(path, "1,2,-3\n");
+        assert(!copy_from_file(rel, path, NULL, &result));
+        assert(result.error_line == 1);
+        assert(relation_get_tuple_num(rel) == 1);
+
+        unlink(path);
+        assert(!copy_from_file(rel, path, NULL, &result));
+        assert(result.error_line == 0);
+        relation_destroy(rel);
+    }
+
+    /* Files spanning many chunks load the same with any number of workers */
+    {
+        char path[] = "/tmp/pigletql-copy-test-XXXXXX";
+        const int fd = mkstemp(path);
+        assert(fd >= 0);
+        FILE *file = fdopen(fd, "w");
+        assert(file);
+        const uint32_t tuple_num = 200000;
+        for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+            fprintf(file, "%u,%u,%u\n", tuple_i, tuple_i * 7919, UINT32_MAX - tuple_i);
+        assert(fclose(file) == 0);
+
+        for (uint16_t worker_num = 1; worker_num <= 4; worker_num *= 2) {
+            pool_t *pool = worker_num > 1 ? pool_create(worker_num) : NULL;
+            relation_t *rel = create_relation(LAYOUT_COLUMNS);
+            relation_create_index(rel, 0);
+            copy_result_t result;
+            assert(copy_from_file(rel, path, pool, &result));
+            assert(result.tuple_num == tuple_num);
+            assert(relation_get_tuple_num(rel) == tuple_num);
+            for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+                assert(relation_get_value(rel, tuple_i, 0) == tuple_i);
+                assert(relation_get_value(rel, tuple_i, 1) == tuple_i * 7919);
+                assert(relation_get_value(rel, tuple_i, 2) == UINT32_MAX - tuple_i);
+            }
+            assert(btree_get_entry_num(relation_get_index(rel, 0)) == tuple_num);
+
+            /* Copies append to what is there */
+            assert(copy_from_file(rel, path, pool, &result));
+            assert(relation_get_tuple_num(rel) == 2 * tuple_num);
+            assert(relation_get_value(rel, tuple_num + 5, 1) == 5 * 7919);
+            relation_destroy(rel);
+            pool_destroy(pool);
+        }
+
+        /* A bad line deep into the file */
+        file = fopen(path, "a");
+        assert(file);
+        fputs("1,2\n", file);
+        assert(fclose(file) == 0);
+        pool_t *pool = pool_create(4);
+        relation_t *rel = create_relation(LAYOUT_ROWS);
+        copy_result_t result;
+        assert(!copy_from_file(rel, path, pool, &result));
+        assert(result.error_line == tuple_num + 1);
+        assert(relation_get_tuple_num(rel) == 0);
+        relation_destroy(rel);
+        pool_destroy(pool);
+
+        unlink(path);
+    }
+
+    return 0;
+}
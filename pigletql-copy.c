@@ -0,0 +1,264 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pigletql-copy.h"
+#include "pigletql-pool.h"
+
+/* Chunks per worker, so workers finishing early steal the rest */
+#define COPY_CHUNKS_PER_WORKER 4
+
+typedef struct copy_chunk_t {
+    /* Lines to parse, the chunk ends right after a newline or at the end of the file */
+    const char *start;
+    const char *end;
+    uint16_t attr_num;
+
+    /* Tuples parsed, values of a tuple next to each other */
+    value_type_t *table;
+    uint32_t tuple_num;
+    uint32_t tuple_slots;
+
+    /* Start of the line failing to parse, NULL if all of them parsed */
+    const char *error_pos;
+} copy_chunk_t;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+/* Number of digits at the start of 8 characters loaded into a word, the first one in the lowest byte */
+static inline size_t copy_digit_num(const uint64_t word)
+{
+    /* Digits are 0x30 to 0x39: the high nibble is 3 and stays 3 after adding 6. Carries out of
+     * non-digits only spoil bytes past them. */
+    const uint64_t high_nibbles = (word & 0xF0F0F0F0F0F0F0F0) ^ 0x3030303030303030;
+    const uint64_t high_nibbles_plus_6 = ((word + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) ^ 0x3030303030303030;
+    const uint64_t non_digits = high_nibbles | high_nibbles_plus_6;
+
+    /* Top bit of every non-zero byte */
+    const uint64_t non_digit_bits = (((non_digits & 0x7F7F7F7F7F7F7F7F) + 0x7F7F7F7F7F7F7F7F) | non_digits) &
+        0x8080808080808080;
+    return non_digit_bits ? (size_t)__builtin_ctzll(non_digit_bits) / 8 : 8;
+}
+
+/* Value of 8 digits, the most significant one in the lowest byte, combining pairs of neighbours */
+static inline uint32_t copy_eight_digits(uint64_t digits)
+{
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+    digits = digits * 10 + (digits >> 8);
+    return (uint32_t)((((digits & mask) * mul1) + (((digits >> 16) & mask) * mul2)) >> 32);
+}
+
+#endif
+
+bool copy_parse_value(const char **pos_ptr, const char *end, value_type_t *value)
+{
+    const char *pos = *pos_ptr;
+    uint64_t result = 0;
+    size_t digit_num = 0;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* Up to 8 digits at once when there are 8 characters to load, leading bytes zeroed are leading
+     * zeroes */
+    if (end - pos >= 8) {
+        uint64_t word;
+        memcpy(&word, pos, sizeof(word));
+        digit_num = copy_digit_num(word);
+        if (digit_num > 0)
+            result = copy_eight_digits((word & 0x0F0F0F0F0F0F0F0F) << ((8 - digit_num) * 8));
+        pos += digit_num;
+        if (digit_num < 8)
+            goto done;
+    }
+#endif
+
+    /* The rest of the digits one by one */
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+        result = result * 10 + (uint64_t)(*pos - '0');
+        if (result > UINT32_MAX)
+            return false;
+        digit_num++;
+        pos++;
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+done:
+#endif
+    if (digit_num == 0)
+        return false;
+    *value = (value_type_t)result;
+    *pos_ptr = pos;
+    return true;
+}
+
+static inline const char *copy_skip_spaces(const char *pos, const char *end)
+{
+    while (pos < end && *pos == ' ')
+        pos++;
+    return pos;
+}
+
+/* Parse a line into values, returning the start of the next line or NULL if the line is malformed */
+static const char *copy_parse_line(const char *pos, const char *end, const uint16_t attr_num, value_type_t *values)
+{
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++) {
+        if (attr_i > 0) {
+            pos = copy_skip_spaces(pos, end);
+            if (pos == end || (*pos != ',' && *pos != '\t'))
+                return NULL;
+            pos++;
+        }
+        pos = copy_skip_spaces(pos, end);
+        if (!copy_parse_value(&pos, end, &values[attr_i]))
+            return NULL;
+    }
+
+    pos = copy_skip_spaces(pos, end);
+    if (pos < end && *pos == '\r')
+        pos++;
+    if (pos == end)
+        return pos;
+    return *pos == '\n' ? pos + 1 : NULL;
+}
+
+static void copy_parse_chunk(void *arg, const uint16_t worker_i)
+{
+    (void) worker_i;
+    copy_chunk_t *chunk = arg;
+    const uint16_t attr_num = chunk->attr_num;
+
+    const char *pos = chunk->start;
+    while (pos < chunk->end) {
+        /* Empty lines are skipped */
+        if (*pos == '\n' || (*pos == '\r' && pos + 1 < chunk->end && pos[1] == '\n')) {
+            pos += *pos == '\n' ? 1 : 2;
+            continue;
+        }
+
+        if (chunk->tuple_num == chunk->tuple_slots) {
+            chunk->tuple_slots = chunk->tuple_slots ? chunk->tuple_slots * 2 : 1024;
+            chunk->table = realloc(chunk->table, (size_t)chunk->tuple_slots * attr_num * sizeof(value_type_t));
+            assert(chunk->table);
+        }
+
+        const char *next = copy_parse_line(pos, chunk->end, attr_num, &chunk->table[(size_t)chunk->tuple_num * attr_num]);
+        if (!next) {
+            chunk->error_pos = pos;
+            return;
+        }
+        chunk->tuple_num++;
+        pos = next;
+    }
+}
+
+static uint64_t copy_line_num(const char *start, const char *end)
+{
+    uint64_t line_num = 0;
+    while ((start = memchr(start, '\n', (size_t)(end - start)))) {
+        start++;
+        line_num++;
+    }
+    return line_num;
+}
+
+/* Split data into chunks ending at line ends */
+static size_t copy_split(const char *data, const size_t data_size, const size_t chunk_size,
+                         const uint16_t attr_num, copy_chunk_t *chunks)
+{
+    const char *data_end = data + data_size;
+    const char *start = data;
+    size_t chunk_num = 0;
+    while (start < data_end) {
+        const char *end = data_end;
+        if ((size_t)(data_end - start) > chunk_size) {
+            end = memchr(start + chunk_size, '\n', (size_t)(data_end - start) - chunk_size);
+            end = end ? end + 1 : data_end;
+        }
+        chunks[chunk_num++] = (copy_chunk_t) { .start = start, .end = end, .attr_num = attr_num };
+        start = end;
+    }
+    return chunk_num;
+}
+
+static bool copy_from_data(relation_t *rel, const char *data, const size_t data_size, pool_t *pool,
+                           copy_result_t *result)
+{
+    const uint16_t worker_num = pool ? pool_get_worker_num(pool) : 1;
+    size_t chunk_size = data_size / ((size_t)worker_num * COPY_CHUNKS_PER_WORKER);
+    if (chunk_size < COPY_MIN_CHUNK_SIZE)
+        chunk_size = COPY_MIN_CHUNK_SIZE;
+    if (chunk_size > COPY_MAX_CHUNK_SIZE)
+        chunk_size = COPY_MAX_CHUNK_SIZE;
+
+    copy_chunk_t *chunks = calloc((data_size + chunk_size - 1) / chunk_size, sizeof(*chunks));
+    if (!chunks)
+        return false;
+    const size_t chunk_num = copy_split(data, data_size, chunk_size, relation_get_attr_num(rel), chunks);
+
+    if (worker_num > 1 && chunk_num > 1) {
+        for (size_t chunk_i = 0; chunk_i < chunk_num; chunk_i++)
+            pool_submit(pool, copy_parse_chunk, &chunks[chunk_i]);
+        pool_wait(pool);
+    } else {
+        for (size_t chunk_i = 0; chunk_i < chunk_num; chunk_i++)
+            copy_parse_chunk(&chunks[chunk_i], 0);
+    }
+
+    /* Nothing goes into the relation unless all of the file fits */
+    bool is_parsed = true;
+    uint64_t tuple_num = 0;
+    for (size_t chunk_i = 0; is_parsed && chunk_i < chunk_num; chunk_i++) {
+        if (chunks[chunk_i].error_pos) {
+            result->error_line = copy_line_num(data, chunks[chunk_i].error_pos) + 1;
+            is_parsed = false;
+        }
+        tuple_num += chunks[chunk_i].tuple_num;
+    }
+    if (is_parsed && relation_get_tuple_num(rel) + tuple_num > UINT32_MAX)
+        is_parsed = false;
+
+    if (is_parsed) {
+        relation_reserve_tuples(rel, (uint32_t)(relation_get_tuple_num(rel) + tuple_num));
+        for (size_t chunk_i = 0; chunk_i < chunk_num; chunk_i++)
+            relation_append_table(rel, chunks[chunk_i].table, chunks[chunk_i].tuple_num);
+        result->tuple_num = tuple_num;
+    }
+
+    for (size_t chunk_i = 0; chunk_i < chunk_num; chunk_i++)
+        free(chunks[chunk_i].table);
+    free(chunks);
+    return is_parsed;
+}
+
+bool copy_from_file(relation_t *rel, const char *path, pool_t *pool, copy_result_t *result)
+{
+    *result = (copy_result_t) { 0 };
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    const size_t data_size = (size_t)st.st_size;
+    if (data_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    const char *data = mmap(NULL, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    const bool is_copied = copy_from_data(rel, data, data_size, pool, result);
+    munmap((void *)data, data_size);
+    return is_copied;
+}
@@ -0,0 +1,38 @@
+#ifndef PIGLETQL_COPY_H
+#define PIGLETQL_COPY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+#include "pigletql-eval.h"
+#include "pigletql-pool.h"
+
+/*
+ * Bulk loading of relations from text files: a tuple per line, values separated by commas or tabs,
+ * i.e. CSV or TSV files of unsigned integers. Files are mapped and split into chunks at line
+ * boundaries. Worker threads parse chunks into tables of values, converting eight digits at a time,
+ * then tables are appended to the relation in file order.
+ * */
+
+/* Files are split into chunks of at least this many bytes, a few per worker */
+#define COPY_MIN_CHUNK_SIZE (64 * 1024)
+/* ... and at most this many bytes */
+#define COPY_MAX_CHUNK_SIZE (16 * 1024 * 1024)
+
+typedef struct copy_result_t {
+    /* Tuples appended */
+    uint64_t tuple_num;
+    /* Line failing to parse counting from 1, 0 if the file could not be read */
+    uint64_t error_line;
+} copy_result_t;
+
+/* Parse an unsigned integer at the position given moving the position past it, false if there are no
+ * digits or the value does not fit */
+bool copy_parse_value(const char **pos, const char *end, value_type_t *value);
+
+/* Load all the lines of a file into a relation using workers of the pool given, NULL parses in the
+ * calling thread. Nothing is appended unless every line has a value per attribute. */
+bool copy_from_file(relation_t *rel, const char *path, pool_t *pool, copy_result_t *result);
+
+#endif //PIGLETQL_COPY_H
@@ -23,14 +23,48 @@
 /* maximum number of predicates per query */
 #define MAX_PRED_NUM UINT16_MAX
 
+/* settings changed with SET: memory budget of a single sort in kilobytes */
+#define SETTING_SORT_MEMORY_KB "sort_memory_kb"
+/* minimum sort memory budget, smaller budgets spill runs of a batch or so */
+#define MIN_SORT_MEMORY_KB 64
+/* settings changed with SET: number of worker threads running parallel scans */
+#define SETTING_PARALLEL_WORKERS "parallel_workers"
+/* maximum number of worker threads */
+#define MAX_PARALLEL_WORKERS 1024
+/* settings changed with SET: run pipelines as generated native code, 0 or 1 */
+#define SETTING_CODEGEN "codegen"
+/* settings changed with SET: asynchronous commit, commits return before their log sync, which comes at
+ * most this many microseconds later. 0 makes every commit wait for its sync. */
+#define SETTING_ASYNC_COMMIT_DELAY_US "async_commit_delay_us"
+/* maximum asynchronous commit delay */
+#define MAX_ASYNC_COMMIT_DELAY_US (1000 * 1000)
+
 typedef enum sort_order_t {
     SORT_ASC = 0,
     SORT_DESC,
 } sort_order_t;
 
+typedef enum index_type_t {
+    INDEX_BTREE = 0,            /* ordered values, for equality and ranges */
+    INDEX_HASH,                 /* equality lookups only */
+} index_type_t;
+
+typedef enum aggregate_func_t {
+    AGGREGATE_COUNT = 0,
+    AGGREGATE_SUM,
+    AGGREGATE_MIN,
+    AGGREGATE_MAX,
+} aggregate_func_t;
+
+typedef enum relation_layout_t {
+    LAYOUT_ROWS = 0,            /* values of a tuple next to each other */
+    LAYOUT_COLUMNS,             /* values of an attribute next to each other */
+} relation_layout_t;
+
 #define PRI_VALUE PRIu32
 #define SCN_VALUE SCNu32
 typedef uint32_t value_type_t;  /* a single value type supported */
+#define MAX_VALUE UINT32_MAX
 
 typedef char attr_name_t[MAX_ATTR_NAME_LEN]; /* attribute names are fixed-size strings */
 typedef char rel_name_t[MAX_REL_NAME_LEN]; /* relation names are fixed-size strings */
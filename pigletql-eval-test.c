@@ -1,7 +1,12 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
 #include "pigletql-eval.h"
+#include "pigletql-intern.h"
 
 int main(int argc, char *argv[])
 {
@@ -81,6 +86,69 @@ int main(int argc, char *argv[])
         relation_destroy(relation);
     }
 
+    /* Check columnar relations: appending, growing, gathering tuples, scanning and sorting */
+    {
+        const char *attr_names[] = {"id", "attr1", "attr2"};
+        const uint16_t attr_num = ARRAY_SIZE(attr_names);
+        const uint32_t tuple_num = 3 * BATCH_SIZE + 10;
+
+        relation_t *relation = relation_create_with_layout(attr_names, attr_num, LAYOUT_COLUMNS);
+        assert(relation);
+        assert(relation_get_layout(relation) == LAYOUT_COLUMNS);
+
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i % 7, tuple_num - tuple_i};
+            relation_append_values(relation, values);
+        }
+        assert(relation_get_tuple_num(relation) == tuple_num);
+
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t *tuple_start = relation_tuple_values_by_id(relation, tuple_i);
+            assert(tuple_start[0] == tuple_i);
+            assert(tuple_start[1] == tuple_i % 7);
+            assert(tuple_start[2] == tuple_num - tuple_i);
+            assert(relation_get_value(relation, tuple_i, 2) == tuple_num - tuple_i);
+        }
+
+        /* Batches point to aligned relation columns */
+        operator_t *scan_op = scan_op_create(NULL, relation);
+        scan_op->open(scan_op->state);
+        uint32_t rows_received = 0;
+        batch_t *batch = NULL;
+        while ((batch = scan_op->next_batch(scan_op->state))) {
+            if (rows_received == 0)
+                assert((uintptr_t)batch->columns[1] % 64 == 0);
+            for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                const uint16_t row_i = batch->sel[sel_i];
+                assert(batch->columns[0][row_i] == rows_received);
+                assert(batch->columns[1][row_i] == rows_received % 7);
+                rows_received++;
+            }
+        }
+        assert(rows_received == tuple_num);
+        scan_op->close(scan_op->state);
+
+        /* Tuples work too */
+        scan_op->open(scan_op->state);
+        tuple_t *tuple = NULL;
+        rows_received = 0;
+        while ((tuple = scan_op->next(scan_op->state))) {
+            assert(tuple_get_attr_value(tuple, "attr2") == tuple_num - rows_received);
+            rows_received++;
+        }
+        assert(rows_received == tuple_num);
+        scan_op->close(scan_op->state);
+        scan_op->destroy(scan_op);
+
+        relation_order_by(relation, 2, SORT_ASC);
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            assert(relation_get_value(relation, tuple_i, 0) == tuple_num - tuple_i - 1);
+            assert(relation_get_value(relation, tuple_i, 2) == tuple_i + 1);
+        }
+
+        relation_destroy(relation);
+    }
+
     /* Check the basic relation scan operator */
     {
 
@@ -101,7 +169,7 @@ int main(int argc, char *argv[])
 
         /* Count the tuples twice */
         {
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
             scan_op->open(scan_op->state);
@@ -125,7 +193,7 @@ int main(int argc, char *argv[])
 
         /* Check values received */
         {
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
             scan_op->open(scan_op->state);
@@ -195,7 +263,7 @@ int main(int argc, char *argv[])
         relation_t *relation_target = relation_create(attr_names, attr_num);
         /* Scan the source and fill the target */
         {
-            operator_t *scan_op_source = scan_op_create(relation_source);
+            operator_t *scan_op_source = scan_op_create(NULL, relation_source);
             assert(scan_op_source);
 
             scan_op_source->open(scan_op_source->state);
@@ -211,7 +279,7 @@ int main(int argc, char *argv[])
 
         /* Check target tuples */
         {
-            operator_t *scan_op = scan_op_create(relation_target);
+            operator_t *scan_op = scan_op_create(NULL, relation_target);
             assert(scan_op);
 
             scan_op->open(scan_op->state);
@@ -278,15 +346,18 @@ int main(int argc, char *argv[])
 
         relation_fill_from_table(relation, &tuple_table[0][0], tuple_num);
 
+        const uint16_t attr1_i = relation_attr_i_by_name(relation, "attr1");
+        const uint16_t attr2_i = relation_attr_i_by_name(relation, "attr2");
+
         /* Count the tuples, check attributes */
         {
             /* This is gonna be wrapped */
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
-            const attr_name_t projected_attr_list[] = {"attr1", "attr2"};
+            const uint16_t projected_attr_list[] = {attr1_i, attr2_i};
 
-            operator_t *proj_op = proj_op_create(scan_op,
+            operator_t *proj_op = proj_op_create(NULL, scan_op,
                                                  projected_attr_list,
                                                  ARRAY_SIZE(projected_attr_list));
             assert(proj_op);
@@ -369,12 +440,12 @@ int main(int argc, char *argv[])
         relation_fill_from_table(right_relation, &right_tuple_table[0][0], right_tuple_num);
 
         {
-            operator_t *left_scan_op = scan_op_create(left_relation);
-            operator_t *right_scan_op = scan_op_create(right_relation);
+            operator_t *left_scan_op = scan_op_create(NULL, left_relation);
+            operator_t *right_scan_op = scan_op_create(NULL, right_relation);
             assert(left_scan_op);
             assert(right_scan_op);
 
-            operator_t *union_op = union_op_create(left_scan_op, right_scan_op);
+            operator_t *union_op = union_op_create(NULL, left_scan_op, right_scan_op);
             assert(union_op);
 
             union_op->open(union_op->state);
@@ -467,12 +538,12 @@ int main(int argc, char *argv[])
         );
 
         {
-            operator_t *left_scan_op = scan_op_create(left_relation);
-            operator_t *right_scan_op = scan_op_create(right_relation);
+            operator_t *left_scan_op = scan_op_create(NULL, left_relation);
+            operator_t *right_scan_op = scan_op_create(NULL, right_relation);
             assert(left_scan_op);
             assert(right_scan_op);
 
-            operator_t *join_op = join_op_create(left_scan_op, right_scan_op);
+            operator_t *join_op = join_op_create(NULL, left_scan_op, right_scan_op);
             assert(join_op);
 
             join_op->open(join_op->state);
@@ -567,16 +638,19 @@ int main(int argc, char *argv[])
 
         relation_fill_from_table(relation, &tuple_table[0][0], tuple_num);
 
+        const uint16_t id_i = relation_attr_i_by_name(relation, "id");
+        const uint16_t attr1_i = relation_attr_i_by_name(relation, "attr1");
+
         {
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
-            operator_t *select_op = select_op_create(scan_op);
+            operator_t *select_op = select_op_create(NULL, scan_op);
             assert(select_op);
 
             /* Select rows where: 0 < id < 3  */
-            select_op_add_attr_const_predicate(select_op, "id", SELECT_GT, 0);
-            select_op_add_attr_const_predicate(select_op, "id", SELECT_LT, 3);
+            select_op_add_attr_const_predicate(select_op, id_i, SELECT_GT, 0);
+            select_op_add_attr_const_predicate(select_op, id_i, SELECT_LT, 3);
 
             select_op->open(select_op->state);
 
@@ -601,14 +675,14 @@ int main(int argc, char *argv[])
         }
 
         {
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
-            operator_t *select_op = select_op_create(scan_op);
+            operator_t *select_op = select_op_create(NULL, scan_op);
             assert(select_op);
 
             /* Select row where: attr1 = 12  */
-            select_op_add_attr_const_predicate(select_op, "attr1", SELECT_EQ, 12);
+            select_op_add_attr_const_predicate(select_op, attr1_i, SELECT_EQ, 12);
 
             select_op->open(select_op->state);
 
@@ -646,17 +720,21 @@ int main(int argc, char *argv[])
 
         relation_fill_from_table(relation, &tuple_table[0][0], tuple_num);
 
+        const uint16_t id_i = relation_attr_i_by_name(relation, "id");
+        const uint16_t attr1_i = relation_attr_i_by_name(relation, "attr1");
+        const uint16_t attr2_i = relation_attr_i_by_name(relation, "attr2");
+
         /* A single check */
         {
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
-            operator_t *select_op = select_op_create(scan_op);
+            operator_t *select_op = select_op_create(NULL, scan_op);
             assert(select_op);
 
             /* Select row where: id > attr1 AND attr1 > attr2   */
-            select_op_add_attr_attr_predicate(select_op, "id", SELECT_GT, "attr1");
-            select_op_add_attr_attr_predicate(select_op, "attr1", SELECT_GT, "attr2");
+            select_op_add_attr_attr_predicate(select_op, id_i, SELECT_GT, attr1_i);
+            select_op_add_attr_attr_predicate(select_op, attr1_i, SELECT_GT, attr2_i);
 
             select_op->open(select_op->state);
 
@@ -677,6 +755,45 @@ int main(int argc, char *argv[])
             select_op->destroy(select_op);
         }
 
+        /* Every comparison, over source tuples and over joined tuples. A single tuple on the right of
+         * joins keeps left attribute indices. */
+        const attr_name_t right_attr_names[] = {"right_id"};
+        const value_type_t right_table[] = {7};
+        relation_t *right_relation = relation_create(right_attr_names, ARRAY_SIZE(right_attr_names));
+        relation_fill_from_table(right_relation, right_table, ARRAY_SIZE(right_table));
+        for (select_predicate_op op = SELECT_GT; op <= SELECT_EQ; op++) {
+            for (int is_joined = 0; is_joined <= 1; is_joined++) {
+                for (int is_attr_attr = 0; is_attr_attr <= 1; is_attr_attr++) {
+                    operator_t *source = scan_op_create(NULL, relation);
+                    if (is_joined)
+                        source = join_op_create(NULL, source, scan_op_create(NULL, right_relation));
+
+                    operator_t *select_op = select_op_create(NULL, source);
+                    if (is_attr_attr)
+                        select_op_add_attr_attr_predicate(select_op, attr1_i, op, attr2_i);
+                    else
+                        select_op_add_attr_const_predicate(select_op, attr1_i, op, 22);
+
+                    uint32_t expected_num = 0;
+                    for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+                        const value_type_t left = tuple_table[tuple_i][attr1_i];
+                        const value_type_t right = is_attr_attr ? tuple_table[tuple_i][attr2_i] : 22;
+                        expected_num += op == SELECT_GT ? left > right : op == SELECT_LT ? left < right : left == right;
+                    }
+
+                    select_op->open(select_op->state);
+                    uint32_t received_num = 0;
+                    while (select_op->next(select_op->state))
+                        received_num++;
+                    select_op->close(select_op->state);
+                    assert(received_num == expected_num);
+
+                    select_op->destroy(select_op);
+                }
+            }
+        }
+        relation_destroy(right_relation);
+
         relation_destroy(relation);
     }
 
@@ -697,12 +814,14 @@ int main(int argc, char *argv[])
 
         relation_fill_from_table(relation, &tuple_table[0][0], tuple_num);
 
+        const uint16_t id_i = relation_attr_i_by_name(relation, "id");
+
         /* Ascending order */
         {
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
-            operator_t *sort_op = sort_op_create(scan_op, "id", SORT_ASC);
+            operator_t *sort_op = sort_op_create(NULL, scan_op, id_i, SORT_ASC);
             assert(sort_op);
 
             sort_op->open(sort_op->state);
@@ -736,10 +855,10 @@ int main(int argc, char *argv[])
 
         /* Descending order */
         {
-            operator_t *scan_op = scan_op_create(relation);
+            operator_t *scan_op = scan_op_create(NULL, relation);
             assert(scan_op);
 
-            operator_t *sort_op = sort_op_create(scan_op, "id", SORT_DESC);
+            operator_t *sort_op = sort_op_create(NULL, scan_op, id_i, SORT_DESC);
             assert(sort_op);
 
             sort_op->open(sort_op->state);
@@ -773,5 +892,1339 @@ int main(int argc, char *argv[])
 
         relation_destroy(relation);
     }
+
+    /* Sort operator on inputs large enough for radix sorting, with keys above INT_MAX */
+    {
+        const attr_name_t attr_names[] = {"key", "row"};
+        relation_t *relation = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t tuple_num = 5000;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {(tuple_i * 2654435761u) % 4096 * 1048573u, tuple_i};
+            relation_append_values(relation, values);
+        }
+
+        for (sort_order_t order = SORT_ASC; order <= SORT_DESC; order++) {
+            operator_t *sort_op = sort_op_create(NULL, scan_op_create(NULL, relation), 0, order);
+            sort_op->open(sort_op->state);
+
+            uint32_t rows_received = 0;
+            value_type_t prev_key = 0, prev_row = 0;
+            batch_t *batch = NULL;
+            while ((batch = sort_op->next_batch(sort_op->state))) {
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    const value_type_t key = batch->columns[0][row_i], row = batch->columns[1][row_i];
+                    if (rows_received > 0) {
+                        assert(order == SORT_ASC ? prev_key <= key : prev_key >= key);
+                        /* Equal keys keep the original order */
+                        assert(prev_key != key || prev_row < row);
+                    }
+                    prev_key = key;
+                    prev_row = row;
+                    rows_received++;
+                }
+            }
+            assert(rows_received == tuple_num);
+
+            sort_op->close(sort_op->state);
+            sort_op->destroy(sort_op);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Sorts over the memory budget spill sorted runs and merge them, merging runs of a couple of
+     * levels on the way */
+    {
+        const attr_name_t attr_names[] = {"key", "row"};
+        relation_t *relation = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t tuple_num = 2 * BATCH_SIZE * SORT_MERGE_RUN_NUM * SORT_MERGE_RUN_NUM + 20000;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {(tuple_i * 2654435761u) % 1000 * 4294967u, tuple_i};
+            relation_append_values(relation, values);
+        }
+
+        /* A run per couple of batches */
+        const size_t memory_budget = sort_op_get_memory_budget();
+        sort_op_set_memory_budget(2 * BATCH_SIZE * 2 * sizeof(value_type_t));
+
+        for (sort_order_t order = SORT_ASC; order <= SORT_DESC; order++) {
+            operator_t *sort_op = sort_op_create(NULL, scan_op_create(NULL, relation), 0, order);
+
+            /* Batches */
+            sort_op->open(sort_op->state);
+            uint32_t rows_received = 0;
+            value_type_t prev_key = 0, prev_row = 0;
+            batch_t *batch = NULL;
+            while ((batch = sort_op->next_batch(sort_op->state))) {
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    const value_type_t key = batch->columns[0][row_i], row = batch->columns[1][row_i];
+                    if (rows_received > 0) {
+                        assert(order == SORT_ASC ? prev_key <= key : prev_key >= key);
+                        assert(prev_key != key || prev_row < row);
+                    }
+                    prev_key = key;
+                    prev_row = row;
+                    rows_received++;
+                }
+            }
+            assert(rows_received == tuple_num);
+            sort_op->close(sort_op->state);
+
+            /* Tuples, after reopening */
+            sort_op->open(sort_op->state);
+            rows_received = 0;
+            tuple_t *tuple = NULL;
+            while ((tuple = sort_op->next(sort_op->state))) {
+                const value_type_t key = tuple_get_attr_value(tuple, "key");
+                assert(rows_received == 0 || (order == SORT_ASC ? prev_key <= key : prev_key >= key));
+                prev_key = key;
+                rows_received++;
+            }
+            assert(rows_received == tuple_num);
+            sort_op->close(sort_op->state);
+
+            sort_op->destroy(sort_op);
+        }
+        assert(!eval_get_error());
+
+        /* Running out of files stops the sort with an error instead */
+        struct rlimit file_limit;
+        assert(getrlimit(RLIMIT_NOFILE, &file_limit) == 0);
+        const int free_fd = dup(0);
+        assert(free_fd >= 0);
+        close(free_fd);
+        struct rlimit low_file_limit = file_limit;
+        low_file_limit.rlim_cur = (rlim_t)free_fd + 4;
+        assert(setrlimit(RLIMIT_NOFILE, &low_file_limit) == 0);
+        {
+            operator_t *sort_op = sort_op_create(NULL, scan_op_create(NULL, relation), 0, SORT_ASC);
+            sort_op->open(sort_op->state);
+            assert(!sort_op->next_batch(sort_op->state));
+            assert(eval_get_error());
+            sort_op->close(sort_op->state);
+            sort_op->destroy(sort_op);
+            eval_clear_error();
+        }
+        assert(setrlimit(RLIMIT_NOFILE, &file_limit) == 0);
+
+        sort_op_set_memory_budget(memory_budget);
+        relation_destroy(relation);
+    }
+
+    /* Top-N operator keeps the first tuples in the sort order */
+    {
+        const attr_name_t attr_names[] = {"key", "row"};
+        relation_t *relation = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t tuple_num = 5000;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            /* Every key is there twice */
+            const value_type_t values[] = {(tuple_i % 2500) * 1000003u, tuple_i};
+            relation_append_values(relation, values);
+        }
+
+        for (sort_order_t order = SORT_ASC; order <= SORT_DESC; order++) {
+            operator_t *top_n_op = top_n_op_create(NULL, scan_op_create(NULL, relation), 0, order, 7);
+            top_n_op->open(top_n_op->state);
+
+            uint32_t rows_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = top_n_op->next_batch(top_n_op->state))) {
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    const value_type_t key_i = order == SORT_ASC ? rows_received / 2 : 2499 - rows_received / 2;
+                    assert(batch->columns[0][row_i] == key_i * 1000003u);
+                    rows_received++;
+                }
+            }
+            assert(rows_received == 7);
+
+            top_n_op->close(top_n_op->state);
+            top_n_op->destroy(top_n_op);
+        }
+
+        /* Fewer tuples than the limit, and none at all */
+        {
+            operator_t *top_n_op = top_n_op_create(NULL, scan_op_create(NULL, relation), 1, SORT_DESC, 10000);
+            top_n_op->open(top_n_op->state);
+            tuple_t *tuple = NULL;
+            uint32_t rows_received = 0;
+            while ((tuple = top_n_op->next(top_n_op->state))) {
+                assert(tuple_get_attr_value(tuple, "row") == tuple_num - rows_received - 1);
+                rows_received++;
+            }
+            assert(rows_received == tuple_num);
+            top_n_op->close(top_n_op->state);
+            top_n_op->destroy(top_n_op);
+
+            top_n_op = top_n_op_create(NULL, scan_op_create(NULL, relation), 1, SORT_DESC, 0);
+            top_n_op->open(top_n_op->state);
+            assert(!top_n_op->next_batch(top_n_op->state));
+            top_n_op->close(top_n_op->state);
+            top_n_op->destroy(top_n_op);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Limit operator skips and limits tuples across batches */
+    {
+        const attr_name_t attr_names[] = {"row"};
+        relation_t *relation = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t tuple_num = 3 * BATCH_SIZE;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+            relation_append_values(relation, &tuple_i);
+
+        const uint32_t limits[][2] = {
+            {10, 0}, {BATCH_SIZE, BATCH_SIZE - 5}, {2 * BATCH_SIZE, 100}, {5, tuple_num - 2}, {0, 0}, {1, tuple_num},
+        };
+        for (size_t limit_i = 0; limit_i < ARRAY_SIZE(limits); limit_i++) {
+            const uint32_t limit = limits[limit_i][0], offset = limits[limit_i][1];
+            const uint32_t expected_num = offset >= tuple_num ? 0 :
+                (tuple_num - offset < limit ? tuple_num - offset : limit);
+
+            operator_t *limit_op = limit_op_create(NULL, scan_op_create(NULL, relation), limit, offset);
+            limit_op->open(limit_op->state);
+
+            uint32_t rows_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = limit_op->next_batch(limit_op->state))) {
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    assert(batch->columns[0][batch->sel[sel_i]] == offset + rows_received);
+                    rows_received++;
+                }
+            }
+            assert(rows_received == expected_num);
+            limit_op->close(limit_op->state);
+
+            /* Tuples work too */
+            limit_op->open(limit_op->state);
+            tuple_t *tuple = NULL;
+            rows_received = 0;
+            while ((tuple = limit_op->next(limit_op->state))) {
+                assert(tuple_get_attr_value(tuple, "row") == offset + rows_received);
+                rows_received++;
+            }
+            assert(rows_received == expected_num);
+            limit_op->close(limit_op->state);
+
+            limit_op->destroy(limit_op);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Aggregation operators: hashed groups in any order, streamed groups one after another */
+    {
+        const attr_name_t attr_names[] = {"sorted", "mixed", "val"};
+        relation_t *relation = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t tuple_num = 3 * BATCH_SIZE + 5;
+        const uint32_t mixed_num = 37;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i / 100, tuple_i % mixed_num, tuple_i};
+            relation_append_values(relation, values);
+        }
+
+        const aggregate_t aggregates[] = {
+            { .func = AGGREGATE_COUNT, .name = intern("count(*)") },
+            { .func = AGGREGATE_SUM, .attr_i = 2, .name = intern("sum(val)") },
+            { .func = AGGREGATE_MIN, .attr_i = 2, .name = intern("min(val)") },
+            { .func = AGGREGATE_MAX, .attr_i = 2, .name = intern("max(val)") },
+        };
+
+        /* Groups of mixed values are hashed */
+        {
+            const uint16_t group_attr_is[] = {1};
+            operator_t *op = hash_aggregate_op_create(NULL, scan_op_create(NULL, relation), group_attr_is, 1,
+                                                      aggregates, ARRAY_SIZE(aggregates));
+            op->open(op->state);
+
+            uint32_t rows_received = 0, tuples_counted = 0;
+            batch_t *batch = NULL;
+            while ((batch = op->next_batch(op->state))) {
+                assert(batch->attr_num == 5);
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    const value_type_t group = batch->columns[0][row_i];
+                    const value_type_t count = batch->columns[1][row_i];
+                    const value_type_t max = group + (count - 1) * mixed_num;
+                    assert(count == tuple_num / mixed_num + (group < tuple_num % mixed_num));
+                    assert(batch->columns[2][row_i] == (uint64_t)(group + max) * count / 2);
+                    assert(batch->columns[3][row_i] == group);
+                    assert(batch->columns[4][row_i] == max);
+                    tuples_counted += count;
+                    rows_received++;
+                }
+            }
+            assert(rows_received == mixed_num);
+            assert(tuples_counted == tuple_num);
+
+            op->close(op->state);
+            op->destroy(op);
+        }
+
+        /* Groups spanning batches stream by, both return the same groups as tuples */
+        {
+            const uint16_t group_attr_is[] = {0};
+            operator_t *ops[] = {
+                stream_aggregate_op_create(NULL, scan_op_create(NULL, relation), group_attr_is, 1,
+                                           aggregates, ARRAY_SIZE(aggregates)),
+                hash_aggregate_op_create(NULL, scan_op_create(NULL, relation), group_attr_is, 1,
+                                         aggregates, ARRAY_SIZE(aggregates)),
+            };
+            for (size_t op_i = 0; op_i < ARRAY_SIZE(ops); op_i++) {
+                operator_t *op = ops[op_i];
+                for (int run = 0; run < 2; run++) {
+                    op->open(op->state);
+
+                    uint32_t rows_received = 0;
+                    tuple_t *tuple = NULL;
+                    while ((tuple = op->next(op->state))) {
+                        const value_type_t group = tuple_get_attr_value(tuple, "sorted");
+                        const value_type_t min = group * 100;
+                        const value_type_t max = min + 99 < tuple_num - 1 ? min + 99 : tuple_num - 1;
+                        assert(group == rows_received);
+                        assert(tuple_get_attr_value(tuple, "count(*)") == max - min + 1);
+                        assert(tuple_get_attr_value(tuple, "sum(val)") == (min + max) * (max - min + 1) / 2);
+                        assert(tuple_get_attr_value(tuple, "min(val)") == min);
+                        assert(tuple_get_attr_value(tuple, "max(val)") == max);
+                        rows_received++;
+                    }
+                    assert(rows_received == (tuple_num + 99) / 100);
+
+                    op->close(op->state);
+                }
+                op->destroy(op);
+            }
+        }
+
+        /* A single group of all the tuples */
+        {
+            operator_t *ops[] = {
+                stream_aggregate_op_create(NULL, scan_op_create(NULL, relation), NULL, 0,
+                                           aggregates, ARRAY_SIZE(aggregates)),
+                hash_aggregate_op_create(NULL, scan_op_create(NULL, relation), NULL, 0,
+                                         aggregates, ARRAY_SIZE(aggregates)),
+            };
+            for (size_t op_i = 0; op_i < ARRAY_SIZE(ops); op_i++) {
+                operator_t *op = ops[op_i];
+                op->open(op->state);
+
+                batch_t *batch = op->next_batch(op->state);
+                assert(batch && batch->sel_num == 1);
+                const uint16_t row_i = batch->sel[0];
+                assert(batch->columns[0][row_i] == tuple_num);
+                assert(batch->columns[1][row_i] == (uint64_t)tuple_num * (tuple_num - 1) / 2);
+                assert(batch->columns[2][row_i] == 0);
+                assert(batch->columns[3][row_i] == tuple_num - 1);
+                assert(!op->next_batch(op->state));
+
+                op->close(op->state);
+                op->destroy(op);
+            }
+        }
+
+        /* Counts of the whole relation are read when opened */
+        {
+            const char *names[] = {intern("count(*)"), intern("count(val)")};
+            operator_t *op = count_op_create(NULL, relation, names, ARRAY_SIZE(names));
+            for (int run = 0; run < 2; run++) {
+                op->open(op->state);
+                tuple_t *tuple = op->next(op->state);
+                assert(tuple);
+                assert(tuple_get_attr_value(tuple, "count(*)") == tuple_num + run);
+                assert(tuple_get_attr_value(tuple, "count(val)") == tuple_num + run);
+                assert(!op->next(op->state));
+                op->close(op->state);
+
+                const value_type_t values[] = {0, 0, 0};
+                relation_append_values(relation, values);
+            }
+            op->destroy(op);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Aggregates of no tuples at all */
+    {
+        const attr_name_t attr_names[] = {"grp", "val"};
+        relation_t *relation = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const aggregate_t aggregates[] = {
+            { .func = AGGREGATE_COUNT, .name = intern("count(*)") },
+            { .func = AGGREGATE_SUM, .attr_i = 1, .name = intern("sum(val)") },
+            { .func = AGGREGATE_MIN, .attr_i = 1, .name = intern("min(val)") },
+            { .func = AGGREGATE_MAX, .attr_i = 1, .name = intern("max(val)") },
+        };
+        const uint16_t group_attr_is[] = {0};
+
+        for (int is_stream = 0; is_stream < 2; is_stream++) {
+            operator_t *(*op_create)(arena_t *, operator_t *, const uint16_t *, const uint16_t,
+                                     const aggregate_t *, const uint16_t) =
+                is_stream ? stream_aggregate_op_create : hash_aggregate_op_create;
+
+            /* Groups of nothing are nothing */
+            operator_t *op = op_create(NULL, scan_op_create(NULL, relation), group_attr_is, 1,
+                                       aggregates, ARRAY_SIZE(aggregates));
+            op->open(op->state);
+            assert(!op->next_batch(op->state));
+            op->close(op->state);
+            op->destroy(op);
+
+            /* Sums, minimums and maximums of nothing have no value, so there's no single group either */
+            op = op_create(NULL, scan_op_create(NULL, relation), NULL, 0, aggregates, ARRAY_SIZE(aggregates));
+            op->open(op->state);
+            assert(!op->next(op->state));
+            op->close(op->state);
+            op->destroy(op);
+
+            /* Counts of nothing are 0 */
+            op = op_create(NULL, scan_op_create(NULL, relation), NULL, 0, aggregates, 1);
+            op->open(op->state);
+            tuple_t *tuple = op->next(op->state);
+            assert(tuple);
+            assert(tuple_get_attr_value(tuple, "count(*)") == 0);
+            assert(!op->next(op->state));
+            op->close(op->state);
+            op->destroy(op);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Sums and counts of groups go past the biggest value there is, sorted by all 64 bits of them */
+    {
+        const attr_name_t attr_names[] = {"grp", "val"};
+        relation_t *relation = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const value_type_t tuples[][2] = {
+            {1, 3000000000u}, {1, 3000000000u}, {2, 5}, {3, 4000000000u}, {3, 294967296u},
+        };
+        for (size_t tuple_i = 0; tuple_i < ARRAY_SIZE(tuples); tuple_i++)
+            relation_append_values(relation, tuples[tuple_i]);
+        const aggregate_t aggregates[] = {
+            { .func = AGGREGATE_SUM, .attr_i = 1, .name = intern("sum(val)") },
+            { .func = AGGREGATE_MAX, .attr_i = 1, .name = intern("max(val)") },
+            { .func = AGGREGATE_COUNT, .attr_i = 1, .name = intern("count(val)") },
+        };
+        const uint16_t group_attr_is[] = {0};
+        /* Lower halves alone would put the group of exactly 2^32 last */
+        const uint64_t sorted_sums[] = {6000000000u, 4294967296u, 5};
+        const value_type_t sorted_maxs[] = {3000000000u, 4000000000u, 5};
+        const uint64_t sorted_counts[] = {2, 2, 1};
+
+        for (int is_stream = 0; is_stream < 2; is_stream++) {
+            operator_t *(*op_create)(arena_t *, operator_t *, const uint16_t *, const uint16_t,
+                                     const aggregate_t *, const uint16_t) =
+                is_stream ? stream_aggregate_op_create : hash_aggregate_op_create;
+            for (int is_top_n = 0; is_top_n < 2; is_top_n++) {
+                operator_t *aggregate_op = op_create(NULL, scan_op_create(NULL, relation), group_attr_is, 1,
+                                                     aggregates, ARRAY_SIZE(aggregates));
+                operator_t *op = is_top_n ? top_n_op_create(NULL, aggregate_op, 1, SORT_DESC, 3) :
+                    sort_op_create(NULL, aggregate_op, 1, SORT_DESC);
+                op->open(op->state);
+                batch_t *batch = op->next_batch(op->state);
+                assert(batch && batch->sel_num == 3);
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    assert(batch_get_value(batch, 1, row_i) == sorted_sums[sel_i]);
+                    assert(batch_get_value(batch, 2, row_i) == sorted_maxs[sel_i]);
+                    assert(batch_get_value(batch, 3, row_i) == sorted_counts[sel_i]);
+                }
+                assert(!op->next_batch(op->state));
+                assert(!eval_get_error());
+                op->close(op->state);
+                op->destroy(op);
+            }
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Batch scanning, projection and selection */
+    {
+        const attr_name_t attr_names[] = {"id", "attr1", "attr2"};
+        const uint16_t attr_num = ARRAY_SIZE(attr_names);
+        const uint32_t tuple_num = 3 * BATCH_SIZE + 10;
+
+        relation_t *relation = relation_create(attr_names, attr_num);
+        assert(relation);
+
+        for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i % 10, tuple_i * 2};
+            relation_append_values(relation, values);
+        }
+
+        /* Scan batches cover all the tuples */
+        {
+            operator_t *scan_op = scan_op_create(NULL, relation);
+            assert(scan_op);
+
+            scan_op->open(scan_op->state);
+
+            size_t tuples_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = scan_op->next_batch(scan_op->state))) {
+                assert(batch->attr_num == 3);
+                assert(batch_attr_i_by_name(batch, "attr2") == 2);
+                assert(batch->sel_num <= BATCH_SIZE);
+                for (size_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    assert(batch->columns[0][row_i] == tuples_received);
+                    assert(batch->columns[2][row_i] == tuples_received * 2);
+                    tuples_received++;
+                }
+            }
+            assert(tuples_received == tuple_num);
+
+            scan_op->close(scan_op->state);
+            scan_op->destroy(scan_op);
+        }
+
+        /* Select a subset of tuples and project attributes */
+        {
+            operator_t *scan_op = scan_op_create(NULL, relation);
+            assert(scan_op);
+
+            operator_t *select_op = select_op_create(NULL, scan_op);
+            assert(select_op);
+            select_op_add_attr_const_predicate(select_op, 1, SELECT_EQ, 3);
+            select_op_add_attr_attr_predicate(select_op, 2, SELECT_GT, 0);
+
+            const uint16_t projected_attr_list[] = {2, 0};
+            operator_t *proj_op = proj_op_create(NULL, select_op,
+                                                 projected_attr_list,
+                                                 ARRAY_SIZE(projected_attr_list));
+            assert(proj_op);
+
+            proj_op->open(proj_op->state);
+
+            size_t tuples_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = proj_op->next_batch(proj_op->state))) {
+                assert(batch->attr_num == 2);
+                assert(0 == strcmp(batch->attr_names[0], "attr2"));
+                assert(0 == strcmp(batch->attr_names[1], "id"));
+                for (size_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    const value_type_t id = batch->columns[1][row_i];
+                    assert(id % 10 == 3);
+                    assert(batch->columns[0][row_i] == id * 2);
+                    tuples_received++;
+                }
+            }
+            assert(tuples_received == tuple_num / 10);
+
+            proj_op->close(proj_op->state);
+            proj_op->destroy(proj_op);
+        }
+
+        /* Union of two batch sources */
+        {
+            operator_t *union_op = union_op_create(NULL, scan_op_create(NULL, relation), scan_op_create(NULL, relation));
+            assert(union_op);
+
+            union_op->open(union_op->state);
+            size_t tuples_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = union_op->next_batch(union_op->state)))
+                tuples_received += batch->sel_num;
+            assert(tuples_received == 2 * tuple_num);
+            union_op->close(union_op->state);
+
+            union_op->destroy(union_op);
+        }
+
+        /* Sort batches */
+        {
+            operator_t *sort_op = sort_op_create(NULL, scan_op_create(NULL, relation), 0, SORT_DESC);
+            assert(sort_op);
+
+            sort_op->open(sort_op->state);
+            value_type_t expected_id = tuple_num - 1;
+            size_t tuples_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = sort_op->next_batch(sort_op->state))) {
+                for (size_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    assert(batch->columns[0][batch->sel[sel_i]] == expected_id);
+                    expected_id--;
+                    tuples_received++;
+                }
+            }
+            assert(tuples_received == tuple_num);
+            sort_op->close(sort_op->state);
+
+            sort_op->destroy(sort_op);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Batch join */
+    {
+        const attr_name_t left_attr_names[] = {"attr1", "attr2"};
+        const uint16_t left_attr_num = ARRAY_SIZE(left_attr_names);
+        const uint32_t left_tuple_num = 100;
+
+        const attr_name_t right_attr_names[] = {"attr3"};
+        const uint16_t right_attr_num = ARRAY_SIZE(right_attr_names);
+        const uint32_t right_tuple_num = 50;
+
+        relation_t *left_relation = relation_create(left_attr_names, left_attr_num);
+        relation_t *right_relation = relation_create(right_attr_names, right_attr_num);
+        relation_t *empty_relation = relation_create(right_attr_names, right_attr_num);
+        assert(left_relation);
+        assert(right_relation);
+        assert(empty_relation);
+
+        for (uint32_t tuple_i = 0; tuple_i < left_tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i + 1};
+            relation_append_values(left_relation, values);
+        }
+        for (uint32_t tuple_i = 0; tuple_i < right_tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i * 3};
+            relation_append_values(right_relation, values);
+        }
+
+        {
+            operator_t *join_op = join_op_create(NULL, scan_op_create(NULL, left_relation),
+                                                 scan_op_create(NULL, right_relation));
+            assert(join_op);
+
+            join_op->open(join_op->state);
+
+            size_t tuples_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = join_op->next_batch(join_op->state))) {
+                assert(batch->attr_num == 3);
+                assert(0 == strcmp(batch->attr_names[2], "attr3"));
+                for (size_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    assert(batch->columns[0][row_i] == tuples_received / right_tuple_num);
+                    assert(batch->columns[1][row_i] == tuples_received / right_tuple_num + 1);
+                    assert(batch->columns[2][row_i] == (tuples_received % right_tuple_num) * 3);
+                    tuples_received++;
+                }
+            }
+            assert(tuples_received == left_tuple_num * right_tuple_num);
+
+            join_op->close(join_op->state);
+            join_op->destroy(join_op);
+        }
+
+        /* Joining with an empty relation gives nothing */
+        {
+            operator_t *join_op = join_op_create(NULL, scan_op_create(NULL, left_relation),
+                                                 scan_op_create(NULL, empty_relation));
+            assert(join_op);
+
+            join_op->open(join_op->state);
+            assert(!join_op->next_batch(join_op->state));
+            join_op->close(join_op->state);
+
+            join_op->destroy(join_op);
+        }
+
+        relation_destroy(left_relation);
+        relation_destroy(right_relation);
+        relation_destroy(empty_relation);
+    }
+
+    /* Hash join operator */
+    {
+        const attr_name_t left_attr_names[] = {"id", "attr1"};
+        const uint16_t left_attr_num = ARRAY_SIZE(left_attr_names);
+        const value_type_t left_tuple_table[4][ARRAY_SIZE(left_attr_names)] = {
+            {1, 10},
+            {2, 20},
+            {3, 30},
+            {2, 40},
+        };
+        const uint32_t left_tuple_num = ARRAY_SIZE(left_tuple_table);
+
+        const attr_name_t right_attr_names[] = {"attr2", "left_id", "attr3"};
+        const uint16_t right_attr_num = ARRAY_SIZE(right_attr_names);
+        const value_type_t right_tuple_table[4][ARRAY_SIZE(right_attr_names)] = {
+            {100, 2, 101},
+            {200, 5, 201},
+            {300, 1, 301},
+            {400, 2, 401},
+        };
+        const uint32_t right_tuple_num = ARRAY_SIZE(right_tuple_table);
+
+        relation_t *left_relation = relation_create(left_attr_names, left_attr_num);
+        relation_t *right_relation = relation_create(right_attr_names, right_attr_num);
+        assert(left_relation);
+        assert(right_relation);
+        relation_fill_from_table(left_relation, &left_tuple_table[0][0], left_tuple_num);
+        relation_fill_from_table(right_relation, &right_tuple_table[0][0], right_tuple_num);
+
+        /* Build on both sides */
+        for (int build_left = 0; build_left <= 1; build_left++) {
+            operator_t *join_op = hash_join_op_create(NULL, scan_op_create(NULL, left_relation),
+                                                      scan_op_create(NULL, right_relation),
+                                                      0, 1, build_left);
+            assert(join_op);
+
+            /* Twice to check reopening */
+            for (int pass = 0; pass < 2; pass++) {
+                join_op->open(join_op->state);
+
+                size_t tuples_received = 0;
+                value_type_t attr3_sum = 0;
+                tuple_t *tuple = NULL;
+                while ((tuple = join_op->next(join_op->state))) {
+                    assert(tuple_get_attr_num(tuple) == 5);
+                    assert(tuple_get_attr_value_by_i(tuple, 0) == tuple_get_attr_value_by_i(tuple, 3));
+                    assert(tuple_get_attr_value(tuple, "id") == tuple_get_attr_value(tuple, "left_id"));
+                    attr3_sum += tuple_get_attr_value(tuple, "attr3");
+                    tuples_received++;
+                }
+                /* 1 matches once, both 2s match twice */
+                assert(tuples_received == 5);
+                assert(attr3_sum == 301 + 2 * 101 + 2 * 401);
+
+                join_op->close(join_op->state);
+            }
+
+            join_op->destroy(join_op);
+        }
+
+        /* The batch path */
+        for (int build_left = 0; build_left <= 1; build_left++) {
+            operator_t *join_op = hash_join_op_create(NULL, scan_op_create(NULL, left_relation),
+                                                      scan_op_create(NULL, right_relation),
+                                                      0, 1, build_left);
+            assert(join_op);
+
+            join_op->open(join_op->state);
+
+            size_t tuples_received = 0;
+            batch_t *batch = NULL;
+            while ((batch = join_op->next_batch(join_op->state))) {
+                assert(batch->attr_num == 5);
+                assert(0 == strcmp(batch->attr_names[0], "id"));
+                assert(0 == strcmp(batch->attr_names[4], "attr3"));
+                for (size_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    assert(batch->columns[0][row_i] == batch->columns[3][row_i]);
+                    assert(batch->columns[2][row_i] + 1 == batch->columns[4][row_i]);
+                    tuples_received++;
+                }
+            }
+            assert(tuples_received == 5);
+
+            join_op->close(join_op->state);
+            join_op->destroy(join_op);
+        }
+
+        relation_destroy(left_relation);
+        relation_destroy(right_relation);
+    }
+
+    /* Hash join batches spanning multiple batches */
+    {
+        const attr_name_t left_attr_names[] = {"id"};
+        const attr_name_t right_attr_names[] = {"key", "value"};
+        relation_t *left_relation = relation_create(left_attr_names, ARRAY_SIZE(left_attr_names));
+        relation_t *right_relation = relation_create(right_attr_names, ARRAY_SIZE(right_attr_names));
+        assert(left_relation);
+        assert(right_relation);
+
+        const uint32_t left_tuple_num = 5000;
+        for (uint32_t tuple_i = 0; tuple_i < left_tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i};
+            relation_append_values(left_relation, values);
+        }
+        /* Every even key matches 3 times */
+        for (uint32_t tuple_i = 0; tuple_i < left_tuple_num; tuple_i += 2) {
+            for (value_type_t copy_i = 0; copy_i < 3; copy_i++) {
+                const value_type_t values[] = {tuple_i, copy_i};
+                relation_append_values(right_relation, values);
+            }
+        }
+
+        operator_t *join_op = hash_join_op_create(NULL, scan_op_create(NULL, left_relation),
+                                                  scan_op_create(NULL, right_relation),
+                                                  0, 0, true);
+        assert(join_op);
+        join_op->open(join_op->state);
+
+        size_t tuples_received = 0;
+        batch_t *batch = NULL;
+        while ((batch = join_op->next_batch(join_op->state))) {
+            for (size_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                const uint16_t row_i = batch->sel[sel_i];
+                assert(batch->columns[0][row_i] == batch->columns[1][row_i]);
+                assert(batch->columns[0][row_i] % 2 == 0);
+                tuples_received++;
+            }
+        }
+        assert(tuples_received == left_tuple_num / 2 * 3);
+
+        join_op->close(join_op->state);
+        join_op->destroy(join_op);
+
+        relation_destroy(left_relation);
+        relation_destroy(right_relation);
+    }
+
+    /* Gather operator runs pipelines over morsels in parallel */
+    for (relation_layout_t layout = LAYOUT_ROWS; layout <= LAYOUT_COLUMNS; layout++) {
+        const char *attr_names[] = {"id", "attr1", "attr2"};
+        relation_t *relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+        /* Not a multiple of the morsel size */
+        const uint32_t tuple_num = 10 * MORSEL_SIZE + 123;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i % 7, tuple_i * 2};
+            relation_append_values(relation, values);
+        }
+
+        for (uint16_t worker_num = 1; worker_num <= 4; worker_num++) {
+            for (int is_ordered = 0; is_ordered <= 1; is_ordered++) {
+                /* attr2 of tuples with attr1 = 3 */
+                operator_t *pipelines[worker_num], *scan_ops[worker_num];
+                for (uint16_t worker_i = 0; worker_i < worker_num; worker_i++) {
+                    scan_ops[worker_i] = scan_op_create(NULL, relation);
+                    operator_t *select_op = select_op_create(NULL, scan_ops[worker_i]);
+                    select_op_add_attr_const_predicate(select_op, 1, SELECT_EQ, 3);
+                    const uint16_t source_attr_is[] = {2};
+                    pipelines[worker_i] = proj_op_create(NULL, select_op, source_attr_is, 1);
+                }
+                operator_t *gather_op = gather_op_create(NULL, relation, pipelines, scan_ops, worker_num,
+                                                         is_ordered);
+                assert(gather_op);
+
+                /* Batches, twice to check reopening */
+                for (int run = 0; run < 2; run++) {
+                    gather_op->open(gather_op->state);
+                    uint32_t rows_received = 0;
+                    uint64_t value_sum = 0;
+                    value_type_t prev_value = 0;
+                    batch_t *batch = NULL;
+                    while ((batch = gather_op->next_batch(gather_op->state))) {
+                        assert(batch->attr_num == 1);
+                        assert(0 == strcmp(batch->attr_names[0], "attr2"));
+                        for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                            const value_type_t value = batch->columns[0][batch->sel[sel_i]];
+                            assert(value / 2 % 7 == 3);
+                            assert(!is_ordered || rows_received == 0 || prev_value < value);
+                            prev_value = value;
+                            value_sum += value;
+                            rows_received++;
+                        }
+                    }
+                    assert(rows_received == tuple_num / 7 + (tuple_num % 7 > 3));
+                    uint64_t expected_sum = 0;
+                    for (value_type_t tuple_i = 3; tuple_i < tuple_num; tuple_i += 7)
+                        expected_sum += tuple_i * 2;
+                    assert(value_sum == expected_sum);
+                    gather_op->close(gather_op->state);
+                }
+
+                /* Tuples */
+                gather_op->open(gather_op->state);
+                uint32_t tuples_received = 0;
+                tuple_t *tuple = NULL;
+                while ((tuple = gather_op->next(gather_op->state))) {
+                    assert(tuple_get_attr_num(tuple) == 1);
+                    assert(tuple_get_attr_value(tuple, "attr2") / 2 % 7 == 3);
+                    tuples_received++;
+                }
+                assert(tuples_received == tuple_num / 7 + (tuple_num % 7 > 3));
+                gather_op->close(gather_op->state);
+
+                /* Closing early skips morsels left */
+                gather_op->open(gather_op->state);
+                assert(gather_op->next_batch(gather_op->state));
+                gather_op->close(gather_op->state);
+
+                gather_op->destroy(gather_op);
+            }
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Gather workers probe a join table built in parallel */
+    {
+        const char *build_attr_names[] = {"key", "payload"};
+        relation_t *build_relation = relation_create_with_layout(build_attr_names, ARRAY_SIZE(build_attr_names),
+                                                                 LAYOUT_COLUMNS);
+        /* Every key is there twice */
+        const uint32_t build_tuple_num = 3 * MORSEL_SIZE + 6;
+        for (value_type_t tuple_i = 0; tuple_i < build_tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i / 2, tuple_i};
+            relation_append_values(build_relation, values);
+        }
+
+        const char *probe_attr_names[] = {"id", "fk"};
+        relation_t *probe_relation = relation_create_with_layout(probe_attr_names, ARRAY_SIZE(probe_attr_names),
+                                                                 LAYOUT_COLUMNS);
+        const uint32_t probe_tuple_num = 5 * MORSEL_SIZE + 7;
+        for (value_type_t tuple_i = 0; tuple_i < probe_tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i % (build_tuple_num / 2 + 100)};
+            relation_append_values(probe_relation, values);
+        }
+
+        uint32_t expected_row_num = 0;
+        uint64_t expected_sum = 0;
+        for (value_type_t tuple_i = 0; tuple_i < probe_tuple_num; tuple_i++) {
+            const value_type_t fk = tuple_i % (build_tuple_num / 2 + 100);
+            if (fk < build_tuple_num / 2) {
+                expected_row_num += 2;
+                expected_sum += 4 * fk + 1;
+            }
+        }
+
+        for (uint16_t worker_num = 1; worker_num <= 4; worker_num++) {
+            join_table_t *table = join_table_create(NULL, scan_op_create(NULL, build_relation), 0);
+            assert(table);
+
+            operator_t *pipelines[worker_num], *scan_ops[worker_num];
+            for (uint16_t worker_i = 0; worker_i < worker_num; worker_i++) {
+                scan_ops[worker_i] = scan_op_create(NULL, probe_relation);
+                pipelines[worker_i] = hash_probe_op_create(NULL, scan_ops[worker_i], table, 1, true);
+            }
+            operator_t *gather_op = gather_op_create(NULL, probe_relation, pipelines, scan_ops, worker_num, false);
+            assert(gather_op);
+            gather_op_add_join_table(gather_op, table);
+
+            /* Twice to check tables get rebuilt */
+            for (int run = 0; run < 2; run++) {
+                gather_op->open(gather_op->state);
+                uint32_t rows_received = 0;
+                uint64_t payload_sum = 0;
+                batch_t *batch = NULL;
+                while ((batch = gather_op->next_batch(gather_op->state))) {
+                    assert(batch->attr_num == 4);
+                    assert(0 == strcmp(batch->attr_names[0], "key"));
+                    assert(0 == strcmp(batch->attr_names[3], "fk"));
+                    for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                        const uint16_t row_i = batch->sel[sel_i];
+                        assert(batch->columns[0][row_i] == batch->columns[3][row_i]);
+                        assert(batch->columns[1][row_i] / 2 == batch->columns[0][row_i]);
+                        payload_sum += batch->columns[1][row_i];
+                        rows_received++;
+                    }
+                }
+                assert(rows_received == expected_row_num);
+                assert(payload_sum == expected_sum);
+                gather_op->close(gather_op->state);
+            }
+
+            gather_op->destroy(gather_op);
+        }
+
+        relation_destroy(build_relation);
+        relation_destroy(probe_relation);
+    }
+
+    /* Scans skip zones predicates cannot hold in */
+    for (relation_layout_t layout = LAYOUT_ROWS; layout <= LAYOUT_COLUMNS; layout++) {
+        const char *attr_names[] = {"ts", "val"};
+        relation_t *relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+        const uint32_t tuple_num = 10 * ZONE_TUPLE_NUM + 123;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i % 5};
+            relation_append_values(relation, values);
+        }
+
+        const struct {
+            select_predicate_op op;
+            value_type_t constant;
+            uint32_t first_tuple_i;
+            uint32_t range_tuple_num;
+            uint32_t scanned_num;
+            uint32_t selected_num;
+        } cases[] = {
+            /* Only the newest zones */
+            {SELECT_GT, 9 * ZONE_TUPLE_NUM + 5, 0, UINT32_MAX, ZONE_TUPLE_NUM + 123, ZONE_TUPLE_NUM + 117},
+            {SELECT_LT, 100, 0, UINT32_MAX, ZONE_TUPLE_NUM, 100},
+            {SELECT_EQ, 3 * ZONE_TUPLE_NUM + 1, 0, UINT32_MAX, ZONE_TUPLE_NUM, 1},
+            {SELECT_GT, tuple_num, 0, UINT32_MAX, 0, 0},
+            /* Ranges starting in the middle of zones */
+            {SELECT_GT, 9 * ZONE_TUPLE_NUM + 5, 9 * ZONE_TUPLE_NUM + 10, 100, 100, 100},
+            {SELECT_GT, 9 * ZONE_TUPLE_NUM + 5, 10, 3 * ZONE_TUPLE_NUM, 0, 0},
+            {SELECT_LT, 2 * ZONE_TUPLE_NUM, ZONE_TUPLE_NUM - 10, 3 * ZONE_TUPLE_NUM, ZONE_TUPLE_NUM + 10, ZONE_TUPLE_NUM + 10},
+        };
+
+        for (size_t case_i = 0; case_i < ARRAY_SIZE(cases); case_i++) {
+            operator_t *scan_op = scan_op_create(NULL, relation);
+            scan_op_add_zone_predicate(scan_op, 0, cases[case_i].op, cases[case_i].constant);
+            scan_op_set_range(scan_op, cases[case_i].first_tuple_i, cases[case_i].range_tuple_num);
+
+            /* Batches and tuples */
+            uint32_t scanned_num = 0;
+            scan_op->open(scan_op->state);
+            batch_t *batch = NULL;
+            while ((batch = scan_op->next_batch(scan_op->state)))
+                scanned_num += batch->sel_num;
+            scan_op->close(scan_op->state);
+            assert(scanned_num == cases[case_i].scanned_num);
+
+            scanned_num = 0;
+            scan_op->open(scan_op->state);
+            while (scan_op->next(scan_op->state))
+                scanned_num++;
+            scan_op->close(scan_op->state);
+            assert(scanned_num == cases[case_i].scanned_num);
+
+            /* Selections above get the rest */
+            operator_t *select_op = select_op_create(NULL, scan_op);
+            select_op_add_attr_const_predicate(select_op, 0, cases[case_i].op, cases[case_i].constant);
+            uint32_t selected_num = 0;
+            select_op->open(select_op->state);
+            while ((batch = select_op->next_batch(select_op->state)))
+                selected_num += batch->sel_num;
+            select_op->close(select_op->state);
+            assert(selected_num == cases[case_i].selected_num);
+
+            select_op->destroy(select_op);
+        }
+
+        /* Zones are summarized again after sorting, the newest tuples come first now */
+        relation_order_by(relation, 0, SORT_DESC);
+        operator_t *scan_op = scan_op_create(NULL, relation);
+        scan_op_add_zone_predicate(scan_op, 0, SELECT_GT, 9 * ZONE_TUPLE_NUM + 5);
+        uint32_t scanned_num = 0;
+        scan_op->open(scan_op->state);
+        batch_t *batch = NULL;
+        while ((batch = scan_op->next_batch(scan_op->state))) {
+            for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++)
+                assert(batch->columns[0][batch->sel[sel_i]] > 8 * ZONE_TUPLE_NUM);
+            scanned_num += batch->sel_num;
+        }
+        scan_op->close(scan_op->state);
+        assert(scanned_num == 2 * ZONE_TUPLE_NUM);
+        scan_op->destroy(scan_op);
+
+        relation_destroy(relation);
+    }
+
+    /* Index scans return tuples where an indexed attribute compares to a constant */
+    for (relation_layout_t layout = LAYOUT_ROWS; layout <= LAYOUT_COLUMNS; layout++) {
+        const char *attr_names[] = {"ts", "val"};
+        relation_t *relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+        const uint32_t tuple_num = 3 * BATCH_SIZE * 10 + 7;
+        const value_type_t distinct_num = 10;
+
+        /* Tuples appended both before and after the indexes are built */
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            if (tuple_i == tuple_num / 2) {
+                assert(relation_create_index(relation, 1));
+                assert(relation_create_hash_index(relation, 0));
+            }
+            const value_type_t values[] = {tuple_i, (tuple_i * 7) % distinct_num};
+            relation_append_values(relation, values);
+        }
+        assert(!relation_get_index(relation, 0));
+        assert(!relation_get_hash_index(relation, 1));
+        assert(btree_get_entry_num(relation_get_index(relation, 1)) == tuple_num);
+        assert(hash_index_get_entry_num(relation_get_hash_index(relation, 0)) == tuple_num);
+
+        const struct {
+            select_predicate_op op;
+            value_type_t constant;
+        } cases[] = {
+            {SELECT_EQ, 3}, {SELECT_EQ, distinct_num}, {SELECT_LT, 2}, {SELECT_LT, 0},
+            {SELECT_GT, 7}, {SELECT_GT, UINT32_MAX},
+        };
+
+        for (size_t case_i = 0; case_i < ARRAY_SIZE(cases); case_i++) {
+            const select_predicate_op op = cases[case_i].op;
+            const value_type_t constant = cases[case_i].constant;
+            uint32_t expected_num = 0;
+            for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+                const value_type_t val = (tuple_i * 7) % distinct_num;
+                expected_num += op == SELECT_EQ ? val == constant : op == SELECT_LT ? val < constant : val > constant;
+            }
+
+            operator_t *op_index = index_scan_op_create(NULL, relation, 1, op, constant);
+
+            /* Batches, twice to check reopening */
+            for (int run = 0; run < 2; run++) {
+                uint32_t scanned_num = 0;
+                value_type_t prev_val = 0;
+                op_index->open(op_index->state);
+                batch_t *batch = NULL;
+                while ((batch = op_index->next_batch(op_index->state))) {
+                    assert(batch->attr_num == 2);
+                    for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                        const uint16_t row_i = batch->sel[sel_i];
+                        const value_type_t ts = batch->columns[0][row_i], val = batch->columns[1][row_i];
+                        assert(val == (ts * 7) % distinct_num);
+                        assert(op == SELECT_EQ ? val == constant : op == SELECT_LT ? val < constant : val > constant);
+                        /* Values come in order */
+                        assert(scanned_num == 0 || prev_val <= val);
+                        prev_val = val;
+                        scanned_num++;
+                    }
+                }
+                op_index->close(op_index->state);
+                assert(scanned_num == expected_num);
+            }
+
+            /* Tuples */
+            uint32_t scanned_num = 0;
+            op_index->open(op_index->state);
+            tuple_t *tuple = NULL;
+            while ((tuple = op_index->next(op_index->state))) {
+                const value_type_t val = tuple_get_attr_value(tuple, "val");
+                assert(val == (tuple_get_attr_value(tuple, "ts") * 7) % distinct_num);
+                scanned_num++;
+            }
+            op_index->close(op_index->state);
+            assert(scanned_num == expected_num);
+
+            op_index->destroy(op_index);
+        }
+
+        /* The index follows tuples reordered, equal values come in the new relation order */
+        relation_order_by(relation, 0, SORT_DESC);
+        operator_t *op_index = index_scan_op_create(NULL, relation, 1, SELECT_EQ, 3);
+        op_index->open(op_index->state);
+        uint32_t scanned_num = 0;
+        value_type_t prev_ts = 0;
+        tuple_t *tuple = NULL;
+        while ((tuple = op_index->next(op_index->state))) {
+            const value_type_t ts = tuple_get_attr_value(tuple, "ts");
+            assert(tuple_get_attr_value(tuple, "val") == 3);
+            assert(scanned_num == 0 || ts < prev_ts);
+            prev_ts = ts;
+            scanned_num++;
+        }
+        op_index->close(op_index->state);
+        assert(scanned_num == tuple_num / distinct_num);
+        op_index->destroy(op_index);
+
+        /* Equality over the hash index */
+        for (value_type_t ts = 0; ts < tuple_num + 1; ts += 97) {
+            op_index = index_scan_op_create(NULL, relation, 0, SELECT_EQ, ts);
+            op_index->open(op_index->state);
+            tuple = op_index->next(op_index->state);
+            assert(ts < tuple_num ? tuple && tuple_get_attr_value(tuple, "ts") == ts : !tuple);
+            assert(!op_index->next(op_index->state));
+            op_index->close(op_index->state);
+            op_index->destroy(op_index);
+        }
+
+        relation_destroy(relation);
+    }
+
+    /* Constants given as parameters are read whenever operators are opened, so trees can be reopened
+     * with different constants */
+    {
+        const char *attr_names[] = {"ts", "val"};
+        relation_t *relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+        const uint32_t tuple_num = 4 * ZONE_TUPLE_NUM;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+            relation_append_values(relation, (value_type_t[]){tuple_i, tuple_i % 10});
+        assert(relation_create_index(relation, 0));
+
+        /* A selection over a scan skipping zones, both reading the same parameters */
+        value_type_t params[2] = {0, 0};
+        operator_t *scan_op = scan_op_create(NULL, relation);
+        scan_op_add_zone_param_predicate(scan_op, 0, SELECT_GT, &params[0]);
+        operator_t *select_op = select_op_create(NULL, scan_op);
+        select_op_add_attr_param_predicate(select_op, 0, SELECT_GT, &params[0]);
+        select_op_add_attr_param_predicate(select_op, 1, SELECT_EQ, &params[1]);
+
+        /* An index scan with the same parameter */
+        operator_t *index_op = index_scan_op_create(NULL, relation, 0, SELECT_GT, 0);
+        index_scan_op_set_param(index_op, &params[0]);
+
+        const value_type_t cases[][2] = {{0, 3}, {3 * ZONE_TUPLE_NUM, 7}, {tuple_num, 0}, {17, 9}};
+        for (size_t case_i = 0; case_i < ARRAY_SIZE(cases); case_i++) {
+            params[0] = cases[case_i][0];
+            params[1] = cases[case_i][1];
+            uint32_t expected_num = 0;
+            for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+                expected_num += tuple_i > params[0] && tuple_i % 10 == params[1];
+
+            uint32_t selected_num = 0;
+            select_op->open(select_op->state);
+            batch_t *batch = NULL;
+            while ((batch = select_op->next_batch(select_op->state))) {
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    assert(batch->columns[0][row_i] > params[0] && batch->columns[1][row_i] == params[1]);
+                }
+                selected_num += batch->sel_num;
+            }
+            select_op->close(select_op->state);
+            assert(selected_num == expected_num);
+
+            /* Tuples too */
+            selected_num = 0;
+            select_op->open(select_op->state);
+            while (select_op->next(select_op->state))
+                selected_num++;
+            select_op->close(select_op->state);
+            assert(selected_num == expected_num);
+
+            uint32_t scanned_num = 0;
+            index_op->open(index_op->state);
+            tuple_t *tuple = NULL;
+            while ((tuple = index_op->next(index_op->state))) {
+                assert(tuple_get_attr_value(tuple, "ts") > params[0]);
+                scanned_num++;
+            }
+            index_op->close(index_op->state);
+            assert(scanned_num == (params[0] < tuple_num ? tuple_num - params[0] - 1 : 0));
+        }
+
+        index_op->destroy(index_op);
+        select_op->destroy(select_op);
+        relation_destroy(relation);
+    }
+
+    /* Relations saved to files and mapped back keep their values, zones and layout */
+    for (relation_layout_t layout = LAYOUT_ROWS; layout <= LAYOUT_COLUMNS; layout++) {
+        char path[] = "/tmp/pigletql-eval-test-XXXXXX";
+        const int fd = mkstemp(path);
+        assert(fd >= 0);
+        close(fd);
+
+        const char *attr_names[] = {"ts", "val", "pad"};
+        relation_t *relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+        const uint32_t tuple_num = 3 * ZONE_TUPLE_NUM + 5;
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+            relation_append_values(relation, (value_type_t[]){tuple_i, tuple_i % 11, 7});
+        assert(relation_save(relation, path));
+        relation_destroy(relation);
+
+        relation = relation_open(path);
+        assert(relation);
+        assert(relation_get_layout(relation) == layout);
+        assert(relation_get_attr_num(relation) == 3);
+        assert(relation_attr_i_by_name(relation, "val") == 1);
+        assert(relation_get_tuple_num(relation) == tuple_num);
+        for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+            const value_type_t *values = relation_tuple_values_by_id(relation, tuple_i);
+            assert(values[0] == tuple_i && values[1] == tuple_i % 11 && values[2] == 7);
+        }
+
+        /* Zones are there, only the zone with the value is scanned */
+        operator_t *scan_op = scan_op_create(NULL, relation);
+        scan_op_add_zone_predicate(scan_op, 0, SELECT_EQ, ZONE_TUPLE_NUM + 1);
+        uint32_t scanned_num = 0;
+        scan_op->open(scan_op->state);
+        batch_t *batch = NULL;
+        while ((batch = scan_op->next_batch(scan_op->state)))
+            scanned_num += batch->sel_num;
+        scan_op->close(scan_op->state);
+        assert(scanned_num == ZONE_TUPLE_NUM);
+        scan_op->destroy(scan_op);
+
+        /* Mapped relations get sorted in place and grow out of the mapping */
+        relation_order_by(relation, 0, SORT_DESC);
+        assert(relation_get_value(relation, 0, 0) == tuple_num - 1);
+        for (value_type_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+            relation_append_values(relation, (value_type_t[]){tuple_i, 0, 0});
+        assert(relation_get_tuple_num(relation) == 2 * tuple_num);
+        assert(relation_get_value(relation, 0, 0) == tuple_num - 1);
+        assert(relation_get_value(relation, 2 * tuple_num - 1, 0) == tuple_num - 1);
+        relation_destroy(relation);
+
+        /* The file was not changed */
+        relation = relation_open(path);
+        assert(relation_get_tuple_num(relation) == tuple_num);
+        assert(relation_get_value(relation, 0, 0) == 0);
+        relation_destroy(relation);
+
+        /* Empty relations */
+        relation = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+        assert(relation_save(relation, path));
+        relation_destroy(relation);
+        relation = relation_open(path);
+        assert(relation && relation_get_tuple_num(relation) == 0);
+        relation_append_values(relation, (value_type_t[]){1, 2, 3});
+        assert(relation_get_value(relation, 0, 2) == 3);
+        relation_destroy(relation);
+
+        /* Not a relation file */
+        FILE *file = fopen(path, "w");
+        assert(file);
+        fputs("garbage", file);
+        fclose(file);
+        assert(!relation_open(path));
+        unlink(path);
+        assert(!relation_open(path));
+    }
+
+    /* Index joins look inner tuples up in hash indexes and B+trees alike */
+    for (index_type_t type = INDEX_BTREE; type <= INDEX_HASH; type++) {
+        const char *outer_attr_names[] = {"id", "ref"};
+        relation_t *outer_relation = relation_create_with_layout(outer_attr_names, ARRAY_SIZE(outer_attr_names),
+                                                                 LAYOUT_COLUMNS);
+        const uint32_t outer_tuple_num = 2 * BATCH_SIZE + 3;
+        for (value_type_t tuple_i = 0; tuple_i < outer_tuple_num; tuple_i++)
+            relation_append_values(outer_relation, (value_type_t[]){tuple_i, tuple_i % 13});
+
+        const char *inner_attr_names[] = {"key", "payload", "extra"};
+        relation_t *inner_relation = relation_create_with_layout(inner_attr_names, ARRAY_SIZE(inner_attr_names),
+                                                                 LAYOUT_ROWS);
+        const uint32_t inner_tuple_num = 50;
+        for (value_type_t tuple_i = 0; tuple_i < inner_tuple_num; tuple_i++)
+            relation_append_values(inner_relation, (value_type_t[]){tuple_i % 10, tuple_i * 2, 1});
+        if (type == INDEX_HASH)
+            assert(relation_create_hash_index(inner_relation, 0));
+        else
+            assert(relation_create_index(inner_relation, 0));
+
+        /* 5 inner tuples for every outer ref below 10 */
+        uint32_t expected_num = 0;
+        for (value_type_t tuple_i = 0; tuple_i < outer_tuple_num; tuple_i++)
+            expected_num += tuple_i % 13 < 10 ? 5 : 0;
+
+        /* Inner tuples only get the payload and the key, in that order */
+        const uint16_t inner_attr_is[] = {1, 0};
+        for (int inner_left = 0; inner_left < 2; inner_left++) {
+            operator_t *join_op = index_join_op_create(NULL, scan_op_create(NULL, outer_relation), inner_relation,
+                                                       1, 0, inner_attr_is, ARRAY_SIZE(inner_attr_is), inner_left);
+            assert(join_op);
+            const uint16_t outer_offset = inner_left ? 2 : 0, inner_offset = inner_left ? 0 : 2;
+
+            uint32_t joined_num = 0;
+            join_op->open(join_op->state);
+            batch_t *batch = NULL;
+            while ((batch = join_op->next_batch(join_op->state))) {
+                assert(batch->attr_num == 4);
+                assert(0 == strcmp(batch->attr_names[inner_offset], "payload"));
+                assert(0 == strcmp(batch->attr_names[inner_offset + 1], "key"));
+                assert(0 == strcmp(batch->attr_names[outer_offset + 1], "ref"));
+                for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+                    const uint16_t row_i = batch->sel[sel_i];
+                    const value_type_t key = batch->columns[inner_offset + 1][row_i];
+                    assert(key == batch->columns[outer_offset + 1][row_i]);
+                    assert((batch->columns[inner_offset][row_i] / 2) % 10 == key);
+                    joined_num++;
+                }
+            }
+            join_op->close(join_op->state);
+            assert(joined_num == expected_num);
+
+            joined_num = 0;
+            join_op->open(join_op->state);
+            tuple_t *tuple = NULL;
+            while ((tuple = join_op->next(join_op->state))) {
+                assert(tuple_get_attr_num(tuple) == 4);
+                const value_type_t key = tuple_get_attr_value(tuple, "key");
+                assert(key == tuple_get_attr_value(tuple, "ref"));
+                assert((tuple_get_attr_value(tuple, "payload") / 2) % 10 == key);
+                assert(tuple_get_attr_value_by_i(tuple, inner_offset + 1) == key);
+                joined_num++;
+            }
+            join_op->close(join_op->state);
+            assert(joined_num == expected_num);
+
+            join_op->destroy(join_op);
+        }
+
+        relation_destroy(inner_relation);
+        relation_destroy(outer_relation);
+    }
+
     return 0;
 }
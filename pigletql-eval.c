@@ -1,8 +1,21 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "pigletql-eval.h"
+#include "pigletql-filter.h"
+#include "pigletql-intern.h"
+#include "pigletql-sort.h"
+#include "pigletql-pool.h"
 
 /*
  * Tuple represents either a tuple itself, a tuple projection or a tuple join
@@ -27,8 +40,8 @@ typedef struct tuple_source_t {
 typedef struct tuple_project_t {
     /* a reference to tuple to project attributes from  */
     tuple_t *source_tuple;
-    /* projected attributes */
-    attr_name_t attr_names[MAX_ATTR_NUM];
+    /* indices of projected attributes in the source tuple */
+    const uint16_t *source_attr_is;
     uint16_t attr_num;
 } tuple_project_t;
 
@@ -37,6 +50,8 @@ typedef struct tuple_join_t {
     /* Contained tuples to join attributes from */
     tuple_t *left_source_tuple;
     tuple_t *right_source_tuple;
+    /* Number of attributes in the left source tuple */
+    uint16_t left_attr_num;
 } tuple_join_t;
 
 /* A unified tuple type passed between operators */
@@ -54,12 +69,20 @@ static bool tuple_source_has_attr(const tuple_source_t *source, const attr_name_
     return relation_has_attr(source->relation, attr_name);
 }
 
+static uint16_t tuple_project_attr_i_by_name(const tuple_project_t *project, const attr_name_t attr_name)
+{
+    for (size_t attr_i = 0; attr_i < project->attr_num; attr_i++ ) {
+        const char *source_attr_name =
+            tuple_get_attr_name_by_i(project->source_tuple, project->source_attr_is[attr_i]);
+        if (strcmp(source_attr_name, attr_name) == 0)
+            return attr_i;
+    }
+    return ATTR_NOT_FOUND;
+}
+
 static bool tuple_project_has_attr(const tuple_project_t *project, const attr_name_t attr_name)
 {
-    for (size_t attr_i = 0; attr_i < project->attr_num; attr_i++ )
-        if (strcmp(project->attr_names[attr_i], attr_name) == 0)
-            return tuple_has_attr(project->source_tuple, attr_name);
-    return false;
+    return tuple_project_attr_i_by_name(project, attr_name) != ATTR_NOT_FOUND;
 }
 
 static bool tuple_join_has_attr(const tuple_join_t *join, const attr_name_t attr_name)
@@ -84,15 +107,14 @@ static value_type_t tuple_source_get_attr_value(const tuple_source_t *source, co
 {
     const relation_t *relation = source->relation;
     uint16_t attr_i = relation_attr_i_by_name(relation, attr_name);
-    return relation_tuple_values_by_id(relation, source->tuple_i)[attr_i];
+    return relation_get_value(relation, source->tuple_i, attr_i);
 }
 
 static value_type_t tuple_project_get_attr_value(const tuple_project_t *project, const attr_name_t attr_name)
 {
-    for (size_t attr_i = 0; attr_i < project->attr_num; attr_i++ )
-        if (strcmp(project->attr_names[attr_i], attr_name) == 0)
-            return tuple_get_attr_value(project->source_tuple, attr_name);
-    assert(false);
+    uint16_t attr_i = tuple_project_attr_i_by_name(project, attr_name);
+    assert(attr_i != ATTR_NOT_FOUND);
+    return tuple_get_attr_value_by_i(project->source_tuple, project->source_attr_is[attr_i]);
 }
 
 static value_type_t tuple_join_get_attr_value(const tuple_join_t *join, const attr_name_t attr_name)
@@ -130,8 +152,7 @@ uint16_t tuple_project_get_attr_num(const tuple_project_t *tuple)
 
 uint16_t tuple_join_get_attr_num(const tuple_join_t *tuple)
 {
-    return tuple_get_attr_num(tuple->left_source_tuple)
-        + tuple_get_attr_num(tuple->right_source_tuple);
+    return tuple->left_attr_num + tuple_get_attr_num(tuple->right_source_tuple);
 }
 
 uint16_t tuple_get_attr_num(const tuple_t *tuple)
@@ -148,20 +169,20 @@ uint16_t tuple_get_attr_num(const tuple_t *tuple)
 
 value_type_t tuple_source_get_attr_value_by_i(const tuple_source_t *tuple, const uint16_t attr_i)
 {
-    return relation_tuple_values_by_id(tuple->relation, tuple->tuple_i)[attr_i];
+    return relation_get_value(tuple->relation, tuple->tuple_i, attr_i);
 }
 
 value_type_t tuple_project_get_attr_value_by_i(const tuple_project_t *tuple, const uint16_t attr_i)
 {
     assert(attr_i < tuple->attr_num);
 
-    return tuple_project_get_attr_value(tuple, tuple->attr_names[attr_i]);
+    return tuple_get_attr_value_by_i(tuple->source_tuple, tuple->source_attr_is[attr_i]);
 }
 
 value_type_t tuple_join_get_attr_value_by_i(const tuple_join_t *tuple, const uint16_t attr_i)
 {
     assert(attr_i < tuple_join_get_attr_num(tuple));
-    const uint16_t left_source_attr_num = tuple_get_attr_num(tuple->left_source_tuple);
+    const uint16_t left_source_attr_num = tuple->left_attr_num;
     if (attr_i < left_source_attr_num)
         return tuple_get_attr_value_by_i(tuple->left_source_tuple, attr_i);
     else
@@ -189,13 +210,13 @@ const char *tuple_project_get_attr_name_by_i(const tuple_project_t *tuple, const
 {
     assert(attr_i < tuple->attr_num);
 
-    return &tuple->attr_names[attr_i][0];
+    return tuple_get_attr_name_by_i(tuple->source_tuple, tuple->source_attr_is[attr_i]);
 }
 
 const char *tuple_join_get_attr_name_by_i(const tuple_join_t *tuple, const uint16_t attr_i)
 {
     assert(attr_i < tuple_join_get_attr_num(tuple));
-    const uint16_t left_source_attr_num = tuple_get_attr_num(tuple->left_source_tuple);
+    const uint16_t left_source_attr_num = tuple->left_attr_num;
     if (attr_i < left_source_attr_num)
         return tuple_get_attr_name_by_i(tuple->left_source_tuple, attr_i);
     else
@@ -218,26 +239,212 @@ const char *tuple_get_attr_name_by_i(const tuple_t *tuple, const uint16_t attr_i
  * Relation - see pigletql.h for comments
  *  */
 
+/* Columns of columnar relations start at cache line boundaries */
+#define COLUMN_ALIGNMENT 64
+/* Relations grow geometrically starting with this number of tuple slots */
+#define RELATION_MIN_TUPLE_SLOTS 1024
+
 struct relation_t {
-    attr_name_t attr_names[MAX_ATTR_NUM];
+    /* Interned attribute names */
+    const char **attr_names;
     uint16_t attr_num;
 
+    relation_layout_t layout;
+
+    /* Row relations store tuples one after another, columnar relations store attribute columns one
+     * after another, tuple_slots values apart */
     value_type_t *tuples;
     uint32_t tuple_num;
     uint32_t tuple_slots;
+
+    /* Relations opened from files keep tuples in a private mapping of the file until they grow */
+    void *mapping;
+    size_t mapping_size;
+
+    /* Values of a tuple gathered from columns */
+    value_type_t *tuple_buf;
+
+    /* Minimum and maximum attribute values of zones of ZONE_TUPLE_NUM tuples, attr_num values per
+     * zone */
+    value_type_t *zone_mins;
+    value_type_t *zone_maxs;
+    uint32_t zone_slots;
+
+    /* Indexes of both kinds, one slot per attribute, NULL if no attribute is indexed yet */
+    btree_t **indexes;
+    hash_index_t **hash_indexes;
+
+    /* Relations materialized from batches with 64-bit attributes keep upper halves of their values
+     * in the last wide_attr_num attributes. high_attr_is has the attribute of the upper half of every
+     * other attribute, 0 if there's none, and is NULL if there are no 64-bit attributes. */
+    uint16_t wide_attr_num;
+    uint16_t *high_attr_is;
 };
 
-relation_t *relation_create(const attr_name_t *attr_names, const uint16_t attr_num)
+static inline value_type_t *relation_value_ptr(const relation_t *rel, const uint32_t tuple_i, const uint16_t attr_i)
+{
+    if (rel->layout == LAYOUT_COLUMNS)
+        return &rel->tuples[(size_t)attr_i * rel->tuple_slots + tuple_i];
+    return &rel->tuples[(size_t)tuple_i * rel->attr_num + attr_i];
+}
+
+static void relation_reserve_zones(relation_t *rel, const uint64_t tuple_slots)
+{
+    const uint32_t zone_slots = (uint32_t)((tuple_slots + ZONE_TUPLE_NUM - 1) / ZONE_TUPLE_NUM);
+    if (zone_slots <= rel->zone_slots)
+        return;
+
+    const size_t bytes_needed = (size_t)zone_slots * rel->attr_num * sizeof(value_type_t);
+    rel->zone_mins = realloc(rel->zone_mins, bytes_needed);
+    rel->zone_maxs = realloc(rel->zone_maxs, bytes_needed);
+    assert(rel->zone_mins && rel->zone_maxs);
+    rel->zone_slots = zone_slots;
+}
+
+/* Account a value just written in its zone, the first tuple of a zone starts it over */
+static inline void relation_zone_add(relation_t *rel, const uint32_t tuple_i, const uint16_t attr_i,
+                                     const value_type_t value)
+{
+    const size_t zone_value_i = (size_t)(tuple_i / ZONE_TUPLE_NUM) * rel->attr_num + attr_i;
+    const bool is_first = tuple_i % ZONE_TUPLE_NUM == 0;
+    if (is_first || value < rel->zone_mins[zone_value_i])
+        rel->zone_mins[zone_value_i] = value;
+    if (is_first || value > rel->zone_maxs[zone_value_i])
+        rel->zone_maxs[zone_value_i] = value;
+}
+
+/* Summarize all the zones from scratch, e.g. after tuples got reordered */
+static void relation_rebuild_zones(relation_t *rel)
+{
+    for (uint32_t tuple_i = 0; tuple_i < rel->tuple_num; tuple_i++)
+        for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
+            relation_zone_add(rel, tuple_i, attr_i, *relation_value_ptr(rel, tuple_i, attr_i));
+}
+
+/* Put a tuple just written into all the indexes */
+static inline void relation_index_add(relation_t *rel, const uint32_t tuple_i)
+{
+    if (!rel->indexes)
+        return;
+    for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++) {
+        if (rel->indexes[attr_i])
+            btree_insert(rel->indexes[attr_i], *relation_value_ptr(rel, tuple_i, attr_i), tuple_i);
+        if (rel->hash_indexes[attr_i])
+            hash_index_insert(rel->hash_indexes[attr_i], *relation_value_ptr(rel, tuple_i, attr_i), tuple_i);
+    }
+}
+
+/* Index all the tuples from scratch, e.g. after tuples got reordered */
+static void relation_rebuild_indexes(relation_t *rel)
+{
+    if (!rel->indexes)
+        return;
+    for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++) {
+        if (rel->indexes[attr_i])
+            btree_reset(rel->indexes[attr_i]);
+        if (rel->hash_indexes[attr_i])
+            hash_index_reset(rel->hash_indexes[attr_i]);
+    }
+    for (uint32_t tuple_i = 0; tuple_i < rel->tuple_num; tuple_i++)
+        relation_index_add(rel, tuple_i);
+}
+
+static void relation_free_tuples(relation_t *rel)
+{
+    if (rel->mapping)
+        munmap(rel->mapping, rel->mapping_size);
+    else
+        free(rel->tuples);
+    rel->tuples = NULL;
+    rel->mapping = NULL;
+    rel->mapping_size = 0;
+}
+
+/* Make sure there are enough slots for the number of tuples given */
+static void relation_reserve(relation_t *rel, const uint32_t tuple_num)
+{
+    if (tuple_num <= rel->tuple_slots)
+        return;
+
+    uint64_t tuple_slots = rel->tuple_slots ? rel->tuple_slots : RELATION_MIN_TUPLE_SLOTS;
+    while (tuple_slots < tuple_num)
+        tuple_slots *= 2;
+    if (tuple_slots > UINT32_MAX)
+        tuple_slots = UINT32_MAX;
+    relation_reserve_zones(rel, tuple_slots);
+    const size_t bytes_needed = tuple_slots * rel->attr_num * sizeof(value_type_t);
+
+    if (rel->layout == LAYOUT_ROWS && !rel->mapping) {
+        rel->tuples = realloc(rel->tuples, bytes_needed);
+        assert(rel->tuples);
+    } else {
+        /* Columns move apart and mappings cannot grow, so copy values over */
+        value_type_t *tuples = aligned_alloc(COLUMN_ALIGNMENT, bytes_needed);
+        assert(tuples);
+        if (rel->layout == LAYOUT_ROWS && rel->tuples)
+            memcpy(tuples, rel->tuples, (size_t)rel->tuple_num * rel->attr_num * sizeof(value_type_t));
+        for (size_t attr_i = 0; rel->layout == LAYOUT_COLUMNS && rel->tuples && attr_i < rel->attr_num; attr_i++)
+            memcpy(&tuples[attr_i * tuple_slots], &rel->tuples[attr_i * rel->tuple_slots],
+                   rel->tuple_num * sizeof(value_type_t));
+        relation_free_tuples(rel);
+        rel->tuples = tuples;
+    }
+    rel->tuple_slots = (uint32_t)tuple_slots;
+}
+
+/* Attribute names given should be interned already */
+static relation_t *relation_create_interned(const char *const *attr_names, const uint16_t attr_num,
+                                            const relation_layout_t layout)
 {
     relation_t *rel = calloc(1, sizeof(*rel));
     if (!rel)
-        return NULL;
+        goto rel_fail;
 
+    rel->attr_names = calloc(attr_num, sizeof(*rel->attr_names));
+    if (!rel->attr_names)
+        goto names_fail;
     rel->attr_num = attr_num;
-    for(size_t attr_i = 0; attr_i < attr_num; attr_i++)
-        strncpy(rel->attr_names[attr_i], attr_names[attr_i], MAX_ATTR_NAME_LEN);
+    memcpy(rel->attr_names, attr_names, attr_num * sizeof(*rel->attr_names));
+
+    rel->layout = layout;
+    if (layout == LAYOUT_COLUMNS) {
+        rel->tuple_buf = calloc(attr_num, sizeof(value_type_t));
+        if (!rel->tuple_buf)
+            goto buf_fail;
+    }
 
     return rel;
+
+buf_fail:
+    free(rel->attr_names);
+
+names_fail:
+    free(rel);
+
+rel_fail:
+    return NULL;
+}
+
+relation_t *relation_create_with_layout(const char *const *attr_names, const uint16_t attr_num,
+                                        const relation_layout_t layout)
+{
+    const char *interned_names[attr_num];
+    for (size_t attr_i = 0; attr_i < attr_num; attr_i++)
+        interned_names[attr_i] = intern(attr_names[attr_i]);
+    return relation_create_interned(interned_names, attr_num, layout);
+}
+
+relation_t *relation_create(const attr_name_t *attr_names, const uint16_t attr_num)
+{
+    const char *names[attr_num];
+    for (size_t attr_i = 0; attr_i < attr_num; attr_i++)
+        names[attr_i] = attr_names[attr_i];
+    return relation_create_with_layout(names, attr_num, LAYOUT_ROWS);
+}
+
+relation_layout_t relation_get_layout(const relation_t *rel)
+{
+    return rel->layout;
 }
 
 void relation_fill_from_table(
@@ -245,65 +452,119 @@ void relation_fill_from_table(
     const value_type_t *table,
     const uint32_t tuple_num)
 {
+    relation_reserve(rel, tuple_num);
     rel->tuple_num = tuple_num;
-    rel->tuple_slots = tuple_num;
-    rel->tuples = calloc(1, sizeof(value_type_t) * rel->attr_num * tuple_num);
-    assert(rel->tuples);
 
     for(size_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
         for(size_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
-            rel->tuples[tuple_i * rel->attr_num + attr_i] = table[tuple_i * rel->attr_num + attr_i];
+            *relation_value_ptr(rel, tuple_i, attr_i) = table[tuple_i * rel->attr_num + attr_i];
+    relation_rebuild_zones(rel);
+    relation_rebuild_indexes(rel);
 }
 
 relation_t *relation_create_for_tuple(const tuple_t *tuple)
 {
     const uint16_t attr_num = tuple_get_attr_num(tuple);
-    attr_name_t attr_names[attr_num];
-    memset(attr_names, 0, attr_num * sizeof(attr_name_t));
+    const char *attr_names[attr_num];
     for (size_t attr_i = 0; attr_i < attr_num; attr_i++ )
-        strncpy(attr_names[attr_i],tuple_get_attr_name_by_i(tuple,attr_i),MAX_ATTR_NAME_LEN);
+        attr_names[attr_i] = tuple_get_attr_name_by_i(tuple, attr_i);
 
-    return relation_create(attr_names, attr_num);
+    return relation_create_with_layout(attr_names, attr_num, LAYOUT_ROWS);
 }
 
-void relation_order_by(relation_t *rel, const attr_name_t sort_attr_name, const sort_order_t order)
+/* Attributes of tuples of a relation as returned in batches, upper halves are no attributes there */
+static inline uint16_t relation_batch_attr_num(const relation_t *rel)
 {
-    (void) order;
-    uint16_t attr_i = relation_attr_i_by_name(rel, sort_attr_name);
-    int cmptuplesasc(const void *leftp, const void *rightp) {
-        const value_type_t *left = leftp, *right = rightp;
-        return (int)left[attr_i] - (int)right[attr_i];
-    };
-    int cmptuplesdesc(const void *leftp, const void *rightp) {
-        const value_type_t *left = leftp, *right = rightp;
-        return (int)right[attr_i] - (int)left[attr_i];
-    };
+    return rel->attr_num - rel->wide_attr_num;
+}
+
+/* Attribute keeping the upper half of an attribute, 0 if the attribute is not 64-bit */
+static inline uint16_t relation_high_attr_i(const relation_t *rel, const uint16_t attr_i)
+{
+    if (!rel->high_attr_is || attr_i >= relation_batch_attr_num(rel))
+        return 0;
+    return rel->high_attr_is[attr_i];
+}
+
+static void relation_order_by_attr(relation_t *rel, const uint16_t attr_i, const sort_order_t order)
+{
+    if (rel->tuple_num == 0)
+        return;
+
+    /* Sort tuple ids by the key attribute, then gather tuples in their new order */
+    uint32_t *tuple_is = calloc(rel->tuple_num, sizeof(uint32_t));
+    assert(tuple_is);
+    const size_t key_stride = rel->layout == LAYOUT_COLUMNS ? 1 : rel->attr_num;
+    sort_ids_by_keys(relation_value_ptr(rel, 0, attr_i), key_stride, rel->tuple_num, order, tuple_is);
+
+    if (rel->layout == LAYOUT_COLUMNS) {
+        /* Columns are gathered one by one through a single column buffer */
+        value_type_t *column_buf = calloc(rel->tuple_num, sizeof(value_type_t));
+        assert(column_buf);
+        for (uint16_t column_i = 0; column_i < rel->attr_num; column_i++) {
+            value_type_t *column = relation_value_ptr(rel, 0, column_i);
+            for (uint32_t tuple_i = 0; tuple_i < rel->tuple_num; tuple_i++)
+                column_buf[tuple_i] = column[tuple_is[tuple_i]];
+            memcpy(column, column_buf, rel->tuple_num * sizeof(value_type_t));
+        }
+        free(column_buf);
+    } else {
+        /* Whole tuples are gathered into a new buffer replacing the old one */
+        const size_t tuple_size = rel->attr_num * sizeof(value_type_t);
+        value_type_t *tuples = calloc(rel->tuple_slots, tuple_size);
+        assert(tuples);
+        for (uint32_t tuple_i = 0; tuple_i < rel->tuple_num; tuple_i++)
+            memcpy(&tuples[(size_t)tuple_i * rel->attr_num],
+                   &rel->tuples[(size_t)tuple_is[tuple_i] * rel->attr_num], tuple_size);
+        relation_free_tuples(rel);
+        rel->tuples = tuples;
+    }
+    relation_rebuild_zones(rel);
+    relation_rebuild_indexes(rel);
+
+    free(tuple_is);
+}
 
-    qsort(rel->tuples, rel->tuple_num, rel->attr_num * sizeof(value_type_t),
-          order == SORT_ASC ? cmptuplesasc : cmptuplesdesc);
+void relation_order_by(relation_t *rel, const uint16_t attr_i, const sort_order_t order)
+{
+    relation_order_by_attr(rel, attr_i, order);
+    /* Sorting is stable, so sorting by upper halves next orders 64-bit attributes by both halves */
+    const uint16_t high_attr_i = relation_high_attr_i(rel, attr_i);
+    if (high_attr_i)
+        relation_order_by_attr(rel, high_attr_i, order);
 }
 
 value_type_t *relation_tuple_values_by_id(const relation_t *rel, uint32_t tuple_i)
 {
-    return &rel->tuples[tuple_i * rel->attr_num];
+    if (rel->layout == LAYOUT_ROWS)
+        return &rel->tuples[tuple_i * rel->attr_num];
+
+    for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
+        rel->tuple_buf[attr_i] = *relation_value_ptr(rel, tuple_i, attr_i);
+    return rel->tuple_buf;
+}
+
+value_type_t relation_get_value(const relation_t *rel, const uint32_t tuple_i, const uint16_t attr_i)
+{
+    return *relation_value_ptr(rel, tuple_i, attr_i);
 }
 
 uint16_t relation_attr_i_by_name(const relation_t *rel, const attr_name_t attr_name)
 {
     for (size_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
-        if (strcmp(rel->attr_names[attr_i], attr_name) == 0)
+        if (rel->attr_names[attr_i] == attr_name || strcmp(rel->attr_names[attr_i], attr_name) == 0)
             return attr_i;
     return ATTR_NOT_FOUND;
 }
 
 const char *relation_attr_name_by_i(const relation_t *rel, const uint16_t attr_i)
 {
-    return &rel->attr_names[attr_i][0];
+    return rel->attr_names[attr_i];
 }
 
 uint16_t relation_get_attr_num(const relation_t *rel)
 {
-    return rel->attr_num;
+    return relation_batch_attr_num(rel);
 }
 
 bool relation_has_attr(const relation_t *rel, const attr_name_t attr_name)
@@ -316,24 +577,10 @@ uint32_t relation_get_tuple_num(const relation_t *rel)
     return rel->tuple_num;
 }
 
-static void relation_ensure_space(relation_t *rel)
-{
-    if (rel->tuple_num >= rel->tuple_slots) {
-        rel->tuple_slots += 1000;
-        const size_t bytes_needed = rel->tuple_slots * rel->attr_num * sizeof(value_type_t);
-        rel->tuples = realloc(rel->tuples, bytes_needed);
-        assert(rel->tuples);
-    }
-}
-
-static value_type_t *relation_get_new_slot(relation_t *rel)
+static uint32_t relation_new_tuple(relation_t *rel)
 {
-    relation_ensure_space(rel);
-
-    value_type_t *tuple_slot = &rel->tuples[rel->tuple_num * rel->attr_num];
-    rel->tuple_num++;
-
-    return tuple_slot;
+    relation_reserve(rel, rel->tuple_num + 1);
+    return rel->tuple_num++;
 }
 
 void relation_append_tuple(relation_t *rel, const tuple_t *tuple)
@@ -345,10 +592,13 @@ void relation_append_tuple(relation_t *rel, const tuple_t *tuple)
         assert(strncmp(rel->attr_names[attr_i], tuple_get_attr_name_by_i(tuple, attr_i), MAX_ATTR_NAME_LEN) == 0);
 
     /* copy tuple data */
-    value_type_t *tuple_slot = relation_get_new_slot(rel);
-    for (size_t attr_i = 0; attr_i < tuple_attr_num; attr_i++)
-        tuple_slot[attr_i] = tuple_get_attr_value_by_i(tuple, attr_i);
-
+    const uint32_t tuple_i = relation_new_tuple(rel);
+    for (size_t attr_i = 0; attr_i < tuple_attr_num; attr_i++) {
+        const value_type_t value = tuple_get_attr_value_by_i(tuple, attr_i);
+        *relation_value_ptr(rel, tuple_i, attr_i) = value;
+        relation_zone_add(rel, tuple_i, attr_i, value);
+    }
+    relation_index_add(rel, tuple_i);
 }
 
 void relation_append_values(relation_t *rel, const value_type_t *values)
@@ -356,674 +606,4634 @@ void relation_append_values(relation_t *rel, const value_type_t *values)
     /* No checks here as data should be already validated by now */
 
     /* copy values */
-    value_type_t *tuple_slot = relation_get_new_slot(rel);
-    for (size_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
-        tuple_slot[attr_i] = values[attr_i];
+    const uint32_t tuple_i = relation_new_tuple(rel);
+    for (size_t attr_i = 0; attr_i < rel->attr_num; attr_i++) {
+        *relation_value_ptr(rel, tuple_i, attr_i) = values[attr_i];
+        relation_zone_add(rel, tuple_i, attr_i, values[attr_i]);
+    }
+    relation_index_add(rel, tuple_i);
+}
 
+void relation_append_table(relation_t *rel, const value_type_t *table, const uint32_t table_tuple_num)
+{
+    const uint32_t first_tuple_i = rel->tuple_num;
+    relation_reserve(rel, first_tuple_i + table_tuple_num);
+
+    for (uint32_t table_tuple_i = 0; table_tuple_i < table_tuple_num; table_tuple_i++) {
+        const value_type_t *values = &table[(size_t)table_tuple_i * rel->attr_num];
+        for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++) {
+            *relation_value_ptr(rel, first_tuple_i + table_tuple_i, attr_i) = values[attr_i];
+            relation_zone_add(rel, first_tuple_i + table_tuple_i, attr_i, values[attr_i]);
+        }
+    }
+    rel->tuple_num += table_tuple_num;
+    for (uint32_t tuple_i = first_tuple_i; tuple_i < rel->tuple_num; tuple_i++)
+        relation_index_add(rel, tuple_i);
 }
 
-void relation_reset(relation_t *rel)
+void relation_reserve_tuples(relation_t *rel, const uint32_t tuple_num)
 {
-    rel->tuple_num = 0;
-    rel->tuple_slots = 0;
-    const size_t bytes_needed = rel->tuple_slots * rel->attr_num * sizeof(value_type_t);
-    rel->tuples = realloc(rel->tuples, bytes_needed);
+    relation_reserve(rel, tuple_num);
 }
 
-void relation_destroy(relation_t *rel)
+/* Index slots are only allocated for relations getting indexed */
+static void relation_reserve_indexes(relation_t *rel)
 {
-    if (!rel)
+    if (rel->indexes)
         return;
-    if (rel->tuples)
-        free(rel->tuples);
-    free(rel);
+    rel->indexes = calloc(rel->attr_num, sizeof(*rel->indexes));
+    rel->hash_indexes = calloc(rel->attr_num, sizeof(*rel->hash_indexes));
+    assert(rel->indexes && rel->hash_indexes);
 }
 
-/*
- * Operators - see pigletql.h
- *  */
+const btree_t *relation_create_index(relation_t *rel, const uint16_t attr_i)
+{
+    assert(attr_i < rel->attr_num);
+    relation_reserve_indexes(rel);
+    if (rel->indexes[attr_i])
+        return rel->indexes[attr_i];
+
+    btree_t *index = btree_create();
+    assert(index);
+    for (uint32_t tuple_i = 0; tuple_i < rel->tuple_num; tuple_i++)
+        btree_insert(index, *relation_value_ptr(rel, tuple_i, attr_i), tuple_i);
+    rel->indexes[attr_i] = index;
+    return index;
+}
 
-/* Table scanning operator */
+const btree_t *relation_get_index(const relation_t *rel, const uint16_t attr_i)
+{
+    return rel->indexes ? rel->indexes[attr_i] : NULL;
+}
 
-typedef struct scan_op_state_t {
-    /* A reference to the relation being scanned */
-    const relation_t *relation;
-    /* Next tuple index to retrieve from the relation */
-    uint32_t next_tuple_i;
-    /* A structure to be filled with references to tuple data */
-    tuple_t current_tuple;
-} scan_op_state_t;
+const hash_index_t *relation_create_hash_index(relation_t *rel, const uint16_t attr_i)
+{
+    assert(attr_i < rel->attr_num);
+    relation_reserve_indexes(rel);
+    if (rel->hash_indexes[attr_i])
+        return rel->hash_indexes[attr_i];
+
+    hash_index_t *index = hash_index_create();
+    assert(index);
+    for (uint32_t tuple_i = 0; tuple_i < rel->tuple_num; tuple_i++)
+        hash_index_insert(index, *relation_value_ptr(rel, tuple_i, attr_i), tuple_i);
+    rel->hash_indexes[attr_i] = index;
+    return index;
+}
 
-void scan_op_open(void *state)
+const hash_index_t *relation_get_hash_index(const relation_t *rel, const uint16_t attr_i)
 {
-    scan_op_state_t *op_state = (typeof(op_state)) state;
-    op_state->next_tuple_i = 0;
-    tuple_t *current_tuple = &op_state->current_tuple;
-    current_tuple->as.source.tuple_i = 0;
+    return rel->hash_indexes ? rel->hash_indexes[attr_i] : NULL;
 }
 
-tuple_t *scan_op_next(void *state)
+void relation_reset(relation_t *rel)
 {
-    scan_op_state_t *op_state = (typeof(op_state)) state;
-    if (op_state->next_tuple_i >= op_state->relation->tuple_num)
-        return NULL;
+    rel->tuple_num = 0;
+    rel->tuple_slots = 0;
+    relation_free_tuples(rel);
+    rel->zone_slots = 0;
+    free(rel->zone_mins);
+    rel->zone_mins = NULL;
+    free(rel->zone_maxs);
+    rel->zone_maxs = NULL;
+    relation_rebuild_indexes(rel);
+}
 
-    tuple_source_t *source_tuple = &op_state->current_tuple.as.source;
-    source_tuple->tuple_i = op_state->next_tuple_i;
-    op_state->next_tuple_i++;
+/*
+ * Relation files: a header, attribute names, zone minimums and maximums, then tuple data at a page
+ * boundary, laid out exactly as in memory so that it can be mapped and used as is
+ *  */
 
-    return &op_state->current_tuple;
-}
+#define RELATION_FILE_MAGIC "PIGLETQL"
+#define RELATION_FILE_VERSION 1
+#define RELATION_FILE_DATA_ALIGNMENT 4096
 
-void scan_op_close(void *state)
+typedef struct relation_file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;
+    uint32_t tuple_num;
+    uint32_t tuple_slots;
+    uint16_t attr_num;
+    uint64_t data_offset;
+} relation_file_header_t;
+
+/* Files keep slots for whole cache lines of values, so that columns stay aligned */
+static uint32_t relation_file_tuple_slots(const uint32_t tuple_num)
 {
-    scan_op_state_t *op_state = (typeof(op_state)) state;
-    op_state->next_tuple_i = 0;
-    tuple_t *current_tuple = &op_state->current_tuple;
-    current_tuple->as.source.tuple_i = 0;
+    const uint32_t line_values = COLUMN_ALIGNMENT / sizeof(value_type_t);
+    return (uint32_t)(((uint64_t)tuple_num + line_values - 1) / line_values * line_values);
 }
 
-void scan_op_destroy(operator_t *operator)
+static uint64_t relation_file_data_offset(const uint16_t attr_num, const uint32_t tuple_num)
 {
-    if (!operator)
-        return;
-    free(operator->state);
-    free(operator);
+    const uint64_t zone_num = (tuple_num + ZONE_TUPLE_NUM - 1) / ZONE_TUPLE_NUM;
+    const uint64_t size = sizeof(relation_file_header_t) + (uint64_t)attr_num * MAX_ATTR_NAME_LEN +
+        2 * zone_num * attr_num * sizeof(value_type_t);
+    return (size + RELATION_FILE_DATA_ALIGNMENT - 1) / RELATION_FILE_DATA_ALIGNMENT * RELATION_FILE_DATA_ALIGNMENT;
 }
 
-operator_t *scan_op_create(const relation_t *relation)
+static bool relation_write_zeros(FILE *file, size_t byte_num)
 {
-    operator_t *op = calloc(1, sizeof(*op));
-    assert(op);
+    static const char zeros[RELATION_FILE_DATA_ALIGNMENT];
+    while (byte_num > 0) {
+        const size_t chunk_size = byte_num < sizeof(zeros) ? byte_num : sizeof(zeros);
+        if (fwrite(zeros, 1, chunk_size, file) != chunk_size)
+            return false;
+        byte_num -= chunk_size;
+    }
+    return true;
+}
 
-    *op = (operator_t) {
-        .open = scan_op_open,
-        .next = scan_op_next,
-        .close = scan_op_close,
-        .destroy = scan_op_destroy,
+static bool relation_write_file(const relation_t *rel, FILE *file)
+{
+    const uint32_t tuple_slots = relation_file_tuple_slots(rel->tuple_num);
+    const relation_file_header_t header = {
+        .magic = RELATION_FILE_MAGIC,
+        .version = RELATION_FILE_VERSION,
+        .layout = rel->layout,
+        .tuple_num = rel->tuple_num,
+        .tuple_slots = tuple_slots,
+        .attr_num = rel->attr_num,
+        .data_offset = relation_file_data_offset(rel->attr_num, rel->tuple_num),
     };
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        return false;
 
-    scan_op_state_t *state = calloc(1, sizeof(*state));
-    assert(state);
+    for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++) {
+        attr_name_t name = {0};
+        strncpy(name, rel->attr_names[attr_i], MAX_ATTR_NAME_LEN - 1);
+        if (fwrite(name, sizeof(name), 1, file) != 1)
+            return false;
+    }
 
-    *state = (scan_op_state_t) {
-        .relation = relation,
-        .next_tuple_i = 0,
-        .current_tuple.tag = TUPLE_SOURCE,
-        .current_tuple.as.source.tuple_i = 0,
-        .current_tuple.as.source.relation = relation,
-    };
-    op->state = state;
+    /* Empty relations have neither zones nor data */
+    if (rel->tuple_num == 0)
+        return relation_write_zeros(file, header.data_offset - sizeof(header) - rel->attr_num * sizeof(attr_name_t));
+
+    const size_t zone_value_num = (size_t)(rel->tuple_num + ZONE_TUPLE_NUM - 1) / ZONE_TUPLE_NUM * rel->attr_num;
+    if (fwrite(rel->zone_mins, sizeof(value_type_t), zone_value_num, file) != zone_value_num ||
+        fwrite(rel->zone_maxs, sizeof(value_type_t), zone_value_num, file) != zone_value_num)
+        return false;
+
+    /* Padding up to the data and past the last value of every column is zeros */
+    const long position = ftell(file);
+    if (position < 0 || !relation_write_zeros(file, header.data_offset - (uint64_t)position))
+        return false;
+
+    const size_t padding_size = (size_t)(tuple_slots - rel->tuple_num) * sizeof(value_type_t);
+    if (rel->layout == LAYOUT_ROWS) {
+        const size_t value_num = (size_t)rel->tuple_num * rel->attr_num;
+        return fwrite(rel->tuples, sizeof(value_type_t), value_num, file) == value_num &&
+            relation_write_zeros(file, padding_size * rel->attr_num);
+    }
 
+    for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
+        if (fwrite(relation_value_ptr(rel, 0, attr_i), sizeof(value_type_t), rel->tuple_num, file) != rel->tuple_num ||
+            !relation_write_zeros(file, padding_size))
+            return false;
+    return true;
+}
 
-    return op;
+bool relation_save(const relation_t *rel, const char *path)
+{
+    /* A new file replaces the old one, which might still be mapped */
+    char tmp_path[strlen(path) + sizeof(".tmp")];
+    sprintf(tmp_path, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file)
+        return false;
+    const bool is_written = relation_write_file(rel, file) && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !is_written || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
 }
 
-/* Projection operator */
+/* A relation over a file mapped, NULL if the file is not a relation file */
+static relation_t *relation_create_mapped(void *mapping, const size_t mapping_size)
+{
+    const relation_file_header_t *header = mapping;
+    if (memcmp(header->magic, RELATION_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RELATION_FILE_VERSION ||
+        (header->layout != LAYOUT_ROWS && header->layout != LAYOUT_COLUMNS) ||
+        header->attr_num == 0 || header->attr_num > MAX_ATTR_NUM ||
+        header->tuple_slots != relation_file_tuple_slots(header->tuple_num) ||
+        header->data_offset != relation_file_data_offset(header->attr_num, header->tuple_num) ||
+        header->data_offset + (uint64_t)header->tuple_slots * header->attr_num * sizeof(value_type_t) > mapping_size)
+        return NULL;
 
-typedef struct proj_op_state_t {
-    /* A reference to the operator to retrieve tuples from */
-    operator_t *source;
-    /* A projecting tuple  */
-    tuple_t current_tuple;
-} proj_op_state_t;
+    const attr_name_t *names = (const attr_name_t *)(header + 1);
+    const char *attr_names[header->attr_num];
+    for (uint16_t attr_i = 0; attr_i < header->attr_num; attr_i++) {
+        if (strnlen(names[attr_i], MAX_ATTR_NAME_LEN) == MAX_ATTR_NAME_LEN)
+            return NULL;
+        attr_names[attr_i] = intern(names[attr_i]);
+    }
 
-void proj_op_open(void *state)
-{
-    proj_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *source = op_state->source;
-    source->open(source->state);
-    op_state->current_tuple.as.project.source_tuple = NULL;
+    relation_t *rel = relation_create_interned(attr_names, header->attr_num, header->layout);
+    if (!rel)
+        return NULL;
+
+    /* Zone summaries are small, so they are copied to be updated as usual */
+    const uint32_t zone_num = (header->tuple_num + ZONE_TUPLE_NUM - 1) / ZONE_TUPLE_NUM;
+    const value_type_t *zone_mins = (const value_type_t *)(names + header->attr_num);
+    const value_type_t *zone_maxs = zone_mins + (size_t)zone_num * header->attr_num;
+    if (zone_num > 0) {
+        relation_reserve_zones(rel, header->tuple_slots);
+        memcpy(rel->zone_mins, zone_mins, (size_t)zone_num * header->attr_num * sizeof(value_type_t));
+        memcpy(rel->zone_maxs, zone_maxs, (size_t)zone_num * header->attr_num * sizeof(value_type_t));
+    }
+
+    rel->mapping = mapping;
+    rel->mapping_size = mapping_size;
+    rel->tuples = (value_type_t *)((char *)mapping + header->data_offset);
+    rel->tuple_num = header->tuple_num;
+    rel->tuple_slots = header->tuple_slots;
+    return rel;
 }
 
-tuple_t *proj_op_next(void *state)
+relation_t *relation_open(const char *path)
 {
-    proj_op_state_t *op_state = (typeof(op_state)) state;
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
 
-    operator_t *source = op_state->source;
-    tuple_t *next_source_tuple = source->next(source->state);
-    if (!next_source_tuple)
+    /* Private mappings can be written to, relations get sorted in place */
+    struct stat st;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(relation_file_header_t))
+        mapping = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
         return NULL;
-    op_state->current_tuple.as.project.source_tuple = next_source_tuple;
 
-    return &op_state->current_tuple;
+    relation_t *rel = relation_create_mapped(mapping, (size_t)st.st_size);
+    if (!rel)
+        munmap(mapping, (size_t)st.st_size);
+    return rel;
 }
 
-void proj_op_close(void *state)
+void relation_destroy(relation_t *rel)
 {
-    proj_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *source = op_state->source;
-    op_state->current_tuple.as.project.source_tuple = NULL;
-    source->close(source->state);
+    if (!rel)
+        return;
+    relation_free_tuples(rel);
+    free(rel->tuple_buf);
+    free(rel->zone_mins);
+    free(rel->zone_maxs);
+    for (uint16_t attr_i = 0; rel->indexes && attr_i < rel->attr_num; attr_i++) {
+        btree_destroy(rel->indexes[attr_i]);
+        hash_index_destroy(rel->hash_indexes[attr_i]);
+    }
+    free(rel->indexes);
+    free(rel->hash_indexes);
+    free(rel->high_attr_is);
+    free(rel->attr_names);
+    free(rel);
 }
 
-void proj_op_destroy(operator_t *operator)
+/*
+ * Batch - see pigletql-eval.h
+ *  */
+
+/* Allocate a batch with attribute name and column pointer arrays. Batches with storage also own
+ * column vectors and a selection vector, others just point to data owned by some other batch. */
+static batch_t *batch_create(arena_t *arena, const uint16_t attr_num, const bool with_storage)
 {
-    if (!operator)
-        return;
+    size_t size = sizeof(batch_t);
+    size += 2 * attr_num * sizeof(value_type_t *);
+    size += attr_num * sizeof(const char *);
+    if (with_storage) {
+        size += (size_t)attr_num * BATCH_SIZE * sizeof(value_type_t);
+        size += BATCH_SIZE * sizeof(uint16_t);
+    }
 
-    proj_op_state_t *op_state = operator->state;
-    op_state->source->destroy(op_state->source);
+    batch_t *batch = arena_calloc(arena, 1, size);
+    if (!batch)
+        return NULL;
 
-    free(operator->state);
-    free(operator);
+    batch->attr_num = attr_num;
+    batch->columns = (value_type_t **)(batch + 1);
+    batch->high_columns = batch->columns + attr_num;
+    batch->attr_names = (const char **)(batch->high_columns + attr_num);
+    if (with_storage) {
+        value_type_t *values = (value_type_t *)(batch->attr_names + attr_num);
+        for (size_t attr_i = 0; attr_i < attr_num; attr_i++)
+            batch->columns[attr_i] = &values[attr_i * BATCH_SIZE];
+        batch->sel = (uint16_t *)&values[(size_t)attr_num * BATCH_SIZE];
+    }
+
+    return batch;
 }
 
-operator_t *proj_op_create(operator_t *source,
-                           const attr_name_t *attr_names,
-                           const uint16_t attr_num)
+static void batch_destroy(arena_t *arena, batch_t *batch)
 {
-    assert(source);
-    assert(attr_num > 0);
+    arena_free(arena, batch);
+}
 
-    operator_t *op = calloc(1, sizeof(*op));
-    if (!op)
-        goto op_fail;
+static void batch_sel_all(batch_t *batch)
+{
+    for (uint16_t row_i = 0; row_i < batch->row_num; row_i++)
+        batch->sel[row_i] = row_i;
+    batch->sel_num = batch->row_num;
+}
+
+uint16_t batch_attr_i_by_name(const batch_t *batch, const attr_name_t attr_name)
+{
+    for (size_t attr_i = 0; attr_i < batch->attr_num; attr_i++)
+        if (strcmp(batch->attr_names[attr_i], attr_name) == 0)
+            return attr_i;
+    return ATTR_NOT_FOUND;
+}
+
+uint64_t batch_get_value(const batch_t *batch, const uint16_t attr_i, const uint16_t row_i)
+{
+    const uint64_t value = batch->columns[attr_i][row_i];
+    if (!batch->high_columns[attr_i])
+        return value;
+    return (uint64_t)batch->high_columns[attr_i][row_i] << 32 | value;
+}
+
+/* A columnar relation with upper halves of 64-bit attributes kept in attributes of their own at the
+ * end. Attribute names should be interned. */
+static relation_t *relation_create_wide(const char *const *attr_names, const uint16_t attr_num, const bool *is_wide)
+{
+    uint16_t wide_attr_num = 0;
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        wide_attr_num += is_wide[attr_i];
+    if (wide_attr_num == 0)
+        return relation_create_interned(attr_names, attr_num, LAYOUT_COLUMNS);
+
+    /* Upper halves go under the names of their attributes, names are looked up from the start */
+    const char *names[attr_num + wide_attr_num];
+    memcpy(names, attr_names, attr_num * sizeof(*names));
+    uint16_t high_attr_is[attr_num];
+    uint16_t high_attr_i = attr_num;
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++) {
+        high_attr_is[attr_i] = is_wide[attr_i] ? high_attr_i : 0;
+        if (is_wide[attr_i])
+            names[high_attr_i++] = attr_names[attr_i];
+    }
+
+    relation_t *rel = relation_create_interned(names, attr_num + wide_attr_num, LAYOUT_COLUMNS);
+    if (!rel)
+        return NULL;
+    rel->high_attr_is = calloc(attr_num, sizeof(uint16_t));
+    if (!rel->high_attr_is) {
+        relation_destroy(rel);
+        return NULL;
+    }
+    memcpy(rel->high_attr_is, high_attr_is, attr_num * sizeof(uint16_t));
+    rel->wide_attr_num = wide_attr_num;
+    return rel;
+}
+
+/* Relations materialized from batches are columnar, so scanning them is zero-copy. Batch attribute
+ * names are interned, so this is safe to call from worker threads. */
+static relation_t *relation_create_for_batch(const batch_t *batch)
+{
+    bool is_wide[batch->attr_num + 1];
+    for (uint16_t attr_i = 0; attr_i < batch->attr_num; attr_i++)
+        is_wide[attr_i] = batch->high_columns[attr_i] != NULL;
+    return relation_create_wide(batch->attr_names, batch->attr_num, is_wide);
+}
+
+static void relation_append_column(relation_t *rel, const uint32_t first_tuple_i, const uint16_t attr_i,
+                                   const value_type_t *column, const batch_t *batch)
+{
+    for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+        const value_type_t value = column[batch->sel[sel_i]];
+        *relation_value_ptr(rel, first_tuple_i + sel_i, attr_i) = value;
+        relation_zone_add(rel, first_tuple_i + sel_i, attr_i, value);
+    }
+}
+
+static void relation_append_batch(relation_t *rel, const batch_t *batch)
+{
+    assert(batch->attr_num == relation_batch_attr_num(rel));
+
+    const uint32_t first_tuple_i = rel->tuple_num;
+    relation_reserve(rel, first_tuple_i + batch->sel_num);
+
+    for (uint16_t attr_i = 0; attr_i < batch->attr_num; attr_i++) {
+        relation_append_column(rel, first_tuple_i, attr_i, batch->columns[attr_i], batch);
+        if (batch->high_columns[attr_i])
+            relation_append_column(rel, first_tuple_i, rel->high_attr_is[attr_i], batch->high_columns[attr_i], batch);
+    }
+    rel->tuple_num += batch->sel_num;
+    for (uint32_t tuple_i = first_tuple_i; tuple_i < rel->tuple_num; tuple_i++)
+        relation_index_add(rel, tuple_i);
+}
+
+/*
+ * Operators - see pigletql.h
+ *  */
+
+/* Operator errors, only operators of the statement thread fail this way */
+
+static char eval_error[256];
+static bool eval_has_error = false;
+
+static void eval_set_error(const char *format, ...)
+{
+    if (eval_has_error)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(eval_error, sizeof(eval_error), format, args);
+    va_end(args);
+    eval_has_error = true;
+}
+
+const char *eval_get_error(void)
+{
+    return eval_has_error ? eval_error : NULL;
+}
+
+void eval_clear_error(void)
+{
+    eval_has_error = false;
+}
+
+/* Table scanning operator */
+
+#define MAX_SCAN_ZONE_PREDICATE_NUM 16
+
+typedef struct scan_zone_predicate_t {
+    uint16_t attr_i;
+    select_predicate_op op;
+    value_type_t constant;
+    /* Parameter the constant is read from when opening, NULL if the constant is fixed */
+    const value_type_t *param;
+} scan_zone_predicate_t;
+
+typedef struct scan_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* A reference to the relation being scanned */
+    const relation_t *relation;
+    /* Range of tuples to scan, the whole relation by default */
+    uint32_t first_tuple_i;
+    uint32_t range_tuple_num;
+    /* Next tuple index to retrieve from the relation */
+    uint32_t next_tuple_i;
+    /* Predicates zones have to pass, and the last zone passing them, UINT32_MAX if none yet */
+    scan_zone_predicate_t zone_predicates[MAX_SCAN_ZONE_PREDICATE_NUM];
+    uint16_t zone_predicate_num;
+    uint32_t checked_zone_i;
+    /* A structure to be filled with references to tuple data */
+    tuple_t current_tuple;
+    /* A batch to be filled with copies of tuple data, or pointing to columns of columnar relations */
+    batch_t *current_batch;
+    uint16_t current_sel[BATCH_SIZE];
+} scan_op_state_t;
+
+/* Index of the tuple following the last one to scan */
+static uint32_t scan_op_end_tuple_i(const scan_op_state_t *op_state)
+{
+    const uint32_t tuple_num = op_state->relation->tuple_num;
+    if (op_state->first_tuple_i >= tuple_num)
+        return tuple_num;
+    if (op_state->range_tuple_num > tuple_num - op_state->first_tuple_i)
+        return tuple_num;
+    return op_state->first_tuple_i + op_state->range_tuple_num;
+}
+
+static bool scan_op_zone_may_match(const scan_op_state_t *op_state, const uint32_t zone_i)
+{
+    const relation_t *rel = op_state->relation;
+    for (uint16_t pred_i = 0; pred_i < op_state->zone_predicate_num; pred_i++) {
+        const scan_zone_predicate_t *predicate = &op_state->zone_predicates[pred_i];
+        const size_t zone_value_i = (size_t)zone_i * rel->attr_num + predicate->attr_i;
+        const value_type_t min = rel->zone_mins[zone_value_i], max = rel->zone_maxs[zone_value_i];
+        switch (predicate->op) {
+        case SELECT_GT:
+            if (max <= predicate->constant)
+                return false;
+            break;
+        case SELECT_LT:
+            if (min >= predicate->constant)
+                return false;
+            break;
+        case SELECT_EQ:
+            if (predicate->constant < min || predicate->constant > max)
+                return false;
+            break;
+        }
+    }
+    return true;
+}
+
+/* Move the next tuple past zones predicates cannot hold in, zones are only checked once */
+static void scan_op_skip_zones(scan_op_state_t *op_state, const uint32_t end_tuple_i)
+{
+    while (op_state->next_tuple_i < end_tuple_i) {
+        const uint32_t zone_i = op_state->next_tuple_i / ZONE_TUPLE_NUM;
+        if (zone_i == op_state->checked_zone_i)
+            return;
+        if (scan_op_zone_may_match(op_state, zone_i)) {
+            op_state->checked_zone_i = zone_i;
+            return;
+        }
+        const uint64_t next_zone_tuple_i = (uint64_t)(zone_i + 1) * ZONE_TUPLE_NUM;
+        op_state->next_tuple_i = next_zone_tuple_i < end_tuple_i ? (uint32_t)next_zone_tuple_i : end_tuple_i;
+    }
+}
+
+void scan_op_open(void *state)
+{
+    scan_op_state_t *op_state = (typeof(op_state)) state;
+    for (uint16_t pred_i = 0; pred_i < op_state->zone_predicate_num; pred_i++) {
+        scan_zone_predicate_t *predicate = &op_state->zone_predicates[pred_i];
+        if (predicate->param)
+            predicate->constant = *predicate->param;
+    }
+    op_state->next_tuple_i = op_state->first_tuple_i;
+    op_state->checked_zone_i = UINT32_MAX;
+    tuple_t *current_tuple = &op_state->current_tuple;
+    current_tuple->as.source.tuple_i = 0;
+}
+
+tuple_t *scan_op_next(void *state)
+{
+    scan_op_state_t *op_state = (typeof(op_state)) state;
+    const uint32_t end_tuple_i = scan_op_end_tuple_i(op_state);
+    if (op_state->zone_predicate_num)
+        scan_op_skip_zones(op_state, end_tuple_i);
+    if (op_state->next_tuple_i >= end_tuple_i)
+        return NULL;
+
+    tuple_source_t *source_tuple = &op_state->current_tuple.as.source;
+    source_tuple->tuple_i = op_state->next_tuple_i;
+    op_state->next_tuple_i++;
+
+    return &op_state->current_tuple;
+}
+
+batch_t *scan_op_next_batch(void *state)
+{
+    scan_op_state_t *op_state = (typeof(op_state)) state;
+    const relation_t *rel = op_state->relation;
+    const uint32_t end_tuple_i = scan_op_end_tuple_i(op_state);
+    if (op_state->zone_predicate_num)
+        scan_op_skip_zones(op_state, end_tuple_i);
+    if (op_state->next_tuple_i >= end_tuple_i)
+        return NULL;
+
+    const bool is_columnar = rel->layout == LAYOUT_COLUMNS;
+    const uint16_t attr_num = relation_batch_attr_num(rel);
+    if (!op_state->current_batch) {
+        op_state->current_batch = batch_create(op_state->arena, attr_num, !is_columnar);
+        assert(op_state->current_batch);
+        for (size_t attr_i = 0; attr_i < attr_num; attr_i++)
+            op_state->current_batch->attr_names[attr_i] = rel->attr_names[attr_i];
+        if (is_columnar)
+            op_state->current_batch->sel = op_state->current_sel;
+    }
+    batch_t *batch = op_state->current_batch;
+
+    uint32_t row_num = end_tuple_i - op_state->next_tuple_i;
+    if (row_num > BATCH_SIZE)
+        row_num = BATCH_SIZE;
+    /* Batches should not spill over into zones not checked yet */
+    const uint32_t zone_tuple_num = ZONE_TUPLE_NUM - op_state->next_tuple_i % ZONE_TUPLE_NUM;
+    if (op_state->zone_predicate_num && row_num > zone_tuple_num)
+        row_num = zone_tuple_num;
+
+    if (is_columnar) {
+        /* Column vectors point right into the relation */
+        for (size_t attr_i = 0; attr_i < attr_num; attr_i++) {
+            const uint16_t high_attr_i = relation_high_attr_i(rel, attr_i);
+            batch->columns[attr_i] = relation_value_ptr(rel, op_state->next_tuple_i, attr_i);
+            if (high_attr_i)
+                batch->high_columns[attr_i] = relation_value_ptr(rel, op_state->next_tuple_i, high_attr_i);
+        }
+    } else {
+        /* Only relations materialized from batches have 64-bit attributes, and those are columnar */
+        assert(!rel->wide_attr_num);
+        /* Transpose rows into column vectors */
+        const value_type_t *tuples = relation_tuple_values_by_id(rel, op_state->next_tuple_i);
+        for (size_t attr_i = 0; attr_i < rel->attr_num; attr_i++) {
+            value_type_t *column = batch->columns[attr_i];
+            for (size_t row_i = 0; row_i < row_num; row_i++)
+                column[row_i] = tuples[row_i * rel->attr_num + attr_i];
+        }
+    }
+    batch->row_num = row_num;
+    batch_sel_all(batch);
+
+    op_state->next_tuple_i += row_num;
+
+    return batch;
+}
+
+void scan_op_close(void *state)
+{
+    scan_op_state_t *op_state = (typeof(op_state)) state;
+    op_state->next_tuple_i = op_state->first_tuple_i;
+    op_state->checked_zone_i = UINT32_MAX;
+    tuple_t *current_tuple = &op_state->current_tuple;
+    current_tuple->as.source.tuple_i = 0;
+}
+
+void scan_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+    scan_op_state_t *op_state = operator->state;
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *scan_op_create(arena_t *arena, const relation_t *relation)
+{
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    assert(op);
+
+    *op = (operator_t) {
+        .open = scan_op_open,
+        .next = scan_op_next,
+        .next_batch = scan_op_next_batch,
+        .close = scan_op_close,
+        .destroy = scan_op_destroy,
+    };
+
+    scan_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    assert(state);
+
+    *state = (scan_op_state_t) {
+        .arena = arena,
+        .relation = relation,
+        .first_tuple_i = 0,
+        .range_tuple_num = UINT32_MAX,
+        .next_tuple_i = 0,
+        .checked_zone_i = UINT32_MAX,
+        .current_tuple.tag = TUPLE_SOURCE,
+        .current_tuple.as.source.tuple_i = 0,
+        .current_tuple.as.source.relation = relation,
+    };
+    op->state = state;
+
+
+    return op;
+}
+
+void scan_op_set_range(operator_t *operator, const uint32_t first_tuple_i, const uint32_t tuple_num)
+{
+    scan_op_state_t *op_state = (typeof(op_state)) operator->state;
+    op_state->first_tuple_i = first_tuple_i;
+    op_state->range_tuple_num = tuple_num;
+    op_state->next_tuple_i = first_tuple_i;
+}
+
+static void scan_op_add_zone_predicate_with(operator_t *operator,
+                                            const uint16_t attr_i,
+                                            const select_predicate_op predicate_op,
+                                            const value_type_t constant,
+                                            const value_type_t *param)
+{
+    scan_op_state_t *op_state = (typeof(op_state)) operator->state;
+    assert(attr_i < op_state->relation->attr_num);
+
+    /* Zones are only worth checking for a few predicates, the rest are left to selections */
+    if (op_state->zone_predicate_num == MAX_SCAN_ZONE_PREDICATE_NUM)
+        return;
+
+    op_state->zone_predicates[op_state->zone_predicate_num++] = (scan_zone_predicate_t) {
+        .attr_i = attr_i,
+        .op = predicate_op,
+        .constant = constant,
+        .param = param,
+    };
+}
+
+void scan_op_add_zone_predicate(operator_t *operator,
+                                const uint16_t attr_i,
+                                const select_predicate_op predicate_op,
+                                const value_type_t constant)
+{
+    scan_op_add_zone_predicate_with(operator, attr_i, predicate_op, constant, NULL);
+}
+
+void scan_op_add_zone_param_predicate(operator_t *operator,
+                                      const uint16_t attr_i,
+                                      const select_predicate_op predicate_op,
+                                      const value_type_t *param)
+{
+    assert(param);
+    scan_op_add_zone_predicate_with(operator, attr_i, predicate_op, *param, param);
+}
+
+/* Equality lookups in whatever index there is over an attribute, hash indexes are preferred */
+
+typedef struct index_lookup_t {
+    const hash_index_t *hash_index;
+    const btree_t *btree;
+    /* Value looked up and the next entry to check */
+    value_type_t value;
+    hash_index_cursor_t hash_cursor;
+    btree_cursor_t btree_cursor;
+    bool is_done;
+} index_lookup_t;
+
+static index_lookup_t index_lookup_create(const relation_t *rel, const uint16_t attr_i)
+{
+    const index_lookup_t lookup = {
+        .hash_index = relation_get_hash_index(rel, attr_i),
+        .btree = relation_get_index(rel, attr_i),
+        .is_done = true,
+    };
+    assert(lookup.hash_index || lookup.btree);
+    return lookup;
+}
+
+static void index_lookup_start(index_lookup_t *lookup, const value_type_t value)
+{
+    lookup->value = value;
+    lookup->is_done = false;
+    if (lookup->hash_index)
+        lookup->hash_cursor = hash_index_lookup(lookup->hash_index, value);
+    else
+        lookup->btree_cursor = btree_lower_bound(lookup->btree, value);
+}
+
+/* Id of the next tuple with the value looked up, false if there are none left */
+static bool index_lookup_next(index_lookup_t *lookup, uint32_t *tuple_i)
+{
+    if (lookup->is_done)
+        return false;
+    if (lookup->hash_index) {
+        lookup->is_done = !hash_index_cursor_next(lookup->hash_index, &lookup->hash_cursor, tuple_i);
+        return !lookup->is_done;
+    }
+
+    value_type_t value = 0;
+    lookup->is_done = !btree_cursor_next(&lookup->btree_cursor, &value, tuple_i) || value != lookup->value;
+    return !lookup->is_done;
+}
+
+/* Index scan operator */
+
+typedef struct index_scan_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* A reference to the relation and the index over the attribute compared */
+    const relation_t *relation;
+    const btree_t *index;
+    select_predicate_op predicate_op;
+    value_type_t constant;
+    /* Parameter the constant is read from when opening, NULL if the constant is fixed */
+    const value_type_t *param;
+    /* Equality scans are lookups, range scans walk the B+tree until an entry fails the predicate */
+    index_lookup_t lookup;
+    btree_cursor_t cursor;
+    bool is_done;
+    /* A structure to be filled with references to tuple data */
+    tuple_t current_tuple;
+    /* A batch to be filled with copies of tuple values */
+    batch_t *current_batch;
+    uint32_t batch_tuple_is[BATCH_SIZE];
+} index_scan_op_state_t;
+
+void index_scan_op_open(void *state)
+{
+    index_scan_op_state_t *op_state = (typeof(op_state)) state;
+    if (op_state->param)
+        op_state->constant = *op_state->param;
+    op_state->is_done = false;
+    switch (op_state->predicate_op) {
+    case SELECT_EQ:
+        index_lookup_start(&op_state->lookup, op_state->constant);
+        break;
+    case SELECT_GT:
+        /* Nothing is greater than the maximum value */
+        if (op_state->constant == UINT32_MAX)
+            op_state->is_done = true;
+        else
+            op_state->cursor = btree_lower_bound(op_state->index, op_state->constant + 1);
+        break;
+    case SELECT_LT:
+        op_state->cursor = btree_first(op_state->index);
+        break;
+    }
+}
+
+/* Id of the next tuple satisfying the predicate, false if there are none left */
+static bool index_scan_op_next_tuple_i(index_scan_op_state_t *op_state, uint32_t *tuple_i)
+{
+    if (op_state->is_done)
+        return false;
+    if (op_state->predicate_op == SELECT_EQ) {
+        op_state->is_done = !index_lookup_next(&op_state->lookup, tuple_i);
+        return !op_state->is_done;
+    }
+
+    value_type_t value = 0;
+    if (!btree_cursor_next(&op_state->cursor, &value, tuple_i)) {
+        op_state->is_done = true;
+        return false;
+    }
+
+    /* Entries are ordered by value, so the first one failing the predicate ends the scan */
+    op_state->is_done = op_state->predicate_op == SELECT_LT && value >= op_state->constant;
+    return !op_state->is_done;
+}
+
+tuple_t *index_scan_op_next(void *state)
+{
+    index_scan_op_state_t *op_state = (typeof(op_state)) state;
+    uint32_t tuple_i = 0;
+    if (!index_scan_op_next_tuple_i(op_state, &tuple_i))
+        return NULL;
+
+    op_state->current_tuple.as.source.tuple_i = tuple_i;
+    return &op_state->current_tuple;
+}
+
+batch_t *index_scan_op_next_batch(void *state)
+{
+    index_scan_op_state_t *op_state = (typeof(op_state)) state;
+    const relation_t *rel = op_state->relation;
+
+    uint16_t row_num = 0;
+    while (row_num < BATCH_SIZE && index_scan_op_next_tuple_i(op_state, &op_state->batch_tuple_is[row_num]))
+        row_num++;
+    if (row_num == 0)
+        return NULL;
+
+    if (!op_state->current_batch) {
+        op_state->current_batch = batch_create(op_state->arena, rel->attr_num, true);
+        assert(op_state->current_batch);
+        for (size_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
+            op_state->current_batch->attr_names[attr_i] = rel->attr_names[attr_i];
+    }
+    batch_t *batch = op_state->current_batch;
+
+    /* Tuples are scattered over the relation, so values get gathered one by one */
+    for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++) {
+        value_type_t *column = batch->columns[attr_i];
+        for (uint16_t row_i = 0; row_i < row_num; row_i++)
+            column[row_i] = *relation_value_ptr(rel, op_state->batch_tuple_is[row_i], attr_i);
+    }
+    batch->row_num = row_num;
+    batch_sel_all(batch);
+
+    return batch;
+}
+
+void index_scan_op_close(void *state)
+{
+    index_scan_op_state_t *op_state = (typeof(op_state)) state;
+    op_state->is_done = true;
+    op_state->current_tuple.as.source.tuple_i = 0;
+}
+
+void index_scan_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+    index_scan_op_state_t *op_state = operator->state;
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *index_scan_op_create(arena_t *arena,
+                                 const relation_t *relation,
+                                 const uint16_t attr_i,
+                                 const select_predicate_op predicate_op,
+                                 const value_type_t constant)
+{
+    /* Only equality can be looked up in hash indexes */
+    const btree_t *index = relation_get_index(relation, attr_i);
+    assert(index || predicate_op == SELECT_EQ);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    assert(op);
+
+    *op = (operator_t) {
+        .open = index_scan_op_open,
+        .next = index_scan_op_next,
+        .next_batch = index_scan_op_next_batch,
+        .close = index_scan_op_close,
+        .destroy = index_scan_op_destroy,
+    };
+
+    index_scan_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    assert(state);
+
+    *state = (index_scan_op_state_t) {
+        .arena = arena,
+        .relation = relation,
+        .index = index,
+        .predicate_op = predicate_op,
+        .constant = constant,
+        .lookup = predicate_op == SELECT_EQ ? index_lookup_create(relation, attr_i) : (index_lookup_t) {0},
+        .is_done = true,
+        .current_tuple.tag = TUPLE_SOURCE,
+        .current_tuple.as.source.tuple_i = 0,
+        .current_tuple.as.source.relation = relation,
+    };
+    op->state = state;
+
+    return op;
+}
+
+void index_scan_op_set_param(operator_t *operator, const value_type_t *param)
+{
+    index_scan_op_state_t *op_state = (typeof(op_state)) operator->state;
+    assert(param);
+    op_state->param = param;
+    op_state->constant = *param;
+}
+
+/* Projection operator */
+
+typedef struct proj_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* A reference to the operator to retrieve tuples from */
+    operator_t *source;
+    /* A projecting tuple  */
+    tuple_t current_tuple;
+    /* A projecting batch referencing source batch columns */
+    batch_t *current_batch;
+    /* Source attribute indices of projected attributes */
+    uint16_t *source_attr_is;
+} proj_op_state_t;
+
+void proj_op_open(void *state)
+{
+    proj_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    source->open(source->state);
+    op_state->current_tuple.as.project.source_tuple = NULL;
+}
+
+tuple_t *proj_op_next(void *state)
+{
+    proj_op_state_t *op_state = (typeof(op_state)) state;
+
+    operator_t *source = op_state->source;
+    tuple_t *next_source_tuple = source->next(source->state);
+    if (!next_source_tuple)
+        return NULL;
+    op_state->current_tuple.as.project.source_tuple = next_source_tuple;
+
+    return &op_state->current_tuple;
+}
+
+batch_t *proj_op_next_batch(void *state)
+{
+    proj_op_state_t *op_state = (typeof(op_state)) state;
+
+    operator_t *source = op_state->source;
+    batch_t *source_batch = source->next_batch(source->state);
+    if (!source_batch)
+        return NULL;
+
+    batch_t *batch = op_state->current_batch;
+    for (size_t attr_i = 0; attr_i < batch->attr_num; attr_i++) {
+        const uint16_t source_attr_i = op_state->source_attr_is[attr_i];
+        assert(source_attr_i < source_batch->attr_num);
+        batch->attr_names[attr_i] = source_batch->attr_names[source_attr_i];
+        batch->columns[attr_i] = source_batch->columns[source_attr_i];
+        batch->high_columns[attr_i] = source_batch->high_columns[source_attr_i];
+    }
+    batch->row_num = source_batch->row_num;
+    batch->sel = source_batch->sel;
+    batch->sel_num = source_batch->sel_num;
+
+    return batch;
+}
+
+void proj_op_close(void *state)
+{
+    proj_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    op_state->current_tuple.as.project.source_tuple = NULL;
+    source->close(source->state);
+}
+
+void proj_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    proj_op_state_t *op_state = operator->state;
+    op_state->source->destroy(op_state->source);
+
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_free(op_state->arena, op_state->source_attr_is);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *proj_op_create(arena_t *arena,
+                           operator_t *source,
+                           const uint16_t *source_attr_is,
+                           const uint16_t attr_num)
+{
+    assert(source);
+    assert(attr_num > 0);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    proj_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->current_tuple.tag = TUPLE_PROJECT;
+    state->source = source;
+    op->state = state;
+
+    state->source_attr_is = arena_calloc(arena, attr_num, sizeof(uint16_t));
+    if (!state->source_attr_is)
+        goto attrs_fail;
+    memcpy(state->source_attr_is, source_attr_is, attr_num * sizeof(uint16_t));
+    state->current_tuple.as.project.source_attr_is = state->source_attr_is;
+    state->current_tuple.as.project.attr_num = attr_num;
+
+    state->current_batch = batch_create(arena, attr_num, false);
+    if (!state->current_batch)
+        goto batch_fail;
+
+    op->open = proj_op_open;
+    op->next = proj_op_next;
+    op->next_batch = proj_op_next_batch;
+    op->close = proj_op_close;
+    op->destroy = proj_op_destroy;
+
+    return op;
+
+batch_fail:
+    arena_free(arena, state->source_attr_is);
+attrs_fail:
+    arena_free(arena, state);
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Union operator */
+
+typedef struct union_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Tuple sources to be united */
+    operator_t *left_source;
+    operator_t *right_source;
+
+    /* the current tuple source */
+    operator_t *current_source;
+} union_op_state_t;
+
+void union_op_open(void *state)
+{
+    union_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *left_source = op_state->left_source;
+    operator_t *right_source = op_state->right_source;
+    left_source->open(left_source->state);
+    right_source->open(right_source->state);
+
+    /* Begin with the left source */
+    op_state->current_source = left_source;
+}
+
+tuple_t *union_op_next(void *state)
+{
+    union_op_state_t *op_state = (typeof(op_state)) state;
+
+    operator_t *current_source = op_state->current_source;
+    tuple_t *next_source_tuple = current_source->next(current_source->state);
+
+    /* the left tuple source is exhausted: switch to the right source, reretrieve a tuple */
+    if (!next_source_tuple && current_source == op_state->left_source) {
+        op_state->current_source = op_state->right_source;
+        current_source = op_state->current_source;
+
+        next_source_tuple = current_source->next(current_source->state);
+    }
+
+    return next_source_tuple;
+}
+
+batch_t *union_op_next_batch(void *state)
+{
+    union_op_state_t *op_state = (typeof(op_state)) state;
+
+    operator_t *current_source = op_state->current_source;
+    batch_t *next_source_batch = current_source->next_batch(current_source->state);
+
+    /* the left batch source is exhausted: switch to the right source, reretrieve a batch */
+    if (!next_source_batch && current_source == op_state->left_source) {
+        op_state->current_source = op_state->right_source;
+        current_source = op_state->current_source;
+
+        next_source_batch = current_source->next_batch(current_source->state);
+    }
+
+    return next_source_batch;
+}
+
+void union_op_close(void *state)
+{
+    union_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *left_source = op_state->left_source;
+    operator_t *right_source = op_state->right_source;
+    left_source->close(left_source->state);
+    right_source->close(right_source->state);
+
+    op_state->current_source = NULL;
+}
+
+void union_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    union_op_state_t *op_state = operator->state;
+    op_state->left_source->destroy(op_state->left_source);
+    op_state->right_source->destroy(op_state->right_source);
+
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *union_op_create(arena_t *arena,
+                            operator_t *left_source,
+                            operator_t *right_source)
+{
+    assert(left_source && right_source);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    union_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->left_source = left_source;
+    state->right_source = right_source;
+    op->state = state;
+
+    op->open = union_op_open;
+    op->next = union_op_next;
+    op->next_batch = union_op_next_batch;
+    op->close = union_op_close;
+    op->destroy = union_op_destroy;
+
+    return op;
+
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Join operator */
+
+typedef struct join_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Tuple sources to be joined */
+    operator_t *left_source;
+    operator_t *right_source;
+
+    /* Current left source tuple to be joined with right source tuples */
+    tuple_t *current_left_tuple;
+
+    /* Joined tuple to be returned */
+    tuple_t current_tuple;
+
+    /* Current source batches and positions within their selection vectors */
+    batch_t *left_batch;
+    uint16_t left_sel_i;
+    batch_t *right_batch;
+    uint16_t right_sel_i;
+    /* Did the right source return anything since the last reset? */
+    bool right_has_rows;
+
+    /* Joined batch to be returned */
+    batch_t *current_batch;
+} join_op_state_t;
+
+void join_op_open(void *state)
+{
+    join_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *left_source = op_state->left_source;
+    operator_t *right_source = op_state->right_source;
+    left_source->open(left_source->state);
+    right_source->open(right_source->state);
+}
+
+tuple_t *join_op_next(void *state)
+{
+    join_op_state_t *op_state = (typeof(op_state)) state;
+
+    operator_t *left_source = op_state->left_source;
+    operator_t *right_source = op_state->right_source;
+    tuple_join_t *join_tuple = &op_state->current_tuple.as.join;
+
+    /* Nothing in the left source? See if we can get one more tuple */
+    if (!join_tuple->left_source_tuple) {
+        join_tuple->left_source_tuple = left_source->next(left_source->state);
+        /* Still nothing? Done joining */
+        if (!join_tuple->left_source_tuple)
+            return NULL;
+        join_tuple->left_attr_num = tuple_get_attr_num(join_tuple->left_source_tuple);
+    }
+
+    join_tuple->right_source_tuple = right_source->next(right_source->state);
+    /* No more tuples in the right source? Get the next left source tuple and reset the right source
+     * operator */
+    if (!join_tuple->right_source_tuple) {
+        join_tuple->left_source_tuple = left_source->next(left_source->state);
+        /* Nothing in the left tuple? Done joining */
+        if (!join_tuple->left_source_tuple)
+            return NULL;
+        join_tuple->left_attr_num = tuple_get_attr_num(join_tuple->left_source_tuple);
+
+        /* reset the right source */
+        right_source->close(right_source->state);
+        right_source->open(right_source->state);
+        join_tuple->right_source_tuple = right_source->next(right_source->state);
+        /* We've resetted the right source and there's nothing - empty relation */
+        if (!join_tuple->right_source_tuple)
+            return NULL;
+    }
+
+    return &op_state->current_tuple;
+}
+
+static batch_t *join_op_batch_for(join_op_state_t *op_state)
+{
+    if (op_state->current_batch)
+        return op_state->current_batch;
+
+    const batch_t *left_batch = op_state->left_batch;
+    const batch_t *right_batch = op_state->right_batch;
+    const uint16_t attr_num = left_batch->attr_num + right_batch->attr_num;
+    batch_t *batch = batch_create(op_state->arena, attr_num, true);
+    assert(batch);
+
+    for (size_t attr_i = 0; attr_i < left_batch->attr_num; attr_i++)
+        batch->attr_names[attr_i] = left_batch->attr_names[attr_i];
+    for (size_t attr_i = 0; attr_i < right_batch->attr_num; attr_i++)
+        batch->attr_names[left_batch->attr_num + attr_i] = right_batch->attr_names[attr_i];
+
+    op_state->current_batch = batch;
+    return batch;
+}
+
+batch_t *join_op_next_batch(void *state)
+{
+    join_op_state_t *op_state = (typeof(op_state)) state;
+
+    operator_t *left_source = op_state->left_source;
+    operator_t *right_source = op_state->right_source;
+
+    uint16_t row_num = 0;
+    while (row_num < BATCH_SIZE) {
+        /* Need a left batch to join with the right source */
+        if (!op_state->left_batch) {
+            op_state->left_batch = left_source->next_batch(left_source->state);
+            op_state->left_sel_i = 0;
+            /* Nothing left? Done joining */
+            if (!op_state->left_batch)
+                break;
+            if (op_state->left_batch->sel_num == 0) {
+                op_state->left_batch = NULL;
+                continue;
+            }
+        }
+
+        if (!op_state->right_batch) {
+            op_state->right_batch = right_source->next_batch(right_source->state);
+            op_state->right_sel_i = 0;
+
+            /* The right source is exhausted: move to the next left tuple, reset the right source */
+            if (!op_state->right_batch) {
+                /* We've resetted the right source and there's nothing - empty relation */
+                if (!op_state->right_has_rows) {
+                    op_state->left_batch = NULL;
+                    break;
+                }
+
+                op_state->right_has_rows = false;
+                op_state->left_sel_i++;
+                if (op_state->left_sel_i >= op_state->left_batch->sel_num)
+                    op_state->left_batch = NULL;
+
+                right_source->close(right_source->state);
+                right_source->open(right_source->state);
+                continue;
+            }
+        }
+
+        const batch_t *left_batch = op_state->left_batch;
+        const batch_t *right_batch = op_state->right_batch;
+        batch_t *batch = join_op_batch_for(op_state);
+
+        /* Join the current left tuple with as many right batch tuples as possible */
+        uint16_t join_num = right_batch->sel_num - op_state->right_sel_i;
+        if (join_num > BATCH_SIZE - row_num)
+            join_num = BATCH_SIZE - row_num;
+        if (join_num > 0)
+            op_state->right_has_rows = true;
+
+        const uint16_t left_row_i = left_batch->sel[op_state->left_sel_i];
+        for (size_t attr_i = 0; attr_i < left_batch->attr_num; attr_i++) {
+            const value_type_t value = left_batch->columns[attr_i][left_row_i];
+            value_type_t *column = batch->columns[attr_i];
+            for (size_t join_i = 0; join_i < join_num; join_i++)
+                column[row_num + join_i] = value;
+        }
+
+        const uint16_t *right_sel = &right_batch->sel[op_state->right_sel_i];
+        for (size_t attr_i = 0; attr_i < right_batch->attr_num; attr_i++) {
+            const value_type_t *right_column = right_batch->columns[attr_i];
+            value_type_t *column = batch->columns[left_batch->attr_num + attr_i];
+            for (size_t join_i = 0; join_i < join_num; join_i++)
+                column[row_num + join_i] = right_column[right_sel[join_i]];
+        }
+
+        row_num += join_num;
+        op_state->right_sel_i += join_num;
+        if (op_state->right_sel_i >= right_batch->sel_num)
+            op_state->right_batch = NULL;
+    }
+
+    if (row_num == 0)
+        return NULL;
+
+    batch_t *batch = op_state->current_batch;
+    batch->row_num = row_num;
+    batch_sel_all(batch);
+    return batch;
+}
+
+void join_op_close(void *state)
+{
+    join_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *left_source = op_state->left_source;
+    operator_t *right_source = op_state->right_source;
+    left_source->close(left_source->state);
+    right_source->close(right_source->state);
+
+    op_state->current_tuple.as.join.left_source_tuple = NULL;
+    op_state->current_tuple.as.join.right_source_tuple = NULL;
+
+    op_state->left_batch = NULL;
+    op_state->right_batch = NULL;
+    op_state->right_has_rows = false;
+}
+
+void join_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    join_op_state_t *op_state = operator->state;
+    op_state->left_source->destroy(op_state->left_source);
+    op_state->right_source->destroy(op_state->right_source);
+
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *join_op_create(arena_t *arena,
+                           operator_t *left_source,
+                           operator_t *right_source)
+{
+    assert(left_source && right_source);
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    join_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->left_source = left_source;
+    state->right_source = right_source;
+    state->current_tuple.tag = TUPLE_JOIN;
+    op->state = state;
+
+    op->open = join_op_open;
+    op->next = join_op_next;
+    op->next_batch = join_op_next_batch;
+    op->close = join_op_close;
+    op->destroy = join_op_destroy;
+
+    return op;
+
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Join tables */
+
+struct join_table_t {
+    /* Arena the table is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Source of tuples to be put into the table */
+    operator_t *build_source;
+    uint16_t build_attr_i;
+
+    /* Materialized build source tuples, NULL if there were none */
+    relation_t *relation;
+    /* Hash table buckets and chains of build tuples, both keep tuple indices + 1, 0 ends a chain */
+    uint32_t *buckets;
+    uint32_t *chains;
+    uint8_t bucket_bits;
+
+    /* Parallel builds wait for insert tasks left */
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    uint32_t insert_task_num;
+};
+
+/* A range of build tuples inserted by a single task */
+typedef struct join_table_range_t {
+    join_table_t *table;
+    uint32_t first_tuple_i;
+    uint32_t tuple_num;
+} join_table_range_t;
+
+static uint32_t hash_join_bucket(const value_type_t value, const uint8_t bucket_bits)
+{
+    /* Multiplicative hashing, higher bits are better mixed */
+    return (uint32_t)(value * 2654435761u) >> (32 - bucket_bits);
+}
+
+/* Tuples are pushed to chain heads with compare-and-swap, so workers never wait for each other */
+static void join_table_insert_range(void *arg, const uint16_t worker_i)
+{
+    (void) worker_i;
+    join_table_range_t *range = arg;
+    join_table_t *table = range->table;
+
+    for (uint32_t tuple_i = range->first_tuple_i; tuple_i < range->first_tuple_i + range->tuple_num; tuple_i++) {
+        const value_type_t value = relation_get_value(table->relation, tuple_i, table->build_attr_i);
+        uint32_t *bucket = &table->buckets[hash_join_bucket(value, table->bucket_bits)];
+        uint32_t head = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+        do {
+            table->chains[tuple_i] = head;
+        } while (!__atomic_compare_exchange_n(bucket, &head, tuple_i + 1, true,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    pthread_mutex_lock(&table->lock);
+    if (--table->insert_task_num == 0)
+        pthread_cond_signal(&table->done_cond);
+    pthread_mutex_unlock(&table->lock);
+}
+
+/* Materialize the build source and put its tuples into the table, in parallel if there's a pool and
+ * more than a morsel of tuples */
+static void join_table_build(join_table_t *table, pool_t *pool)
+{
+    operator_t *build_source = table->build_source;
+    build_source->open(build_source->state);
+    batch_t *batch = NULL;
+    while ((batch = build_source->next_batch(build_source->state))) {
+        if (!table->relation) {
+            table->relation = relation_create_for_batch(batch);
+            assert(table->relation);
+        }
+        relation_append_batch(table->relation, batch);
+    }
+    build_source->close(build_source->state);
+
+    /* Nothing to join with */
+    const relation_t *rel = table->relation;
+    if (!rel)
+        return;
+
+    table->bucket_bits = 1;
+    while (((uint64_t)1 << table->bucket_bits) < (uint64_t)rel->tuple_num * 2)
+        table->bucket_bits++;
+
+    table->buckets = calloc((size_t)1 << table->bucket_bits, sizeof(uint32_t));
+    table->chains = calloc(rel->tuple_num, sizeof(uint32_t));
+    assert(table->buckets && table->chains);
+
+    if (!pool || rel->tuple_num <= MORSEL_SIZE) {
+        /* Insert tuples backwards, so chains keep tuples in the original order */
+        for (uint32_t tuple_i = rel->tuple_num; tuple_i-- > 0;) {
+            const value_type_t value = relation_get_value(rel, tuple_i, table->build_attr_i);
+            const uint32_t bucket_i = hash_join_bucket(value, table->bucket_bits);
+            table->chains[tuple_i] = table->buckets[bucket_i];
+            table->buckets[bucket_i] = tuple_i + 1;
+        }
+        return;
+    }
+
+    /* A task per morsel of build tuples, chains end up in no particular order */
+    const uint32_t range_num = rel->tuple_num / MORSEL_SIZE + (rel->tuple_num % MORSEL_SIZE != 0);
+    join_table_range_t *ranges = calloc(range_num, sizeof(join_table_range_t));
+    assert(ranges);
+    table->insert_task_num = range_num;
+    for (uint32_t range_i = 0; range_i < range_num; range_i++) {
+        join_table_range_t *range = &ranges[range_i];
+        range->table = table;
+        range->first_tuple_i = range_i * MORSEL_SIZE;
+        range->tuple_num = rel->tuple_num - range->first_tuple_i < MORSEL_SIZE ?
+            rel->tuple_num - range->first_tuple_i : MORSEL_SIZE;
+        pool_submit(pool, join_table_insert_range, range);
+    }
+
+    pthread_mutex_lock(&table->lock);
+    while (table->insert_task_num > 0)
+        pthread_cond_wait(&table->done_cond, &table->lock);
+    pthread_mutex_unlock(&table->lock);
+
+    free(ranges);
+}
+
+static void join_table_reset(join_table_t *table)
+{
+    relation_destroy(table->relation);
+    table->relation = NULL;
+    free(table->buckets);
+    table->buckets = NULL;
+    free(table->chains);
+    table->chains = NULL;
+}
+
+join_table_t *join_table_create(arena_t *arena, operator_t *build_source, const uint16_t build_attr_i)
+{
+    assert(build_source);
+
+    join_table_t *table = arena_calloc(arena, 1, sizeof(*table));
+    if (!table)
+        return NULL;
+
+    table->arena = arena;
+    table->build_source = build_source;
+    table->build_attr_i = build_attr_i;
+    pthread_mutex_init(&table->lock, NULL);
+    pthread_cond_init(&table->done_cond, NULL);
+
+    return table;
+}
+
+void join_table_destroy(join_table_t *table)
+{
+    if (!table)
+        return;
+
+    table->build_source->destroy(table->build_source);
+    join_table_reset(table);
+    pthread_cond_destroy(&table->done_cond);
+    pthread_mutex_destroy(&table->lock);
+    arena_free(table->arena, table);
+}
+
+/* Hash join operator */
+
+typedef struct hash_join_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Tuple source to probe the table with and the attribute to compare */
+    operator_t *probe_source;
+    uint16_t probe_attr_i;
+    /* Is the table built on the left source? */
+    bool build_left;
+
+    /* Hash joins build tables of their own, hash probes get tables built already */
+    join_table_t *table;
+    bool owns_table;
+
+    /* Current probe tuple value and the next build tuple to be checked, index + 1 */
+    value_type_t probe_value;
+    uint32_t next_build_tuple_i;
+
+    /* Current probe tuple and a reference to build tuple to be joined with it */
+    tuple_t *probe_tuple;
+    tuple_t build_tuple;
+    /* Joined tuple to be returned */
+    tuple_t current_tuple;
+
+    /* Current probe batch and a position within its selection vector */
+    batch_t *probe_batch;
+    uint16_t probe_sel_i;
+    uint16_t probe_row_i;
+    /* Joined batch to be returned */
+    batch_t *current_batch;
+} hash_join_op_state_t;
+
+/* Find the next build tuple matching the current probe value, UINT32_MAX if there's none */
+static uint32_t hash_join_next_match(hash_join_op_state_t *op_state)
+{
+    const join_table_t *table = op_state->table;
+    while (op_state->next_build_tuple_i) {
+        const uint32_t tuple_i = op_state->next_build_tuple_i - 1;
+        op_state->next_build_tuple_i = table->chains[tuple_i];
+        if (relation_get_value(table->relation, tuple_i, table->build_attr_i) == op_state->probe_value)
+            return tuple_i;
+    }
+    return UINT32_MAX;
+}
+
+static void hash_join_start_probe(hash_join_op_state_t *op_state, const value_type_t probe_value)
+{
+    const join_table_t *table = op_state->table;
+    op_state->probe_value = probe_value;
+    op_state->next_build_tuple_i = table->buckets[hash_join_bucket(probe_value, table->bucket_bits)];
+}
+
+void hash_join_op_open(void *state)
+{
+    hash_join_op_state_t *op_state = (typeof(op_state)) state;
+
+    if (op_state->owns_table)
+        join_table_build(op_state->table, NULL);
+
+    /* Nothing to join with */
+    if (!op_state->table->relation)
+        return;
+
+    op_state->build_tuple.as.source.relation = op_state->table->relation;
+
+    operator_t *probe_source = op_state->probe_source;
+    probe_source->open(probe_source->state);
+}
+
+tuple_t *hash_join_op_next(void *state)
+{
+    hash_join_op_state_t *op_state = (typeof(op_state)) state;
+    const relation_t *build_relation = op_state->table->relation;
+    if (!build_relation)
+        return NULL;
+
+    operator_t *probe_source = op_state->probe_source;
+    tuple_join_t *join_tuple = &op_state->current_tuple.as.join;
+
+    for (;;) {
+        /* Try the rest of the chain for the current probe tuple */
+        const uint32_t build_tuple_i = hash_join_next_match(op_state);
+        if (build_tuple_i != UINT32_MAX) {
+            op_state->build_tuple.as.source.tuple_i = build_tuple_i;
+            return &op_state->current_tuple;
+        }
+
+        /* Nothing there? Move to the next probe tuple */
+        op_state->probe_tuple = probe_source->next(probe_source->state);
+        if (!op_state->probe_tuple)
+            return NULL;
+        hash_join_start_probe(op_state, tuple_get_attr_value_by_i(op_state->probe_tuple, op_state->probe_attr_i));
+
+        if (op_state->build_left) {
+            join_tuple->left_source_tuple = &op_state->build_tuple;
+            join_tuple->right_source_tuple = op_state->probe_tuple;
+            join_tuple->left_attr_num = build_relation->attr_num;
+        } else {
+            join_tuple->left_source_tuple = op_state->probe_tuple;
+            join_tuple->right_source_tuple = &op_state->build_tuple;
+            join_tuple->left_attr_num = tuple_get_attr_num(op_state->probe_tuple);
+        }
+    }
+}
+
+static batch_t *hash_join_op_batch_for(hash_join_op_state_t *op_state)
+{
+    if (op_state->current_batch)
+        return op_state->current_batch;
+
+    const batch_t *probe_batch = op_state->probe_batch;
+    const relation_t *build_relation = op_state->table->relation;
+    const uint16_t attr_num = probe_batch->attr_num + build_relation->attr_num;
+    batch_t *batch = batch_create(op_state->arena, attr_num, true);
+    assert(batch);
+
+    const uint16_t build_offset = op_state->build_left ? 0 : probe_batch->attr_num;
+    const uint16_t probe_offset = op_state->build_left ? build_relation->attr_num : 0;
+    for (size_t attr_i = 0; attr_i < build_relation->attr_num; attr_i++)
+        batch->attr_names[build_offset + attr_i] = build_relation->attr_names[attr_i];
+    for (size_t attr_i = 0; attr_i < probe_batch->attr_num; attr_i++)
+        batch->attr_names[probe_offset + attr_i] = probe_batch->attr_names[attr_i];
+
+    op_state->current_batch = batch;
+    return batch;
+}
+
+batch_t *hash_join_op_next_batch(void *state)
+{
+    hash_join_op_state_t *op_state = (typeof(op_state)) state;
+    const relation_t *build_relation = op_state->table->relation;
+    if (!build_relation)
+        return NULL;
+
+    operator_t *probe_source = op_state->probe_source;
+
+    uint16_t row_num = 0;
+    while (row_num < BATCH_SIZE) {
+        /* Emit all the build tuples matching the current probe row */
+        const uint32_t build_tuple_i = hash_join_next_match(op_state);
+        if (build_tuple_i != UINT32_MAX) {
+            const batch_t *probe_batch = op_state->probe_batch;
+            batch_t *batch = hash_join_op_batch_for(op_state);
+            const uint16_t build_offset = op_state->build_left ? 0 : probe_batch->attr_num;
+            const uint16_t probe_offset = op_state->build_left ? build_relation->attr_num : 0;
+
+            for (size_t attr_i = 0; attr_i < build_relation->attr_num; attr_i++)
+                batch->columns[build_offset + attr_i][row_num] = relation_get_value(build_relation, build_tuple_i, attr_i);
+            for (size_t attr_i = 0; attr_i < probe_batch->attr_num; attr_i++)
+                batch->columns[probe_offset + attr_i][row_num] = probe_batch->columns[attr_i][op_state->probe_row_i];
+
+            row_num++;
+            continue;
+        }
+
+        /* Next probe row */
+        if (op_state->probe_batch && op_state->probe_sel_i < op_state->probe_batch->sel_num) {
+            const batch_t *probe_batch = op_state->probe_batch;
+            op_state->probe_row_i = probe_batch->sel[op_state->probe_sel_i++];
+            hash_join_start_probe(op_state, probe_batch->columns[op_state->probe_attr_i][op_state->probe_row_i]);
+            continue;
+        }
+
+        /* Next probe batch */
+        op_state->probe_batch = probe_source->next_batch(probe_source->state);
+        op_state->probe_sel_i = 0;
+        if (!op_state->probe_batch)
+            break;
+    }
+
+    if (row_num == 0)
+        return NULL;
+
+    batch_t *batch = op_state->current_batch;
+    batch->row_num = row_num;
+    batch_sel_all(batch);
+    return batch;
+}
+
+static void hash_join_op_reset(hash_join_op_state_t *op_state)
+{
+    if (op_state->owns_table)
+        join_table_reset(op_state->table);
+
+    op_state->next_build_tuple_i = 0;
+    op_state->probe_tuple = NULL;
+    op_state->probe_batch = NULL;
+    op_state->probe_sel_i = 0;
+}
+
+void hash_join_op_close(void *state)
+{
+    hash_join_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *probe_source = op_state->probe_source;
+
+    /* The build source is closed as soon as it gets materialized */
+    if (op_state->table->relation)
+        probe_source->close(probe_source->state);
+
+    hash_join_op_reset(op_state);
+}
+
+void hash_join_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    hash_join_op_state_t *op_state = operator->state;
+    op_state->probe_source->destroy(op_state->probe_source);
+
+    hash_join_op_reset(op_state);
+    if (op_state->owns_table)
+        join_table_destroy(op_state->table);
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+static operator_t *hash_join_op_create_with_table(arena_t *arena,
+                                                  operator_t *probe_source,
+                                                  join_table_t *table,
+                                                  const bool owns_table,
+                                                  const uint16_t probe_attr_i,
+                                                  const bool build_left)
+{
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    hash_join_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->probe_source = probe_source;
+    state->probe_attr_i = probe_attr_i;
+    state->build_left = build_left;
+    state->table = table;
+    state->owns_table = owns_table;
+    state->build_tuple.tag = TUPLE_SOURCE;
+    state->current_tuple.tag = TUPLE_JOIN;
+    op->state = state;
+
+    op->open = hash_join_op_open;
+    op->next = hash_join_op_next;
+    op->next_batch = hash_join_op_next_batch;
+    op->close = hash_join_op_close;
+    op->destroy = hash_join_op_destroy;
+
+    return op;
+
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+operator_t *hash_join_op_create(arena_t *arena,
+                                operator_t *left_source,
+                                operator_t *right_source,
+                                const uint16_t left_attr_i,
+                                const uint16_t right_attr_i,
+                                const bool build_left)
+{
+    assert(left_source && right_source);
+
+    join_table_t *table = join_table_create(arena, build_left ? left_source : right_source,
+                                            build_left ? left_attr_i : right_attr_i);
+    if (!table)
+        return NULL;
+
+    operator_t *op = hash_join_op_create_with_table(arena, build_left ? right_source : left_source, table, true,
+                                                    build_left ? right_attr_i : left_attr_i, build_left);
+    if (!op) {
+        arena_free(arena, table);
+        return NULL;
+    }
+    return op;
+}
+
+operator_t *hash_probe_op_create(arena_t *arena,
+                                 operator_t *probe_source,
+                                 join_table_t *table,
+                                 const uint16_t probe_attr_i,
+                                 const bool build_left)
+{
+    assert(probe_source && table);
+    return hash_join_op_create_with_table(arena, probe_source, table, false, probe_attr_i, build_left);
+}
+
+/* Index join operator */
+
+typedef struct index_join_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Tuple source to look inner tuples up for and the attribute to compare */
+    operator_t *outer_source;
+    uint16_t outer_attr_i;
+    /* Inner relation attributes joined */
+    const relation_t *inner_relation;
+    uint16_t *inner_attr_is;
+    uint16_t inner_attr_num;
+    /* Do inner attributes go first? */
+    bool inner_left;
+
+    /* Lookup of the current outer tuple value */
+    index_lookup_t lookup;
+
+    /* Current outer tuple and references to inner tuple attributes to be joined with it */
+    tuple_t *outer_tuple;
+    tuple_t inner_source_tuple;
+    tuple_t inner_tuple;
+    /* Joined tuple to be returned */
+    tuple_t current_tuple;
+
+    /* Current outer batch and a position within its selection vector */
+    batch_t *outer_batch;
+    uint16_t outer_sel_i;
+    uint16_t outer_row_i;
+    /* Joined batch to be returned */
+    batch_t *current_batch;
+} index_join_op_state_t;
+
+void index_join_op_open(void *state)
+{
+    index_join_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *outer_source = op_state->outer_source;
+    outer_source->open(outer_source->state);
+}
+
+tuple_t *index_join_op_next(void *state)
+{
+    index_join_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *outer_source = op_state->outer_source;
+    tuple_join_t *join_tuple = &op_state->current_tuple.as.join;
+
+    for (;;) {
+        /* Try the rest of the inner tuples for the current outer tuple */
+        uint32_t inner_tuple_i = 0;
+        if (index_lookup_next(&op_state->lookup, &inner_tuple_i)) {
+            op_state->inner_source_tuple.as.source.tuple_i = inner_tuple_i;
+            return &op_state->current_tuple;
+        }
+
+        /* Nothing there? Move to the next outer tuple */
+        op_state->outer_tuple = outer_source->next(outer_source->state);
+        if (!op_state->outer_tuple)
+            return NULL;
+        index_lookup_start(&op_state->lookup, tuple_get_attr_value_by_i(op_state->outer_tuple, op_state->outer_attr_i));
+
+        if (op_state->inner_left) {
+            join_tuple->left_source_tuple = &op_state->inner_tuple;
+            join_tuple->right_source_tuple = op_state->outer_tuple;
+            join_tuple->left_attr_num = op_state->inner_attr_num;
+        } else {
+            join_tuple->left_source_tuple = op_state->outer_tuple;
+            join_tuple->right_source_tuple = &op_state->inner_tuple;
+            join_tuple->left_attr_num = tuple_get_attr_num(op_state->outer_tuple);
+        }
+    }
+}
+
+static batch_t *index_join_op_batch_for(index_join_op_state_t *op_state)
+{
+    if (op_state->current_batch)
+        return op_state->current_batch;
+
+    const batch_t *outer_batch = op_state->outer_batch;
+    const relation_t *inner_relation = op_state->inner_relation;
+    batch_t *batch = batch_create(op_state->arena, outer_batch->attr_num + op_state->inner_attr_num, true);
+    assert(batch);
+
+    const uint16_t inner_offset = op_state->inner_left ? 0 : outer_batch->attr_num;
+    const uint16_t outer_offset = op_state->inner_left ? op_state->inner_attr_num : 0;
+    for (size_t attr_i = 0; attr_i < op_state->inner_attr_num; attr_i++)
+        batch->attr_names[inner_offset + attr_i] = inner_relation->attr_names[op_state->inner_attr_is[attr_i]];
+    for (size_t attr_i = 0; attr_i < outer_batch->attr_num; attr_i++)
+        batch->attr_names[outer_offset + attr_i] = outer_batch->attr_names[attr_i];
+
+    op_state->current_batch = batch;
+    return batch;
+}
+
+batch_t *index_join_op_next_batch(void *state)
+{
+    index_join_op_state_t *op_state = (typeof(op_state)) state;
+    const relation_t *inner_relation = op_state->inner_relation;
+    operator_t *outer_source = op_state->outer_source;
+
+    uint16_t row_num = 0;
+    while (row_num < BATCH_SIZE) {
+        /* Emit all the inner tuples matching the current outer row */
+        uint32_t inner_tuple_i = 0;
+        if (index_lookup_next(&op_state->lookup, &inner_tuple_i)) {
+            const batch_t *outer_batch = op_state->outer_batch;
+            batch_t *batch = index_join_op_batch_for(op_state);
+            const uint16_t inner_offset = op_state->inner_left ? 0 : outer_batch->attr_num;
+            const uint16_t outer_offset = op_state->inner_left ? op_state->inner_attr_num : 0;
+
+            for (size_t attr_i = 0; attr_i < op_state->inner_attr_num; attr_i++)
+                batch->columns[inner_offset + attr_i][row_num] =
+                    *relation_value_ptr(inner_relation, inner_tuple_i, op_state->inner_attr_is[attr_i]);
+            for (size_t attr_i = 0; attr_i < outer_batch->attr_num; attr_i++)
+                batch->columns[outer_offset + attr_i][row_num] = outer_batch->columns[attr_i][op_state->outer_row_i];
+
+            row_num++;
+            continue;
+        }
+
+        /* Next outer row */
+        if (op_state->outer_batch && op_state->outer_sel_i < op_state->outer_batch->sel_num) {
+            const batch_t *outer_batch = op_state->outer_batch;
+            op_state->outer_row_i = outer_batch->sel[op_state->outer_sel_i++];
+            index_lookup_start(&op_state->lookup, outer_batch->columns[op_state->outer_attr_i][op_state->outer_row_i]);
+            continue;
+        }
+
+        /* Next outer batch */
+        op_state->outer_batch = outer_source->next_batch(outer_source->state);
+        op_state->outer_sel_i = 0;
+        if (!op_state->outer_batch)
+            break;
+    }
+
+    if (row_num == 0)
+        return NULL;
+
+    batch_t *batch = op_state->current_batch;
+    batch->row_num = row_num;
+    batch_sel_all(batch);
+    return batch;
+}
+
+void index_join_op_close(void *state)
+{
+    index_join_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *outer_source = op_state->outer_source;
+    outer_source->close(outer_source->state);
+
+    op_state->lookup.is_done = true;
+    op_state->outer_tuple = NULL;
+    op_state->outer_batch = NULL;
+    op_state->outer_sel_i = 0;
+}
+
+void index_join_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    index_join_op_state_t *op_state = operator->state;
+    op_state->outer_source->destroy(op_state->outer_source);
+
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_free(op_state->arena, op_state->inner_attr_is);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *index_join_op_create(arena_t *arena,
+                                 operator_t *outer_source,
+                                 const relation_t *inner_relation,
+                                 const uint16_t outer_attr_i,
+                                 const uint16_t inner_attr_i,
+                                 const uint16_t *inner_attr_is,
+                                 const uint16_t inner_attr_num,
+                                 const bool inner_left)
+{
+    assert(outer_source && inner_relation);
+    assert(inner_attr_num > 0);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    index_join_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->outer_source = outer_source;
+    state->outer_attr_i = outer_attr_i;
+    state->inner_relation = inner_relation;
+    state->inner_attr_num = inner_attr_num;
+    state->inner_left = inner_left;
+    state->lookup = index_lookup_create(inner_relation, inner_attr_i);
+    op->state = state;
+
+    state->inner_attr_is = arena_calloc(arena, inner_attr_num, sizeof(uint16_t));
+    if (!state->inner_attr_is)
+        goto attrs_fail;
+    memcpy(state->inner_attr_is, inner_attr_is, inner_attr_num * sizeof(uint16_t));
+
+    /* Inner tuples are relation tuples narrowed down to the attributes joined */
+    state->inner_source_tuple.tag = TUPLE_SOURCE;
+    state->inner_source_tuple.as.source.relation = inner_relation;
+    state->inner_tuple.tag = TUPLE_PROJECT;
+    state->inner_tuple.as.project.source_tuple = &state->inner_source_tuple;
+    state->inner_tuple.as.project.source_attr_is = state->inner_attr_is;
+    state->inner_tuple.as.project.attr_num = inner_attr_num;
+    state->current_tuple.tag = TUPLE_JOIN;
+
+    op->open = index_join_op_open;
+    op->next = index_join_op_next;
+    op->next_batch = index_join_op_next_batch;
+    op->close = index_join_op_close;
+    op->destroy = index_join_op_destroy;
+
+    return op;
+
+attrs_fail:
+    arena_free(arena, state);
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Select operator */
+
+#define MAX_SELECT_PREDICATE_NUM 16
+
+typedef struct select_predicate_t select_predicate_t;
+
+/* Evaluators specialized for a predicate kind and a comparison, chosen once predicates are added */
+typedef bool (*select_tuple_eval)(const select_predicate_t *predicate, const tuple_t *tuple);
+
+struct select_predicate_t {
+    select_predicate_tag tag;
+    select_predicate_op op;
+    select_tuple_eval tuple_eval;
+    union {
+        struct {
+            uint16_t left_attr_i;
+            value_type_t right_constant;
+            /* Parameter the constant is read from when opening, NULL if the constant is fixed */
+            const value_type_t *right_param;
+        } attr_const;
+        struct {
+            uint16_t left_attr_i;
+            uint16_t right_attr_i;
+        } attr_attr;
+    } as;
+};
+
+typedef struct select_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Tuple source to apply filters to */
+    operator_t *source;
+    select_predicate_t predicates[MAX_SELECT_PREDICATE_NUM];
+    size_t predicate_num;
+
+    /* A filtered batch referencing source batch columns */
+    batch_t *current_batch;
+    uint16_t current_sel[BATCH_SIZE];
+    uint64_t current_mask[FILTER_MASK_WORD_NUM(BATCH_SIZE)];
+} select_op_state_t;
+
+void select_op_open(void *state)
+{
+    select_op_state_t *op_state = (typeof(op_state)) state;
+    for (size_t pred_i = 0; pred_i < op_state->predicate_num; ++pred_i) {
+        select_predicate_t *predicate = &op_state->predicates[pred_i];
+        if (predicate->tag == SELECT_ATTR_CONST && predicate->as.attr_const.right_param)
+            predicate->as.attr_const.right_constant = *predicate->as.attr_const.right_param;
+    }
+
+    operator_t *source = op_state->source;
+    source->open(source->state);
+}
+
+/* Values of source tuples are read right from relations, the rest of tuples go through references */
+static inline value_type_t select_tuple_value(const tuple_t *tuple, const uint16_t attr_i)
+{
+    if (tuple->tag == TUPLE_SOURCE)
+        return *relation_value_ptr(tuple->as.source.relation, tuple->as.source.tuple_i, attr_i);
+    return tuple_get_attr_value_by_i(tuple, attr_i);
+}
+
+#define SELECT_TUPLE_EVAL(name, LEFT_ATTR_I, RIGHT, CMP)                               \
+    static bool name(const select_predicate_t *predicate, const tuple_t *tuple)        \
+    {                                                                                   \
+        const value_type_t left = select_tuple_value(tuple, predicate->as.LEFT_ATTR_I); \
+        const value_type_t right = RIGHT;                                               \
+        return CMP;                                                                     \
+    }
+
+SELECT_TUPLE_EVAL(select_tuple_const_gt, attr_const.left_attr_i, predicate->as.attr_const.right_constant, left > right)
+SELECT_TUPLE_EVAL(select_tuple_const_lt, attr_const.left_attr_i, predicate->as.attr_const.right_constant, left < right)
+SELECT_TUPLE_EVAL(select_tuple_const_eq, attr_const.left_attr_i, predicate->as.attr_const.right_constant, left == right)
+SELECT_TUPLE_EVAL(select_tuple_attr_gt, attr_attr.left_attr_i,
+                  select_tuple_value(tuple, predicate->as.attr_attr.right_attr_i), left > right)
+SELECT_TUPLE_EVAL(select_tuple_attr_lt, attr_attr.left_attr_i,
+                  select_tuple_value(tuple, predicate->as.attr_attr.right_attr_i), left < right)
+SELECT_TUPLE_EVAL(select_tuple_attr_eq, attr_attr.left_attr_i,
+                  select_tuple_value(tuple, predicate->as.attr_attr.right_attr_i), left == right)
+
+static const select_tuple_eval select_tuple_evals[SELECT_ATTR_ATTR + 1][SELECT_EQ + 1] = {
+    [SELECT_ATTR_CONST] = {
+        [SELECT_GT] = select_tuple_const_gt,
+        [SELECT_LT] = select_tuple_const_lt,
+        [SELECT_EQ] = select_tuple_const_eq,
+    },
+    [SELECT_ATTR_ATTR] = {
+        [SELECT_GT] = select_tuple_attr_gt,
+        [SELECT_LT] = select_tuple_attr_lt,
+        [SELECT_EQ] = select_tuple_attr_eq,
+    },
+};
+
+static bool tuple_satisfies_predicates(const tuple_t *tuple, const select_predicate_t predicates[],
+                                       const size_t predicate_num)
+{
+    for (size_t pred_i = 0; pred_i < predicate_num; ++pred_i)
+        if (!predicates[pred_i].tuple_eval(&predicates[pred_i], tuple))
+            return false;
+    return true;
+}
+
+tuple_t *select_op_next(void *state)
+{
+    select_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+
+    tuple_t *tuple = NULL;
+    do {
+        tuple = source->next(source->state);
+    } while (tuple && !tuple_satisfies_predicates(tuple, op_state->predicates, op_state->predicate_num));
+
+    return tuple;
+}
+
+/* Dense batches are filtered a column at a time with vectorized kernels ANDing bitmasks */
+static uint16_t select_op_filter_dense(select_op_state_t *op_state, const batch_t *source_batch)
+{
+    uint64_t *mask = op_state->current_mask;
+    filter_mask_fill(mask, source_batch->row_num);
+
+    for (size_t pred_i = 0; pred_i < op_state->predicate_num; ++pred_i) {
+        const select_predicate_t *predicate = &op_state->predicates[pred_i];
+        if (predicate->tag == SELECT_ATTR_CONST) {
+            const value_type_t *left_column = source_batch->columns[predicate->as.attr_const.left_attr_i];
+            filter_attr_const(predicate->op, left_column, predicate->as.attr_const.right_constant,
+                              source_batch->row_num, mask);
+        } else {
+            const value_type_t *left_column = source_batch->columns[predicate->as.attr_attr.left_attr_i];
+            const value_type_t *right_column = source_batch->columns[predicate->as.attr_attr.right_attr_i];
+            filter_attr_attr(predicate->op, left_column, right_column, source_batch->row_num, mask);
+        }
+    }
+
+    return filter_mask_to_sel(mask, source_batch->row_num, op_state->current_sel);
+}
+
+/* Sparse batches only look at rows alive, one predicate for the whole batch at a time */
+static uint16_t select_op_filter_sparse(select_op_state_t *op_state, const batch_t *source_batch)
+{
+    const uint16_t *sel = source_batch->sel;
+    uint16_t sel_num = source_batch->sel_num;
+    for (size_t pred_i = 0; pred_i < op_state->predicate_num; ++pred_i) {
+        const select_predicate_t *predicate = &op_state->predicates[pred_i];
+        if (predicate->tag == SELECT_ATTR_CONST) {
+            const value_type_t *left_column = source_batch->columns[predicate->as.attr_const.left_attr_i];
+            sel_num = filter_sel_attr_const(predicate->op, left_column,
+                                            predicate->as.attr_const.right_constant,
+                                            sel, sel_num, op_state->current_sel);
+        } else {
+            const value_type_t *left_column = source_batch->columns[predicate->as.attr_attr.left_attr_i];
+            const value_type_t *right_column = source_batch->columns[predicate->as.attr_attr.right_attr_i];
+            sel_num = filter_sel_attr_attr(predicate->op, left_column, right_column,
+                                           sel, sel_num, op_state->current_sel);
+        }
+        sel = op_state->current_sel;
+    }
+    return sel_num;
+}
+
+batch_t *select_op_next_batch(void *state)
+{
+    select_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+
+    batch_t *source_batch = NULL;
+    while ((source_batch = source->next_batch(source->state))) {
+        /* Selections are ordered, so all rows are alive if there are as many as rows */
+        const bool is_dense = source_batch->sel_num == source_batch->row_num;
+        const uint16_t sel_num = is_dense ?
+            select_op_filter_dense(op_state, source_batch) :
+            select_op_filter_sparse(op_state, source_batch);
+        const uint16_t *sel = op_state->current_sel;
+
+        /* Everything filtered out? Try the next batch */
+        if (sel_num == 0)
+            continue;
+
+        batch_t *batch = op_state->current_batch;
+        if (!batch) {
+            batch = batch_create(op_state->arena, source_batch->attr_num, false);
+            assert(batch);
+            op_state->current_batch = batch;
+        }
+        for (size_t attr_i = 0; attr_i < batch->attr_num; attr_i++) {
+            batch->attr_names[attr_i] = source_batch->attr_names[attr_i];
+            batch->columns[attr_i] = source_batch->columns[attr_i];
+            batch->high_columns[attr_i] = source_batch->high_columns[attr_i];
+        }
+        batch->row_num = source_batch->row_num;
+        batch->sel = (uint16_t *)sel;
+        batch->sel_num = sel_num;
+
+        return batch;
+    }
+
+    return NULL;
+}
+
+void select_op_close(void *state)
+{
+    select_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    source->close(source->state);
+}
+
+void select_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    select_op_state_t *op_state = operator->state;
+    op_state->source->destroy(op_state->source);
+
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+static void select_op_add_attr_const_predicate_with(operator_t *operator,
+                                                    const uint16_t left_attr_i,
+                                                    const select_predicate_op predicate_op,
+                                                    const value_type_t right_constant,
+                                                    const value_type_t *right_param)
+{
+    select_op_state_t *op_state = (typeof(op_state)) operator->state;
+    assert(op_state->predicate_num < MAX_SELECT_PREDICATE_NUM);
+
+    select_predicate_t *predicate = &op_state->predicates[op_state->predicate_num];
+
+    predicate->tag = SELECT_ATTR_CONST;
+    predicate->op = predicate_op;
+    predicate->tuple_eval = select_tuple_evals[SELECT_ATTR_CONST][predicate_op];
+    predicate->as.attr_const.left_attr_i = left_attr_i;
+    predicate->as.attr_const.right_constant = right_constant;
+    predicate->as.attr_const.right_param = right_param;
+
+    op_state->predicate_num++;
+}
+
+void select_op_add_attr_const_predicate(operator_t *operator,
+                                        const uint16_t left_attr_i,
+                                        const select_predicate_op predicate_op,
+                                        const value_type_t right_constant)
+{
+    select_op_add_attr_const_predicate_with(operator, left_attr_i, predicate_op, right_constant, NULL);
+}
+
+void select_op_add_attr_param_predicate(operator_t *operator,
+                                        const uint16_t left_attr_i,
+                                        const select_predicate_op predicate_op,
+                                        const value_type_t *right_param)
+{
+    assert(right_param);
+    select_op_add_attr_const_predicate_with(operator, left_attr_i, predicate_op, *right_param, right_param);
+}
+
+void select_op_add_attr_attr_predicate(operator_t *operator,
+                                       const uint16_t left_attr_i,
+                                       const select_predicate_op predicate_op,
+                                       const uint16_t right_attr_i)
+{
+    select_op_state_t *op_state = (typeof(op_state)) operator->state;
+    assert(op_state->predicate_num < MAX_SELECT_PREDICATE_NUM);
+
+    select_predicate_t *predicate = &op_state->predicates[op_state->predicate_num];
+
+    predicate->tag = SELECT_ATTR_ATTR;
+    predicate->op = predicate_op;
+    predicate->tuple_eval = select_tuple_evals[SELECT_ATTR_ATTR][predicate_op];
+    predicate->as.attr_attr.left_attr_i = left_attr_i;
+    predicate->as.attr_attr.right_attr_i = right_attr_i;
+
+    op_state->predicate_num++;
+}
+
+operator_t *select_op_create(arena_t *arena, operator_t *source)
+{
+    assert(source);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    select_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->source = source;
+    state->predicate_num = 0;
+    op->state = state;
+
+    op->open = select_op_open;
+    op->next = select_op_next;
+    op->next_batch = select_op_next_batch;
+    op->close = select_op_close;
+    op->destroy = select_op_destroy;
+
+    return op;
+
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Sort operator */
+
+static size_t sort_memory_budget = SORT_DEFAULT_MEMORY_BUDGET;
+
+void sort_op_set_memory_budget(const size_t bytes)
+{
+    sort_memory_budget = bytes;
+}
+
+size_t sort_op_get_memory_budget(void)
+{
+    return sort_memory_budget;
+}
+
+/* A sorted run spilled to a temporary file, tuples are stored as arrays of values */
+typedef struct sort_run_t {
+    FILE *file;
+    /* Spilled runs are of level 0, runs merged from runs of level n are of level n + 1 */
+    uint32_t level;
+    /* Current tuple of the run, NULL when the run is exhausted */
+    value_type_t *tuple;
+} sort_run_t;
+
+/* Runs being merged, their current tuples and a loser tree picking the next tuple */
+typedef struct sort_merge_t {
+    sort_run_t *runs;
+    uint32_t run_num;
+    uint16_t attr_num;
+    uint16_t sort_attr_i;
+    /* Upper half of the sort attribute, 0 if it's not 64-bit */
+    uint16_t sort_high_attr_i;
+    sort_order_t sort_order;
+    value_type_t *run_tuples;
+    uint32_t *loser_tree;
+    /* Set when a run failed to be read back */
+    bool has_failed;
+} sort_merge_t;
+
+typedef struct sort_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    operator_t *source;
+    /* Attribute to sort tuples by */
+    uint16_t sort_attr_i;
+    /* Sort order, descending or ascending */
+    sort_order_t sort_order;
+    /* Bytes of tuple values to keep in memory before spilling a sorted run */
+    size_t memory_budget;
+
+    /* Temporary relation to be used for sorting, or for merged tuples if runs were spilled */
+    relation_t *tmp_relation;
+    /* Relation scan op */
+    operator_t *tmp_relation_scan_op;
+
+    /* Spilled runs, levels never increasing from the first run to the last one */
+    sort_run_t *runs;
+    uint32_t run_num;
+    /* Set when a run failed to be spilled */
+    bool has_failed;
+    /* Merge of all the runs returning tuples */
+    sort_merge_t merge;
+} sort_op_state_t;
+
+static void sort_op_fail(sort_op_state_t *op_state, const char *what)
+{
+    eval_set_error("sort failed to %s a temporary file: %s", what, strerror(errno));
+    op_state->has_failed = true;
+}
+
+static bool sort_run_write(sort_op_state_t *op_state, FILE *file, const value_type_t *tuple)
+{
+    const uint16_t attr_num = op_state->tmp_relation->attr_num;
+    if (fwrite(tuple, sizeof(value_type_t), attr_num, file) == attr_num)
+        return true;
+    sort_op_fail(op_state, "write");
+    return false;
+}
+
+/* Make sure the whole run made it to the file before reading it back from the start */
+static bool sort_run_rewind(sort_op_state_t *op_state, FILE *file)
+{
+    if (fflush(file) == 0 && !ferror(file) && fseek(file, 0, SEEK_SET) == 0)
+        return true;
+    sort_op_fail(op_state, "write");
+    return false;
+}
+
+static void sort_run_advance(sort_merge_t *merge, sort_run_t *run)
+{
+    const size_t read_num = fread(run->tuple, sizeof(value_type_t), merge->attr_num, run->file);
+    if (read_num == merge->attr_num)
+        return;
+
+    run->tuple = NULL;
+    /* Runs end on a tuple boundary */
+    if (read_num > 0 || ferror(run->file)) {
+        eval_set_error("sort failed to read a temporary file back");
+        merge->has_failed = true;
+    }
+}
+
+/* Does the current tuple of a run go before the current tuple of another run? Exhausted runs go
+ * last, equal keys are taken from earlier runs first to keep the sort stable */
+static bool sort_run_before(const sort_merge_t *merge, const uint32_t left_i, const uint32_t right_i)
+{
+    const value_type_t *left = merge->runs[left_i].tuple, *right = merge->runs[right_i].tuple;
+    if (!left || !right)
+        return left != NULL;
+
+    uint64_t left_key = left[merge->sort_attr_i], right_key = right[merge->sort_attr_i];
+    if (merge->sort_high_attr_i) {
+        left_key |= (uint64_t)left[merge->sort_high_attr_i] << 32;
+        right_key |= (uint64_t)right[merge->sort_high_attr_i] << 32;
+    }
+    if (left_key != right_key)
+        return merge->sort_order == SORT_ASC ? left_key < right_key : left_key > right_key;
+    return left_i < right_i;
+}
+
+/* Internal nodes of the tree keep losers of their subtrees, leaves are runs; returns the winner */
+static uint32_t sort_loser_tree_init(sort_merge_t *merge, const uint32_t node_i)
+{
+    if (node_i >= merge->run_num)
+        return node_i - merge->run_num;
+
+    const uint32_t left_winner = sort_loser_tree_init(merge, 2 * node_i);
+    const uint32_t right_winner = sort_loser_tree_init(merge, 2 * node_i + 1);
+    if (sort_run_before(merge, left_winner, right_winner)) {
+        merge->loser_tree[node_i] = right_winner;
+        return left_winner;
+    }
+    merge->loser_tree[node_i] = left_winner;
+    return right_winner;
+}
+
+/* The winner got a new tuple, replay its matches on the way to the root */
+static void sort_loser_tree_replay(sort_merge_t *merge)
+{
+    uint32_t *loser_tree = merge->loser_tree;
+    uint32_t winner = loser_tree[0];
+    for (uint32_t node_i = (winner + merge->run_num) / 2; node_i > 0; node_i /= 2) {
+        if (sort_run_before(merge, loser_tree[node_i], winner)) {
+            const uint32_t loser = winner;
+            winner = loser_tree[node_i];
+            loser_tree[node_i] = loser;
+        }
+    }
+    loser_tree[0] = winner;
+}
+
+static void sort_merge_start(const sort_op_state_t *op_state, sort_merge_t *merge, sort_run_t *runs,
+                             const uint32_t run_num)
+{
+    const uint16_t attr_num = op_state->tmp_relation->attr_num;
+    *merge = (sort_merge_t) {
+        .runs = runs,
+        .run_num = run_num,
+        .attr_num = attr_num,
+        .sort_attr_i = op_state->sort_attr_i,
+        .sort_high_attr_i = relation_high_attr_i(op_state->tmp_relation, op_state->sort_attr_i),
+        .sort_order = op_state->sort_order,
+        .run_tuples = calloc((size_t)run_num * attr_num, sizeof(value_type_t)),
+        .loser_tree = calloc(run_num, sizeof(uint32_t)),
+    };
+    assert(merge->run_tuples && merge->loser_tree);
+
+    for (uint32_t run_i = 0; run_i < run_num; run_i++) {
+        sort_run_t *run = &runs[run_i];
+        run->tuple = &merge->run_tuples[(size_t)run_i * attr_num];
+        sort_run_advance(merge, run);
+    }
+    merge->loser_tree[0] = sort_loser_tree_init(merge, 1);
+}
+
+/* The next merged tuple, valid until the merge advances; NULL once all runs are exhausted */
+static const value_type_t *sort_merge_peek(const sort_merge_t *merge)
+{
+    return merge->runs[merge->loser_tree[0]].tuple;
+}
+
+static void sort_merge_advance(sort_merge_t *merge)
+{
+    sort_run_advance(merge, &merge->runs[merge->loser_tree[0]]);
+    sort_loser_tree_replay(merge);
+}
+
+static void sort_merge_finish(sort_merge_t *merge)
+{
+    free(merge->run_tuples);
+    free(merge->loser_tree);
+    *merge = (sort_merge_t) {0};
+}
+
+/* Merge the last SORT_MERGE_RUN_NUM runs into a run of the next level for as long as they are of the
+ * same level, so that every tuple gets written a logarithmic number of times and there is only a
+ * logarithmic number of runs open */
+static bool sort_op_merge_levels(sort_op_state_t *op_state)
+{
+    while (op_state->run_num >= SORT_MERGE_RUN_NUM) {
+        const uint32_t first_run_i = op_state->run_num - SORT_MERGE_RUN_NUM;
+        sort_run_t *runs = &op_state->runs[first_run_i];
+        if (runs[0].level != runs[SORT_MERGE_RUN_NUM - 1].level)
+            return true;
+
+        FILE *file = tmpfile();
+        if (!file) {
+            sort_op_fail(op_state, "create");
+            return false;
+        }
+
+        sort_merge_t merge;
+        sort_merge_start(op_state, &merge, runs, SORT_MERGE_RUN_NUM);
+        const value_type_t *tuple = NULL;
+        bool is_written = true;
+        while (is_written && (tuple = sort_merge_peek(&merge))) {
+            is_written = sort_run_write(op_state, file, tuple);
+            sort_merge_advance(&merge);
+        }
+        const bool has_failed = merge.has_failed;
+        sort_merge_finish(&merge);
+        if (!is_written || has_failed || !sort_run_rewind(op_state, file)) {
+            op_state->has_failed = true;
+            fclose(file);
+            return false;
+        }
+
+        const uint32_t level = runs[0].level + 1;
+        for (uint32_t run_i = 0; run_i < SORT_MERGE_RUN_NUM; run_i++)
+            fclose(runs[run_i].file);
+        runs[0] = (sort_run_t) { .file = file, .level = level };
+        op_state->run_num = first_run_i + 1;
+    }
+    return true;
+}
+
+/* Sort tuples kept in memory and write them to a new run, false if the run could not be written */
+static bool sort_op_spill_run(sort_op_state_t *op_state)
+{
+    relation_t *rel = op_state->tmp_relation;
+    relation_order_by(rel, op_state->sort_attr_i, op_state->sort_order);
+
+    FILE *file = tmpfile();
+    if (!file) {
+        sort_op_fail(op_state, "create");
+        return false;
+    }
+    for (uint32_t tuple_i = 0; tuple_i < rel->tuple_num; tuple_i++) {
+        if (!sort_run_write(op_state, file, relation_tuple_values_by_id(rel, tuple_i))) {
+            fclose(file);
+            return false;
+        }
+    }
+    if (!sort_run_rewind(op_state, file)) {
+        fclose(file);
+        return false;
+    }
+
+    op_state->runs = realloc(op_state->runs, (op_state->run_num + 1) * sizeof(sort_run_t));
+    assert(op_state->runs);
+    op_state->runs[op_state->run_num++] = (sort_run_t) { .file = file, .level = 0 };
+
+    /* Keep the memory for the next run */
+    rel->tuple_num = 0;
+
+    return sort_op_merge_levels(op_state);
+}
+
+/* Merge the next batch of tuples into the relation, returns false when all runs are exhausted */
+static bool sort_op_merge_batch(sort_op_state_t *op_state)
+{
+    relation_t *rel = op_state->tmp_relation;
+    rel->tuple_num = 0;
+
+    const value_type_t *tuple = NULL;
+    while (rel->tuple_num < BATCH_SIZE && (tuple = sort_merge_peek(&op_state->merge))) {
+        relation_append_values(rel, tuple);
+        sort_merge_advance(&op_state->merge);
+    }
+
+    /* Tuples are not returned past a run failing to be read */
+    if (op_state->merge.has_failed)
+        return false;
+
+    operator_t *scan_op = op_state->tmp_relation_scan_op;
+    scan_op->close(scan_op->state);
+    scan_op->open(scan_op->state);
+    return rel->tuple_num > 0;
+}
+
+void sort_op_open(void *state)
+{
+    sort_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+
+    /* Materialize a table to be sorted, batch by batch, spilling sorted runs over the budget */
+    source->open(source->state);
+    batch_t *batch = NULL;
+    while(!op_state->has_failed && (batch = source->next_batch(source->state))) {
+        if (!op_state->tmp_relation) {
+            op_state->tmp_relation = relation_create_for_batch(batch);
+            assert(op_state->tmp_relation);
+            op_state->tmp_relation_scan_op = scan_op_create(op_state->arena, op_state->tmp_relation);
+        }
+        relation_append_batch(op_state->tmp_relation, batch);
+
+        relation_t *rel = op_state->tmp_relation;
+        if ((size_t)rel->tuple_num * rel->attr_num * sizeof(value_type_t) >= op_state->memory_budget)
+            sort_op_spill_run(op_state);
+    }
+    source->close(source->state);
+
+    /* Nothing to sort, or nothing to return after failing */
+    if (!op_state->tmp_relation || op_state->has_failed)
+        return;
+
+    /* Everything fits, sort it in memory */
+    if (op_state->run_num == 0) {
+        relation_order_by(op_state->tmp_relation, op_state->sort_attr_i, op_state->sort_order);
+        op_state->tmp_relation_scan_op->open(op_state->tmp_relation_scan_op->state);
+        return;
+    }
+
+    /* Spill the rest and merge runs a batch at a time */
+    if (op_state->tmp_relation->tuple_num > 0 && !sort_op_spill_run(op_state))
+        return;
+    sort_merge_start(op_state, &op_state->merge, op_state->runs, op_state->run_num);
+
+    /* The relation now only keeps a batch of merged tuples at a time */
+    relation_reset(op_state->tmp_relation);
+    op_state->tmp_relation_scan_op->open(op_state->tmp_relation_scan_op->state);
+}
+
+tuple_t *sort_op_next(void *state)
+{
+    sort_op_state_t *op_state = (typeof(op_state)) state;
+    if (!op_state->tmp_relation || op_state->has_failed)
+        return NULL;
+
+    operator_t *scan_op = op_state->tmp_relation_scan_op;
+    tuple_t *tuple = scan_op->next(scan_op->state);
+    if (tuple || op_state->run_num == 0 || !sort_op_merge_batch(op_state))
+        return tuple;
+    return scan_op->next(scan_op->state);
+}
+
+batch_t *sort_op_next_batch(void *state)
+{
+    sort_op_state_t *op_state = (typeof(op_state)) state;
+    if (!op_state->tmp_relation || op_state->has_failed)
+        return NULL;
+
+    operator_t *scan_op = op_state->tmp_relation_scan_op;
+    batch_t *batch = scan_op->next_batch(scan_op->state);
+    if (batch || op_state->run_num == 0 || !sort_op_merge_batch(op_state))
+        return batch;
+    return scan_op->next_batch(scan_op->state);
+}
+
+void sort_op_close(void *state)
+{
+    sort_op_state_t *op_state = (typeof(op_state)) state;
+    /* If there was a tmp relation - destroy it */
+    if (op_state->tmp_relation) {
+        op_state->tmp_relation_scan_op->close(op_state->tmp_relation_scan_op->state);
+        scan_op_destroy(op_state->tmp_relation_scan_op);
+        relation_destroy(op_state->tmp_relation);
+        op_state->tmp_relation = NULL;
+    }
+
+    /* Temporary files go away once closed */
+    sort_merge_finish(&op_state->merge);
+    for (uint32_t run_i = 0; run_i < op_state->run_num; run_i++)
+        fclose(op_state->runs[run_i].file);
+    free(op_state->runs);
+    op_state->runs = NULL;
+    op_state->run_num = 0;
+    op_state->has_failed = false;
+}
+
+void sort_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    sort_op_state_t *op_state = operator->state;
+    op_state->source->destroy(op_state->source);
+
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *sort_op_create(arena_t *arena,
+                           operator_t *source,
+                           const uint16_t sort_attr_i,
+                           const sort_order_t order)
+{
+    assert(source);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    sort_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->source = source;
+    state->sort_order = order;
+    state->sort_attr_i = sort_attr_i;
+    state->memory_budget = sort_memory_budget;
+    op->state = state;
+
+    op->open = sort_op_open;
+    op->next = sort_op_next;
+    op->next_batch = sort_op_next_batch;
+    op->close = sort_op_close;
+    op->destroy = sort_op_destroy;
+
+    return op;
+
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Top-N operator */
+
+typedef struct top_n_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    operator_t *source;
+    /* Attribute to sort tuples by */
+    uint16_t sort_attr_i;
+    /* Sort order, descending or ascending */
+    sort_order_t sort_order;
+    /* Number of tuples to keep */
+    uint32_t limit;
+
+    /* Temporary relation keeping the best tuples seen so far */
+    relation_t *tmp_relation;
+    /* Tuple indices of the relation in a heap, the tuple to be replaced next is on top */
+    uint32_t *heap;
+    uint32_t heap_slots;
+    /* Relation scan op */
+    operator_t *tmp_relation_scan_op;
+} top_n_op_state_t;
+
+/* Does the left key go before the right key in the sort order? */
+static inline bool top_n_before(const uint64_t left, const uint64_t right, const sort_order_t order)
+{
+    return order == SORT_ASC ? left < right : left > right;
+}
+
+static inline uint64_t top_n_key(const top_n_op_state_t *op_state, const uint32_t heap_i)
+{
+    const relation_t *rel = op_state->tmp_relation;
+    const uint32_t tuple_i = op_state->heap[heap_i];
+    const uint64_t key = *relation_value_ptr(rel, tuple_i, op_state->sort_attr_i);
+    const uint16_t high_attr_i = relation_high_attr_i(rel, op_state->sort_attr_i);
+    if (!high_attr_i)
+        return key;
+    return (uint64_t)*relation_value_ptr(rel, tuple_i, high_attr_i) << 32 | key;
+}
+
+static void top_n_sift_up(top_n_op_state_t *op_state, uint32_t heap_i)
+{
+    uint32_t *heap = op_state->heap;
+    while (heap_i > 0) {
+        const uint32_t parent_i = (heap_i - 1) / 2;
+        if (!top_n_before(top_n_key(op_state, parent_i), top_n_key(op_state, heap_i), op_state->sort_order))
+            break;
+        const uint32_t tuple_i = heap[parent_i];
+        heap[parent_i] = heap[heap_i];
+        heap[heap_i] = tuple_i;
+        heap_i = parent_i;
+    }
+}
+
+static void top_n_sift_down(top_n_op_state_t *op_state, uint32_t heap_i)
+{
+    uint32_t *heap = op_state->heap;
+    const uint32_t heap_num = op_state->tmp_relation->tuple_num;
+    const sort_order_t order = op_state->sort_order;
+    for (;;) {
+        /* Pick the child going last in the sort order */
+        const uint32_t left_i = 2 * heap_i + 1, right_i = left_i + 1;
+        uint32_t last_i = heap_i;
+        if (left_i < heap_num && top_n_before(top_n_key(op_state, last_i), top_n_key(op_state, left_i), order))
+            last_i = left_i;
+        if (right_i < heap_num && top_n_before(top_n_key(op_state, last_i), top_n_key(op_state, right_i), order))
+            last_i = right_i;
+        if (last_i == heap_i)
+            break;
+        const uint32_t tuple_i = heap[last_i];
+        heap[last_i] = heap[heap_i];
+        heap[heap_i] = tuple_i;
+        heap_i = last_i;
+    }
+}
+
+static void top_n_copy_row(relation_t *rel, const uint32_t tuple_i, const batch_t *batch, const uint16_t row_i)
+{
+    for (uint16_t attr_i = 0; attr_i < batch->attr_num; attr_i++) {
+        *relation_value_ptr(rel, tuple_i, attr_i) = batch->columns[attr_i][row_i];
+        if (batch->high_columns[attr_i])
+            *relation_value_ptr(rel, tuple_i, rel->high_attr_is[attr_i]) = batch->high_columns[attr_i][row_i];
+    }
+}
+
+static void top_n_add_batch(top_n_op_state_t *op_state, const batch_t *batch)
+{
+    relation_t *rel = op_state->tmp_relation;
+
+    for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+        const uint16_t row_i = batch->sel[sel_i];
+
+        /* Not enough tuples yet, just add the row to the heap */
+        if (rel->tuple_num < op_state->limit) {
+            if (rel->tuple_num == op_state->heap_slots) {
+                op_state->heap_slots = op_state->heap_slots ? op_state->heap_slots * 2 : BATCH_SIZE;
+                op_state->heap = realloc(op_state->heap, op_state->heap_slots * sizeof(uint32_t));
+                assert(op_state->heap);
+            }
+            const uint32_t tuple_i = relation_new_tuple(rel);
+            top_n_copy_row(rel, tuple_i, batch, row_i);
+            op_state->heap[tuple_i] = tuple_i;
+            top_n_sift_up(op_state, tuple_i);
+            continue;
+        }
+
+        /* Replace the tuple going last if the row goes before it */
+        const uint64_t key = batch_get_value(batch, op_state->sort_attr_i, row_i);
+        if (!top_n_before(key, top_n_key(op_state, 0), op_state->sort_order))
+            continue;
+        top_n_copy_row(rel, op_state->heap[0], batch, row_i);
+        top_n_sift_down(op_state, 0);
+    }
+}
+
+void top_n_op_open(void *state)
+{
+    top_n_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+
+    if (op_state->limit == 0)
+        return;
+
+    /* Keep the best tuples of the source, batch by batch */
+    source->open(source->state);
+    batch_t *batch = NULL;
+    while((batch = source->next_batch(source->state))) {
+        if (!op_state->tmp_relation) {
+            op_state->tmp_relation = relation_create_for_batch(batch);
+            assert(op_state->tmp_relation);
+            op_state->tmp_relation_scan_op = scan_op_create(op_state->arena, op_state->tmp_relation);
+        }
+        top_n_add_batch(op_state, batch);
+    }
+    source->close(source->state);
+
+    /* Nothing to sort */
+    if (!op_state->tmp_relation)
+        return;
+
+    /* Sort the tuples kept */
+    relation_order_by(op_state->tmp_relation, op_state->sort_attr_i, op_state->sort_order);
+
+    /* Open a scan op on them */
+    op_state->tmp_relation_scan_op->open(op_state->tmp_relation_scan_op->state);
+}
+
+tuple_t *top_n_op_next(void *state)
+{
+    top_n_op_state_t *op_state = (typeof(op_state)) state;
+    if (!op_state->tmp_relation)
+        return NULL;
+    return op_state->tmp_relation_scan_op->next(op_state->tmp_relation_scan_op->state);
+}
+
+batch_t *top_n_op_next_batch(void *state)
+{
+    top_n_op_state_t *op_state = (typeof(op_state)) state;
+    if (!op_state->tmp_relation)
+        return NULL;
+    return op_state->tmp_relation_scan_op->next_batch(op_state->tmp_relation_scan_op->state);
+}
+
+void top_n_op_close(void *state)
+{
+    top_n_op_state_t *op_state = (typeof(op_state)) state;
+    /* If there was a tmp relation - destroy it */
+    if (op_state->tmp_relation) {
+        op_state->tmp_relation_scan_op->close(op_state->tmp_relation_scan_op->state);
+        scan_op_destroy(op_state->tmp_relation_scan_op);
+        relation_destroy(op_state->tmp_relation);
+        op_state->tmp_relation = NULL;
+    }
+    free(op_state->heap);
+    op_state->heap = NULL;
+    op_state->heap_slots = 0;
+}
+
+void top_n_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    top_n_op_state_t *op_state = operator->state;
+    op_state->source->destroy(op_state->source);
+
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *top_n_op_create(arena_t *arena,
+                            operator_t *source,
+                            const uint16_t sort_attr_i,
+                            const sort_order_t order,
+                            const uint32_t limit)
+{
+    assert(source);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    top_n_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->source = source;
+    state->sort_order = order;
+    state->sort_attr_i = sort_attr_i;
+    state->limit = limit;
+    op->state = state;
+
+    op->open = top_n_op_open;
+    op->next = top_n_op_next;
+    op->next_batch = top_n_op_next_batch;
+    op->close = top_n_op_close;
+    op->destroy = top_n_op_destroy;
+
+    return op;
+
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Limit operator */
+
+typedef struct limit_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    operator_t *source;
+    uint32_t limit;
+    uint32_t offset;
+
+    /* Tuples skipped and returned so far */
+    uint32_t skipped_num;
+    uint32_t returned_num;
+    /* Is the source still open? */
+    bool source_open;
+
+    /* A limited batch referencing source batch columns */
+    batch_t *current_batch;
+} limit_op_state_t;
+
+void limit_op_open(void *state)
+{
+    limit_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    source->open(source->state);
+
+    op_state->skipped_num = 0;
+    op_state->returned_num = 0;
+    op_state->source_open = true;
+}
+
+/* Stop pulling from the source once the limit is reached, after the last batch was consumed */
+static bool limit_op_done(limit_op_state_t *op_state)
+{
+    if (!op_state->source_open)
+        return true;
+    if (op_state->returned_num < op_state->limit)
+        return false;
+
+    operator_t *source = op_state->source;
+    source->close(source->state);
+    op_state->source_open = false;
+    return true;
+}
+
+tuple_t *limit_op_next(void *state)
+{
+    limit_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+
+    while (!limit_op_done(op_state)) {
+        tuple_t *tuple = source->next(source->state);
+        if (!tuple)
+            return NULL;
+
+        if (op_state->skipped_num < op_state->offset) {
+            op_state->skipped_num++;
+            continue;
+        }
+
+        op_state->returned_num++;
+        return tuple;
+    }
+
+    return NULL;
+}
+
+batch_t *limit_op_next_batch(void *state)
+{
+    limit_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+
+    while (!limit_op_done(op_state)) {
+        batch_t *source_batch = source->next_batch(source->state);
+        if (!source_batch)
+            return NULL;
+
+        /* Skip rows up to the offset, then take rows up to the limit */
+        uint16_t skip_num = source_batch->sel_num;
+        if (op_state->offset - op_state->skipped_num < skip_num)
+            skip_num = (uint16_t)(op_state->offset - op_state->skipped_num);
+        op_state->skipped_num += skip_num;
+
+        uint16_t take_num = source_batch->sel_num - skip_num;
+        if (op_state->limit - op_state->returned_num < take_num)
+            take_num = (uint16_t)(op_state->limit - op_state->returned_num);
+        if (take_num == 0)
+            continue;
+        op_state->returned_num += take_num;
+
+        batch_t *batch = op_state->current_batch;
+        if (!batch) {
+            batch = batch_create(op_state->arena, source_batch->attr_num, false);
+            assert(batch);
+            op_state->current_batch = batch;
+        }
+        for (size_t attr_i = 0; attr_i < batch->attr_num; attr_i++) {
+            batch->attr_names[attr_i] = source_batch->attr_names[attr_i];
+            batch->columns[attr_i] = source_batch->columns[attr_i];
+            batch->high_columns[attr_i] = source_batch->high_columns[attr_i];
+        }
+        batch->row_num = source_batch->row_num;
+        batch->sel = &source_batch->sel[skip_num];
+        batch->sel_num = take_num;
+
+        return batch;
+    }
+
+    return NULL;
+}
+
+void limit_op_close(void *state)
+{
+    limit_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    if (op_state->source_open)
+        source->close(source->state);
+    op_state->source_open = false;
+}
+
+void limit_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    limit_op_state_t *op_state = operator->state;
+    op_state->source->destroy(op_state->source);
+
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *limit_op_create(arena_t *arena,
+                            operator_t *source,
+                            const uint32_t limit,
+                            const uint32_t offset)
+{
+    assert(source);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
 
-    proj_op_state_t *state = calloc(1, sizeof(*state));
+    limit_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
     if (!state)
         goto state_fail;
 
-    state->current_tuple.tag = TUPLE_PROJECT;
+    state->arena = arena;
     state->source = source;
+    state->limit = limit;
+    state->offset = offset;
     op->state = state;
 
-    state->current_tuple.as.project.attr_num = attr_num;
-    for (size_t i = 0; i < attr_num; ++i)
-        strncpy(state->current_tuple.as.project.attr_names[i], attr_names[i], MAX_ATTR_NAME_LEN);
+    op->open = limit_op_open;
+    op->next = limit_op_next;
+    op->next_batch = limit_op_next_batch;
+    op->close = limit_op_close;
+    op->destroy = limit_op_destroy;
 
-    op->open = proj_op_open;
-    op->next = proj_op_next;
-    op->close = proj_op_close;
-    op->destroy = proj_op_destroy;
+    return op;
+
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
+}
+
+/* Aggregation operators */
+
+/* Accumulators of groups with no tuples aggregated yet */
+static uint64_t aggregate_acc_init(const aggregate_func_t func)
+{
+    switch (func) {
+    case AGGREGATE_COUNT:
+    case AGGREGATE_SUM:
+    case AGGREGATE_MAX:
+        return 0;
+    case AGGREGATE_MIN:
+        return UINT64_MAX;
+    }
+    assert(false);
+}
+
+static void aggregate_accs_init(uint64_t *accs, const aggregate_t *aggregates, const uint16_t aggregate_num)
+{
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++)
+        accs[aggregate_i] = aggregate_acc_init(aggregates[aggregate_i].func);
+}
+
+/* Ungrouped aggregates of no tuples at all still make a group if they are all counts. Sums, minimums
+ * and maximums of nothing have no value, so there's no group of them. */
+static bool aggregate_has_empty_group(const uint16_t group_attr_num, const aggregate_t *aggregates,
+                                      const uint16_t aggregate_num)
+{
+    if (group_attr_num > 0)
+        return false;
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++)
+        if (aggregates[aggregate_i].func != AGGREGATE_COUNT)
+            return false;
+    return true;
+}
+
+/* Sums and counts grow past values aggregated, so they are returned as 64-bit attributes */
+static inline bool aggregate_is_wide(const aggregate_func_t func)
+{
+    return func == AGGREGATE_COUNT || func == AGGREGATE_SUM;
+}
+
+/* Add rows of a batch to accumulators of their groups, accumulators of a group next to each other.
+ * Aggregates are added one at a time, so loops over rows stay tight. */
+static void aggregate_add_rows(const aggregate_t *aggregates, const uint16_t aggregate_num, uint64_t *accs,
+                               const batch_t *batch, const uint16_t *sel, const uint16_t sel_num,
+                               const uint32_t *group_is)
+{
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++) {
+        const aggregate_t *aggregate = &aggregates[aggregate_i];
+        uint64_t *aggregate_accs = &accs[aggregate_i];
+        if (aggregate->func == AGGREGATE_COUNT) {
+            for (uint16_t sel_i = 0; sel_i < sel_num; sel_i++)
+                aggregate_accs[(size_t)group_is[sel_i] * aggregate_num]++;
+            continue;
+        }
+
+        const value_type_t *column = batch->columns[aggregate->attr_i];
+        switch (aggregate->func) {
+        case AGGREGATE_SUM:
+            for (uint16_t sel_i = 0; sel_i < sel_num; sel_i++)
+                aggregate_accs[(size_t)group_is[sel_i] * aggregate_num] += column[sel[sel_i]];
+            break;
+        case AGGREGATE_MIN:
+            for (uint16_t sel_i = 0; sel_i < sel_num; sel_i++) {
+                uint64_t *acc = &aggregate_accs[(size_t)group_is[sel_i] * aggregate_num];
+                if (column[sel[sel_i]] < *acc)
+                    *acc = column[sel[sel_i]];
+            }
+            break;
+        case AGGREGATE_MAX:
+            for (uint16_t sel_i = 0; sel_i < sel_num; sel_i++) {
+                uint64_t *acc = &aggregate_accs[(size_t)group_is[sel_i] * aggregate_num];
+                if (column[sel[sel_i]] > *acc)
+                    *acc = column[sel[sel_i]];
+            }
+            break;
+        case AGGREGATE_COUNT:
+            assert(false);
+        }
+    }
+}
+
+/* Same for rows all belonging to a single group */
+static void aggregate_add_group_rows(const aggregate_t *aggregates, const uint16_t aggregate_num, uint64_t *accs,
+                                     const batch_t *batch, const uint16_t *sel, const uint16_t sel_num)
+{
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++) {
+        const aggregate_t *aggregate = &aggregates[aggregate_i];
+        if (aggregate->func == AGGREGATE_COUNT) {
+            accs[aggregate_i] += sel_num;
+            continue;
+        }
+
+        const value_type_t *column = batch->columns[aggregate->attr_i];
+        uint64_t acc = accs[aggregate_i];
+        switch (aggregate->func) {
+        case AGGREGATE_SUM:
+            for (uint16_t sel_i = 0; sel_i < sel_num; sel_i++)
+                acc += column[sel[sel_i]];
+            break;
+        case AGGREGATE_MIN:
+            for (uint16_t sel_i = 0; sel_i < sel_num; sel_i++)
+                acc = column[sel[sel_i]] < acc ? column[sel[sel_i]] : acc;
+            break;
+        case AGGREGATE_MAX:
+            for (uint16_t sel_i = 0; sel_i < sel_num; sel_i++)
+                acc = column[sel[sel_i]] > acc ? column[sel[sel_i]] : acc;
+            break;
+        case AGGREGATE_COUNT:
+            assert(false);
+        }
+        accs[aggregate_i] = acc;
+    }
+}
+
+/* Attribute names of aggregation results: group attributes of the source followed by aggregates */
+static const char **aggregate_names_create(arena_t *arena, const uint16_t group_attr_num,
+                                           const aggregate_t *aggregates, const uint16_t aggregate_num)
+{
+    const char **names = arena_calloc(arena, group_attr_num + aggregate_num, sizeof(const char *));
+    if (!names)
+        return NULL;
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++)
+        names[group_attr_num + aggregate_i] = aggregates[aggregate_i].name;
+    return names;
+}
+
+/*
+ * Tuples of operators returning batches of their own: batches are materialized into a relation a
+ * batch at a time and tuples of the relation are returned
+ *  */
+
+typedef struct batch_tuples_t {
+    relation_t *result;
+    uint32_t next_tuple_i;
+    tuple_t tuple;
+} batch_tuples_t;
+
+static void batch_tuples_reset(batch_tuples_t *tuples)
+{
+    if (tuples->result)
+        tuples->result->tuple_num = 0;
+    tuples->next_tuple_i = 0;
+}
+
+static tuple_t *batch_tuples_next(batch_tuples_t *tuples, const op_next_batch next_batch, void *state)
+{
+    relation_t *result = tuples->result;
+    if (!result || tuples->next_tuple_i == result->tuple_num) {
+        batch_t *batch = next_batch(state);
+        if (!batch)
+            return NULL;
+
+        if (!result) {
+            result = relation_create_for_batch(batch);
+            assert(result);
+            tuples->result = result;
+        }
+        result->tuple_num = 0;
+        relation_append_batch(result, batch);
+        tuples->next_tuple_i = 0;
+    }
+
+    tuples->tuple.tag = TUPLE_SOURCE;
+    tuples->tuple.as.source.relation = result;
+    tuples->tuple.as.source.tuple_i = tuples->next_tuple_i++;
+    return &tuples->tuple;
+}
+
+static void batch_tuples_destroy(batch_tuples_t *tuples)
+{
+    relation_destroy(tuples->result);
+}
+
+/* Hash aggregation operator */
+
+typedef struct hash_aggregate_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    operator_t *source;
+    uint16_t *group_attr_is;
+    uint16_t group_attr_num;
+    aggregate_t *aggregates;
+    uint16_t aggregate_num;
+    /* Names of result attributes, group attribute names are taken from source batches */
+    const char **names;
+
+    /* Values of group attributes and accumulators of groups, a group after another */
+    value_type_t *group_keys;
+    uint64_t *group_accs;
+    uint32_t *group_hashes;
+    uint32_t group_num;
+    uint32_t group_slots;
+    /* Open addressing with linear probing over group indices plus one, kept at most half full */
+    uint32_t *table;
+    uint32_t table_slot_num;
+    /* Group of every row of a source batch */
+    uint32_t group_is[BATCH_SIZE];
+
+    /* Temporary relation keeping results */
+    relation_t *tmp_relation;
+    /* Relation scan op */
+    operator_t *tmp_relation_scan_op;
+} hash_aggregate_op_state_t;
+
+static inline uint32_t aggregate_hash(const batch_t *batch, const uint16_t *group_attr_is,
+                                      const uint16_t group_attr_num, const uint16_t row_i)
+{
+    /* Multiplicative hashing of values mixed in one by one, higher bits are better mixed */
+    uint64_t hash = 0;
+    for (uint16_t attr_i = 0; attr_i < group_attr_num; attr_i++)
+        hash = (hash ^ batch->columns[group_attr_is[attr_i]][row_i]) * 0x9e3779b97f4a7c15ull;
+    return (uint32_t)(hash >> 32);
+}
+
+static void hash_aggregate_grow_table(hash_aggregate_op_state_t *op_state)
+{
+    const uint32_t slot_num = op_state->table_slot_num ? op_state->table_slot_num * 2 : 2 * BATCH_SIZE;
+    uint32_t *table = calloc(slot_num, sizeof(uint32_t));
+    assert(table);
+
+    for (uint32_t group_i = 0; group_i < op_state->group_num; group_i++) {
+        uint32_t slot_i = op_state->group_hashes[group_i] & (slot_num - 1);
+        while (table[slot_i])
+            slot_i = (slot_i + 1) & (slot_num - 1);
+        table[slot_i] = group_i + 1;
+    }
+
+    free(op_state->table);
+    op_state->table = table;
+    op_state->table_slot_num = slot_num;
+}
+
+static uint32_t hash_aggregate_add_group(hash_aggregate_op_state_t *op_state, const batch_t *batch,
+                                         const uint16_t row_i, const uint32_t hash)
+{
+    const uint16_t group_attr_num = op_state->group_attr_num;
+    const uint16_t aggregate_num = op_state->aggregate_num;
+    if (op_state->group_num == op_state->group_slots) {
+        const uint32_t group_slots = op_state->group_slots ? op_state->group_slots * 2 : BATCH_SIZE;
+        op_state->group_keys = realloc(op_state->group_keys, (size_t)group_slots * (group_attr_num + 1) * sizeof(value_type_t));
+        op_state->group_accs = realloc(op_state->group_accs, (size_t)group_slots * (aggregate_num + 1) * sizeof(uint64_t));
+        op_state->group_hashes = realloc(op_state->group_hashes, (size_t)group_slots * sizeof(uint32_t));
+        assert(op_state->group_keys && op_state->group_accs && op_state->group_hashes);
+        op_state->group_slots = group_slots;
+    }
+
+    const uint32_t group_i = op_state->group_num++;
+    value_type_t *keys = &op_state->group_keys[(size_t)group_i * group_attr_num];
+    for (uint16_t attr_i = 0; attr_i < group_attr_num; attr_i++)
+        keys[attr_i] = batch ? batch->columns[op_state->group_attr_is[attr_i]][row_i] : 0;
+    aggregate_accs_init(&op_state->group_accs[(size_t)group_i * aggregate_num], op_state->aggregates, aggregate_num);
+    op_state->group_hashes[group_i] = hash;
+    return group_i;
+}
+
+/* Group of a row, a new group if there's none yet */
+static uint32_t hash_aggregate_find_group(hash_aggregate_op_state_t *op_state, const batch_t *batch,
+                                          const uint16_t row_i)
+{
+    const uint16_t *group_attr_is = op_state->group_attr_is;
+    const uint16_t group_attr_num = op_state->group_attr_num;
+    const uint32_t hash = aggregate_hash(batch, group_attr_is, group_attr_num, row_i);
+    const uint32_t slot_mask = op_state->table_slot_num - 1;
+    uint32_t slot_i = hash & slot_mask;
+    for (; op_state->table[slot_i]; slot_i = (slot_i + 1) & slot_mask) {
+        const uint32_t group_i = op_state->table[slot_i] - 1;
+        if (op_state->group_hashes[group_i] != hash)
+            continue;
+
+        const value_type_t *keys = &op_state->group_keys[(size_t)group_i * group_attr_num];
+        uint16_t attr_i = 0;
+        while (attr_i < group_attr_num && keys[attr_i] == batch->columns[group_attr_is[attr_i]][row_i])
+            attr_i++;
+        if (attr_i == group_attr_num)
+            return group_i;
+    }
+
+    const uint32_t group_i = hash_aggregate_add_group(op_state, batch, row_i, hash);
+    op_state->table[slot_i] = group_i + 1;
+    return group_i;
+}
+
+static void hash_aggregate_add_batch(hash_aggregate_op_state_t *op_state, const batch_t *batch)
+{
+    /* Room for every row making a group of its own, so the table never grows while rows are looked up */
+    while ((op_state->group_num + batch->sel_num) * 2 > op_state->table_slot_num)
+        hash_aggregate_grow_table(op_state);
+
+    for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++)
+        op_state->group_is[sel_i] = hash_aggregate_find_group(op_state, batch, batch->sel[sel_i]);
+    aggregate_add_rows(op_state->aggregates, op_state->aggregate_num, op_state->group_accs,
+                       batch, batch->sel, batch->sel_num, op_state->group_is);
+}
+
+void hash_aggregate_op_open(void *state)
+{
+    hash_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    const uint16_t group_attr_num = op_state->group_attr_num;
+    const uint16_t aggregate_num = op_state->aggregate_num;
+
+    /* Aggregate the source, batch by batch */
+    source->open(source->state);
+    batch_t *batch = NULL;
+    while((batch = source->next_batch(source->state))) {
+        for (uint16_t attr_i = 0; attr_i < group_attr_num; attr_i++)
+            op_state->names[attr_i] = batch->attr_names[op_state->group_attr_is[attr_i]];
+        hash_aggregate_add_batch(op_state, batch);
+    }
+    source->close(source->state);
+
+    /* Counts of no tuples at all are still returned */
+    if (op_state->group_num == 0 && aggregate_has_empty_group(group_attr_num, op_state->aggregates, aggregate_num))
+        hash_aggregate_add_group(op_state, NULL, 0, 0);
+
+    /* Nothing to return */
+    if (op_state->group_num == 0)
+        return;
+
+    /* Keep results in a relation */
+    bool is_wide[group_attr_num + aggregate_num];
+    for (uint16_t attr_i = 0; attr_i < group_attr_num; attr_i++)
+        is_wide[attr_i] = false;
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++)
+        is_wide[group_attr_num + aggregate_i] = aggregate_is_wide(op_state->aggregates[aggregate_i].func);
+    relation_t *rel = relation_create_wide(op_state->names, group_attr_num + aggregate_num, is_wide);
+    assert(rel);
+    op_state->tmp_relation = rel;
+    relation_reserve(rel, op_state->group_num);
+    value_type_t values[rel->attr_num];
+    for (uint32_t group_i = 0; group_i < op_state->group_num; group_i++) {
+        memcpy(values, &op_state->group_keys[(size_t)group_i * group_attr_num], group_attr_num * sizeof(value_type_t));
+        const uint64_t *accs = &op_state->group_accs[(size_t)group_i * aggregate_num];
+        for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++) {
+            const uint16_t attr_i = group_attr_num + aggregate_i;
+            values[attr_i] = (value_type_t)accs[aggregate_i];
+            if (is_wide[attr_i])
+                values[rel->high_attr_is[attr_i]] = (value_type_t)(accs[aggregate_i] >> 32);
+        }
+        relation_append_values(rel, values);
+    }
+
+    /* Open a scan op on them */
+    op_state->tmp_relation_scan_op = scan_op_create(op_state->arena, op_state->tmp_relation);
+    assert(op_state->tmp_relation_scan_op);
+    op_state->tmp_relation_scan_op->open(op_state->tmp_relation_scan_op->state);
+}
+
+tuple_t *hash_aggregate_op_next(void *state)
+{
+    hash_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    if (!op_state->tmp_relation)
+        return NULL;
+    return op_state->tmp_relation_scan_op->next(op_state->tmp_relation_scan_op->state);
+}
+
+batch_t *hash_aggregate_op_next_batch(void *state)
+{
+    hash_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    if (!op_state->tmp_relation)
+        return NULL;
+    return op_state->tmp_relation_scan_op->next_batch(op_state->tmp_relation_scan_op->state);
+}
+
+void hash_aggregate_op_close(void *state)
+{
+    hash_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    /* If there was a tmp relation - destroy it */
+    if (op_state->tmp_relation) {
+        op_state->tmp_relation_scan_op->close(op_state->tmp_relation_scan_op->state);
+        scan_op_destroy(op_state->tmp_relation_scan_op);
+        op_state->tmp_relation_scan_op = NULL;
+        relation_destroy(op_state->tmp_relation);
+        op_state->tmp_relation = NULL;
+    }
+
+    free(op_state->group_keys);
+    free(op_state->group_accs);
+    free(op_state->group_hashes);
+    free(op_state->table);
+    op_state->group_keys = NULL;
+    op_state->group_accs = NULL;
+    op_state->group_hashes = NULL;
+    op_state->table = NULL;
+    op_state->group_num = 0;
+    op_state->group_slots = 0;
+    op_state->table_slot_num = 0;
+}
+
+void hash_aggregate_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    hash_aggregate_op_state_t *op_state = operator->state;
+    op_state->source->destroy(op_state->source);
+
+    arena_t *arena = op_state->arena;
+    arena_free(arena, op_state->names);
+    arena_free(arena, op_state->aggregates);
+    arena_free(arena, op_state->group_attr_is);
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *hash_aggregate_op_create(arena_t *arena,
+                                     operator_t *source,
+                                     const uint16_t *group_attr_is,
+                                     const uint16_t group_attr_num,
+                                     const aggregate_t *aggregates,
+                                     const uint16_t aggregate_num)
+{
+    assert(source);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    hash_aggregate_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->source = source;
+    state->group_attr_num = group_attr_num;
+    state->aggregate_num = aggregate_num;
+    op->state = state;
+
+    /* At least a slot each, so empty arrays are not mistaken for failures */
+    state->group_attr_is = arena_calloc(arena, group_attr_num + 1, sizeof(uint16_t));
+    if (!state->group_attr_is)
+        goto group_attrs_fail;
+    if (group_attr_num > 0)
+        memcpy(state->group_attr_is, group_attr_is, group_attr_num * sizeof(uint16_t));
+
+    state->aggregates = arena_calloc(arena, aggregate_num + 1, sizeof(aggregate_t));
+    if (!state->aggregates)
+        goto aggregates_fail;
+    memcpy(state->aggregates, aggregates, aggregate_num * sizeof(aggregate_t));
+
+    state->names = aggregate_names_create(arena, group_attr_num, aggregates, aggregate_num);
+    if (!state->names)
+        goto names_fail;
+
+    op->open = hash_aggregate_op_open;
+    op->next = hash_aggregate_op_next;
+    op->next_batch = hash_aggregate_op_next_batch;
+    op->close = hash_aggregate_op_close;
+    op->destroy = hash_aggregate_op_destroy;
 
     return op;
 
+names_fail:
+    arena_free(arena, state->aggregates);
+aggregates_fail:
+    arena_free(arena, state->group_attr_is);
+group_attrs_fail:
+    arena_free(arena, state);
 state_fail:
-    free(op);
+    arena_free(arena, op);
 op_fail:
     return NULL;
 }
 
-/* Union operator */
+/* Streaming aggregation operator */
 
-typedef struct union_op_state_t {
-    /* Tuple sources to be united */
-    operator_t *left_source;
-    operator_t *right_source;
+typedef struct stream_aggregate_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    operator_t *source;
+    uint16_t *group_attr_is;
+    uint16_t group_attr_num;
+    aggregate_t *aggregates;
+    uint16_t aggregate_num;
+
+    /* The group being aggregated: values of group attributes and accumulators */
+    bool has_group;
+    value_type_t *group_keys;
+    uint64_t *group_accs;
+    /* Groups returned so far */
+    uint32_t group_num;
+
+    /* Source batch being aggregated and the next row of its selection vector */
+    batch_t *source_batch;
+    uint16_t next_sel_i;
+    bool is_source_done;
+
+    /* A batch owning result columns, and upper halves of 64-bit aggregates */
+    batch_t *current_batch;
+    value_type_t *high_values;
+    /* Batches are materialized when tuples are requested */
+    batch_tuples_t tuples;
+} stream_aggregate_op_state_t;
+
+void stream_aggregate_op_open(void *state)
+{
+    stream_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    source->open(source->state);
 
-    /* the current tuple source */
-    operator_t *current_source;
-} union_op_state_t;
+    op_state->has_group = false;
+    op_state->group_num = 0;
+    op_state->source_batch = NULL;
+    op_state->next_sel_i = 0;
+    op_state->is_source_done = false;
+    batch_tuples_reset(&op_state->tuples);
+}
 
-void union_op_open(void *state)
+static bool stream_aggregate_in_group(const stream_aggregate_op_state_t *op_state, const batch_t *batch,
+                                      const uint16_t row_i)
 {
-    union_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *left_source = op_state->left_source;
-    operator_t *right_source = op_state->right_source;
-    left_source->open(left_source->state);
-    right_source->open(right_source->state);
+    for (uint16_t attr_i = 0; attr_i < op_state->group_attr_num; attr_i++)
+        if (op_state->group_keys[attr_i] != batch->columns[op_state->group_attr_is[attr_i]][row_i])
+            return false;
+    return true;
+}
 
-    /* Begin with the left source */
-    op_state->current_source = left_source;
+static void stream_aggregate_start_group(stream_aggregate_op_state_t *op_state, const batch_t *batch,
+                                         const uint16_t row_i)
+{
+    for (uint16_t attr_i = 0; attr_i < op_state->group_attr_num; attr_i++)
+        op_state->group_keys[attr_i] = batch->columns[op_state->group_attr_is[attr_i]][row_i];
+    aggregate_accs_init(op_state->group_accs, op_state->aggregates, op_state->aggregate_num);
+    op_state->has_group = true;
 }
 
-tuple_t *union_op_next(void *state)
+static void stream_aggregate_end_group(stream_aggregate_op_state_t *op_state)
 {
-    union_op_state_t *op_state = (typeof(op_state)) state;
+    batch_t *batch = op_state->current_batch;
+    const uint16_t group_attr_num = op_state->group_attr_num;
+    op_state->has_group = false;
+
+    const uint16_t row_i = batch->row_num++;
+    for (uint16_t attr_i = 0; attr_i < group_attr_num; attr_i++)
+        batch->columns[attr_i][row_i] = op_state->group_keys[attr_i];
+    for (uint16_t aggregate_i = 0; aggregate_i < op_state->aggregate_num; aggregate_i++) {
+        const uint16_t attr_i = group_attr_num + aggregate_i;
+        const uint64_t acc = op_state->group_accs[aggregate_i];
+        batch->columns[attr_i][row_i] = (value_type_t)acc;
+        if (batch->high_columns[attr_i])
+            batch->high_columns[attr_i][row_i] = (value_type_t)(acc >> 32);
+    }
+    op_state->group_num++;
+}
 
-    operator_t *current_source = op_state->current_source;
-    tuple_t *next_source_tuple = current_source->next(current_source->state);
+batch_t *stream_aggregate_op_next_batch(void *state)
+{
+    stream_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    batch_t *batch = op_state->current_batch;
+
+    batch->row_num = 0;
+    while (batch->row_num < BATCH_SIZE && !op_state->is_source_done) {
+        batch_t *source_batch = op_state->source_batch;
+        if (!source_batch || op_state->next_sel_i == source_batch->sel_num) {
+            op_state->source_batch = source->next_batch(source->state);
+            op_state->next_sel_i = 0;
+            if (op_state->source_batch) {
+                for (uint16_t attr_i = 0; attr_i < op_state->group_attr_num; attr_i++)
+                    batch->attr_names[attr_i] = op_state->source_batch->attr_names[op_state->group_attr_is[attr_i]];
+                continue;
+            }
+
+            /* The last group ends with the source */
+            op_state->is_source_done = true;
+            if (!op_state->has_group && op_state->group_num == 0 &&
+                aggregate_has_empty_group(op_state->group_attr_num, op_state->aggregates, op_state->aggregate_num))
+                aggregate_accs_init(op_state->group_accs, op_state->aggregates, op_state->aggregate_num);
+            else if (!op_state->has_group)
+                break;
+            stream_aggregate_end_group(op_state);
+            break;
+        }
 
-    /* the left tuple source is exhausted: switch to the right source, reretrieve a tuple */
-    if (!next_source_tuple && current_source == op_state->left_source) {
-        op_state->current_source = op_state->right_source;
-        current_source = op_state->current_source;
+        const uint16_t *sel = source_batch->sel;
+        const uint16_t first_sel_i = op_state->next_sel_i;
+        if (!op_state->has_group) {
+            stream_aggregate_start_group(op_state, source_batch, sel[first_sel_i]);
+        } else if (!stream_aggregate_in_group(op_state, source_batch, sel[first_sel_i])) {
+            stream_aggregate_end_group(op_state);
+            continue;
+        }
 
-        next_source_tuple = current_source->next(current_source->state);
+        /* Rows of the group go one after another */
+        uint16_t end_sel_i = first_sel_i + 1;
+        while (end_sel_i < source_batch->sel_num && stream_aggregate_in_group(op_state, source_batch, sel[end_sel_i]))
+            end_sel_i++;
+        aggregate_add_group_rows(op_state->aggregates, op_state->aggregate_num, op_state->group_accs,
+                                 source_batch, &sel[first_sel_i], end_sel_i - first_sel_i);
+        op_state->next_sel_i = end_sel_i;
     }
 
-    return next_source_tuple;
+    if (batch->row_num == 0)
+        return NULL;
+    batch_sel_all(batch);
+    return batch;
 }
 
-void union_op_close(void *state)
+tuple_t *stream_aggregate_op_next(void *state)
 {
-    union_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *left_source = op_state->left_source;
-    operator_t *right_source = op_state->right_source;
-    left_source->close(left_source->state);
-    right_source->close(right_source->state);
+    stream_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    return batch_tuples_next(&op_state->tuples, stream_aggregate_op_next_batch, op_state);
+}
 
-    op_state->current_source = NULL;
+void stream_aggregate_op_close(void *state)
+{
+    stream_aggregate_op_state_t *op_state = (typeof(op_state)) state;
+    operator_t *source = op_state->source;
+    source->close(source->state);
 }
 
-void union_op_destroy(operator_t *operator)
+void stream_aggregate_op_destroy(operator_t *operator)
 {
     if (!operator)
         return;
 
-    union_op_state_t *op_state = operator->state;
-    op_state->left_source->destroy(op_state->left_source);
-    op_state->right_source->destroy(op_state->right_source);
+    stream_aggregate_op_state_t *op_state = operator->state;
+    op_state->source->destroy(op_state->source);
+    batch_tuples_destroy(&op_state->tuples);
+
+    arena_t *arena = op_state->arena;
+    batch_destroy(arena, op_state->current_batch);
+    arena_free(arena, op_state->high_values);
+    arena_free(arena, op_state->group_accs);
+    arena_free(arena, op_state->group_keys);
+    arena_free(arena, op_state->aggregates);
+    arena_free(arena, op_state->group_attr_is);
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *stream_aggregate_op_create(arena_t *arena,
+                                       operator_t *source,
+                                       const uint16_t *group_attr_is,
+                                       const uint16_t group_attr_num,
+                                       const aggregate_t *aggregates,
+                                       const uint16_t aggregate_num)
+{
+    assert(source);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
+    if (!op)
+        goto op_fail;
+
+    stream_aggregate_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
+    if (!state)
+        goto state_fail;
+
+    state->arena = arena;
+    state->source = source;
+    state->group_attr_num = group_attr_num;
+    state->aggregate_num = aggregate_num;
+    op->state = state;
+
+    /* At least a slot each, so empty arrays are not mistaken for failures */
+    state->group_attr_is = arena_calloc(arena, group_attr_num + 1, sizeof(uint16_t));
+    if (!state->group_attr_is)
+        goto group_attrs_fail;
+    if (group_attr_num > 0)
+        memcpy(state->group_attr_is, group_attr_is, group_attr_num * sizeof(uint16_t));
+
+    state->aggregates = arena_calloc(arena, aggregate_num + 1, sizeof(aggregate_t));
+    if (!state->aggregates)
+        goto aggregates_fail;
+    memcpy(state->aggregates, aggregates, aggregate_num * sizeof(aggregate_t));
+
+    state->group_keys = arena_calloc(arena, group_attr_num + 1, sizeof(value_type_t));
+    if (!state->group_keys)
+        goto keys_fail;
+
+    state->group_accs = arena_calloc(arena, aggregate_num + 1, sizeof(uint64_t));
+    if (!state->group_accs)
+        goto accs_fail;
+
+    state->current_batch = batch_create(arena, group_attr_num + aggregate_num, true);
+    if (!state->current_batch)
+        goto batch_fail;
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++)
+        state->current_batch->attr_names[group_attr_num + aggregate_i] = aggregates[aggregate_i].name;
+
+    state->high_values = arena_calloc(arena, (size_t)aggregate_num * BATCH_SIZE + 1, sizeof(value_type_t));
+    if (!state->high_values)
+        goto high_values_fail;
+    for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++)
+        if (aggregate_is_wide(aggregates[aggregate_i].func))
+            state->current_batch->high_columns[group_attr_num + aggregate_i] = &state->high_values[aggregate_i * BATCH_SIZE];
+
+    op->open = stream_aggregate_op_open;
+    op->next = stream_aggregate_op_next;
+    op->next_batch = stream_aggregate_op_next_batch;
+    op->close = stream_aggregate_op_close;
+    op->destroy = stream_aggregate_op_destroy;
 
-    free(operator->state);
-    free(operator);
+    return op;
+
+high_values_fail:
+    batch_destroy(arena, state->current_batch);
+batch_fail:
+    arena_free(arena, state->group_accs);
+accs_fail:
+    arena_free(arena, state->group_keys);
+keys_fail:
+    arena_free(arena, state->aggregates);
+aggregates_fail:
+    arena_free(arena, state->group_attr_is);
+group_attrs_fail:
+    arena_free(arena, state);
+state_fail:
+    arena_free(arena, op);
+op_fail:
+    return NULL;
 }
 
-operator_t *union_op_create(operator_t *left_source,
-                            operator_t *right_source)
+/* Tuple count operator */
+
+typedef struct count_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    const relation_t *relation;
+    /* Relations might grow between statements, so the number is read every time the op is opened */
+    uint32_t tuple_num;
+    bool is_done;
+
+    /* A batch owning the single row returned */
+    batch_t *current_batch;
+    /* Batches are materialized when tuples are requested */
+    batch_tuples_t tuples;
+} count_op_state_t;
+
+void count_op_open(void *state)
 {
-    assert(left_source && right_source);
+    count_op_state_t *op_state = (typeof(op_state)) state;
+    op_state->tuple_num = op_state->relation->tuple_num;
+    op_state->is_done = false;
+    batch_tuples_reset(&op_state->tuples);
+}
+
+batch_t *count_op_next_batch(void *state)
+{
+    count_op_state_t *op_state = (typeof(op_state)) state;
+    if (op_state->is_done)
+        return NULL;
+    op_state->is_done = true;
+
+    batch_t *batch = op_state->current_batch;
+    for (uint16_t attr_i = 0; attr_i < batch->attr_num; attr_i++)
+        batch->columns[attr_i][0] = op_state->tuple_num;
+    batch->row_num = 1;
+    batch_sel_all(batch);
+    return batch;
+}
+
+tuple_t *count_op_next(void *state)
+{
+    count_op_state_t *op_state = (typeof(op_state)) state;
+    return batch_tuples_next(&op_state->tuples, count_op_next_batch, op_state);
+}
+
+void count_op_close(void *state)
+{
+    (void) state;
+}
+
+void count_op_destroy(operator_t *operator)
+{
+    if (!operator)
+        return;
+
+    count_op_state_t *op_state = operator->state;
+    batch_tuples_destroy(&op_state->tuples);
+
+    arena_t *arena = op_state->arena;
+    batch_destroy(arena, op_state->current_batch);
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
+
+operator_t *count_op_create(arena_t *arena,
+                            const relation_t *relation,
+                            const char *const *attr_names,
+                            const uint16_t attr_num)
+{
+    assert(relation);
 
-    operator_t *op = calloc(1, sizeof(*op));
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
     if (!op)
         goto op_fail;
 
-    union_op_state_t *state = calloc(1, sizeof(*state));
+    count_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
     if (!state)
         goto state_fail;
 
-    state->left_source = left_source;
-    state->right_source = right_source;
+    state->arena = arena;
+    state->relation = relation;
     op->state = state;
 
-    op->open = union_op_open;
-    op->next = union_op_next;
-    op->close = union_op_close;
-    op->destroy = union_op_destroy;
+    state->current_batch = batch_create(arena, attr_num, true);
+    if (!state->current_batch)
+        goto batch_fail;
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        state->current_batch->attr_names[attr_i] = attr_names[attr_i];
+
+    op->open = count_op_open;
+    op->next = count_op_next;
+    op->next_batch = count_op_next_batch;
+    op->close = count_op_close;
+    op->destroy = count_op_destroy;
 
     return op;
 
+batch_fail:
+    arena_free(arena, state);
 state_fail:
-    free(op);
+    arena_free(arena, op);
 op_fail:
     return NULL;
 }
 
-/* Join operator */
-
-typedef struct join_op_state_t {
-    /* Tuple sources to be joined */
-    operator_t *left_source;
-    operator_t *right_source;
+/* Compiled pipeline operator */
 
-    /* Current left source tuple to be joined with right source tuples */
-    tuple_t *current_left_tuple;
+typedef struct compiled_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Relation scanned and the function running the pipeline over it */
+    const relation_t *relation;
+    compiled_pipeline_fn pipeline_fn;
+    value_type_t *constants;
+    /* Parameters constants are read from when opening, NULL for fixed constants */
+    const value_type_t **params;
+    uint16_t constant_num;
+    uint16_t *out_attr_is;
+    uint16_t out_attr_num;
+
+    /* Base pointers of relation attributes, taken when opening */
+    const value_type_t **attr_values;
+    uint32_t stride;
+    uint32_t next_tuple_i;
 
-    /* Joined tuple to be returned */
+    /* A batch owning output columns */
+    batch_t *current_batch;
+    /* Batches are materialized when tuples are requested */
+    relation_t *current_result;
+    uint32_t next_result_tuple_i;
     tuple_t current_tuple;
-} join_op_state_t;
+} compiled_op_state_t;
 
-void join_op_open(void *state)
+void compiled_op_open(void *state)
 {
-    join_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *left_source = op_state->left_source;
-    operator_t *right_source = op_state->right_source;
-    left_source->open(left_source->state);
-    right_source->open(right_source->state);
+    compiled_op_state_t *op_state = (typeof(op_state)) state;
+    const relation_t *rel = op_state->relation;
+
+    for (uint16_t constant_i = 0; constant_i < op_state->constant_num; constant_i++)
+        if (op_state->params[constant_i])
+            op_state->constants[constant_i] = *op_state->params[constant_i];
+
+    /* Relations might grow between statements, so pointers are taken every time */
+    for (uint16_t attr_i = 0; attr_i < rel->attr_num; attr_i++)
+        op_state->attr_values[attr_i] = rel->tuples ? relation_value_ptr(rel, 0, attr_i) : NULL;
+    op_state->stride = rel->layout == LAYOUT_COLUMNS ? 1 : rel->attr_num;
+    op_state->next_tuple_i = 0;
+
+    if (op_state->current_result)
+        op_state->current_result->tuple_num = 0;
+    op_state->next_result_tuple_i = 0;
 }
 
-tuple_t *join_op_next(void *state)
+batch_t *compiled_op_next_batch(void *state)
 {
-    join_op_state_t *op_state = (typeof(op_state)) state;
+    compiled_op_state_t *op_state = (typeof(op_state)) state;
+    batch_t *batch = op_state->current_batch;
+
+    /* Functions only stop early when output columns are full */
+    const uint16_t row_num = op_state->pipeline_fn(op_state->attr_values, op_state->stride, op_state->constants,
+                                                   &op_state->next_tuple_i, op_state->relation->tuple_num,
+                                                   batch->columns);
+    if (row_num == 0)
+        return NULL;
 
-    operator_t *left_source = op_state->left_source;
-    operator_t *right_source = op_state->right_source;
-    tuple_join_t *join_tuple = &op_state->current_tuple.as.join;
+    batch->row_num = row_num;
+    batch_sel_all(batch);
+    return batch;
+}
 
-    /* Nothing in the left source? See if we can get one more tuple */
-    if (!join_tuple->left_source_tuple) {
-        join_tuple->left_source_tuple = left_source->next(left_source->state);
-        /* Still nothing? Done joining */
-        if (!join_tuple->left_source_tuple)
-            return NULL;
-    }
+tuple_t *compiled_op_next(void *state)
+{
+    compiled_op_state_t *op_state = (typeof(op_state)) state;
 
-    join_tuple->right_source_tuple = right_source->next(right_source->state);
-    /* No more tuples in the right source? Get the next left source tuple and reset the right source
-     * operator */
-    if (!join_tuple->right_source_tuple) {
-        join_tuple->left_source_tuple = left_source->next(left_source->state);
-        /* Nothing in the left tuple? Done joining */
-        if (!join_tuple->left_source_tuple)
+    relation_t *result = op_state->current_result;
+    if (!result || op_state->next_result_tuple_i == result->tuple_num) {
+        batch_t *batch = compiled_op_next_batch(op_state);
+        if (!batch)
             return NULL;
 
-        /* reset the right source */
-        right_source->close(right_source->state);
-        right_source->open(right_source->state);
-        join_tuple->right_source_tuple = right_source->next(right_source->state);
-        /* We've resetted the right source and there's nothing - empty relation */
-        if (!join_tuple->right_source_tuple)
-            return NULL;
+        if (!result) {
+            result = relation_create_for_batch(batch);
+            assert(result);
+            op_state->current_result = result;
+        }
+        result->tuple_num = 0;
+        relation_append_batch(result, batch);
+        op_state->next_result_tuple_i = 0;
     }
 
+    tuple_source_t *source_tuple = &op_state->current_tuple.as.source;
+    source_tuple->relation = result;
+    source_tuple->tuple_i = op_state->next_result_tuple_i++;
+
     return &op_state->current_tuple;
 }
 
-void join_op_close(void *state)
+void compiled_op_close(void *state)
 {
-    join_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *left_source = op_state->left_source;
-    operator_t *right_source = op_state->right_source;
-    left_source->close(left_source->state);
-    right_source->close(right_source->state);
-
-    op_state->current_tuple.as.join.left_source_tuple = NULL;
-    op_state->current_tuple.as.join.right_source_tuple = NULL;
+    (void) state;
 }
 
-void join_op_destroy(operator_t *operator)
+void compiled_op_destroy(operator_t *operator)
 {
     if (!operator)
         return;
 
-    join_op_state_t *op_state = operator->state;
-    op_state->left_source->destroy(op_state->left_source);
-    op_state->right_source->destroy(op_state->right_source);
-
-    free(operator->state);
-    free(operator);
+    compiled_op_state_t *op_state = operator->state;
+    relation_destroy(op_state->current_result);
+
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, op_state->attr_values);
+    arena_free(arena, op_state->out_attr_is);
+    arena_free(arena, op_state->params);
+    arena_free(arena, op_state->constants);
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
 }
 
-operator_t *join_op_create(operator_t *left_source,
-                           operator_t *right_source)
+operator_t *compiled_op_create(arena_t *arena,
+                               const relation_t *relation,
+                               const compiled_pipeline_fn pipeline_fn,
+                               const value_type_t *constants,
+                               const uint16_t constant_num,
+                               const uint16_t *out_attr_is,
+                               const uint16_t out_attr_num)
 {
-    assert(left_source && right_source);
-    operator_t *op = calloc(1, sizeof(*op));
+    assert(relation && pipeline_fn);
+
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
     if (!op)
         goto op_fail;
 
-    join_op_state_t *state = calloc(1, sizeof(*state));
+    compiled_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
     if (!state)
         goto state_fail;
 
-    state->left_source = left_source;
-    state->right_source = right_source;
-    state->current_tuple.tag = TUPLE_JOIN;
+    state->arena = arena;
+    state->relation = relation;
+    state->pipeline_fn = pipeline_fn;
+    state->constant_num = constant_num;
+    state->out_attr_num = out_attr_num;
+    state->current_tuple.tag = TUPLE_SOURCE;
     op->state = state;
 
-    op->open = join_op_open;
-    op->next = join_op_next;
-    op->close = join_op_close;
-    op->destroy = join_op_destroy;
+    /* At least a slot each, so empty arrays are not mistaken for failures */
+    state->constants = arena_calloc(arena, constant_num + 1, sizeof(value_type_t));
+    if (!state->constants)
+        goto constants_fail;
+    memcpy(state->constants, constants, constant_num * sizeof(value_type_t));
+
+    state->params = arena_calloc(arena, constant_num + 1, sizeof(value_type_t *));
+    if (!state->params)
+        goto params_fail;
+
+    state->out_attr_is = arena_calloc(arena, out_attr_num + 1, sizeof(uint16_t));
+    if (!state->out_attr_is)
+        goto out_attrs_fail;
+    memcpy(state->out_attr_is, out_attr_is, out_attr_num * sizeof(uint16_t));
+
+    state->attr_values = arena_calloc(arena, relation->attr_num + 1, sizeof(value_type_t *));
+    if (!state->attr_values)
+        goto attr_values_fail;
+
+    state->current_batch = batch_create(arena, out_attr_num, true);
+    if (!state->current_batch)
+        goto batch_fail;
+    for (uint16_t attr_i = 0; attr_i < out_attr_num; attr_i++)
+        state->current_batch->attr_names[attr_i] = relation->attr_names[out_attr_is[attr_i]];
+
+    op->open = compiled_op_open;
+    op->next = compiled_op_next;
+    op->next_batch = compiled_op_next_batch;
+    op->close = compiled_op_close;
+    op->destroy = compiled_op_destroy;
 
     return op;
 
+batch_fail:
+    arena_free(arena, state->attr_values);
+attr_values_fail:
+    arena_free(arena, state->out_attr_is);
+out_attrs_fail:
+    arena_free(arena, state->params);
+params_fail:
+    arena_free(arena, state->constants);
+constants_fail:
+    arena_free(arena, state);
 state_fail:
-    free(op);
+    arena_free(arena, op);
 op_fail:
     return NULL;
 }
 
-/* Select operator */
-
-#define MAX_SELECT_PREDICATE_NUM 16
-
-typedef enum select_predicate_tag {
-    SELECT_ATTR_CONST,
-    SELECT_ATTR_ATTR,
-} select_predicate_tag;
+void compiled_op_set_param(operator_t *operator, const uint16_t constant_i, const value_type_t *param)
+{
+    compiled_op_state_t *op_state = (typeof(op_state)) operator->state;
+    assert(constant_i < op_state->constant_num && param);
+    op_state->params[constant_i] = param;
+    op_state->constants[constant_i] = *param;
+}
 
-typedef struct select_predicate_t {
-    select_predicate_tag tag;
-    select_predicate_op op;
-    union {
-        struct {
-            attr_name_t left_attr_name;
-            value_type_t right_constant;
-        } attr_const;
-        struct {
-            attr_name_t left_attr_name;
-            attr_name_t right_attr_name;
-        } attr_attr;
-    } as;
-} select_predicate_t;
+/* Gather operator */
 
-typedef struct select_op_state_t {
-    /* Tuple source to apply filters to */
-    operator_t *source;
-    select_predicate_t predicates[MAX_SELECT_PREDICATE_NUM];
-    size_t predicate_num;
-} select_op_state_t;
+static uint16_t gather_worker_num;
+/* Workers shared by all the gather operators */
+static pool_t *gather_pool;
 
-void select_op_open(void *state)
+void gather_op_set_worker_num(const uint16_t worker_num)
 {
-    select_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *source = op_state->source;
-    source->open(source->state);
+    assert(worker_num > 0);
+    gather_worker_num = worker_num;
 }
 
-static bool op_compare_values(select_predicate_op op, value_type_t left_value, value_type_t right_value)
+uint16_t gather_op_get_worker_num(void)
 {
-    switch(op) {
-    case SELECT_GT:
-        return left_value > right_value;
-    case SELECT_LT:
-        return left_value < right_value;
-    case SELECT_EQ:
-        return left_value == right_value;
-    }
-    assert(false);
+    /* All the CPUs by default */
+    if (!gather_worker_num)
+        gather_worker_num = pool_cpu_num();
+    return gather_worker_num;
 }
 
-static bool tuple_satisfies_predicate(tuple_t *tuple, select_predicate_t *predicate)
+/* The pool is recreated when operators need some other number of workers */
+static pool_t *gather_get_pool(const uint16_t worker_num)
 {
-    value_type_t left_value, right_value;
-    if (predicate->tag == SELECT_ATTR_CONST) {
-        left_value = tuple_get_attr_value(tuple, predicate->as.attr_const.left_attr_name);
-        right_value = predicate->as.attr_const.right_constant;
-    } else if (predicate->tag == SELECT_ATTR_ATTR) {
-        left_value = tuple_get_attr_value(tuple, predicate->as.attr_attr.left_attr_name);
-        right_value = tuple_get_attr_value(tuple, predicate->as.attr_attr.right_attr_name);
-    } else {
-        assert(false);
+    if (gather_pool && pool_get_worker_num(gather_pool) != worker_num) {
+        pool_destroy(gather_pool);
+        gather_pool = NULL;
     }
-    return op_compare_values(predicate->op, left_value, right_value);
+    if (!gather_pool)
+        gather_pool = pool_create(worker_num);
+    assert(gather_pool);
+    return gather_pool;
 }
 
-static bool tuple_satisfies_predicates(tuple_t *tuple, select_predicate_t predicates[], size_t predicate_num)
+pool_t *gather_op_get_pool(void)
 {
-    for (size_t pred_i = 0; pred_i < predicate_num; ++pred_i)
-        if (!tuple_satisfies_predicate(tuple, &predicates[pred_i]))
-            return false;
-    return true;
+    return gather_get_pool(gather_op_get_worker_num());
 }
 
-tuple_t *select_op_next(void *state)
-{
-    select_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *source = op_state->source;
-
-    tuple_t *tuple = NULL;
-    do {
-        tuple = source->next(source->state);
-    } while (tuple && !tuple_satisfies_predicates(tuple, op_state->predicates, op_state->predicate_num));
+typedef struct gather_op_state_t gather_op_state_t;
 
-    return tuple;
-}
+typedef struct gather_morsel_t {
+    gather_op_state_t *op_state;
+    uint32_t first_tuple_i;
+    uint32_t tuple_num;
+    /* Tuples returned by the pipeline, NULL if there were none */
+    relation_t *result;
+    bool is_done;
+} gather_morsel_t;
+
+struct gather_op_state_t {
+    /* Arena the operator is allocated in, NULL for the heap */
+    arena_t *arena;
+    /* Relation scanned by pipelines */
+    const relation_t *relation;
+    /* A pipeline per worker and scan operators at the bottom of pipelines */
+    operator_t **pipelines;
+    operator_t **scan_ops;
+    uint16_t worker_num;
+    /* Return tuples in the relation order or as soon as morsels are done */
+    bool is_ordered;
+    bool is_open;
+    /* Tables probed by pipelines, built before morsels are run */
+    join_table_t **join_tables;
+    uint16_t join_table_num;
+
+    /* Morsels, the order they were done in and the cancellation flag are protected by the lock */
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    gather_morsel_t *morsels;
+    uint32_t morsel_num;
+    uint32_t *done_morsel_is;
+    uint32_t done_num;
+    bool is_cancelled;
+
+    /* Morsels taken so far and the result tuples are being returned from */
+    uint32_t taken_num;
+    relation_t *current_result;
+    uint32_t next_tuple_i;
+    tuple_t current_tuple;
+    /* A batch pointing to columns of the current result */
+    batch_t *current_batch;
+    uint16_t current_sel[BATCH_SIZE];
+};
 
-void select_op_close(void *state)
+/* Run a pipeline over a morsel, materializing its output */
+static void gather_run_morsel(void *arg, const uint16_t worker_i)
 {
-    select_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *source = op_state->source;
-    source->close(source->state);
+    gather_morsel_t *morsel = arg;
+    gather_op_state_t *op_state = morsel->op_state;
+
+    pthread_mutex_lock(&op_state->lock);
+    const bool is_cancelled = op_state->is_cancelled;
+    pthread_mutex_unlock(&op_state->lock);
+
+    if (!is_cancelled) {
+        operator_t *pipeline = op_state->pipelines[worker_i];
+        scan_op_set_range(op_state->scan_ops[worker_i], morsel->first_tuple_i, morsel->tuple_num);
+
+        pipeline->open(pipeline->state);
+        batch_t *batch = NULL;
+        while ((batch = pipeline->next_batch(pipeline->state))) {
+            if (batch->sel_num == 0)
+                continue;
+            if (!morsel->result) {
+                morsel->result = relation_create_for_batch(batch);
+                assert(morsel->result);
+            }
+            relation_append_batch(morsel->result, batch);
+        }
+        pipeline->close(pipeline->state);
+    }
+
+    pthread_mutex_lock(&op_state->lock);
+    morsel->is_done = true;
+    op_state->done_morsel_is[op_state->done_num++] = (uint32_t)(morsel - op_state->morsels);
+    pthread_cond_broadcast(&op_state->done_cond);
+    pthread_mutex_unlock(&op_state->lock);
 }
 
-void select_op_destroy(operator_t *operator)
+void gather_op_open(void *state)
 {
-    if (!operator)
-        return;
-
-    select_op_state_t *op_state = operator->state;
-    op_state->source->destroy(op_state->source);
-
-    free(operator->state);
-    free(operator);
+    gather_op_state_t *op_state = (typeof(op_state)) state;
+
+    /* Split the relation into morsels, all of them are run right away */
+    const uint32_t tuple_num = relation_get_tuple_num(op_state->relation);
+    const uint32_t morsel_num = tuple_num / MORSEL_SIZE + (tuple_num % MORSEL_SIZE != 0);
+    op_state->morsels = calloc(morsel_num, sizeof(gather_morsel_t));
+    op_state->done_morsel_is = calloc(morsel_num, sizeof(uint32_t));
+    assert((op_state->morsels && op_state->done_morsel_is) || morsel_num == 0);
+    op_state->morsel_num = morsel_num;
+    op_state->done_num = 0;
+    op_state->taken_num = 0;
+    op_state->is_cancelled = false;
+    op_state->is_open = true;
+
+    pool_t *pool = gather_get_pool(op_state->worker_num);
+    for (uint16_t table_i = 0; table_i < op_state->join_table_num; table_i++)
+        join_table_build(op_state->join_tables[table_i], pool);
+
+    for (uint32_t morsel_i = 0; morsel_i < morsel_num; morsel_i++) {
+        gather_morsel_t *morsel = &op_state->morsels[morsel_i];
+        morsel->op_state = op_state;
+        morsel->first_tuple_i = morsel_i * MORSEL_SIZE;
+        morsel->tuple_num = tuple_num - morsel->first_tuple_i < MORSEL_SIZE ?
+            tuple_num - morsel->first_tuple_i : MORSEL_SIZE;
+        pool_submit(pool, gather_run_morsel, morsel);
+    }
 }
 
-void select_op_add_attr_const_predicate(operator_t *operator,
-                                        const attr_name_t left_attr_name,
-                                        const select_predicate_op predicate_op,
-                                        const value_type_t right_constant)
+/* Wait for the next morsel having tuples, either in the morsel order or in the order morsels are
+ * done, returns false when there are no morsels left */
+static bool gather_op_take_morsel(gather_op_state_t *op_state)
 {
-    select_op_state_t *op_state = (typeof(op_state)) operator->state;
-    assert(op_state->predicate_num < MAX_SELECT_PREDICATE_NUM);
+    relation_destroy(op_state->current_result);
+    op_state->current_result = NULL;
+    op_state->next_tuple_i = 0;
 
-    select_predicate_t *predicate = &op_state->predicates[op_state->predicate_num];
+    while (!op_state->current_result) {
+        if (op_state->taken_num == op_state->morsel_num)
+            return false;
 
-    predicate->tag = SELECT_ATTR_CONST;
-    predicate->op = predicate_op;
-    strncpy(predicate->as.attr_const.left_attr_name, left_attr_name, MAX_ATTR_NAME_LEN);
-    predicate->as.attr_const.right_constant = right_constant;
+        uint32_t morsel_i = 0;
+        pthread_mutex_lock(&op_state->lock);
+        if (op_state->is_ordered) {
+            morsel_i = op_state->taken_num;
+            while (!op_state->morsels[morsel_i].is_done)
+                pthread_cond_wait(&op_state->done_cond, &op_state->lock);
+        } else {
+            while (op_state->done_num == op_state->taken_num)
+                pthread_cond_wait(&op_state->done_cond, &op_state->lock);
+            morsel_i = op_state->done_morsel_is[op_state->taken_num];
+        }
+        pthread_mutex_unlock(&op_state->lock);
+        op_state->taken_num++;
 
-    op_state->predicate_num++;
+        /* Results are released as soon as they are returned */
+        op_state->current_result = op_state->morsels[morsel_i].result;
+        op_state->morsels[morsel_i].result = NULL;
+    }
+
+    return true;
 }
 
-void select_op_add_attr_attr_predicate(operator_t *operator,
-                                       const attr_name_t left_attr_name,
-                                       const select_predicate_op predicate_op,
-                                       const attr_name_t right_attr_name)
+static bool gather_op_has_tuples(gather_op_state_t *op_state)
 {
-    select_op_state_t *op_state = (typeof(op_state)) operator->state;
-    assert(op_state->predicate_num < MAX_SELECT_PREDICATE_NUM);
-
-    select_predicate_t *predicate = &op_state->predicates[op_state->predicate_num];
-
-    predicate->tag = SELECT_ATTR_ATTR;
-    predicate->op = predicate_op;
-    strncpy(predicate->as.attr_attr.left_attr_name, left_attr_name, MAX_ATTR_NAME_LEN);
-    strncpy(predicate->as.attr_attr.right_attr_name, right_attr_name, MAX_ATTR_NAME_LEN);
-
-    op_state->predicate_num++;
+    if (op_state->current_result && op_state->next_tuple_i < op_state->current_result->tuple_num)
+        return true;
+    return gather_op_take_morsel(op_state);
 }
 
-operator_t *select_op_create(operator_t *source)
+tuple_t *gather_op_next(void *state)
 {
-    assert(source);
-
-    operator_t *op = calloc(1, sizeof(*op));
-    if (!op)
-        goto op_fail;
-
-    select_op_state_t *state = calloc(1, sizeof(*state));
-    if (!state)
-        goto state_fail;
-
-    state->source = source;
-    state->predicate_num = 0;
-    op->state = state;
-
-    op->open = select_op_open;
-    op->next = select_op_next;
-    op->close = select_op_close;
-    op->destroy = select_op_destroy;
+    gather_op_state_t *op_state = (typeof(op_state)) state;
+    if (!gather_op_has_tuples(op_state))
+        return NULL;
 
-    return op;
+    tuple_source_t *source_tuple = &op_state->current_tuple.as.source;
+    source_tuple->relation = op_state->current_result;
+    source_tuple->tuple_i = op_state->next_tuple_i++;
 
-state_fail:
-    free(op);
-op_fail:
-    return NULL;
+    return &op_state->current_tuple;
 }
 
-/* Sort operator */
-
-typedef struct sort_op_state_t {
-    operator_t *source;
-    /* Attribute to sort tuples by */
-    attr_name_t sort_attr_name;
-    /* Sort order, descending or ascending */
-    sort_order_t sort_order;
-
-    /* Temporary relation to be used for sorting*/
-    relation_t *tmp_relation;
-    /* Relation scan op */
-    operator_t *tmp_relation_scan_op;
-} sort_op_state_t;
-
-void sort_op_open(void *state)
+batch_t *gather_op_next_batch(void *state)
 {
-    sort_op_state_t *op_state = (typeof(op_state)) state;
-    operator_t *source = op_state->source;
+    gather_op_state_t *op_state = (typeof(op_state)) state;
+    if (!gather_op_has_tuples(op_state))
+        return NULL;
 
-    /* Materialize a table to be sorted */
-    source->open(source->state);
-    tuple_t *tuple = NULL;
-    while((tuple = source->next(source->state))) {
-        if (!op_state->tmp_relation) {
-            op_state->tmp_relation = relation_create_for_tuple(tuple);
-            assert(op_state->tmp_relation);
-            op_state->tmp_relation_scan_op = scan_op_create(op_state->tmp_relation);
-        }
-        relation_append_tuple(op_state->tmp_relation, tuple);
+    const relation_t *rel = op_state->current_result;
+    const uint16_t attr_num = relation_batch_attr_num(rel);
+    if (!op_state->current_batch) {
+        op_state->current_batch = batch_create(op_state->arena, attr_num, false);
+        assert(op_state->current_batch);
+        op_state->current_batch->sel = op_state->current_sel;
     }
-    source->close(source->state);
+    batch_t *batch = op_state->current_batch;
+
+    uint32_t row_num = rel->tuple_num - op_state->next_tuple_i;
+    if (row_num > BATCH_SIZE)
+        row_num = BATCH_SIZE;
+
+    /* Results are columnar, so column vectors point right into them */
+    for (size_t attr_i = 0; attr_i < attr_num; attr_i++) {
+        const uint16_t high_attr_i = relation_high_attr_i(rel, attr_i);
+        batch->attr_names[attr_i] = rel->attr_names[attr_i];
+        batch->columns[attr_i] = relation_value_ptr(rel, op_state->next_tuple_i, attr_i);
+        batch->high_columns[attr_i] = high_attr_i ? relation_value_ptr(rel, op_state->next_tuple_i, high_attr_i) : NULL;
+    }
+    batch->row_num = row_num;
+    batch_sel_all(batch);
 
-    /* Sort it */
-    relation_order_by(op_state->tmp_relation, op_state->sort_attr_name, op_state->sort_order);
+    op_state->next_tuple_i += row_num;
 
-    /* Open a scan op on it */
-    op_state->tmp_relation_scan_op->open(op_state->tmp_relation_scan_op->state);
+    return batch;
 }
 
-tuple_t *sort_op_next(void *state)
+void gather_op_close(void *state)
 {
-    sort_op_state_t *op_state = (typeof(op_state)) state;
-    return op_state->tmp_relation_scan_op->next(op_state->tmp_relation_scan_op->state);;
-}
+    gather_op_state_t *op_state = (typeof(op_state)) state;
+    if (!op_state->is_open)
+        return;
 
-void sort_op_close(void *state)
-{
-    sort_op_state_t *op_state = (typeof(op_state)) state;
-    /* If there was a tmp relation - destroy it */
-    if (op_state->tmp_relation) {
-        op_state->tmp_relation_scan_op->close(op_state->tmp_relation_scan_op->state);
-        scan_op_destroy(op_state->tmp_relation_scan_op);
-        relation_destroy(op_state->tmp_relation);
-        op_state->tmp_relation = NULL;
-    }
+    /* Morsels not started yet are skipped, the rest have to finish before results are released */
+    pthread_mutex_lock(&op_state->lock);
+    op_state->is_cancelled = true;
+    while (op_state->done_num < op_state->morsel_num)
+        pthread_cond_wait(&op_state->done_cond, &op_state->lock);
+    pthread_mutex_unlock(&op_state->lock);
+
+    relation_destroy(op_state->current_result);
+    op_state->current_result = NULL;
+    for (uint32_t morsel_i = 0; morsel_i < op_state->morsel_num; morsel_i++)
+        relation_destroy(op_state->morsels[morsel_i].result);
+
+    free(op_state->morsels);
+    op_state->morsels = NULL;
+    free(op_state->done_morsel_is);
+    op_state->done_morsel_is = NULL;
+    op_state->morsel_num = 0;
+    for (uint16_t table_i = 0; table_i < op_state->join_table_num; table_i++)
+        join_table_reset(op_state->join_tables[table_i]);
+    op_state->is_open = false;
 }
 
-void sort_op_destroy(operator_t *operator)
+void gather_op_destroy(operator_t *operator)
 {
     if (!operator)
         return;
 
-    sort_op_state_t *op_state = operator->state;
-    op_state->source->destroy(op_state->source);
+    /* Workers might still be running morsels */
+    gather_op_state_t *op_state = operator->state;
+    gather_op_close(op_state);
+    for (uint16_t worker_i = 0; worker_i < op_state->worker_num; worker_i++)
+        op_state->pipelines[worker_i]->destroy(op_state->pipelines[worker_i]);
+    for (uint16_t table_i = 0; table_i < op_state->join_table_num; table_i++)
+        join_table_destroy(op_state->join_tables[table_i]);
+    free(op_state->join_tables);
+
+    pthread_cond_destroy(&op_state->done_cond);
+    pthread_mutex_destroy(&op_state->lock);
+
+    batch_destroy(op_state->arena, op_state->current_batch);
+    arena_t *arena = op_state->arena;
+    arena_free(arena, op_state->pipelines);
+    arena_free(arena, op_state->scan_ops);
+    arena_free(arena, operator->state);
+    arena_free(arena, operator);
+}
 
-    free(operator->state);
-    free(operator);
+void gather_op_add_join_table(operator_t *operator, join_table_t *table)
+{
+    assert(table);
+
+    gather_op_state_t *op_state = operator->state;
+    join_table_t **join_tables = realloc(op_state->join_tables,
+                                         (op_state->join_table_num + 1) * sizeof(join_table_t *));
+    assert(join_tables);
+    join_tables[op_state->join_table_num++] = table;
+    op_state->join_tables = join_tables;
 }
 
-operator_t *sort_op_create(operator_t *source,
-                           const attr_name_t sort_attr_name,
-                           const sort_order_t order)
+operator_t *gather_op_create(arena_t *arena,
+                             const relation_t *relation,
+                             operator_t *const *pipelines,
+                             operator_t *const *scan_ops,
+                             const uint16_t worker_num,
+                             const bool is_ordered)
 {
-    assert(source);
+    assert(relation);
+    assert(worker_num > 0);
 
-    operator_t *op = calloc(1, sizeof(*op));
+    operator_t *op = arena_calloc(arena, 1, sizeof(*op));
     if (!op)
         goto op_fail;
 
-    sort_op_state_t *state = calloc(1, sizeof(*state));
+    gather_op_state_t *state = arena_calloc(arena, 1, sizeof(*state));
     if (!state)
         goto state_fail;
 
-    state->source = source;
-    state->sort_order = order;
-    strncpy(state->sort_attr_name, sort_attr_name, MAX_ATTR_NAME_LEN);
+    state->arena = arena;
+    state->relation = relation;
+    state->worker_num = worker_num;
+    state->is_ordered = is_ordered;
+    state->current_tuple.tag = TUPLE_SOURCE;
     op->state = state;
 
-    op->open = sort_op_open;
-    op->next = sort_op_next;
-    op->close = sort_op_close;
-    op->destroy = sort_op_destroy;
+    state->pipelines = arena_calloc(arena, worker_num, sizeof(operator_t *));
+    if (!state->pipelines)
+        goto pipelines_fail;
+    memcpy(state->pipelines, pipelines, worker_num * sizeof(operator_t *));
+
+    state->scan_ops = arena_calloc(arena, worker_num, sizeof(operator_t *));
+    if (!state->scan_ops)
+        goto scans_fail;
+    memcpy(state->scan_ops, scan_ops, worker_num * sizeof(operator_t *));
+
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_cond_init(&state->done_cond, NULL);
+
+    op->open = gather_op_open;
+    op->next = gather_op_next;
+    op->next_batch = gather_op_next_batch;
+    op->close = gather_op_close;
+    op->destroy = gather_op_destroy;
 
     return op;
 
+scans_fail:
+    arena_free(arena, state->pipelines);
+pipelines_fail:
+    arena_free(arena, state);
 state_fail:
-    free(op);
+    arena_free(arena, op);
 op_fail:
     return NULL;
 }
@@ -6,6 +6,10 @@
 #include <assert.h>
 
 #include "pigletql-def.h"
+#include "pigletql-arena.h"
+#include "pigletql-btree.h"
+#include "pigletql-hash.h"
+#include "pigletql-pool.h"
 
 /*
  * A tuple is a reference to a real tuple stored in a relation
@@ -29,18 +33,32 @@ const char *tuple_get_attr_name_by_i(const tuple_t *tuple, const uint16_t attr_i
 
 typedef struct relation_t relation_t;
 
+/* Relations keep minimum and maximum attribute values of every zone of this many tuples, so scans
+ * can skip zones where predicates cannot hold */
+#define ZONE_TUPLE_NUM 4096
+
 relation_t *relation_create(const attr_name_t *attr_names, const uint16_t attr_num);
 
+/* Columnar relations keep an aligned array of values per attribute, row relations keep all the
+ * values of a tuple next to each other */
+relation_t *relation_create_with_layout(const char *const *attr_names, const uint16_t attr_num,
+                                        const relation_layout_t layout);
+
+relation_layout_t relation_get_layout(const relation_t *rel);
+
 relation_t *relation_create_for_tuple(const tuple_t *tuple);
 
 void relation_fill_from_table(relation_t *relation,
                               const value_type_t *table,
                               const uint32_t table_tuple_num);
 
-void relation_order_by(relation_t *rel, const attr_name_t sort_attr_name, const sort_order_t order);
+void relation_order_by(relation_t *rel, const uint16_t sort_attr_i, const sort_order_t order);
 
+/* Values of a tuple. Columnar relations gather values into a buffer valid until the next call */
 value_type_t *relation_tuple_values_by_id(const relation_t *rel, const uint32_t tuple_i);
 
+value_type_t relation_get_value(const relation_t *rel, const uint32_t tuple_i, const uint16_t attr_i);
+
 uint16_t relation_attr_i_by_name(const relation_t *rel, const attr_name_t attr_name);
 
 const char *relation_attr_name_by_i(const relation_t *rel, const uint16_t attr_i);
@@ -55,10 +73,68 @@ void relation_append_tuple(relation_t *rel, const tuple_t *tuple);
 
 void relation_append_values(relation_t *rel, const value_type_t *values);
 
+/* Append tuples of a table, values of a tuple next to each other, reserving space only once */
+void relation_append_table(relation_t *rel, const value_type_t *table, const uint32_t table_tuple_num);
+
+/* Make room for this many tuples in total, so appending up to that many does not move values */
+void relation_reserve_tuples(relation_t *rel, const uint32_t tuple_num);
+
 void relation_reset(relation_t *relation);
 
+/* Build a B+tree index over an attribute, kept up to date as tuples are appended or reordered. The
+ * index is owned by the relation. */
+const btree_t *relation_create_index(relation_t *rel, const uint16_t attr_i);
+
+/* The B+tree index over an attribute, NULL if there's none */
+const btree_t *relation_get_index(const relation_t *rel, const uint16_t attr_i);
+
+/* Same for hash indexes, an attribute can have an index of each kind */
+const hash_index_t *relation_create_hash_index(relation_t *rel, const uint16_t attr_i);
+
+const hash_index_t *relation_get_hash_index(const relation_t *rel, const uint16_t attr_i);
+
+/* Save a relation to a file replacing whatever was there: a header with the schema, tuple number and
+ * zone summaries followed by row or column data aligned the way it is in memory */
+bool relation_save(const relation_t *rel, const char *path);
+
+/* Open a relation saved before, mapping its file instead of reading it. Values are used straight from
+ * the mapping until the relation grows. NULL if the file is missing or not a relation file. */
+relation_t *relation_open(const char *path);
+
 void relation_destroy(relation_t *relation);
 
+/*
+ * A batch is a chunk of tuples stored as column vectors, one vector per attribute. Only rows listed
+ * in the selection vector are alive, the rest of the rows were filtered out.
+ *
+ * Sums and counts go past the biggest value, so aggregates return them as 64-bit attributes: lower
+ * halves of values are kept in the column vector as usual, upper halves in a vector of their own.
+ *  */
+
+/* maximum number of rows in a batch */
+#define BATCH_SIZE 1024
+
+typedef struct batch_t {
+    /* Attributes and their values */
+    uint16_t attr_num;
+    const char **attr_names;
+    value_type_t **columns;
+    /* Upper halves of values of 64-bit attributes, NULL for other attributes */
+    value_type_t **high_columns;
+
+    /* Number of rows in column vectors */
+    uint16_t row_num;
+
+    /* Indices of rows alive */
+    uint16_t *sel;
+    uint16_t sel_num;
+} batch_t;
+
+uint16_t batch_attr_i_by_name(const batch_t *batch, const attr_name_t attr_name);
+
+/* Value of an attribute in a row, both halves of it for 64-bit attributes */
+uint64_t batch_get_value(const batch_t *batch, const uint16_t attr_i, const uint16_t row_i);
+
 /*
  * Operators iterate over relation tuples or tuples returned from other operators using 3 standard
  * ops: open, next, close.
@@ -67,47 +143,77 @@ void relation_destroy(relation_t *relation);
  *
  * next - retrieves the next tuple, ending with a NULL value
  *
+ * next_batch - retrieves the next batch of tuples, ending with a NULL value; batches returned are
+ * owned by the operator and valid until the next call
+ *
  * close - closes the operator and resets its state
  *
  * destroy - deallocates all the memory required by an operator and it's child operators
+ *
+ * Between open and close an operator should be consumed either with next or with next_batch, never
+ * both.
  * */
 
 typedef struct operator_t operator_t;
 
 typedef void (*op_open)(void *state);
 typedef tuple_t *(*op_next)(void *state);
+typedef batch_t *(*op_next_batch)(void *state);
 typedef void (*op_close)(void *state);
 typedef void (*op_destroy)(operator_t *state);
 
-/* The operator itself is just 4 pointers to related ops and operator state */
+/* The operator itself is just 5 pointers to related ops and operator state */
 struct operator_t {
     op_open open;
     op_next next;
+    op_next_batch next_batch;
     op_close close;
     op_destroy destroy;
 
     void *state;
 } ;
 
+/*
+ * Operators and their state are allocated in the arena given to constructors, or on the heap when
+ * the arena is NULL. Data-dependent buffers (hash tables, sorted relations) always live on the
+ * heap. Destroy functions have to be called either way.
+ *  */
+
+/*
+ * Operators failing after being opened, e.g. sorts running out of temporary files or disk space,
+ * stop returning tuples and leave an error message. The first error is kept until cleared, so
+ * statements clear it before opening their operators and check it once done.
+ *  */
+
+/* NULL if no operator failed since the last clear */
+const char *eval_get_error(void);
+
+void eval_clear_error(void);
+
 /*
  * Table scan operator just goes over all tuples in a relation.
  *  */
 
-operator_t *scan_op_create(const relation_t *relation);
+operator_t *scan_op_create(arena_t *arena, const relation_t *relation);
+
+/* Only scan tuple_num tuples starting with the tuple given, e.g. a morsel of a parallel scan */
+void scan_op_set_range(operator_t *operator, const uint32_t first_tuple_i, const uint32_t tuple_num);
 
 /*
- * Projection operator chooses a subset of attributes.
+ * Projection operator chooses a subset of attributes, given as indices of source tuple attributes.
  *  */
 
-operator_t *proj_op_create(operator_t *source,
-                           const attr_name_t *tuple_attr_names,
-                           const uint16_t tuple_attr_num);
+operator_t *proj_op_create(arena_t *arena,
+                           operator_t *source,
+                           const uint16_t *source_attr_is,
+                           const uint16_t attr_num);
 
 /*
  * Union operator gets tuples from both supplied relations with the same attributes.
  * */
 
-operator_t *union_op_create(operator_t *left_source,
+operator_t *union_op_create(arena_t *arena,
+                            operator_t *left_source,
                             operator_t *right_source);
 
 /*
@@ -115,14 +221,74 @@ operator_t *union_op_create(operator_t *left_source,
  * tuples from both relations, with attributes joined.
  * */
 
-operator_t *join_op_create(operator_t *left_source,
+operator_t *join_op_create(arena_t *arena,
+                           operator_t *left_source,
                            operator_t *right_source);
 
+/*
+ * Hash join operator joins tuples of two sources with equal values of given attributes (indices of
+ * left and right source tuple attributes). A hash table is built on one of the sources, preferably
+ * the smaller one, and then probed with tuples from the other source. Attributes are joined the
+ * same way the join operator does.
+ * */
+
+operator_t *hash_join_op_create(arena_t *arena,
+                                operator_t *left_source,
+                                operator_t *right_source,
+                                const uint16_t left_attr_i,
+                                const uint16_t right_attr_i,
+                                const bool build_left);
 
 /*
- * Selection operator filters tuples according to a list of predicates
+ * A join table is a hash table over tuples of a build source, built once and probed by any number of
+ * hash probe operators, possibly from worker threads. Parallel builds insert morsels of build tuples
+ * into shared buckets concurrently. Tables are built and released by gather operators.
+ * */
+
+typedef struct join_table_t join_table_t;
+
+join_table_t *join_table_create(arena_t *arena, operator_t *build_source, const uint16_t build_attr_i);
+
+/* Destroys the build source as well */
+void join_table_destroy(join_table_t *table);
+
+/*
+ * Hash probe operator is a hash join over a join table built elsewhere, the table is not owned by
+ * the operator. Attributes are joined the same way the hash join operator does.
+ * */
+
+operator_t *hash_probe_op_create(arena_t *arena,
+                                 operator_t *probe_source,
+                                 join_table_t *table,
+                                 const uint16_t probe_attr_i,
+                                 const bool build_left);
+
+/*
+ * Index join operator joins tuples of an outer source with tuples of an inner relation, looking up
+ * inner tuples with the outer attribute value in an index over the inner attribute, a hash index if
+ * there is one. Inner tuples only get the relation attributes listed, attributes are joined the same
+ * way the join operator does, inner attributes going first if inner_left is set.
+ * */
+
+operator_t *index_join_op_create(arena_t *arena,
+                                 operator_t *outer_source,
+                                 const relation_t *inner_relation,
+                                 const uint16_t outer_attr_i,
+                                 const uint16_t inner_attr_i,
+                                 const uint16_t *inner_attr_is,
+                                 const uint16_t inner_attr_num,
+                                 const bool inner_left);
+
+/*
+ * Selection operator filters tuples according to a list of predicates. Predicate attributes are
+ * given as indices of source tuple attributes.
  *  */
 
+typedef enum select_predicate_tag {
+    SELECT_ATTR_CONST,          /* compare an attribute to a constant */
+    SELECT_ATTR_ATTR,           /* compare two attributes */
+} select_predicate_tag;
+
 typedef enum select_predicate_op {
     SELECT_GT,                  /* greater than */
     SELECT_LT,                  /* less than  */
@@ -130,23 +296,207 @@ typedef enum select_predicate_op {
 } select_predicate_op;
 
 void select_op_add_attr_const_predicate(operator_t *operator,
-                                        const attr_name_t left_attr_name,
+                                        const uint16_t left_attr_i,
                                         const select_predicate_op predicate_op,
                                         const value_type_t right_constant);
 
 void select_op_add_attr_attr_predicate(operator_t *operator,
-                                       const attr_name_t left_attr_name,
+                                       const uint16_t left_attr_i,
                                        const select_predicate_op predicate_op,
-                                       const attr_name_t right_attr_name);
+                                       const uint16_t right_attr_i);
 
-operator_t *select_op_create(operator_t *source);
+/* Parameters of prepared statements: the constant is read from the parameter whenever the operator is
+ * opened, so the same operator tree can be run with different constants. Parameters should outlive
+ * operators. */
+void select_op_add_attr_param_predicate(operator_t *operator,
+                                        const uint16_t left_attr_i,
+                                        const select_predicate_op predicate_op,
+                                        const value_type_t *right_param);
+
+operator_t *select_op_create(arena_t *arena, operator_t *source);
+
+/*
+ * Scans skip zones of tuples where attribute-constant predicates given cannot hold. Tuples of the
+ * rest of zones are returned as is, so predicates still have to be applied by a selection above.
+ *  */
+
+void scan_op_add_zone_predicate(operator_t *operator,
+                                const uint16_t attr_i,
+                                const select_predicate_op predicate_op,
+                                const value_type_t constant);
+
+/* Same for constants of parameters, read when opening */
+void scan_op_add_zone_param_predicate(operator_t *operator,
+                                      const uint16_t attr_i,
+                                      const select_predicate_op predicate_op,
+                                      const value_type_t *param);
 
 /*
- * Sort operator sorts tuples by a given attribute in ascending or descending order
+ * Index scan operator returns tuples of a relation where an indexed attribute compares to a constant,
+ * looking them up in the index over the attribute. Tuples come in the order of attribute values,
+ * tuples with equal values in the relation order. Equality is looked up in a hash index if there is
+ * one, ranges need a B+tree.
  *  */
 
-operator_t *sort_op_create(operator_t *source,
-                           const attr_name_t sort_attr_name,
+operator_t *index_scan_op_create(arena_t *arena,
+                                 const relation_t *relation,
+                                 const uint16_t attr_i,
+                                 const select_predicate_op predicate_op,
+                                 const value_type_t constant);
+
+/* Read the constant from a parameter when opening instead */
+void index_scan_op_set_param(operator_t *operator, const value_type_t *param);
+
+/*
+ * Sort operator sorts tuples by a given attribute index in ascending or descending order. Sorts
+ * keeping more tuple values in memory than the budget spill sorted runs to temporary files, runs are
+ * then merged while tuples are being returned. Sorts failing to spill or read back runs return no
+ * more tuples and leave an error.
+ *  */
+
+#define SORT_DEFAULT_MEMORY_BUDGET ((size_t)256 * 1024 * 1024)
+
+/* Runs spilled are merged this many at a time into bigger runs while spilling, so that the number of
+ * temporary files open only grows logarithmically with the number of tuples */
+#define SORT_MERGE_RUN_NUM 16
+
+/* Memory budget in bytes of sort operators created afterwards */
+void sort_op_set_memory_budget(const size_t bytes);
+
+size_t sort_op_get_memory_budget(void);
+
+operator_t *sort_op_create(arena_t *arena,
+                           operator_t *source,
+                           const uint16_t sort_attr_i,
                            const sort_order_t order);
 
+/*
+ * Top-N operator returns the first limit tuples the sort operator would return. Only limit tuples
+ * are kept while consuming the source, in a heap with the tuple to be replaced next on top.
+ *  */
+
+operator_t *top_n_op_create(arena_t *arena,
+                            operator_t *source,
+                            const uint16_t sort_attr_i,
+                            const sort_order_t order,
+                            const uint32_t limit);
+
+/*
+ * Limit operator skips offset tuples and then returns at most limit tuples. The source is closed as
+ * soon as the limit is reached.
+ *  */
+
+operator_t *limit_op_create(arena_t *arena,
+                            operator_t *source,
+                            const uint32_t limit,
+                            const uint32_t offset);
+
+/*
+ * Aggregation operators group tuples of a source by values of group attributes and return a tuple per
+ * group: values of group attributes followed by values of aggregates. Without group attributes all the
+ * tuples make a single group. If there are no tuples at all, the group is only returned when all the
+ * aggregates are counts, as sums, minimums and maximums of nothing have no value.
+ *
+ * Aggregates are accumulated in 64 bits. Sums and counts are returned as 64-bit attributes, see
+ * batch_t, minimums and maximums are values.
+ * Aggregated attributes are given as indices of source tuple attributes, counts have none. Names of
+ * aggregates should be interned.
+ *  */
+
+typedef struct aggregate_t {
+    aggregate_func_t func;
+    uint16_t attr_i;
+    const char *name;
+} aggregate_t;
+
+/* Hash aggregation keeps groups in a hash table, all the source tuples are consumed when the operator
+ * is opened */
+operator_t *hash_aggregate_op_create(arena_t *arena,
+                                     operator_t *source,
+                                     const uint16_t *group_attr_is,
+                                     const uint16_t group_attr_num,
+                                     const aggregate_t *aggregates,
+                                     const uint16_t aggregate_num);
+
+/* Streaming aggregation expects tuples of a group to come one after another, e.g. sorted on group
+ * attributes. Only the current group is kept, groups are returned as soon as they end. */
+operator_t *stream_aggregate_op_create(arena_t *arena,
+                                       operator_t *source,
+                                       const uint16_t *group_attr_is,
+                                       const uint16_t group_attr_num,
+                                       const aggregate_t *aggregates,
+                                       const uint16_t aggregate_num);
+
+/*
+ * Tuple count operator returns a single tuple with the number of tuples of a relation, read when the
+ * operator is opened, as every one of the attributes named. This is COUNT(*) of a whole relation
+ * without scanning it. Attribute names should be interned.
+ *  */
+
+operator_t *count_op_create(arena_t *arena,
+                            const relation_t *relation,
+                            const char *const *attr_names,
+                            const uint16_t attr_num);
+
+/*
+ * Compiled pipeline operator runs a scan, selections and projections fused into a single native
+ * function, see pigletql-codegen.h. The function scans tuples starting with *next_tuple_i and
+ * ending before end_tuple_i, and writes values of tuples passing filters into output columns. It
+ * stops after writing BATCH_SIZE tuples and returns the number of tuples written.
+ *
+ * Attribute values of the relation are given as a base pointer per attribute and a stride between
+ * tuples, so the same function works for both relation layouts. Constants compared to are given at
+ * runtime, out_attr_is are relation attribute indices of output columns.
+ *  */
+
+typedef uint16_t (*compiled_pipeline_fn)(const value_type_t *const *attr_values,
+                                         const uint32_t stride,
+                                         const value_type_t *constants,
+                                         uint32_t *next_tuple_i,
+                                         const uint32_t end_tuple_i,
+                                         value_type_t *const *out_columns);
+
+operator_t *compiled_op_create(arena_t *arena,
+                               const relation_t *relation,
+                               const compiled_pipeline_fn pipeline_fn,
+                               const value_type_t *constants,
+                               const uint16_t constant_num,
+                               const uint16_t *out_attr_is,
+                               const uint16_t out_attr_num);
+
+/* Read constant constant_i from a parameter when opening */
+void compiled_op_set_param(operator_t *operator, const uint16_t constant_i, const value_type_t *param);
+
+/*
+ * Gather operator runs pipelines over a relation in parallel. The relation is split into morsels of
+ * MORSEL_SIZE tuples, a pool of workers then runs a pipeline over each of them. Every worker has a
+ * pipeline of its own, scan_ops are scan operators at the bottom of those pipelines. Pipelines are
+ * consumed a batch at a time from worker threads, so they should not allocate from arenas.
+ *
+ * Pipeline output is materialized per morsel and returned either in the relation order or as soon
+ * as morsels are done. Pipelines are owned by the operator and destroyed with it.
+ *  */
+
+/* Tuples per morsel */
+#define MORSEL_SIZE (10 * BATCH_SIZE)
+
+/* Number of workers of gather operators created afterwards, all the CPUs by default */
+void gather_op_set_worker_num(const uint16_t worker_num);
+
+uint16_t gather_op_get_worker_num(void);
+
+/* Workers shared by gather operators, for other parallel work run between queries */
+pool_t *gather_op_get_pool(void);
+
+/* Tables probed by pipelines get built when the operator is opened, using the same workers. Tables
+ * are owned by the operator and destroyed with it. */
+void gather_op_add_join_table(operator_t *operator, join_table_t *table);
+
+operator_t *gather_op_create(arena_t *arena,
+                             const relation_t *relation,
+                             operator_t *const *pipelines,
+                             operator_t *const *scan_ops,
+                             const uint16_t worker_num,
+                             const bool is_ordered);
+
 #endif //PIGLETQL_EVAL_H
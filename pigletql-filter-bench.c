@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pigletql-filter.h"
+
+/*
+ * Filter kernel throughput per instruction set: rows per second filtered by an attribute-constant
+ * predicate alone and followed by an attribute-attribute predicate, the way select does it for
+ * dense batches.
+ *  */
+
+#define BENCH_ROW_NUM (64 * 1024 * 1024)
+#define BENCH_ROUND_NUM 5
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double bench_filter(const value_type_t *left_column, const value_type_t *right_column,
+                           const bool with_attr_attr, size_t *rows_selected)
+{
+    uint64_t mask[FILTER_MASK_WORD_NUM(BATCH_SIZE)];
+    uint16_t sel[BATCH_SIZE];
+
+    double best_seconds = 0;
+    for (size_t round_i = 0; round_i < BENCH_ROUND_NUM; round_i++) {
+        size_t selected = 0;
+        const double start = now_seconds();
+        for (size_t row_i = 0; row_i < BENCH_ROW_NUM; row_i += BATCH_SIZE) {
+            filter_mask_fill(mask, BATCH_SIZE);
+            filter_attr_const(SELECT_LT, &left_column[row_i], 1u << 30, BATCH_SIZE, mask);
+            if (with_attr_attr)
+                filter_attr_attr(SELECT_GT, &left_column[row_i], &right_column[row_i], BATCH_SIZE, mask);
+            selected += filter_mask_to_sel(mask, BATCH_SIZE, sel);
+        }
+        const double seconds = now_seconds() - start;
+        if (round_i == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+        *rows_selected = selected;
+    }
+    return best_seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    value_type_t *left_column = calloc(BENCH_ROW_NUM, sizeof(value_type_t));
+    value_type_t *right_column = calloc(BENCH_ROW_NUM, sizeof(value_type_t));
+    if (!left_column || !right_column) {
+        fprintf(stderr, "Error: failed to allocate columns\n");
+        return 1;
+    }
+
+    srand(42);
+    for (size_t row_i = 0; row_i < BENCH_ROW_NUM; row_i++) {
+        left_column[row_i] = (value_type_t)rand() * 2;
+        right_column[row_i] = (value_type_t)rand() * 2;
+    }
+
+    printf("%-8s %16s %16s %10s\n", "isa", "attr<const r/s", "+attr>attr r/s", "selected");
+    for (filter_isa_t isa = FILTER_ISA_SCALAR; isa < FILTER_ISA_NUM; isa++) {
+        if (!filter_set_isa(isa)) {
+            printf("%-8s %16s\n", filter_isa_name(isa), "unsupported");
+            continue;
+        }
+
+        size_t selected = 0;
+        const double const_seconds = bench_filter(left_column, right_column, false, &selected);
+        const double both_seconds = bench_filter(left_column, right_column, true, &selected);
+        printf("%-8s %16.3e %16.3e %10zu\n", filter_isa_name(isa),
+               BENCH_ROW_NUM / const_seconds, BENCH_ROW_NUM / both_seconds, selected);
+    }
+
+    free(left_column);
+    free(right_column);
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pigletql-filter.h"
+
+/* Values around sign bits make sure comparisons are unsigned */
+static const value_type_t edge_values[] = {0, 1, INT32_MAX - 1, INT32_MAX, (value_type_t)INT32_MAX + 1, UINT32_MAX - 1, UINT32_MAX};
+
+static bool compare(const select_predicate_op op, const value_type_t left, const value_type_t right)
+{
+    switch (op) {
+    case SELECT_GT:
+        return left > right;
+    case SELECT_LT:
+        return left < right;
+    case SELECT_EQ:
+        return left == right;
+    }
+    assert(false);
+}
+
+static void fill_column(value_type_t *column, const uint16_t row_num)
+{
+    for (uint16_t row_i = 0; row_i < row_num; row_i++) {
+        if (rand() % 2)
+            column[row_i] = edge_values[rand() % ARRAY_SIZE(edge_values)];
+        else
+            column[row_i] = (value_type_t)rand() % 16;
+    }
+}
+
+static void filter_mask_test(void)
+{
+    /* Masks only have bits for rows given */
+    {
+        uint64_t mask[FILTER_MASK_WORD_NUM(BATCH_SIZE)];
+
+        filter_mask_fill(mask, 65);
+        assert(mask[0] == UINT64_MAX);
+        assert(mask[1] == 1);
+
+        uint16_t sel[BATCH_SIZE];
+        assert(filter_mask_to_sel(mask, 65, sel) == 65);
+        for (uint16_t row_i = 0; row_i < 65; row_i++)
+            assert(sel[row_i] == row_i);
+
+        filter_mask_fill(mask, 128);
+        mask[0] = 0;
+        mask[1] = ((uint64_t)1 << 63) | 2;
+        assert(filter_mask_to_sel(mask, 128, sel) == 2);
+        assert(sel[0] == 65);
+        assert(sel[1] == 127);
+    }
+}
+
+static void filter_kernels_test(void)
+{
+    /* All the instruction sets supported give the same results as a plain loop */
+    const uint16_t row_nums[] = {0, 1, 3, 63, 64, 65, 100, 1000, BATCH_SIZE};
+    const select_predicate_op ops[] = {SELECT_GT, SELECT_LT, SELECT_EQ};
+    const filter_isa_t default_isa = filter_get_isa();
+    assert(default_isa == filter_isa_best());
+
+    for (filter_isa_t isa = FILTER_ISA_SCALAR; isa < FILTER_ISA_NUM; isa++) {
+        if (!filter_isa_supported(isa)) {
+            assert(!filter_set_isa(isa));
+            continue;
+        }
+        assert(filter_set_isa(isa));
+        assert(filter_get_isa() == isa);
+
+        for (size_t row_num_i = 0; row_num_i < ARRAY_SIZE(row_nums); row_num_i++) {
+            const uint16_t row_num = row_nums[row_num_i];
+            value_type_t left_column[BATCH_SIZE], right_column[BATCH_SIZE];
+            fill_column(left_column, row_num);
+            fill_column(right_column, row_num);
+
+            for (size_t op_i = 0; op_i < ARRAY_SIZE(ops); op_i++) {
+                const select_predicate_op op = ops[op_i];
+                for (size_t const_i = 0; const_i < ARRAY_SIZE(edge_values); const_i++) {
+                    const value_type_t constant = edge_values[const_i];
+
+                    uint64_t mask[FILTER_MASK_WORD_NUM(BATCH_SIZE)];
+                    filter_mask_fill(mask, row_num);
+                    filter_attr_const(op, left_column, constant, row_num, mask);
+                    filter_attr_attr(op, left_column, right_column, row_num, mask);
+
+                    uint16_t sel[BATCH_SIZE];
+                    const uint16_t sel_num = filter_mask_to_sel(mask, row_num, sel);
+
+                    uint16_t expected_sel[BATCH_SIZE];
+                    uint16_t expected_sel_num = 0;
+                    for (uint16_t row_i = 0; row_i < row_num; row_i++)
+                        if (compare(op, left_column[row_i], constant) &&
+                            compare(op, left_column[row_i], right_column[row_i]))
+                            expected_sel[expected_sel_num++] = row_i;
+
+                    assert(sel_num == expected_sel_num);
+                    assert(0 == memcmp(sel, expected_sel, sel_num * sizeof(uint16_t)));
+
+                    /* Sparse filters agree */
+                    uint16_t all_sel[BATCH_SIZE], sparse_sel[BATCH_SIZE];
+                    for (uint16_t row_i = 0; row_i < row_num; row_i++)
+                        all_sel[row_i] = row_i;
+                    uint16_t sparse_sel_num = filter_sel_attr_const(op, left_column, constant,
+                                                                    all_sel, row_num, sparse_sel);
+                    sparse_sel_num = filter_sel_attr_attr(op, left_column, right_column,
+                                                          sparse_sel, sparse_sel_num, sparse_sel);
+                    assert(sparse_sel_num == expected_sel_num);
+                    assert(0 == memcmp(sparse_sel, expected_sel, sparse_sel_num * sizeof(uint16_t)));
+                }
+            }
+        }
+    }
+
+    assert(filter_set_isa(default_isa));
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    srand(42);
+
+    filter_mask_test();
+    filter_kernels_test();
+
+    return 0;
+}
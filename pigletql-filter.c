@@ -0,0 +1,430 @@
+#include <string.h>
+#include <assert.h>
+
+#include "pigletql-filter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILTER_X86
+#endif
+
+/*
+ * Kernels only process full 64-row mask words, remaining rows are handled by a scalar loop. All
+ * kernels have the same signature, the constant is ignored by attribute-attribute kernels while
+ * right columns are ignored by attribute-constant kernels.
+ *  */
+
+typedef void (*filter_kernel)(const value_type_t *left_column,
+                              const value_type_t *right_column,
+                              const value_type_t constant,
+                              const uint16_t word_num,
+                              uint64_t *mask);
+
+enum {
+    FILTER_KIND_ATTR_CONST,
+    FILTER_KIND_ATTR_ATTR,
+    FILTER_KIND_NUM,
+};
+
+#define FILTER_OP_NUM (SELECT_EQ + 1)
+
+/* Scalar kernels */
+
+#define FILTER_SCALAR_KERNEL(name, RIGHT, CMP)                          \
+    static void name(const value_type_t *left_column,                   \
+                     const value_type_t *right_column,                  \
+                     const value_type_t constant,                       \
+                     const uint16_t word_num,                           \
+                     uint64_t *mask)                                    \
+    {                                                                   \
+        (void) right_column; (void) constant;                           \
+        for (size_t word_i = 0; word_i < word_num; word_i++) {          \
+            uint64_t bits = 0;                                          \
+            for (size_t lane_i = 0; lane_i < 64; lane_i++) {            \
+                const size_t row_i = word_i * 64 + lane_i;              \
+                const value_type_t left = left_column[row_i];           \
+                const value_type_t right = RIGHT;                       \
+                bits |= (uint64_t)(CMP) << lane_i;                      \
+            }                                                           \
+            mask[word_i] &= bits;                                       \
+        }                                                               \
+    }
+
+FILTER_SCALAR_KERNEL(filter_scalar_const_gt, constant, left > right)
+FILTER_SCALAR_KERNEL(filter_scalar_const_lt, constant, left < right)
+FILTER_SCALAR_KERNEL(filter_scalar_const_eq, constant, left == right)
+FILTER_SCALAR_KERNEL(filter_scalar_attr_gt, right_column[row_i], left > right)
+FILTER_SCALAR_KERNEL(filter_scalar_attr_lt, right_column[row_i], left < right)
+FILTER_SCALAR_KERNEL(filter_scalar_attr_eq, right_column[row_i], left == right)
+
+#ifdef FILTER_X86
+
+/* SSE and AVX2 only have signed comparisons, flipping sign bits makes them work for unsigned
+ * values */
+
+#define FILTER_SSE42_KERNEL(name, RIGHT, CMP)                                     \
+    __attribute__((target("sse4.2")))                                           \
+    static void name(const value_type_t *left_column,                           \
+                     const value_type_t *right_column,                          \
+                     const value_type_t constant,                               \
+                     const uint16_t word_num,                                   \
+                     uint64_t *mask)                                            \
+    {                                                                           \
+        (void) right_column;                                                    \
+        const __m128i sign = _mm_set1_epi32(INT32_MIN);                         \
+        const __m128i constant_vec = _mm_set1_epi32((int32_t)constant);         \
+        (void) sign; (void) constant_vec;                                       \
+        for (size_t word_i = 0; word_i < word_num; word_i++) {                  \
+            uint64_t bits = 0;                                                  \
+            for (size_t lane_i = 0; lane_i < 64; lane_i += 4) {                 \
+                const size_t row_i = word_i * 64 + lane_i;                      \
+                const __m128i left = _mm_loadu_si128((const __m128i *)&left_column[row_i]); \
+                const __m128i right = RIGHT;                                    \
+                const __m128i res = CMP;                                        \
+                bits |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(res)) << lane_i; \
+            }                                                                   \
+            mask[word_i] &= bits;                                               \
+        }                                                                       \
+    }
+
+#define SSE42_LOAD_RIGHT _mm_loadu_si128((const __m128i *)&right_column[row_i])
+#define SSE42_GT(a, b) _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign))
+
+FILTER_SSE42_KERNEL(filter_sse42_const_gt, constant_vec, SSE42_GT(left, right))
+FILTER_SSE42_KERNEL(filter_sse42_const_lt, constant_vec, SSE42_GT(right, left))
+FILTER_SSE42_KERNEL(filter_sse42_const_eq, constant_vec, _mm_cmpeq_epi32(left, right))
+FILTER_SSE42_KERNEL(filter_sse42_attr_gt, SSE42_LOAD_RIGHT, SSE42_GT(left, right))
+FILTER_SSE42_KERNEL(filter_sse42_attr_lt, SSE42_LOAD_RIGHT, SSE42_GT(right, left))
+FILTER_SSE42_KERNEL(filter_sse42_attr_eq, SSE42_LOAD_RIGHT, _mm_cmpeq_epi32(left, right))
+
+#define FILTER_AVX2_KERNEL(name, RIGHT, CMP)                                      \
+    __attribute__((target("avx2")))                                             \
+    static void name(const value_type_t *left_column,                           \
+                     const value_type_t *right_column,                          \
+                     const value_type_t constant,                               \
+                     const uint16_t word_num,                                   \
+                     uint64_t *mask)                                            \
+    {                                                                           \
+        (void) right_column;                                                    \
+        const __m256i sign = _mm256_set1_epi32(INT32_MIN);                      \
+        const __m256i constant_vec = _mm256_set1_epi32((int32_t)constant);      \
+        (void) sign; (void) constant_vec;                                       \
+        for (size_t word_i = 0; word_i < word_num; word_i++) {                  \
+            uint64_t bits = 0;                                                  \
+            for (size_t lane_i = 0; lane_i < 64; lane_i += 8) {                 \
+                const size_t row_i = word_i * 64 + lane_i;                      \
+                const __m256i left = _mm256_loadu_si256((const __m256i *)&left_column[row_i]); \
+                const __m256i right = RIGHT;                                    \
+                const __m256i res = CMP;                                        \
+                bits |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(res)) << lane_i; \
+            }                                                                   \
+            mask[word_i] &= bits;                                               \
+        }                                                                       \
+    }
+
+#define AVX2_LOAD_RIGHT _mm256_loadu_si256((const __m256i *)&right_column[row_i])
+#define AVX2_GT(a, b) _mm256_cmpgt_epi32(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign))
+
+FILTER_AVX2_KERNEL(filter_avx2_const_gt, constant_vec, AVX2_GT(left, right))
+FILTER_AVX2_KERNEL(filter_avx2_const_lt, constant_vec, AVX2_GT(right, left))
+FILTER_AVX2_KERNEL(filter_avx2_const_eq, constant_vec, _mm256_cmpeq_epi32(left, right))
+FILTER_AVX2_KERNEL(filter_avx2_attr_gt, AVX2_LOAD_RIGHT, AVX2_GT(left, right))
+FILTER_AVX2_KERNEL(filter_avx2_attr_lt, AVX2_LOAD_RIGHT, AVX2_GT(right, left))
+FILTER_AVX2_KERNEL(filter_avx2_attr_eq, AVX2_LOAD_RIGHT, _mm256_cmpeq_epi32(left, right))
+
+/* AVX-512 compares unsigned values directly and produces bitmasks */
+
+#define FILTER_AVX512_KERNEL(name, RIGHT, CMP)                                    \
+    __attribute__((target("avx512f")))                                          \
+    static void name(const value_type_t *left_column,                           \
+                     const value_type_t *right_column,                          \
+                     const value_type_t constant,                               \
+                     const uint16_t word_num,                                   \
+                     uint64_t *mask)                                            \
+    {                                                                           \
+        (void) right_column;                                                    \
+        const __m512i constant_vec = _mm512_set1_epi32((int32_t)constant);      \
+        (void) constant_vec;                                                    \
+        for (size_t word_i = 0; word_i < word_num; word_i++) {                  \
+            uint64_t bits = 0;                                                  \
+            for (size_t lane_i = 0; lane_i < 64; lane_i += 16) {                \
+                const size_t row_i = word_i * 64 + lane_i;                      \
+                const __m512i left = _mm512_loadu_si512(&left_column[row_i]);   \
+                const __m512i right = RIGHT;                                    \
+                bits |= (uint64_t)(CMP) << lane_i;                              \
+            }                                                                   \
+            mask[word_i] &= bits;                                               \
+        }                                                                       \
+    }
+
+#define AVX512_LOAD_RIGHT _mm512_loadu_si512(&right_column[row_i])
+
+FILTER_AVX512_KERNEL(filter_avx512_const_gt, constant_vec, _mm512_cmpgt_epu32_mask(left, right))
+FILTER_AVX512_KERNEL(filter_avx512_const_lt, constant_vec, _mm512_cmplt_epu32_mask(left, right))
+FILTER_AVX512_KERNEL(filter_avx512_const_eq, constant_vec, _mm512_cmpeq_epu32_mask(left, right))
+FILTER_AVX512_KERNEL(filter_avx512_attr_gt, AVX512_LOAD_RIGHT, _mm512_cmpgt_epu32_mask(left, right))
+FILTER_AVX512_KERNEL(filter_avx512_attr_lt, AVX512_LOAD_RIGHT, _mm512_cmplt_epu32_mask(left, right))
+FILTER_AVX512_KERNEL(filter_avx512_attr_eq, AVX512_LOAD_RIGHT, _mm512_cmpeq_epu32_mask(left, right))
+
+#endif
+
+/* Kernels by instruction set, kind of predicate and comparison */
+static const filter_kernel filter_kernels[FILTER_ISA_NUM][FILTER_KIND_NUM][FILTER_OP_NUM] = {
+    [FILTER_ISA_SCALAR] = {
+        [FILTER_KIND_ATTR_CONST] = {
+            [SELECT_GT] = filter_scalar_const_gt,
+            [SELECT_LT] = filter_scalar_const_lt,
+            [SELECT_EQ] = filter_scalar_const_eq,
+        },
+        [FILTER_KIND_ATTR_ATTR] = {
+            [SELECT_GT] = filter_scalar_attr_gt,
+            [SELECT_LT] = filter_scalar_attr_lt,
+            [SELECT_EQ] = filter_scalar_attr_eq,
+        },
+    },
+#ifdef FILTER_X86
+    [FILTER_ISA_SSE42] = {
+        [FILTER_KIND_ATTR_CONST] = {
+            [SELECT_GT] = filter_sse42_const_gt,
+            [SELECT_LT] = filter_sse42_const_lt,
+            [SELECT_EQ] = filter_sse42_const_eq,
+        },
+        [FILTER_KIND_ATTR_ATTR] = {
+            [SELECT_GT] = filter_sse42_attr_gt,
+            [SELECT_LT] = filter_sse42_attr_lt,
+            [SELECT_EQ] = filter_sse42_attr_eq,
+        },
+    },
+    [FILTER_ISA_AVX2] = {
+        [FILTER_KIND_ATTR_CONST] = {
+            [SELECT_GT] = filter_avx2_const_gt,
+            [SELECT_LT] = filter_avx2_const_lt,
+            [SELECT_EQ] = filter_avx2_const_eq,
+        },
+        [FILTER_KIND_ATTR_ATTR] = {
+            [SELECT_GT] = filter_avx2_attr_gt,
+            [SELECT_LT] = filter_avx2_attr_lt,
+            [SELECT_EQ] = filter_avx2_attr_eq,
+        },
+    },
+    [FILTER_ISA_AVX512] = {
+        [FILTER_KIND_ATTR_CONST] = {
+            [SELECT_GT] = filter_avx512_const_gt,
+            [SELECT_LT] = filter_avx512_const_lt,
+            [SELECT_EQ] = filter_avx512_const_eq,
+        },
+        [FILTER_KIND_ATTR_ATTR] = {
+            [SELECT_GT] = filter_avx512_attr_gt,
+            [SELECT_LT] = filter_avx512_attr_lt,
+            [SELECT_EQ] = filter_avx512_attr_eq,
+        },
+    },
+#endif
+};
+
+/*
+ * Instruction set selection
+ *  */
+
+static filter_isa_t filter_current_isa = FILTER_ISA_SCALAR;
+
+bool filter_isa_supported(const filter_isa_t isa)
+{
+#ifdef FILTER_X86
+    __builtin_cpu_init();
+    switch (isa) {
+    case FILTER_ISA_SCALAR:
+        return true;
+    case FILTER_ISA_SSE42:
+        return __builtin_cpu_supports("sse4.2");
+    case FILTER_ISA_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case FILTER_ISA_AVX512:
+        return __builtin_cpu_supports("avx512f");
+    case FILTER_ISA_NUM:
+        break;
+    }
+    return false;
+#else
+    return isa == FILTER_ISA_SCALAR;
+#endif
+}
+
+filter_isa_t filter_isa_best(void)
+{
+    for (filter_isa_t isa = FILTER_ISA_NUM; isa-- > FILTER_ISA_SCALAR;)
+        if (filter_isa_supported(isa))
+            return isa;
+    return FILTER_ISA_SCALAR;
+}
+
+const char *filter_isa_name(const filter_isa_t isa)
+{
+    static const char *names[FILTER_ISA_NUM] = {
+        [FILTER_ISA_SCALAR] = "scalar",
+        [FILTER_ISA_SSE42] = "sse4.2",
+        [FILTER_ISA_AVX2] = "avx2",
+        [FILTER_ISA_AVX512] = "avx512",
+    };
+    assert(isa < FILTER_ISA_NUM);
+    return names[isa];
+}
+
+filter_isa_t filter_get_isa(void)
+{
+    return filter_current_isa;
+}
+
+bool filter_set_isa(const filter_isa_t isa)
+{
+    if (isa >= FILTER_ISA_NUM || !filter_isa_supported(isa))
+        return false;
+    filter_current_isa = isa;
+    return true;
+}
+
+__attribute__((constructor))
+static void filter_init(void)
+{
+    filter_current_isa = filter_isa_best();
+}
+
+/*
+ * Kernel entry points
+ *  */
+
+void filter_mask_fill(uint64_t *mask, const uint16_t row_num)
+{
+    const uint16_t word_num = FILTER_MASK_WORD_NUM(row_num);
+    memset(mask, 0xff, word_num * sizeof(uint64_t));
+    if (row_num % 64)
+        mask[word_num - 1] = ((uint64_t)1 << (row_num % 64)) - 1;
+}
+
+static bool filter_compare(const select_predicate_op op, const value_type_t left, const value_type_t right)
+{
+    switch(op) {
+    case SELECT_GT:
+        return left > right;
+    case SELECT_LT:
+        return left < right;
+    case SELECT_EQ:
+        return left == right;
+    }
+    assert(false);
+    return false;
+}
+
+static void filter_apply(const select_predicate_op op,
+                         const value_type_t *left_column,
+                         const value_type_t *right_column,
+                         const value_type_t constant,
+                         const uint16_t row_num,
+                         uint64_t *mask)
+{
+    assert(op < FILTER_OP_NUM);
+
+    const int kind = right_column ? FILTER_KIND_ATTR_ATTR : FILTER_KIND_ATTR_CONST;
+    const uint16_t word_num = row_num / 64;
+    filter_kernels[filter_current_isa][kind][op](left_column, right_column, constant, word_num, mask);
+
+    /* Rows left in the last partial word */
+    const uint16_t first_row_i = word_num * 64;
+    if (first_row_i == row_num)
+        return;
+
+    uint64_t bits = 0;
+    for (uint16_t row_i = first_row_i; row_i < row_num; row_i++) {
+        const value_type_t right = right_column ? right_column[row_i] : constant;
+        bits |= (uint64_t)filter_compare(op, left_column[row_i], right) << (row_i - first_row_i);
+    }
+    mask[word_num] &= bits;
+}
+
+void filter_attr_const(const select_predicate_op op,
+                       const value_type_t *column, const value_type_t constant,
+                       const uint16_t row_num, uint64_t *mask)
+{
+    filter_apply(op, column, NULL, constant, row_num, mask);
+}
+
+void filter_attr_attr(const select_predicate_op op,
+                      const value_type_t *left_column, const value_type_t *right_column,
+                      const uint16_t row_num, uint64_t *mask)
+{
+    filter_apply(op, left_column, right_column, 0, row_num, mask);
+}
+
+uint16_t filter_mask_to_sel(const uint64_t *mask, const uint16_t row_num, uint16_t *sel)
+{
+    uint16_t sel_num = 0;
+    const uint16_t word_num = FILTER_MASK_WORD_NUM(row_num);
+    for (uint16_t word_i = 0; word_i < word_num; word_i++) {
+        uint64_t bits = mask[word_i];
+        while (bits) {
+            sel[sel_num++] = word_i * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+    return sel_num;
+}
+
+/* Sparse filters are branch-free: every row is written, but only rows passing are counted */
+
+uint16_t filter_sel_attr_const(const select_predicate_op op,
+                               const value_type_t *column, const value_type_t constant,
+                               const uint16_t *sel, const uint16_t sel_num,
+                               uint16_t *res_sel)
+{
+    uint16_t res_num = 0;
+    switch (op) {
+    case SELECT_GT:
+        for (size_t sel_i = 0; sel_i < sel_num; sel_i++) {
+            res_sel[res_num] = sel[sel_i];
+            res_num += column[sel[sel_i]] > constant;
+        }
+        break;
+    case SELECT_LT:
+        for (size_t sel_i = 0; sel_i < sel_num; sel_i++) {
+            res_sel[res_num] = sel[sel_i];
+            res_num += column[sel[sel_i]] < constant;
+        }
+        break;
+    case SELECT_EQ:
+        for (size_t sel_i = 0; sel_i < sel_num; sel_i++) {
+            res_sel[res_num] = sel[sel_i];
+            res_num += column[sel[sel_i]] == constant;
+        }
+        break;
+    }
+    return res_num;
+}
+
+uint16_t filter_sel_attr_attr(const select_predicate_op op,
+                              const value_type_t *left_column, const value_type_t *right_column,
+                              const uint16_t *sel, const uint16_t sel_num,
+                              uint16_t *res_sel)
+{
+    uint16_t res_num = 0;
+    switch (op) {
+    case SELECT_GT:
+        for (size_t sel_i = 0; sel_i < sel_num; sel_i++) {
+            res_sel[res_num] = sel[sel_i];
+            res_num += left_column[sel[sel_i]] > right_column[sel[sel_i]];
+        }
+        break;
+    case SELECT_LT:
+        for (size_t sel_i = 0; sel_i < sel_num; sel_i++) {
+            res_sel[res_num] = sel[sel_i];
+            res_num += left_column[sel[sel_i]] < right_column[sel[sel_i]];
+        }
+        break;
+    case SELECT_EQ:
+        for (size_t sel_i = 0; sel_i < sel_num; sel_i++) {
+            res_sel[res_num] = sel[sel_i];
+            res_num += left_column[sel[sel_i]] == right_column[sel[sel_i]];
+        }
+        break;
+    }
+    return res_num;
+}
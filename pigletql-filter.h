@@ -0,0 +1,68 @@
+#ifndef PIGLETQL_FILTER_H
+#define PIGLETQL_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+#include "pigletql-eval.h"
+
+/*
+ * Filter kernels compare whole column vectors against a constant or another column. Results are
+ * ANDed into a bitmask having a bit per row, so predicates can be applied one after another before
+ * turning the mask into a selection vector.
+ *
+ * Vectorized kernels are chosen at startup depending on instruction sets supported by the CPU.
+ * */
+
+/* number of 64-bit mask words needed for a number of rows */
+#define FILTER_MASK_WORD_NUM(row_num) (((row_num) + 63) / 64)
+
+typedef enum filter_isa_t {
+    FILTER_ISA_SCALAR = 0,
+    FILTER_ISA_SSE42,
+    FILTER_ISA_AVX2,
+    FILTER_ISA_AVX512,
+    FILTER_ISA_NUM,
+} filter_isa_t;
+
+/* Best instruction set supported by the CPU */
+filter_isa_t filter_isa_best(void);
+
+bool filter_isa_supported(const filter_isa_t isa);
+
+const char *filter_isa_name(const filter_isa_t isa);
+
+/* Instruction set used by kernels, mostly useful for testing and benchmarking */
+filter_isa_t filter_get_isa(void);
+
+bool filter_set_isa(const filter_isa_t isa);
+
+/* Set mask bits for all the rows given */
+void filter_mask_fill(uint64_t *mask, const uint16_t row_num);
+
+/* Clear mask bits of rows where column values do not compare to the constant given */
+void filter_attr_const(const select_predicate_op op,
+                       const value_type_t *column, const value_type_t constant,
+                       const uint16_t row_num, uint64_t *mask);
+
+/* Clear mask bits of rows where values in one column do not compare to values in another column */
+void filter_attr_attr(const select_predicate_op op,
+                      const value_type_t *left_column, const value_type_t *right_column,
+                      const uint16_t row_num, uint64_t *mask);
+
+/* Turn a mask into a selection vector, returns the number of rows selected */
+uint16_t filter_mask_to_sel(const uint64_t *mask, const uint16_t row_num, uint16_t *sel);
+
+/* Filter a selection vector, for sparse batches where comparing whole columns is a waste */
+uint16_t filter_sel_attr_const(const select_predicate_op op,
+                               const value_type_t *column, const value_type_t constant,
+                               const uint16_t *sel, const uint16_t sel_num,
+                               uint16_t *res_sel);
+
+uint16_t filter_sel_attr_attr(const select_predicate_op op,
+                              const value_type_t *left_column, const value_type_t *right_column,
+                              const uint16_t *sel, const uint16_t sel_num,
+                              uint16_t *res_sel);
+
+#endif //PIGLETQL_FILTER_H
@@ -0,0 +1,84 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "pigletql-hash.h"
+
+/* Number of tuple ids found for a value, checking they come in insertion order */
+static uint32_t count_equal(const hash_index_t *index, const value_type_t value)
+{
+    hash_index_cursor_t cursor = hash_index_lookup(index, value);
+    uint32_t tuple_i = 0, prev_tuple_i = 0;
+    uint32_t entry_num = 0;
+    while (hash_index_cursor_next(index, &cursor, &tuple_i)) {
+        assert(entry_num == 0 || prev_tuple_i < tuple_i);
+        prev_tuple_i = tuple_i;
+        entry_num++;
+    }
+    return entry_num;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* An empty index */
+    {
+        hash_index_t *index = hash_index_create();
+        assert(index);
+        assert(hash_index_get_entry_num(index) == 0);
+        assert(count_equal(index, 0) == 0);
+        assert(count_equal(index, UINT32_MAX) == 0);
+        hash_index_destroy(index);
+    }
+
+    /* Unique keys, growing the table many times */
+    {
+        hash_index_t *index = hash_index_create();
+        const uint32_t entry_num = 100000;
+        for (uint32_t entry_i = 0; entry_i < entry_num; entry_i++)
+            hash_index_insert(index, entry_i * 3, entry_i);
+        assert(hash_index_get_entry_num(index) == entry_num);
+
+        for (uint32_t entry_i = 0; entry_i < entry_num; entry_i++) {
+            hash_index_cursor_t cursor = hash_index_lookup(index, entry_i * 3);
+            uint32_t tuple_i = 0;
+            assert(hash_index_cursor_next(index, &cursor, &tuple_i));
+            assert(tuple_i == entry_i);
+            assert(!hash_index_cursor_next(index, &cursor, &tuple_i));
+            assert(count_equal(index, entry_i * 3 + 1) == 0);
+        }
+
+        hash_index_reset(index);
+        assert(hash_index_get_entry_num(index) == 0);
+        assert(count_equal(index, 3) == 0);
+        hash_index_insert(index, 3, 7);
+        assert(count_equal(index, 3) == 1);
+
+        hash_index_destroy(index);
+    }
+
+    /* Random keys with many duplicates, values colliding in their low bits included */
+    {
+        hash_index_t *index = hash_index_create();
+        const uint32_t entry_num = 200000;
+        const value_type_t distinct_num = 1000;
+        uint32_t *counts = calloc(distinct_num, sizeof(uint32_t));
+        assert(counts);
+
+        srand(42);
+        for (uint32_t entry_i = 0; entry_i < entry_num; entry_i++) {
+            const value_type_t key_i = (value_type_t)rand() % distinct_num;
+            hash_index_insert(index, key_i << 20, entry_i);
+            counts[key_i]++;
+        }
+
+        for (value_type_t key_i = 0; key_i < distinct_num; key_i++)
+            assert(count_equal(index, key_i << 20) == counts[key_i]);
+
+        free(counts);
+        hash_index_destroy(index);
+    }
+
+    return 0;
+}
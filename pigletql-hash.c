@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "pigletql-hash.h"
+
+/* Tables start with this many slots and double once half full */
+#define HASH_INDEX_MIN_SLOT_BITS 6
+/* No entry, marks empty slots and chain ends */
+#define HASH_INDEX_NO_ENTRY UINT32_MAX
+
+typedef struct hash_index_slot_t {
+    value_type_t value;
+    /* Chain of entries with the value, the last one is where new entries go */
+    uint32_t first_entry_i;
+    uint32_t last_entry_i;
+} hash_index_slot_t;
+
+struct hash_index_t {
+    hash_index_slot_t *slots;
+    uint8_t slot_bits;
+    uint32_t value_num;
+
+    /* Tuple ids of entries and the next entry with the same value */
+    uint32_t *tuple_is;
+    uint32_t *next_entry_is;
+    uint32_t entry_num;
+    uint32_t entry_slots;
+};
+
+static inline uint32_t hash_index_slot_i(const value_type_t value, const uint8_t slot_bits)
+{
+    /* Multiplicative hashing, higher bits are better mixed */
+    return (uint32_t)(value * 2654435761u) >> (32 - slot_bits);
+}
+
+static hash_index_slot_t *hash_index_slots_create(const uint8_t slot_bits)
+{
+    hash_index_slot_t *slots = malloc(((size_t)1 << slot_bits) * sizeof(*slots));
+    assert(slots);
+    for (size_t slot_i = 0; slot_i < (size_t)1 << slot_bits; slot_i++)
+        slots[slot_i].first_entry_i = HASH_INDEX_NO_ENTRY;
+    return slots;
+}
+
+/* Slot of the value, or the empty slot the value would go to */
+static hash_index_slot_t *hash_index_find_slot(hash_index_slot_t *slots, const uint8_t slot_bits,
+                                               const value_type_t value)
+{
+    const uint32_t mask = ((uint32_t)1 << slot_bits) - 1;
+    uint32_t slot_i = hash_index_slot_i(value, slot_bits);
+    while (slots[slot_i].first_entry_i != HASH_INDEX_NO_ENTRY && slots[slot_i].value != value)
+        slot_i = (slot_i + 1) & mask;
+    return &slots[slot_i];
+}
+
+hash_index_t *hash_index_create(void)
+{
+    hash_index_t *index = calloc(1, sizeof(*index));
+    if (!index)
+        return NULL;
+    index->slot_bits = HASH_INDEX_MIN_SLOT_BITS;
+    index->slots = hash_index_slots_create(index->slot_bits);
+    return index;
+}
+
+void hash_index_destroy(hash_index_t *index)
+{
+    if (!index)
+        return;
+    free(index->slots);
+    free(index->tuple_is);
+    free(index->next_entry_is);
+    free(index);
+}
+
+void hash_index_reset(hash_index_t *index)
+{
+    free(index->slots);
+    index->slot_bits = HASH_INDEX_MIN_SLOT_BITS;
+    index->slots = hash_index_slots_create(index->slot_bits);
+    index->value_num = 0;
+    index->entry_num = 0;
+}
+
+uint32_t hash_index_get_entry_num(const hash_index_t *index)
+{
+    return index->entry_num;
+}
+
+/* Double the number of slots, chains stay as they are */
+static void hash_index_grow(hash_index_t *index)
+{
+    const uint8_t slot_bits = index->slot_bits + 1;
+    assert(slot_bits <= 32);
+    hash_index_slot_t *slots = hash_index_slots_create(slot_bits);
+    for (size_t slot_i = 0; slot_i < (size_t)1 << index->slot_bits; slot_i++) {
+        const hash_index_slot_t *slot = &index->slots[slot_i];
+        if (slot->first_entry_i != HASH_INDEX_NO_ENTRY)
+            *hash_index_find_slot(slots, slot_bits, slot->value) = *slot;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->slot_bits = slot_bits;
+}
+
+void hash_index_insert(hash_index_t *index, const value_type_t value, const uint32_t tuple_i)
+{
+    if (index->entry_num == index->entry_slots) {
+        const uint32_t entry_slots = index->entry_slots ? index->entry_slots * 2 : 1u << HASH_INDEX_MIN_SLOT_BITS;
+        index->tuple_is = realloc(index->tuple_is, entry_slots * sizeof(uint32_t));
+        index->next_entry_is = realloc(index->next_entry_is, entry_slots * sizeof(uint32_t));
+        assert(index->tuple_is && index->next_entry_is);
+        index->entry_slots = entry_slots;
+    }
+    const uint32_t entry_i = index->entry_num++;
+    index->tuple_is[entry_i] = tuple_i;
+    index->next_entry_is[entry_i] = HASH_INDEX_NO_ENTRY;
+
+    hash_index_slot_t *slot = hash_index_find_slot(index->slots, index->slot_bits, value);
+    if (slot->first_entry_i != HASH_INDEX_NO_ENTRY) {
+        index->next_entry_is[slot->last_entry_i] = entry_i;
+        slot->last_entry_i = entry_i;
+        return;
+    }
+
+    *slot = (hash_index_slot_t) { .value = value, .first_entry_i = entry_i, .last_entry_i = entry_i };
+    if (++index->value_num * 2 > (uint32_t)1 << index->slot_bits)
+        hash_index_grow(index);
+}
+
+hash_index_cursor_t hash_index_lookup(const hash_index_t *index, const value_type_t value)
+{
+    const hash_index_slot_t *slot = hash_index_find_slot(index->slots, index->slot_bits, value);
+    return (hash_index_cursor_t) { .entry_i = slot->first_entry_i };
+}
+
+bool hash_index_cursor_next(const hash_index_t *index, hash_index_cursor_t *cursor, uint32_t *tuple_i)
+{
+    if (cursor->entry_i == HASH_INDEX_NO_ENTRY)
+        return false;
+    *tuple_i = index->tuple_is[cursor->entry_i];
+    cursor->entry_i = index->next_entry_is[cursor->entry_i];
+    return true;
+}
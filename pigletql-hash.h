@@ -0,0 +1,39 @@
+#ifndef PIGLETQL_HASH_H
+#define PIGLETQL_HASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+
+/*
+ * A hash index maps attribute values to ids of tuples holding them, for equality lookups only. Distinct
+ * values live in an open-addressing table with linear probing, every value pointing to a chain of
+ * tuple ids in insertion order. Lookups of unique keys are a single probe and a single chain entry.
+ * */
+
+typedef struct hash_index_t hash_index_t;
+
+/* A position in the chain of tuple ids of a value, valid until the next insertion */
+typedef struct hash_index_cursor_t {
+    uint32_t entry_i;
+} hash_index_cursor_t;
+
+hash_index_t *hash_index_create(void);
+
+void hash_index_destroy(hash_index_t *index);
+
+void hash_index_insert(hash_index_t *index, const value_type_t value, const uint32_t tuple_i);
+
+/* Drop all the entries */
+void hash_index_reset(hash_index_t *index);
+
+uint32_t hash_index_get_entry_num(const hash_index_t *index);
+
+/* A cursor at the first tuple id with the value given */
+hash_index_cursor_t hash_index_lookup(const hash_index_t *index, const value_type_t value);
+
+/* Read the tuple id at the cursor and move the cursor to the next one, false if there are none left */
+bool hash_index_cursor_next(const hash_index_t *index, hash_index_cursor_t *cursor, uint32_t *tuple_i);
+
+#endif //PIGLETQL_HASH_H
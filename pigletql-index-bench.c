@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pigletql-eval.h"
+
+/*
+ * Point lookups: time per lookup of a select over a full scan, skipping zones where it can, and of
+ * index scans over a B+tree and a hash index. Keys are unique and in random order, so zones do not
+ * help here. Joins: a small relation joined with the big one, building a hash table over the big one
+ * every time versus looking its tuples up in the index.
+ *  */
+
+#define BENCH_ROW_NUM (1000 * 1000)
+#define BENCH_SCAN_LOOKUP_NUM 20
+#define BENCH_INDEX_LOOKUP_NUM (100 * 1000)
+#define BENCH_OUTER_ROW_NUM (10 * 1000)
+#define BENCH_JOIN_NUM 5
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t bench_consume(operator_t *op)
+{
+    uint32_t row_num = 0;
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state)))
+        row_num += batch->sel_num;
+    op->close(op->state);
+    return row_num;
+}
+
+static double bench_scan(const relation_t *rel, const value_type_t *keys, uint32_t *row_num)
+{
+    *row_num = 0;
+    const double start = now_seconds();
+    for (size_t lookup_i = 0; lookup_i < BENCH_SCAN_LOOKUP_NUM; lookup_i++) {
+        operator_t *scan_op = scan_op_create(NULL, rel);
+        scan_op_add_zone_predicate(scan_op, 0, SELECT_EQ, keys[lookup_i]);
+        operator_t *op = select_op_create(NULL, scan_op);
+        select_op_add_attr_const_predicate(op, 0, SELECT_EQ, keys[lookup_i]);
+        *row_num += bench_consume(op);
+        op->destroy(op);
+    }
+    return (now_seconds() - start) / BENCH_SCAN_LOOKUP_NUM;
+}
+
+static double bench_index(const relation_t *rel, const value_type_t *keys, uint32_t *row_num)
+{
+    *row_num = 0;
+    const double start = now_seconds();
+    for (size_t lookup_i = 0; lookup_i < BENCH_INDEX_LOOKUP_NUM; lookup_i++) {
+        operator_t *op = index_scan_op_create(NULL, rel, 0, SELECT_EQ, keys[lookup_i % BENCH_ROW_NUM]);
+        *row_num += bench_consume(op);
+        op->destroy(op);
+    }
+    return (now_seconds() - start) / BENCH_INDEX_LOOKUP_NUM;
+}
+
+static double bench_join(const relation_t *rel, const relation_t *outer, const bool use_index, uint32_t *row_num)
+{
+    const uint16_t inner_attr_is[] = {0, 1};
+    *row_num = 0;
+    const double start = now_seconds();
+    for (size_t join_i = 0; join_i < BENCH_JOIN_NUM; join_i++) {
+        operator_t *op = use_index ?
+            index_join_op_create(NULL, scan_op_create(NULL, outer), rel, 0, 0, inner_attr_is, 2, false) :
+            hash_join_op_create(NULL, scan_op_create(NULL, outer), scan_op_create(NULL, rel), 0, 0, false);
+        *row_num += bench_consume(op);
+        op->destroy(op);
+    }
+    return (now_seconds() - start) / BENCH_JOIN_NUM;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    const char *attr_names[] = {"key", "payload"};
+    relation_t *rel = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+    const char *outer_attr_names[] = {"fk"};
+    relation_t *outer = relation_create_with_layout(outer_attr_names, ARRAY_SIZE(outer_attr_names), LAYOUT_COLUMNS);
+    value_type_t *keys = calloc(BENCH_ROW_NUM, sizeof(value_type_t));
+    if (!rel || !outer || !keys) {
+        fprintf(stderr, "Error: failed to create the relation\n");
+        return 1;
+    }
+
+    /* A random permutation of keys */
+    srand(42);
+    for (value_type_t row_i = 0; row_i < BENCH_ROW_NUM; row_i++)
+        keys[row_i] = row_i;
+    for (value_type_t row_i = BENCH_ROW_NUM - 1; row_i > 0; row_i--) {
+        const value_type_t swap_i = (value_type_t)rand() % (row_i + 1);
+        const value_type_t key = keys[row_i];
+        keys[row_i] = keys[swap_i];
+        keys[swap_i] = key;
+    }
+    for (value_type_t row_i = 0; row_i < BENCH_ROW_NUM; row_i++) {
+        const value_type_t values[] = {keys[row_i], row_i};
+        relation_append_values(rel, values);
+    }
+    /* Half of the outer rows find a match */
+    for (value_type_t row_i = 0; row_i < BENCH_OUTER_ROW_NUM; row_i++)
+        relation_append_values(outer, (value_type_t[]){(value_type_t)rand() % (2 * BENCH_ROW_NUM)});
+
+    double build_start = now_seconds();
+    relation_create_index(rel, 0);
+    printf("B+tree built over %d rows in %.3f s\n", BENCH_ROW_NUM, now_seconds() - build_start);
+
+    printf("%10s %14s %14s %10s\n", "lookup", "rows found", "us/lookup", "speedup");
+
+    uint32_t row_num = 0;
+    const double scan_seconds = bench_scan(rel, keys, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "scan", row_num, scan_seconds * 1e6, 1.0);
+
+    const double btree_seconds = bench_index(rel, keys, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "btree", row_num, btree_seconds * 1e6, scan_seconds / btree_seconds);
+
+    uint32_t btree_join_row_num = 0;
+    const double btree_join_seconds = bench_join(rel, outer, true, &btree_join_row_num);
+
+    /* Equality lookups prefer the hash index from now on */
+    build_start = now_seconds();
+    relation_create_hash_index(rel, 0);
+    printf("hash index built over %d rows in %.3f s\n", BENCH_ROW_NUM, now_seconds() - build_start);
+
+    const double hash_seconds = bench_index(rel, keys, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "hash", row_num, hash_seconds * 1e6, scan_seconds / hash_seconds);
+
+    printf("%10s %14s %14s %10s\n", "join", "rows joined", "ms/join", "speedup");
+
+    const double hash_join_seconds = bench_join(rel, outer, false, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "hash join", row_num, hash_join_seconds * 1e3, 1.0);
+    printf("%10s %14u %14.3f %10.2f\n", "btree", btree_join_row_num, btree_join_seconds * 1e3,
+           hash_join_seconds / btree_join_seconds);
+
+    const double index_join_seconds = bench_join(rel, outer, true, &row_num);
+    printf("%10s %14u %14.3f %10.2f\n", "hash", row_num, index_join_seconds * 1e3,
+           hash_join_seconds / index_join_seconds);
+
+    free(keys);
+    relation_destroy(outer);
+    relation_destroy(rel);
+
+    return 0;
+}
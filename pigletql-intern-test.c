@@ -0,0 +1,48 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pigletql-intern.h"
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* Equal names share a pointer */
+    {
+        const char *name = intern("attr1");
+        assert(0 == strcmp(name, "attr1"));
+        assert(name == intern("attr1"));
+        assert(name != intern("attr2"));
+
+        /* Names of a given length, e.g. tokens in a query string */
+        assert(name == intern_n("attr1 FROM rel1", 5));
+        assert(intern_n("attr12", 5) == name);
+    }
+
+    /* Lots of names survive table growth */
+    {
+        const char *names[1000];
+        for (size_t name_i = 0; name_i < 1000; name_i++) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "name%zu", name_i);
+            names[name_i] = intern(buf);
+        }
+        for (size_t name_i = 0; name_i < 1000; name_i++) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "name%zu", name_i);
+            assert(names[name_i] == intern(buf));
+            assert(0 == strcmp(names[name_i], buf));
+        }
+    }
+
+    /* Long names get cut */
+    {
+        char long_name[2 * MAX_ATTR_NAME_LEN];
+        memset(long_name, 'a', sizeof(long_name) - 1);
+        long_name[sizeof(long_name) - 1] = '\0';
+        assert(strlen(intern(long_name)) == MAX_ATTR_NAME_LEN - 1);
+    }
+
+    return 0;
+}
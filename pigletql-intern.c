@@ -0,0 +1,38 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "pigletql-intern.h"
+#include "pigletql-names.h"
+
+/* Interned names by themselves */
+static name_table_t table;
+
+const char *intern_n(const char *name, size_t len)
+{
+    len = strnlen(name, len);
+    if (len > MAX_ATTR_NAME_LEN - 1)
+        len = MAX_ATTR_NAME_LEN - 1;
+
+    const char *interned = name_table_get(&table, name, len);
+    if (interned)
+        return interned;
+
+    char *copy = malloc(len + 1);
+    assert(copy);
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+
+    /* A name not found is never taken, only failing to grow the table fails */
+    const bool is_added = name_table_add(&table, copy, len, copy);
+    assert(is_added);
+    (void) is_added;
+
+    return copy;
+}
+
+const char *intern(const char *name)
+{
+    return intern_n(name, MAX_ATTR_NAME_LEN);
+}
@@ -0,0 +1,19 @@
+#ifndef PIGLETQL_INTERN_H
+#define PIGLETQL_INTERN_H
+
+#include <stddef.h>
+
+#include "pigletql-def.h"
+
+/*
+ * Interned names are stored once and never freed, equal names share the same pointer. Attribute and
+ * relation names are interned by the parser and relations.
+ * */
+
+/* Intern a name of a given length, names longer than MAX_ATTR_NAME_LEN - 1 get cut */
+const char *intern_n(const char *name, size_t len);
+
+/* Intern a zero-terminated name */
+const char *intern(const char *name);
+
+#endif //PIGLETQL_INTERN_H
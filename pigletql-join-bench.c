@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pigletql-eval.h"
+
+/*
+ * Equality join scaling: probe rows per second of a serial hash join, and of gather workers probing a
+ * join table built in parallel. Half of the probe rows find a match.
+ *  */
+
+#define BENCH_BUILD_ROW_NUM (1000 * 1000)
+#define BENCH_PROBE_ROW_NUM (4 * 1000 * 1000)
+#define BENCH_ROUND_NUM 3
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t bench_consume(operator_t *op)
+{
+    uint32_t row_num = 0;
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state)))
+        row_num += batch->sel_num;
+    op->close(op->state);
+    return row_num;
+}
+
+static double bench_serial(const relation_t *build, const relation_t *probe, uint32_t *row_num)
+{
+    operator_t *op = hash_join_op_create(NULL, scan_op_create(NULL, build), scan_op_create(NULL, probe), 0, 1, true);
+
+    double best_seconds = 0;
+    for (size_t round_i = 0; round_i < BENCH_ROUND_NUM; round_i++) {
+        const double start = now_seconds();
+        *row_num = bench_consume(op);
+        const double seconds = now_seconds() - start;
+        if (round_i == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+    }
+
+    op->destroy(op);
+    return best_seconds;
+}
+
+static double bench_parallel(const relation_t *build, const relation_t *probe, const uint16_t worker_num,
+                             uint32_t *row_num)
+{
+    join_table_t *table = join_table_create(NULL, scan_op_create(NULL, build), 0);
+    operator_t *pipelines[worker_num], *scan_ops[worker_num];
+    for (uint16_t worker_i = 0; worker_i < worker_num; worker_i++) {
+        scan_ops[worker_i] = scan_op_create(NULL, probe);
+        pipelines[worker_i] = hash_probe_op_create(NULL, scan_ops[worker_i], table, 1, true);
+    }
+    operator_t *op = gather_op_create(NULL, probe, pipelines, scan_ops, worker_num, false);
+    gather_op_add_join_table(op, table);
+
+    double best_seconds = 0;
+    for (size_t round_i = 0; round_i < BENCH_ROUND_NUM; round_i++) {
+        const double start = now_seconds();
+        *row_num = bench_consume(op);
+        const double seconds = now_seconds() - start;
+        if (round_i == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+    }
+
+    op->destroy(op);
+    return best_seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    const char *build_attr_names[] = {"key", "payload"};
+    relation_t *build = relation_create_with_layout(build_attr_names, ARRAY_SIZE(build_attr_names), LAYOUT_COLUMNS);
+    const char *probe_attr_names[] = {"id", "fk"};
+    relation_t *probe = relation_create_with_layout(probe_attr_names, ARRAY_SIZE(probe_attr_names), LAYOUT_COLUMNS);
+    if (!build || !probe) {
+        fprintf(stderr, "Error: failed to create relations\n");
+        return 1;
+    }
+
+    srand(42);
+    for (value_type_t row_i = 0; row_i < BENCH_BUILD_ROW_NUM; row_i++) {
+        const value_type_t values[] = {row_i, (value_type_t)rand()};
+        relation_append_values(build, values);
+    }
+    for (value_type_t row_i = 0; row_i < BENCH_PROBE_ROW_NUM; row_i++) {
+        const value_type_t values[] = {row_i, (value_type_t)rand() % (2 * BENCH_BUILD_ROW_NUM)};
+        relation_append_values(probe, values);
+    }
+
+    printf("%10s %14s %14s %10s\n", "threads", "rows joined", "probe r/s", "speedup");
+
+    uint32_t row_num = 0;
+    const double serial_seconds = bench_serial(build, probe, &row_num);
+    printf("%10s %14u %14.3e %10.2f\n", "serial", row_num, BENCH_PROBE_ROW_NUM / serial_seconds, 1.0);
+
+    const uint16_t worker_nums[] = {1, 2, 4, 8, 16};
+    for (size_t worker_num_i = 0; worker_num_i < ARRAY_SIZE(worker_nums); worker_num_i++) {
+        const double seconds = bench_parallel(build, probe, worker_nums[worker_num_i], &row_num);
+        printf("%10u %14u %14.3e %10.2f\n", worker_nums[worker_num_i], row_num, BENCH_PROBE_ROW_NUM / seconds,
+               serial_seconds / seconds);
+    }
+
+    relation_destroy(build);
+    relation_destroy(probe);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pigletql-names.h"
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* FNV-1a of names, and names made of words mixed in one by one */
+    {
+        assert(fnv1a("", 0) == FNV1A_BASIS);
+        assert(fnv1a("a", 1) == 0xe40c292cu);
+        assert(fnv1a("foobar", 6) == 0xbf9cf968u);
+        assert(fnv1a("foobar tail", 6) == fnv1a("foobar", 6));
+        assert(fnv1a_step(FNV1A_BASIS, 'a') == fnv1a("a", 1));
+    }
+
+    /* Records by names of a given length */
+    {
+        name_table_t table = {0};
+        int record1 = 1, record2 = 2;
+        assert(!name_table_get(&table, "rel1", 4));
+
+        assert(name_table_add(&table, "rel1", 4, &record1));
+        assert(name_table_add(&table, "rel2", 4, &record2));
+        assert(!name_table_add(&table, "rel1", 4, &record2));
+
+        assert(name_table_get(&table, "rel1", 4) == &record1);
+        assert(name_table_get(&table, "rel2 FROM", 4) == &record2);
+        assert(!name_table_get(&table, "rel", 3));
+        assert(!name_table_get(&table, "rel12", 5));
+
+        name_table_destroy(&table);
+    }
+
+    /* Lots of records survive table growth */
+    {
+        name_table_t table = {0};
+        static char names[1000][32];
+        for (size_t name_i = 0; name_i < 1000; name_i++) {
+            snprintf(names[name_i], sizeof(names[name_i]), "name%zu", name_i);
+            assert(name_table_add(&table, names[name_i], strlen(names[name_i]), names[name_i]));
+        }
+        assert(table.record_num == 1000);
+        for (size_t name_i = 0; name_i < 1000; name_i++) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "name%zu", name_i);
+            assert(name_table_get(&table, buf, strlen(buf)) == names[name_i]);
+        }
+
+        name_table_destroy(&table);
+    }
+
+    return 0;
+}
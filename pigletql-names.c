@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pigletql-names.h"
+
+#define NAME_TABLE_MIN_SLOT_NUM 64
+
+uint32_t fnv1a(const char *name, const size_t len)
+{
+    uint32_t hash = FNV1A_BASIS;
+    for (size_t i = 0; i < len; i++)
+        hash = fnv1a_step(hash, (uint8_t)name[i]);
+    return hash;
+}
+
+/* The slot of a name, an empty one if there's no such name */
+static size_t name_table_find(const name_table_t *table, const char *name, const size_t len, const uint32_t hash)
+{
+    size_t slot_i = hash & (table->slot_num - 1);
+    for (; table->records[slot_i]; slot_i = (slot_i + 1) & (table->slot_num - 1)) {
+        const char *slot_name = table->names[slot_i];
+        if (table->hashes[slot_i] == hash && 0 == strncmp(slot_name, name, len) && slot_name[len] == '\0')
+            break;
+    }
+    return slot_i;
+}
+
+static bool name_table_grow(name_table_t *table)
+{
+    const size_t slot_num = table->slot_num ? table->slot_num * 2 : NAME_TABLE_MIN_SLOT_NUM;
+    const char **names = calloc(slot_num, sizeof(*names));
+    void **records = calloc(slot_num, sizeof(*records));
+    uint32_t *hashes = calloc(slot_num, sizeof(*hashes));
+    if (!names || !records || !hashes) {
+        free(names);
+        free(records);
+        free(hashes);
+        return false;
+    }
+
+    for (size_t old_i = 0; old_i < table->slot_num; old_i++) {
+        if (!table->records[old_i])
+            continue;
+        size_t slot_i = table->hashes[old_i] & (slot_num - 1);
+        while (records[slot_i])
+            slot_i = (slot_i + 1) & (slot_num - 1);
+        names[slot_i] = table->names[old_i];
+        records[slot_i] = table->records[old_i];
+        hashes[slot_i] = table->hashes[old_i];
+    }
+
+    name_table_destroy(table);
+    table->names = names;
+    table->records = records;
+    table->hashes = hashes;
+    table->slot_num = slot_num;
+    return true;
+}
+
+void *name_table_get(const name_table_t *table, const char *name, const size_t len)
+{
+    if (!table->slot_num)
+        return NULL;
+    return table->records[name_table_find(table, name, len, fnv1a(name, len))];
+}
+
+bool name_table_add(name_table_t *table, const char *name, const size_t len, void *record)
+{
+    if ((table->record_num + 1) * 2 > table->slot_num && !name_table_grow(table))
+        return false;
+
+    const uint32_t hash = fnv1a(name, len);
+    const size_t slot_i = name_table_find(table, name, len, hash);
+    if (table->records[slot_i])
+        return false;
+
+    table->names[slot_i] = name;
+    table->records[slot_i] = record;
+    table->hashes[slot_i] = hash;
+    table->record_num++;
+    return true;
+}
+
+void name_table_destroy(name_table_t *table)
+{
+    free(table->names);
+    free(table->records);
+    free(table->hashes);
+}
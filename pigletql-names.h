@@ -0,0 +1,43 @@
+#ifndef PIGLETQL_NAMES_H
+#define PIGLETQL_NAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * FNV-1a hashing, and tables of records by name hashed with it. Tables use open addressing with linear
+ * probing and are kept at most half full. Tables own neither names nor records, both should stay
+ * where they are for as long as records are in a table.
+ * */
+
+#define FNV1A_BASIS 2166136261u
+
+/* Mix a value into a hash, a byte at a time for names or a word at a time for binary data */
+static inline uint32_t fnv1a_step(const uint32_t hash, const uint32_t value)
+{
+    return (hash ^ value) * 16777619u;
+}
+
+/* Hash a name of a given length */
+uint32_t fnv1a(const char *name, const size_t len);
+
+/* Zero-initialized tables are empty */
+typedef struct name_table_t {
+    const char **names;
+    void **records;
+    uint32_t *hashes;
+    size_t slot_num;
+    size_t record_num;
+} name_table_t;
+
+/* The record under a name of a given length, NULL if there's no such name */
+void *name_table_get(const name_table_t *table, const char *name, const size_t len);
+
+/* Add a record under a zero-terminated name of a given length, false if the name is taken or the
+ * table failed to grow */
+bool name_table_add(name_table_t *table, const char *name, const size_t len, void *record);
+
+void name_table_destroy(name_table_t *table);
+
+#endif //PIGLETQL_NAMES_H
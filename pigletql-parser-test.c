@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "pigletql-parser.h"
 
@@ -12,7 +13,7 @@ static void select_test(void)
     {
         const char *query = "SELECT *,attr1 FROM WHERE attr1=11;";
 
-        scanner_t *scanner = scanner_create(query);
+        scanner_t *scanner = scanner_create(NULL, query);
 
         token_t token = scanner_next(scanner);
         assert(token.type == TOKEN_SELECT);
@@ -61,7 +62,7 @@ static void select_test(void)
     {
         const char *query = "attr1 !1attr";
 
-        scanner_t *scanner = scanner_create(query);
+        scanner_t *scanner = scanner_create(NULL, query);
 
         token_t token = scanner_next(scanner);
         assert(token.type == TOKEN_IDENT);
@@ -79,7 +80,7 @@ static void select_test(void)
     {
         const char *query = "ORDER   BY ASC DESC";
 
-        scanner_t *scanner = scanner_create(query);
+        scanner_t *scanner = scanner_create(NULL, query);
 
         token_t token = scanner_next(scanner);
         assert(token.type == TOKEN_ORDER);
@@ -104,9 +105,9 @@ static void select_test(void)
     {
         const char *query_str = "SELECT attr1 FROM rel1;";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(scanner);
         assert(parser);
         assert(query);
@@ -127,9 +128,9 @@ static void select_test(void)
     {
         const char *query_str = "SELECT attr1, attr2 FROM rel1,rel2,rel3;";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
 
         assert(parser_parse(parser, scanner, query));
 
@@ -149,9 +150,9 @@ static void select_test(void)
     {
         const char *query_str = "SELECT a1 FROM r1 WHERE a1=a2 AND b2<3 AND b3>4;";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
 
         assert(parser_parse(parser, scanner, query));
 
@@ -164,10 +165,12 @@ static void select_test(void)
         assert(query->as.select.predicates[1].left.type == TOKEN_IDENT);
         assert(query->as.select.predicates[1].op.type == TOKEN_LESS);
         assert(query->as.select.predicates[1].right.type == TOKEN_NUMBER);
+        assert(query->as.select.predicates[1].right_value == 3);
 
         assert(query->as.select.predicates[2].left.type == TOKEN_IDENT);
         assert(query->as.select.predicates[2].op.type == TOKEN_GREATER);
         assert(query->as.select.predicates[2].right.type == TOKEN_NUMBER);
+        assert(query->as.select.predicates[2].right_value == 4);
 
         scanner_destroy(scanner);
         parser_destroy(parser);
@@ -177,9 +180,9 @@ static void select_test(void)
     {
         const char *query_str = "SELECT a1, a2 FROM r1 ORDER BY a3 DESC;";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
 
         assert(parser_parse(parser, scanner, query));
         assert(query->tag == QUERY_SELECT);
@@ -193,9 +196,9 @@ static void select_test(void)
 
         query_str = "SELECT a1, a2 FROM r1 ORDER BY a3;";
 
-        scanner = scanner_create(query_str);
-        parser = parser_create();
-        query = query_create();
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
 
         assert(parser_parse(parser, scanner, query));
         assert(query->as.select.has_order);
@@ -208,9 +211,9 @@ static void select_test(void)
 
         query_str = "SELECT a1, a2 FROM r1 ORDER BY a3 ASC;";
 
-        scanner = scanner_create(query_str);
-        parser = parser_create();
-        query = query_create();
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
 
         assert(parser_parse(parser, scanner, query));
         assert(query->as.select.has_order);
@@ -221,6 +224,65 @@ static void select_test(void)
         parser_destroy(parser);
         query_destroy(query);
     }
+
+    {
+        const char *query_str = "SELECT a1 FROM r1 ORDER BY a1 DESC LIMIT 10 OFFSET 20;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+        assert(query->as.select.has_order);
+        assert(query->as.select.has_limit);
+        assert(query->as.select.limit == 10);
+        assert(query->as.select.offset == 20);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        query_str = "SELECT a1 FROM r1 limit 3000000000;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+        assert(!query->as.select.has_order);
+        assert(query->as.select.has_limit);
+        assert(query->as.select.limit == 3000000000u);
+        assert(query->as.select.offset == 0);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* Offset needs a limit, numbers are required */
+        query_str = "SELECT a1 FROM r1 OFFSET 1;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        query_str = "SELECT a1 FROM r1 LIMIT a2;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
 }
 
 static void create_table_test(void)
@@ -229,7 +291,7 @@ static void create_table_test(void)
     {
         const char *query = "CREATE TABLE (a1);";
 
-        scanner_t *scanner = scanner_create(query);
+        scanner_t *scanner = scanner_create(NULL, query);
 
         token_t token = scanner_next(scanner);
         assert(token.type == TOKEN_CREATE);
@@ -258,9 +320,9 @@ static void create_table_test(void)
     {
         const char *query_str = "CREATE TABLE rel1 (a1, a2);";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(scanner);
         assert(parser);
         assert(query);
@@ -274,6 +336,29 @@ static void create_table_test(void)
         assert(0 == strncmp(query->as.create_table.attr_names[1], "a2", MAX_ATTR_NAME_LEN));
 
         assert(0 == strncmp(query->as.create_table.rel_name, "rel1", MAX_REL_NAME_LEN));
+        assert(query->as.create_table.layout == LAYOUT_ROWS);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* CREATE TABLE with a columnar layout */
+    {
+        const char *query_str = "CREATE TABLE rel1 (a1, a2) COLUMNAR;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_CREATE_TABLE);
+        assert(query->as.create_table.attr_num == 2);
+        assert(query->as.create_table.layout == LAYOUT_COLUMNS);
 
         scanner_destroy(scanner);
         parser_destroy(parser);
@@ -282,13 +367,99 @@ static void create_table_test(void)
 
 }
 
+static void create_index_test(void)
+{
+    /* index scanner test */
+    {
+        const char *query = "CREATE INDEX idx ON rel1 (a1);";
+
+        scanner_t *scanner = scanner_create(NULL, query);
+
+        const token_type types[] = {TOKEN_CREATE, TOKEN_INDEX, TOKEN_IDENT, TOKEN_ON, TOKEN_IDENT, TOKEN_LPAREN,
+                                    TOKEN_IDENT, TOKEN_RPAREN, TOKEN_SEMICOLON, TOKEN_EOS};
+        for (size_t token_i = 0; token_i < ARRAY_SIZE(types); token_i++)
+            assert(scanner_next(scanner).type == types[token_i]);
+
+        scanner_destroy(scanner);
+    }
+
+    /* basic CREATE INDEX query test */
+    {
+        const char *query_str = "CREATE INDEX idx ON rel1 (a1);";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_CREATE_INDEX);
+        assert(0 == strncmp(query->as.create_index.index_name, "idx", MAX_REL_NAME_LEN));
+        assert(0 == strncmp(query->as.create_index.rel_name, "rel1", MAX_REL_NAME_LEN));
+        assert(0 == strncmp(query->as.create_index.attr_name, "a1", MAX_ATTR_NAME_LEN));
+        assert(query->as.create_index.type == INDEX_BTREE);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* hash index test */
+    {
+        const char *query_str = "CREATE INDEX idx ON rel1 (a1) HASH;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_CREATE_INDEX);
+        assert(0 == strncmp(query->as.create_index.attr_name, "a1", MAX_ATTR_NAME_LEN));
+        assert(query->as.create_index.type == INDEX_HASH);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* Indexes are over a single attribute */
+    {
+        const char *query_strs[] = {
+            "CREATE INDEX idx ON rel1 (a1, a2);",
+            "CREATE INDEX idx rel1 (a1);",
+            "CREATE INDEX ON rel1 (a1);",
+            "CREATE INDEX idx ON rel1;",
+            "CREATE INDEX idx ON rel1 (a1) ORDER;",
+        };
+
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(query_strs); query_i++) {
+            scanner_t *scanner = scanner_create(NULL, query_strs[query_i]);
+            parser_t *parser = parser_create(NULL);
+            query_t *query = query_create(NULL);
+
+            assert(!parser_parse(parser, scanner, query));
+
+            scanner_destroy(scanner);
+            parser_destroy(parser);
+            query_destroy(query);
+        }
+    }
+}
+
 static void insert_test(void)
 {
     /* insert scanner test */
     {
         const char *query = "INSERT INTO rel1 VALUES (111);";
 
-        scanner_t *scanner = scanner_create(query);
+        scanner_t *scanner = scanner_create(NULL, query);
 
         token_t token = scanner_next(scanner);
         assert(token.type == TOKEN_INSERT);
@@ -323,9 +494,9 @@ static void insert_test(void)
     {
         const char *query_str = "INSERT INTO rel1 VALUES (111, 222);";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(scanner);
         assert(parser);
         assert(query);
@@ -337,6 +508,8 @@ static void insert_test(void)
         assert(0 == strncmp(query->as.insert.rel_name, "rel1", MAX_REL_NAME_LEN));
 
         assert(query->as.insert.value_num == 2);
+        assert(query->as.insert.attr_num == 2);
+        assert(query->as.insert.tuple_num == 1);
         assert(query->as.insert.values[0] == 111);
         assert(query->as.insert.values[1] == 222);
 
@@ -345,6 +518,278 @@ static void insert_test(void)
         query_destroy(query);
     }
 
+    /* Many tuples, values of a tuple next to each other */
+    {
+        const char *query_str = "INSERT INTO rel1 VALUES (1, 2), (3, 4), (5, 4294967295);";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_INSERT);
+        assert(query->as.insert.value_num == 6);
+        assert(query->as.insert.attr_num == 2);
+        assert(query->as.insert.tuple_num == 3);
+        for (value_type_t value_i = 0; value_i < 5; value_i++)
+            assert(query->as.insert.values[value_i] == value_i + 1);
+        assert(query->as.insert.values[5] == UINT32_MAX);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* More values than fit a single tuple, parsed into an arena */
+    {
+        const uint32_t tuple_num = 30000;
+        char *query_str = malloc(tuple_num * 32 + 64);
+        assert(query_str);
+        char *pos = query_str + sprintf(query_str, "INSERT INTO rel1 VALUES ");
+        for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+            pos += sprintf(pos, "%s(%u, %u, %u)", tuple_i ? ", " : "", tuple_i, tuple_i * 2, tuple_i * 3);
+        sprintf(pos, ";");
+
+        arena_t *arena = arena_create();
+        scanner_t *scanner = scanner_create(arena, query_str);
+        parser_t *parser = parser_create(arena);
+        query_t *query = query_create(arena);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->as.insert.value_num == tuple_num * 3);
+        assert(query->as.insert.attr_num == 3);
+        assert(query->as.insert.tuple_num == tuple_num);
+        for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+            for (uint32_t attr_i = 0; attr_i < 3; attr_i++)
+                assert(query->as.insert.values[tuple_i * 3 + attr_i] == tuple_i * (attr_i + 1));
+
+        arena_destroy(arena);
+        free(query_str);
+    }
+
+}
+
+static void set_test(void)
+{
+    /* basic SET query test */
+    {
+        const char *query_str = "SET sort_memory_kb = 1024;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_SET);
+
+        assert(0 == strncmp(query->as.set.name, "sort_memory_kb", MAX_ATTR_NAME_LEN));
+        assert(query->as.set.value == 1024);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+}
+
+static void copy_test(void)
+{
+    /* Paths are kept without the quotes */
+    {
+        const char *query_str = "COPY rel1 FROM '/tmp/some dir/rel1.csv';";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_COPY);
+
+        assert(0 == strncmp(query->as.copy.rel_name, "rel1", MAX_REL_NAME_LEN));
+        assert(0 == strcmp(query->as.copy.path, "/tmp/some dir/rel1.csv"));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+}
+
+static void prepare_test(void)
+{
+    /* A select with parameters numbered in the order of predicates */
+    {
+        const char *query_str = "PREPARE by_id AS SELECT a1, a2 FROM rel1 WHERE a1 = ? AND a2 > 5 AND a3 < ? LIMIT 10;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_PREPARE);
+        assert(0 == strncmp(query->as.prepare.name, "by_id", MAX_REL_NAME_LEN));
+
+        const query_select_t *select = &query->as.prepare.select;
+        assert(select->attr_num == 2);
+        assert(select->rel_num == 1);
+        assert(0 == strncmp(select->rel_names[0], "rel1", MAX_REL_NAME_LEN));
+        assert(select->pred_num == 3);
+        assert(select->predicates[0].right.type == TOKEN_PARAM);
+        assert(select->predicates[1].right.type == TOKEN_NUMBER);
+        assert(select->predicates[2].right.type == TOKEN_PARAM);
+        assert(select->param_num == 2);
+        assert(select->has_limit && select->limit == 10);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* Execute with values and without */
+    {
+        const char *query_str = "EXECUTE by_id (42, 7);";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_EXECUTE);
+        assert(0 == strncmp(query->as.execute.name, "by_id", MAX_REL_NAME_LEN));
+        assert(query->as.execute.value_num == 2);
+        assert(query->as.execute.values[0] == 42);
+        assert(query->as.execute.values[1] == 7);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        query_str = "execute by_id;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_EXECUTE);
+        assert(query->as.execute.value_num == 0);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* An empty list of values is no values too */
+        query_str = "EXECUTE by_id ();";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_EXECUTE);
+        assert(query->as.execute.value_num == 0);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* Deallocate */
+    {
+        const char *query_str = "DEALLOCATE by_id;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+
+        assert(query->tag == QUERY_DEALLOCATE);
+        assert(0 == strncmp(query->as.deallocate.name, "by_id", MAX_REL_NAME_LEN));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+}
+
+static void aggregate_test(void)
+{
+    /* Aggregates among attributes, group attributes */
+    {
+        const char *query_str = "SELECT a1, count(*), SUM(a2), Min(a3), max(a2) FROM r1 WHERE a2 > 1 GROUP BY a1, a4 "
+            "ORDER BY a1;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+        assert(query->tag == QUERY_SELECT);
+
+        const query_select_t *select = &query->as.select;
+        assert(select->attr_num == 1);
+        assert(0 == strncmp(select->attr_names[0], "a1", MAX_ATTR_NAME_LEN));
+
+        assert(select->aggregate_num == 4);
+        assert(select->aggregates[0].func == AGGREGATE_COUNT);
+        assert(select->aggregates[0].attr_name == NULL);
+        assert(0 == strcmp(select->aggregates[0].name, "count(*)"));
+        assert(select->aggregates[0].output_i == 1);
+        assert(select->aggregates[1].func == AGGREGATE_SUM);
+        assert(0 == strcmp(select->aggregates[1].attr_name, "a2"));
+        assert(0 == strcmp(select->aggregates[1].name, "sum(a2)"));
+        assert(select->aggregates[2].func == AGGREGATE_MIN);
+        assert(0 == strcmp(select->aggregates[2].name, "min(a3)"));
+        assert(select->aggregates[3].func == AGGREGATE_MAX);
+        assert(select->aggregates[3].output_i == 4);
+
+        assert(select->pred_num == 1);
+        assert(select->group_attr_num == 2);
+        assert(0 == strncmp(select->group_attr_names[0], "a1", MAX_ATTR_NAME_LEN));
+        assert(0 == strncmp(select->group_attr_names[1], "a4", MAX_ATTR_NAME_LEN));
+        assert(select->has_order);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* Aggregates first, no groups */
+        query_str = "SELECT count(a1), a2 FROM r1;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(parser_parse(parser, scanner, query));
+        assert(query->as.select.attr_num == 1);
+        assert(query->as.select.aggregate_num == 1);
+        assert(query->as.select.aggregates[0].output_i == 0);
+        assert(0 == strcmp(query->as.select.aggregates[0].attr_name, "a1"));
+        assert(query->as.select.group_attr_num == 0);
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
 }
 
 static void error_test(void)
@@ -359,9 +804,9 @@ static void error_test(void)
         /* No INTO */
         const char *query_str = "INSERT rel1 VALUES (111, 222);";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(scanner);
         assert(parser);
         assert(query);
@@ -375,9 +820,9 @@ static void error_test(void)
         /* No VALUES */
         query_str = "INSERT INTO rel1 (111, 222);";
 
-        scanner = scanner_create(query_str);
-        parser = parser_create();
-        query = query_create();
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
 
         assert(!parser_parse(parser, scanner, query));
 
@@ -388,9 +833,9 @@ static void error_test(void)
         /* Invalid value list */
         query_str = "INSERT INTO rel1 VALUES ();";
 
-        scanner = scanner_create(query_str);
-        parser = parser_create();
-        query = query_create();
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
 
         assert(!parser_parse(parser, scanner, query));
 
@@ -400,9 +845,48 @@ static void error_test(void)
 
         query_str = "INSERT INTO rel1 VALUES (111,);";
 
-        scanner = scanner_create(query_str);
-        parser = parser_create();
-        query = query_create();
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* Tuples of different sizes */
+        query_str = "INSERT INTO rel1 VALUES (111, 222), (333);";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* A dangling comma after tuples */
+        query_str = "INSERT INTO rel1 VALUES (111, 222),;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* Values not fitting into a value */
+        query_str = "INSERT INTO rel1 VALUES (4294967296, 1), (4294967299, 1);";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
 
         assert(!parser_parse(parser, scanner, query));
 
@@ -411,13 +895,42 @@ static void error_test(void)
         query_destroy(query);
     }
 
+    /* Other numbers out of range */
+    {
+        const char *query_strs[] = {
+            "INSERT INTO rel1 VALUES (1), (99999999999999999999999);",
+            "SELECT a1 FROM rel1 LIMIT 4294967296;",
+            "SELECT a1 FROM rel1 LIMIT 1 OFFSET 4294967296;",
+            "EXECUTE stmt (1, 4294967296);",
+            "SET sort_memory_kb = 4294967297;",
+            "SELECT a1 FROM rel1 WHERE a1 = 4294967296;",
+            "SELECT a1 FROM rel1 WHERE a1 < 1 AND a1 > 18446744073709551617;",
+            "SELECT a1 FROM rel1 WHERE a1 = "
+            "1000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+            "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+            "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000;",
+        };
+
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(query_strs); query_i++) {
+            scanner_t *scanner = scanner_create(NULL, query_strs[query_i]);
+            parser_t *parser = parser_create(NULL);
+            query_t *query = query_create(NULL);
+
+            assert(!parser_parse(parser, scanner, query));
+
+            scanner_destroy(scanner);
+            parser_destroy(parser);
+            query_destroy(query);
+        }
+    }
+
     /* CREATE TABLE errors */
     {
         const char *query_str = "CREATE rel1;";
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
 
         assert(!parser_parse(parser, scanner, query));
 
@@ -427,9 +940,9 @@ static void error_test(void)
 
         query_str = "CREATE TABLE rel1;";
 
-        scanner = scanner_create(query_str);
-        parser = parser_create();
-        query = query_create();
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
 
         assert(!parser_parse(parser, scanner, query));
 
@@ -439,9 +952,9 @@ static void error_test(void)
 
         query_str = "CREATE TABLE rel1 (a1,);";
 
-        scanner = scanner_create(query_str);
-        parser = parser_create();
-        query = query_create();
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
 
         assert(!parser_parse(parser, scanner, query));
 
@@ -450,6 +963,146 @@ static void error_test(void)
         query_destroy(query);
     }
 
+    /* COPY errors */
+    {
+        /* No closing quote */
+        const char *query_str = "COPY rel1 FROM 'rel1.csv;";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* No FROM */
+        query_str = "COPY rel1 'rel1.csv';";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* Not a string */
+        query_str = "COPY rel1 FROM rel1;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* PREPARE and EXECUTE errors */
+    {
+        /* Only selects get prepared */
+        const char *query_str = "PREPARE q AS INSERT INTO rel1 VALUES (1);";
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* No AS */
+        query_str = "PREPARE q SELECT a1 FROM rel1;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* Parameters are constants on the right */
+        query_str = "PREPARE q AS SELECT a1 FROM rel1 WHERE ? = a1;";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* Values only */
+        query_str = "EXECUTE q (?);";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+
+        /* No trailing commas */
+        query_str = "EXECUTE q (1,);";
+
+        scanner = scanner_create(NULL, query_str);
+        parser = parser_create(NULL);
+        query = query_create(NULL);
+
+        assert(!parser_parse(parser, scanner, query));
+
+        scanner_destroy(scanner);
+        parser_destroy(parser);
+        query_destroy(query);
+    }
+
+    /* Aggregate errors */
+    {
+        const char *bad_queries[] = {
+            /* Only counts take a star */
+            "SELECT sum(*) FROM r1;",
+            /* No parentheses */
+            "SELECT count a1 FROM r1;",
+            "SELECT count(a1 FROM r1;",
+            /* Aggregate names are reserved */
+            "SELECT count FROM r1;",
+            /* No BY, no group attributes */
+            "SELECT a1 FROM r1 GROUP a1;",
+            "SELECT a1 FROM r1 GROUP BY;",
+            /* Groups come before the order */
+            "SELECT a1 FROM r1 ORDER BY a1 GROUP BY a1;",
+        };
+
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(bad_queries); query_i++) {
+            scanner_t *scanner = scanner_create(NULL, bad_queries[query_i]);
+            parser_t *parser = parser_create(NULL);
+            query_t *query = query_create(NULL);
+
+            assert(!parser_parse(parser, scanner, query));
+
+            scanner_destroy(scanner);
+            parser_destroy(parser);
+            query_destroy(query);
+        }
+    }
+
     /* Get back normal stderr */
     dup2(stderr_fd, 2);
 }
@@ -460,7 +1113,12 @@ int main(int argc, char *argv[])
 
     select_test();
     create_table_test();
+    create_index_test();
     insert_test();
+    set_test();
+    copy_test();
+    prepare_test();
+    aggregate_test();
 
     error_test();
 
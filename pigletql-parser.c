@@ -4,29 +4,38 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
 
 #include "pigletql-parser.h"
+#include "pigletql-intern.h"
 
 typedef struct scanner_t {
+    arena_t *arena;
     const char *input;
     const char *token_start;
 } scanner_t;
 
 typedef struct parser_t {
+    arena_t *arena;
     scanner_t *scanner;
     query_t *query;
 
     token_t current;
     token_t previous;
 
+    /* Values an insert has room for */
+    uint32_t insert_value_slots;
+
     bool had_error;
 } parser_t;
 
-scanner_t *scanner_create(const char *string)
+scanner_t *scanner_create(arena_t *arena, const char *string)
 {
-    scanner_t *scanner = calloc(1, sizeof(*scanner));
+    scanner_t *scanner = arena_calloc(arena, 1, sizeof(*scanner));
     assert(scanner);
 
+    scanner->arena = arena;
     scanner->input = string;
 
     return scanner;
@@ -35,7 +44,7 @@ scanner_t *scanner_create(const char *string)
 void scanner_destroy(scanner_t *scanner)
 {
     if (scanner)
-        free(scanner);
+        arena_free(scanner->arena, scanner);
 }
 
 static bool char_is_alpha(char c)
@@ -121,31 +130,96 @@ static token_type scan_keyword(scanner_t *scanner, int start, int length, const
 static token_type scan_ident_type(scanner_t *scanner)
 {
     switch(scanner_peek_start(scanner)) {
-    case 's': return scan_keyword(scanner, 1, 5, "elect", TOKEN_SELECT);
+    case 's': {
+        /* either SELECT, SET or SUM */
+        token_type t = scan_keyword(scanner, 1, 5, "elect", TOKEN_SELECT);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        t = scan_keyword(scanner, 1, 2, "et", TOKEN_SET);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        return scan_keyword(scanner, 1, 2, "um", TOKEN_SUM);
+    }
     case 'f': return scan_keyword(scanner, 1, 3, "rom", TOKEN_FROM);
     case 'w': return scan_keyword(scanner, 1, 4, "here", TOKEN_WHERE);
     case 'a': {
-        /* either AND or ASC here */
+        /* either AND, ASC or AS here */
         token_type t = scan_keyword(scanner, 1, 2, "nd", TOKEN_AND);
         if (t != TOKEN_IDENT)
             return t;
 
-        return scan_keyword(scanner, 1, 2, "sc", TOKEN_ASC);;
+        t = scan_keyword(scanner, 1, 2, "sc", TOKEN_ASC);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        return scan_keyword(scanner, 1, 1, "s", TOKEN_AS);
     }
-    case 'o': return scan_keyword(scanner, 1, 4, "rder", TOKEN_ORDER);
+    case 'o': {
+        /* either ORDER, OFFSET or ON */
+        token_type t = scan_keyword(scanner, 1, 4, "rder", TOKEN_ORDER);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        t = scan_keyword(scanner, 1, 5, "ffset", TOKEN_OFFSET);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        return scan_keyword(scanner, 1, 1, "n", TOKEN_ON);
+    }
+    case 'l': return scan_keyword(scanner, 1, 4, "imit", TOKEN_LIMIT);
     case 'b': return scan_keyword(scanner, 1, 1, "y", TOKEN_BY);
-    case 'd': return scan_keyword(scanner, 1, 3, "esc", TOKEN_DESC);
-    case 'c': return scan_keyword(scanner, 1, 5, "reate", TOKEN_CREATE);
+    case 'd': {
+        /* either DESC or DEALLOCATE */
+        token_type t = scan_keyword(scanner, 1, 3, "esc", TOKEN_DESC);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        return scan_keyword(scanner, 1, 9, "eallocate", TOKEN_DEALLOCATE);
+    }
+    case 'p': return scan_keyword(scanner, 1, 6, "repare", TOKEN_PREPARE);
+    case 'e': return scan_keyword(scanner, 1, 6, "xecute", TOKEN_EXECUTE);
+    case 'c': {
+        /* either CREATE, COLUMNAR, COPY or COUNT */
+        token_type t = scan_keyword(scanner, 1, 5, "reate", TOKEN_CREATE);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        t = scan_keyword(scanner, 1, 7, "olumnar", TOKEN_COLUMNAR);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        t = scan_keyword(scanner, 1, 3, "opy", TOKEN_COPY);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        return scan_keyword(scanner, 1, 4, "ount", TOKEN_COUNT);
+    }
     case 't': return scan_keyword(scanner, 1, 4, "able", TOKEN_TABLE);
     case 'i': {
-        /* either INTO or INSERT */
+        /* either INTO, INSERT or INDEX */
         token_type t = scan_keyword(scanner, 1, 5, "nsert", TOKEN_INSERT);
         if (t != TOKEN_IDENT)
             return t;
 
-        return scan_keyword(scanner, 1, 3, "nto", TOKEN_INTO);;
+        t = scan_keyword(scanner, 1, 3, "nto", TOKEN_INTO);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        return scan_keyword(scanner, 1, 4, "ndex", TOKEN_INDEX);
     }
     case 'v': return scan_keyword(scanner, 1, 5, "alues", TOKEN_VALUES);
+    case 'h': return scan_keyword(scanner, 1, 3, "ash", TOKEN_HASH);
+    case 'g': return scan_keyword(scanner, 1, 4, "roup", TOKEN_GROUP);
+    case 'm': {
+        /* either MIN or MAX */
+        token_type t = scan_keyword(scanner, 1, 2, "in", TOKEN_MIN);
+        if (t != TOKEN_IDENT)
+            return t;
+
+        return scan_keyword(scanner, 1, 2, "ax", TOKEN_MAX);
+    }
     }
     return TOKEN_IDENT;
 }
@@ -166,6 +240,19 @@ static token_t scanner_number(scanner_t *scanner)
     return scanner_token_create(scanner, TOKEN_NUMBER);
 }
 
+/* Strings are single-quoted, the token includes the quotes */
+static token_t scanner_string(scanner_t *scanner)
+{
+    while (!scanner_at_eos(scanner) && scanner_peek(scanner) != '\'')
+        scanner_advance(scanner);
+
+    if (scanner_at_eos(scanner))
+        return scanner_token_error_create("Unterminated string");
+
+    scanner_advance(scanner);
+    return scanner_token_create(scanner, TOKEN_STRING);
+}
+
 token_t scanner_next(scanner_t *scanner)
 {
     scanner_skip_space(scanner);
@@ -192,88 +279,240 @@ token_t scanner_next(scanner_t *scanner)
     case '>': return scanner_token_create(scanner, TOKEN_GREATER);
     case '(': return scanner_token_create(scanner, TOKEN_LPAREN);
     case ')': return scanner_token_create(scanner, TOKEN_RPAREN);
+    case '?': return scanner_token_create(scanner, TOKEN_PARAM);
+    case '\'': return scanner_string(scanner);
     }
 
     return scanner_token_error_create("Unknown character");
 }
 
 
-query_t *query_create(void)
+query_t *query_create(arena_t *arena)
 {
-    query_t *query = calloc(1, sizeof(*query));
+    query_t *query = arena_calloc(arena, 1, sizeof(*query));
     if (!query)
         return NULL;
+    query->arena = arena;
     return query;
 }
 
+static void query_select_destroy(arena_t *arena, query_select_t *select)
+{
+    arena_free(arena, select->attr_names);
+    arena_free(arena, select->aggregates);
+    arena_free(arena, select->rel_names);
+    arena_free(arena, select->predicates);
+    arena_free(arena, select->group_attr_names);
+}
+
 void query_destroy(query_t *query)
 {
-    if (query)
-        free(query);
+    if (!query)
+        return;
+
+    arena_t *arena = query->arena;
+    switch (query->tag) {
+    case QUERY_SELECT:
+        query_select_destroy(arena, &query->as.select);
+        break;
+    case QUERY_CREATE_TABLE:
+        arena_free(arena, query->as.create_table.attr_names);
+        break;
+    case QUERY_CREATE_INDEX:
+        break;
+    case QUERY_INSERT:
+        arena_free(arena, query->as.insert.values);
+        break;
+    case QUERY_SET:
+        break;
+    case QUERY_COPY:
+        arena_free(arena, (char *)query->as.copy.path);
+        break;
+    case QUERY_PREPARE:
+        query_select_destroy(arena, &query->as.prepare.select);
+        break;
+    case QUERY_EXECUTE:
+        arena_free(arena, query->as.execute.values);
+        break;
+    case QUERY_DEALLOCATE:
+        break;
+    }
+    arena_free(arena, query);
+}
+
+/* Grow an array by one element, arrays only hold as many elements as parsed */
+static void *query_array_append(query_t *query, void *array, const uint16_t num, const size_t elem_size)
+{
+    assert(num < UINT16_MAX);
+    array = arena_realloc(query->arena, array, num * elem_size, (num + 1) * elem_size);
+    assert(array);
+    return array;
+}
+
+static const char *token_intern(const token_t token)
+{
+    return intern_n(token.start, (size_t)token.length);
+}
+
+/* Selects are either queries of their own or prepared ones */
+static query_select_t *query_get_select(query_t *query)
+{
+    return query->tag == QUERY_PREPARE ? &query->as.prepare.select : &query->as.select;
 }
 
 static void query_select_add_attr(query_t *query, token_t token)
 {
-    strncpy(query->as.select.attr_names[query->as.select.attr_num], token.start, (size_t)token.length);
-    query->as.select.attr_num++;
+    query_select_t *select = query_get_select(query);
+    select->attr_names = query_array_append(query, select->attr_names, select->attr_num, sizeof(const char *));
+    select->attr_names[select->attr_num++] = token_intern(token);
+}
+
+static aggregate_func_t token_aggregate_func(const token_t token)
+{
+    switch (token.type) {
+    case TOKEN_COUNT: return AGGREGATE_COUNT;
+    case TOKEN_SUM: return AGGREGATE_SUM;
+    case TOKEN_MIN: return AGGREGATE_MIN;
+    case TOKEN_MAX: return AGGREGATE_MAX;
+    default:
+        assert(false);
+    }
+}
+
+/* The attribute token is a star for COUNT(*) */
+static void query_select_add_aggregate(query_t *query, token_t func, token_t attr)
+{
+    query_select_t *select = query_get_select(query);
+    select->aggregates = query_array_append(query, select->aggregates, select->aggregate_num,
+                                            sizeof(query_aggregate_t));
+    query_aggregate_t *aggregate = &select->aggregates[select->aggregate_num++];
+    aggregate->func = token_aggregate_func(func);
+    aggregate->attr_name = attr.type == TOKEN_STAR ? NULL : token_intern(attr);
+    aggregate->output_i = (uint16_t)(select->attr_num + select->aggregate_num - 1);
+
+    /* Output names are spelled the way aggregates are, in lower case */
+    char name[MAX_ATTR_NAME_LEN];
+    int len = snprintf(name, sizeof(name), "%.*s(%.*s)", func.length, func.start, attr.length, attr.start);
+    if (len >= (int)sizeof(name))
+        len = sizeof(name) - 1;
+    for (int i = 0; i < func.length; i++)
+        name[i] = (char)tolower(name[i]);
+    aggregate->name = intern_n(name, (size_t)len);
+}
+
+static void query_select_add_group_attr(query_t *query, token_t token)
+{
+    query_select_t *select = query_get_select(query);
+    select->group_attr_names = query_array_append(query, select->group_attr_names, select->group_attr_num,
+                                                  sizeof(const char *));
+    select->group_attr_names[select->group_attr_num++] = token_intern(token);
 }
 
 static void query_create_table_add_attr(query_t *query, token_t token)
 {
-    strncpy(query->as.create_table.attr_names[query->as.create_table.attr_num], token.start, (size_t)token.length);
-    query->as.create_table.attr_num++;
+    query_create_table_t *create_table = &query->as.create_table;
+    create_table->attr_names = query_array_append(query, create_table->attr_names, create_table->attr_num,
+                                                  sizeof(const char *));
+    create_table->attr_names[create_table->attr_num++] = token_intern(token);
 }
 
-static void query_insert_add_value(query_t *query, token_t token)
+/* Inserts can have thousands of tuples, so values grow geometrically */
+static void query_insert_add_value(query_t *query, uint32_t *value_slots, const value_type_t value)
 {
-    query->as.insert.values[query->as.insert.value_num] = (value_type_t)atoi(token.start);
-    query->as.insert.value_num++;
+    query_insert_t *insert = &query->as.insert;
+    if (insert->value_num == *value_slots) {
+        const uint32_t new_value_slots = *value_slots ? *value_slots * 2 : 16;
+        insert->values = arena_realloc(query->arena, insert->values, *value_slots * sizeof(value_type_t),
+                                       new_value_slots * sizeof(value_type_t));
+        assert(insert->values);
+        *value_slots = new_value_slots;
+    }
+    insert->values[insert->value_num++] = value;
+}
+
+static void query_copy_add_path(query_t *query, token_t token)
+{
+    /* Paths are no names, so they are copied without the quotes rather than interned */
+    const size_t path_len = (size_t)token.length - 2;
+    char *path = arena_calloc(query->arena, path_len + 1, 1);
+    assert(path);
+    memcpy(path, token.start + 1, path_len);
+    query->as.copy.path = path;
 }
 
 static void query_select_add_rel(query_t *query, token_t token)
 {
-    strncpy(query->as.select.rel_names[query->as.select.rel_num], token.start, (size_t)token.length);
-    query->as.select.rel_num++;
+    query_select_t *select = query_get_select(query);
+    select->rel_names = query_array_append(query, select->rel_names, select->rel_num, sizeof(const char *));
+    select->rel_names[select->rel_num++] = token_intern(token);
 }
 
 static void query_create_table_add_rel(query_t *query, token_t token)
 {
-    strncpy(query->as.create_table.rel_name, token.start, (size_t)token.length);
+    query->as.create_table.rel_name = token_intern(token);
 }
 
 static void query_insert_add_rel(query_t *query, token_t token)
 {
-    strncpy(query->as.insert.rel_name, token.start, (size_t)token.length);
+    query->as.insert.rel_name = token_intern(token);
 }
 
-static void query_select_add_pred(query_t *query, token_t left_operand, token_t operator, token_t right_operand)
+static void query_select_add_pred(query_t *query, token_t left_operand, token_t operator, token_t right_operand,
+                                  const value_type_t right_value)
 {
-    query->as.select.predicates[query->as.select.pred_num].left = left_operand;
-    query->as.select.predicates[query->as.select.pred_num].op = operator;
-    query->as.select.predicates[query->as.select.pred_num].right = right_operand;
-    query->as.select.pred_num++;
+    query_select_t *select = query_get_select(query);
+    select->predicates = query_array_append(query, select->predicates, select->pred_num, sizeof(query_predicate_t));
+    select->predicates[select->pred_num].left = left_operand;
+    select->predicates[select->pred_num].op = operator;
+    select->predicates[select->pred_num].right = right_operand;
+    select->predicates[select->pred_num].right_value = right_value;
+    select->pred_num++;
+    if (right_operand.type == TOKEN_PARAM)
+        select->param_num++;
 }
 
 static void query_select_add_order_by_attr(query_t *query, token_t token)
 {
-    query->as.select.has_order = true;
-    strncpy(query->as.select.order_by_attr, token.start, (size_t)token.length);
+    query_select_t *select = query_get_select(query);
+    select->has_order = true;
+    select->order_by_attr = token_intern(token);
 }
 
 static void query_select_add_sort_order(query_t *query, token_t token)
 {
+    query_select_t *select = query_get_select(query);
     if (token.type == TOKEN_ASC) {
-        query->as.select.order_type = SORT_ASC;
+        select->order_type = SORT_ASC;
     } else {
-        query->as.select.order_type = SORT_DESC;
+        select->order_type = SORT_DESC;
     }
 }
 
-parser_t *parser_create(void)
+static void query_select_add_limit(query_t *query, const value_type_t limit)
+{
+    query_select_t *select = query_get_select(query);
+    select->has_limit = true;
+    select->limit = limit;
+}
+
+static void query_select_add_offset(query_t *query, const value_type_t offset)
+{
+    query_get_select(query)->offset = offset;
+}
+
+static void query_execute_add_value(query_t *query, const value_type_t value)
+{
+    query_execute_t *execute = &query->as.execute;
+    execute->values = query_array_append(query, execute->values, execute->value_num, sizeof(value_type_t));
+    execute->values[execute->value_num++] = value;
+}
+
+parser_t *parser_create(arena_t *arena)
 {
-    parser_t *parser = calloc(1, sizeof(*parser));
+    parser_t *parser = arena_calloc(arena, 1, sizeof(*parser));
     if (!parser)
         return NULL;
+    parser->arena = arena;
     return parser;
 
 }
@@ -281,7 +520,7 @@ parser_t *parser_create(void)
 void parser_destroy(parser_t *parser)
 {
     if (parser)
-        free(parser);
+        arena_free(parser->arena, parser);
 }
 
 static void parser_error_at(parser_t *parser, token_t token, const char *msg)
@@ -313,6 +552,21 @@ static void parser_error_at_current(parser_t *parser, const char *msg)
     parser_error_at(parser, parser->current, msg);
 }
 
+/* The value of the number just consumed, values not fitting into value_type_t are errors */
+static value_type_t parser_number_value(parser_t *parser)
+{
+    if (parser->previous.type != TOKEN_NUMBER)
+        return 0;
+
+    errno = 0;
+    const unsigned long long value = strtoull(parser->previous.start, NULL, 10);
+    if (errno == ERANGE || value > UINT32_MAX) {
+        parser_error(parser, "Value out of range");
+        return 0;
+    }
+    return (value_type_t)value;
+}
+
 static void parser_advance(parser_t *parser)
 {
     parser->previous = parser->current;
@@ -361,13 +615,45 @@ static void parse_predicate(parser_t *parser)
     token_t op = parser->previous;
 
     if (!parser_match(parser, TOKEN_IDENT) &&
-        !parser_match(parser, TOKEN_NUMBER)) {
-        parser_error(parser, "Right predicate identifier or number expected");
+        !parser_match(parser, TOKEN_NUMBER) &&
+        !parser_match(parser, TOKEN_PARAM)) {
+        parser_error(parser, "Right predicate identifier, number or parameter expected");
         return;
     }
     token_t right = parser->previous;
 
-    query_select_add_pred(parser->query, left, op, right);
+    query_select_add_pred(parser->query, left, op, right, parser_number_value(parser));
+}
+
+static void parse_select_item(parser_t *parser)
+{
+    if (!parser_match(parser, TOKEN_COUNT) &&
+        !parser_match(parser, TOKEN_SUM) &&
+        !parser_match(parser, TOKEN_MIN) &&
+        !parser_match(parser, TOKEN_MAX)) {
+        parser_consume(parser, TOKEN_IDENT, "Attribute name or aggregate expected");
+        query_select_add_attr(parser->query, parser->previous);
+        return;
+    }
+    token_t func = parser->previous;
+
+    parser_consume(parser, TOKEN_LPAREN, "LPAREN expected");
+    if (func.type != TOKEN_COUNT || !parser_match(parser, TOKEN_STAR))
+        parser_consume(parser, TOKEN_IDENT, "Attribute name expected");
+    token_t attr = parser->previous;
+    parser_consume(parser, TOKEN_RPAREN, "RPAREN expected");
+
+    query_select_add_aggregate(parser->query, func, attr);
+}
+
+static void parse_group(parser_t *parser)
+{
+    parser_consume(parser, TOKEN_BY, "GROUP should always be followed by BY");
+
+    do {
+        parser_consume(parser, TOKEN_IDENT, "Attribute name expected");
+        query_select_add_group_attr(parser->query, parser->previous);
+    } while (parser_match(parser, TOKEN_COMMA));
 }
 
 static void parse_order(parser_t *parser)
@@ -381,12 +667,22 @@ static void parse_order(parser_t *parser)
         query_select_add_sort_order(parser->query, parser->previous);
 }
 
+static void parse_limit(parser_t *parser)
+{
+    parser_consume(parser, TOKEN_NUMBER, "Number of tuples expected");
+    query_select_add_limit(parser->query, parser_number_value(parser));
+
+    if (parser_match(parser, TOKEN_OFFSET)) {
+        parser_consume(parser, TOKEN_NUMBER, "Number of tuples to skip expected");
+        query_select_add_offset(parser->query, parser_number_value(parser));
+    }
+}
+
 static void parse_select(parser_t *parser)
 {
-    /* Collect attribute names */
+    /* Collect attribute names and aggregates */
     do {
-        parser_consume(parser, TOKEN_IDENT, "Attribute name expected");
-        query_select_add_attr(parser->query, parser->previous);
+        parse_select_item(parser);
     } while (parser_match(parser, TOKEN_COMMA));
 
     /* Collect relation names */
@@ -404,9 +700,17 @@ static void parse_select(parser_t *parser)
         } while (parser_match(parser, TOKEN_AND));
     }
 
+    /* Group by */
+    if (parser_match(parser, TOKEN_GROUP))
+        parse_group(parser);
+
     /* Order by */
     if (parser_match(parser, TOKEN_ORDER))
         parse_order(parser);
+
+    /* Limit */
+    if (parser_match(parser, TOKEN_LIMIT))
+        parse_limit(parser);
 }
 
 static void parser_create_table(parser_t *parser)
@@ -422,6 +726,56 @@ static void parser_create_table(parser_t *parser)
         query_create_table_add_attr(parser->query, parser->previous);
     } while (parser_match(parser, TOKEN_COMMA));
     parser_consume(parser, TOKEN_RPAREN, "RPAREN expected");
+
+    /* Storage layout */
+    if (parser_match(parser, TOKEN_COLUMNAR))
+        parser->query->as.create_table.layout = LAYOUT_COLUMNS;
+}
+
+static void parser_create_index(parser_t *parser)
+{
+    /* Index name */
+    parser_consume(parser, TOKEN_IDENT, "Index name expected");
+    parser->query->as.create_index.index_name = token_intern(parser->previous);
+
+    /* Relation name */
+    parser_consume(parser, TOKEN_ON, "ON expected");
+    parser_consume(parser, TOKEN_IDENT, "Relation name expected");
+    parser->query->as.create_index.rel_name = token_intern(parser->previous);
+
+    /* A single attribute */
+    parser_consume(parser, TOKEN_LPAREN, "LPAREN expected");
+    parser_consume(parser, TOKEN_IDENT, "Attribute name expected");
+    parser->query->as.create_index.attr_name = token_intern(parser->previous);
+    parser_consume(parser, TOKEN_RPAREN, "RPAREN expected");
+
+    /* Index type */
+    if (parser_match(parser, TOKEN_HASH))
+        parser->query->as.create_index.type = INDEX_HASH;
+}
+
+static void parser_insert_tuple(parser_t *parser)
+{
+    query_insert_t *insert = &parser->query->as.insert;
+    const uint32_t first_value_i = insert->value_num;
+
+    /* Value list */
+    parser_consume(parser, TOKEN_LPAREN, "LPAREN expected");
+    do {
+        parser_consume(parser, TOKEN_NUMBER, "An integer value expected");
+        query_insert_add_value(parser->query, &parser->insert_value_slots, parser_number_value(parser));
+    } while (parser_match(parser, TOKEN_COMMA));
+    parser_consume(parser, TOKEN_RPAREN, "RPAREN expected");
+
+    /* Tuples are checked against the relation once, so they should all look the same */
+    const uint32_t value_num = insert->value_num - first_value_i;
+    if (value_num > MAX_ATTR_NUM)
+        parser_error(parser, "Too many values in a tuple");
+    else if (insert->tuple_num == 0)
+        insert->attr_num = (uint16_t)value_num;
+    else if (value_num != insert->attr_num)
+        parser_error(parser, "Tuples should have the same number of values");
+    insert->tuple_num++;
 }
 
 static void parser_insert(parser_t *parser)
@@ -430,30 +784,102 @@ static void parser_insert(parser_t *parser)
     parser_consume(parser, TOKEN_IDENT, "Relation name expected");
     query_insert_add_rel(parser->query, parser->previous);
 
-    /* Value list */
+    /* Tuple list */
     parser_consume(parser, TOKEN_VALUES, "VALUES expected");
+    parser->insert_value_slots = 0;
+    do {
+        parser_insert_tuple(parser);
+    } while (parser_match(parser, TOKEN_COMMA) && !parser->had_error);
+}
 
-    parser_consume(parser, TOKEN_LPAREN, "LPAREN expected");
+static void parser_set(parser_t *parser)
+{
+    parser_consume(parser, TOKEN_IDENT, "Setting name expected");
+    parser->query->as.set.name = token_intern(parser->previous);
+
+    parser_consume(parser, TOKEN_EQUAL, "EQUAL expected");
+
+    parser_consume(parser, TOKEN_NUMBER, "An integer value expected");
+    parser->query->as.set.value = parser_number_value(parser);
+}
+
+static void parser_copy(parser_t *parser)
+{
+    parser_consume(parser, TOKEN_IDENT, "Relation name expected");
+    parser->query->as.copy.rel_name = token_intern(parser->previous);
+
+    parser_consume(parser, TOKEN_FROM, "FROM expected");
+
+    parser_consume(parser, TOKEN_STRING, "A quoted file path expected");
+    if (!parser->had_error)
+        query_copy_add_path(parser->query, parser->previous);
+}
+
+static void parser_prepare(parser_t *parser)
+{
+    parser_consume(parser, TOKEN_IDENT, "Prepared statement name expected");
+    parser->query->as.prepare.name = token_intern(parser->previous);
+
+    /* Only selects get prepared */
+    parser_consume(parser, TOKEN_AS, "AS expected");
+    parser_consume(parser, TOKEN_SELECT, "SELECT expected");
+    parse_select(parser);
+}
+
+static void parser_execute(parser_t *parser)
+{
+    parser_consume(parser, TOKEN_IDENT, "Prepared statement name expected");
+    parser->query->as.execute.name = token_intern(parser->previous);
+
+    /* Parameter values, if there are any; an empty list is the same as none */
+    if (!parser_match(parser, TOKEN_LPAREN) || parser_match(parser, TOKEN_RPAREN))
+        return;
     do {
         parser_consume(parser, TOKEN_NUMBER, "An integer value expected");
-        query_insert_add_value(parser->query, parser->previous);
+        query_execute_add_value(parser->query, parser_number_value(parser));
     } while (parser_match(parser, TOKEN_COMMA));
     parser_consume(parser, TOKEN_RPAREN, "RPAREN expected");
 }
 
+static void parser_deallocate(parser_t *parser)
+{
+    parser_consume(parser, TOKEN_IDENT, "Prepared statement name expected");
+    parser->query->as.deallocate.name = token_intern(parser->previous);
+}
+
 static void parse_query(parser_t *parser)
 {
     if (parser_match(parser, TOKEN_SELECT)) {
         parser->query->tag = QUERY_SELECT;
         parse_select(parser);
     } else if (parser_match(parser, TOKEN_CREATE)) {
-        parser_consume(parser, TOKEN_TABLE, "TABLE expected");
-        parser->query->tag = QUERY_CREATE_TABLE;
-        parser_create_table(parser);
+        if (parser_match(parser, TOKEN_INDEX)) {
+            parser->query->tag = QUERY_CREATE_INDEX;
+            parser_create_index(parser);
+        } else {
+            parser_consume(parser, TOKEN_TABLE, "TABLE or INDEX expected");
+            parser->query->tag = QUERY_CREATE_TABLE;
+            parser_create_table(parser);
+        }
     } else if (parser_match(parser, TOKEN_INSERT)) {
         parser_consume(parser, TOKEN_INTO, "INTO expected");
         parser->query->tag = QUERY_INSERT;
         parser_insert(parser);
+    } else if (parser_match(parser, TOKEN_SET)) {
+        parser->query->tag = QUERY_SET;
+        parser_set(parser);
+    } else if (parser_match(parser, TOKEN_COPY)) {
+        parser->query->tag = QUERY_COPY;
+        parser_copy(parser);
+    } else if (parser_match(parser, TOKEN_PREPARE)) {
+        parser->query->tag = QUERY_PREPARE;
+        parser_prepare(parser);
+    } else if (parser_match(parser, TOKEN_EXECUTE)) {
+        parser->query->tag = QUERY_EXECUTE;
+        parser_execute(parser);
+    } else if (parser_match(parser, TOKEN_DEALLOCATE)) {
+        parser->query->tag = QUERY_DEALLOCATE;
+        parser_deallocate(parser);
     } else
         parser_error(parser, "Query type unsupported");
 
@@ -4,10 +4,13 @@
 #include <stdbool.h>
 
 #include "pigletql-def.h"
+#include "pigletql-arena.h"
 
 typedef enum token_type {
     TOKEN_IDENT,
     TOKEN_NUMBER,
+    TOKEN_STRING,
+    TOKEN_PARAM,
 
     TOKEN_STAR,
     TOKEN_COMMA,
@@ -23,6 +26,8 @@ typedef enum token_type {
     TOKEN_SELECT,
     TOKEN_CREATE,
     TOKEN_TABLE,
+    TOKEN_INDEX,
+    TOKEN_ON,
     TOKEN_INSERT,
 
     TOKEN_FROM,
@@ -34,9 +39,29 @@ typedef enum token_type {
     TOKEN_ASC,
     TOKEN_DESC,
 
+    TOKEN_LIMIT,
+    TOKEN_OFFSET,
+
     TOKEN_INTO,
     TOKEN_VALUES,
 
+    TOKEN_COLUMNAR,
+    TOKEN_HASH,
+
+    TOKEN_SET,
+    TOKEN_COPY,
+
+    TOKEN_PREPARE,
+    TOKEN_AS,
+    TOKEN_EXECUTE,
+    TOKEN_DEALLOCATE,
+
+    TOKEN_GROUP,
+    TOKEN_COUNT,
+    TOKEN_SUM,
+    TOKEN_MIN,
+    TOKEN_MAX,
+
     TOKEN_ERROR,                /* failed to scan */
     TOKEN_EOS                   /* end of stream */
 } token_type;
@@ -51,53 +76,151 @@ typedef struct query_predicate_t {
     token_t left;
     token_t op;
     token_t right;
+    /* Value of the right operand if it's a number */
+    value_type_t right_value;
 } query_predicate_t;
 
 typedef enum query_tag {
     QUERY_SELECT,
     QUERY_CREATE_TABLE,
+    QUERY_CREATE_INDEX,
     QUERY_INSERT,
+    QUERY_SET,
+    QUERY_COPY,
+    QUERY_PREPARE,
+    QUERY_EXECUTE,
+    QUERY_DEALLOCATE,
 } query_tag;
 
+/* Names below are interned, arrays are sized to the number of elements parsed */
+
+/* An aggregate to output */
+typedef struct query_aggregate_t {
+    aggregate_func_t func;
+    /* Attribute aggregated, NULL for COUNT(*) */
+    const char *attr_name;
+    /* Name of the output attribute, e.g. sum(a1) */
+    const char *name;
+    /* Position among attributes and aggregates to output, attributes take the rest of positions in
+     * the order listed */
+    uint16_t output_i;
+} query_aggregate_t;
+
 typedef struct query_select_t {
     /* Attributes to output */
-    attr_name_t attr_names[MAX_ATTR_NUM];
+    const char **attr_names;
     uint16_t attr_num;
 
+    /* Aggregates to output along with attributes */
+    query_aggregate_t *aggregates;
+    uint16_t aggregate_num;
+
     /* Relations to get tuples from */
-    rel_name_t rel_names[MAX_REL_NUM];
+    const char **rel_names;
     uint16_t rel_num;
 
     /* Predicates to apply to tuples */
-    query_predicate_t predicates[MAX_PRED_NUM];
+    query_predicate_t *predicates;
     uint16_t pred_num;
 
+    /* Attributes to group tuples by, attributes to output should be among them in selects with
+     * groups or aggregates */
+    const char **group_attr_names;
+    uint16_t group_attr_num;
+
+    /* Parameters of prepared statements are predicate constants given as ?, numbered in the order of
+     * predicates */
+    uint16_t param_num;
+
     /* Pick an attribute to sort by */
     bool has_order;
-    attr_name_t order_by_attr;
+    const char *order_by_attr;
     sort_order_t order_type;
+
+    /* Return at most limit tuples after skipping offset tuples */
+    bool has_limit;
+    value_type_t limit;
+    value_type_t offset;
 } query_select_t;
 
 typedef struct query_create_table_t {
-    rel_name_t rel_name;
+    const char *rel_name;
 
-    attr_name_t attr_names[MAX_ATTR_NUM];
+    const char **attr_names;
     uint16_t attr_num;
+
+    /* How relation values are stored */
+    relation_layout_t layout;
 } query_create_table_t;
 
+typedef struct query_create_index_t {
+    const char *index_name;
+
+    /* Attribute of the relation to index */
+    const char *rel_name;
+    const char *attr_name;
+
+    index_type_t type;
+} query_create_index_t;
+
 typedef struct query_insert_t {
-    rel_name_t rel_name;
+    const char *rel_name;
 
-    value_type_t values[MAX_ATTR_NUM];
-    uint16_t value_num;
+    /* Values of all the tuples, values of a tuple next to each other */
+    value_type_t *values;
+    uint32_t value_num;
+
+    /* Every tuple has as many values as the first one */
+    uint16_t attr_num;
+    uint32_t tuple_num;
 } query_insert_t;
 
+/* Load tuples from a file */
+typedef struct query_copy_t {
+    const char *rel_name;
+    /* Path without the quotes, not interned */
+    const char *path;
+} query_copy_t;
+
+/* Keep a select under a name to execute it later, possibly with parameters */
+typedef struct query_prepare_t {
+    const char *name;
+    query_select_t select;
+} query_prepare_t;
+
+/* Execute a prepared select with parameter values */
+typedef struct query_execute_t {
+    const char *name;
+    value_type_t *values;
+    uint16_t value_num;
+} query_execute_t;
+
+/* Forget a prepared select */
+typedef struct query_deallocate_t {
+    const char *name;
+} query_deallocate_t;
+
+/* Change a setting of the interpreter */
+typedef struct query_set_t {
+    const char *name;
+    value_type_t value;
+} query_set_t;
+
 typedef struct query_t {
+    /* Arena the query and its arrays are allocated in, NULL for the heap */
+    arena_t *arena;
+
     query_tag tag;
     union {
         query_select_t select;
         query_create_table_t create_table;
+        query_create_index_t create_index;
         query_insert_t insert;
+        query_set_t set;
+        query_copy_t copy;
+        query_prepare_t prepare;
+        query_execute_t execute;
+        query_deallocate_t deallocate;
     } as;
 } query_t;
 
@@ -105,17 +228,17 @@ typedef struct parser_t parser_t;
 
 typedef struct scanner_t scanner_t;
 
-scanner_t *scanner_create(const char *string);
+scanner_t *scanner_create(arena_t *arena, const char *string);
 
 void scanner_destroy(scanner_t *scanner);
 
 token_t scanner_next(scanner_t *scanner);
 
-query_t *query_create(void);
+query_t *query_create(arena_t *arena);
 
 void query_destroy(query_t *query);
 
-parser_t *parser_create(void);
+parser_t *parser_create(arena_t *arena);
 
 void parser_destroy(parser_t *parser);
 
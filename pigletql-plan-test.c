@@ -0,0 +1,615 @@
+#include <assert.h>
+#include <string.h>
+
+#include "pigletql-plan.h"
+#include "pigletql-codegen.h"
+
+static catalogue_t *catalogue_create_for_test(void)
+{
+    catalogue_t *cat = catalogue_create();
+    assert(cat);
+
+    {
+        const attr_name_t attr_names[] = {"id", "attr1", "attr2"};
+        const size_t attr_num = ARRAY_SIZE(attr_names);
+        relation_t *rel1 = relation_create(attr_names, attr_num);
+        for (value_type_t i = 0; i < 100; i++) {
+            const value_type_t values[] = {i, i % 10, i * 2};
+            relation_append_values(rel1, values);
+        }
+        catalogue_add_relation(cat, "rel1", rel1);
+    }
+
+    {
+        const attr_name_t attr_names[] = {"id2", "attr3"};
+        const size_t attr_num = ARRAY_SIZE(attr_names);
+        relation_t *rel2 = relation_create(attr_names, attr_num);
+        for (value_type_t i = 0; i < 10; i++) {
+            const value_type_t values[] = {i * 3, i};
+            relation_append_values(rel2, values);
+        }
+        catalogue_add_relation(cat, "rel2", rel2);
+    }
+
+    return cat;
+}
+
+static plan_node_t *plan_for_query(catalogue_t *cat, const char *query_str, bound_select_t **bound)
+{
+    scanner_t *scanner = scanner_create(NULL, query_str);
+    parser_t *parser = parser_create(NULL);
+    query_t *query = query_create(NULL);
+    assert(parser_parse(parser, scanner, query));
+
+    *bound = bind_select(NULL, cat, &query->as.select);
+    assert(*bound);
+
+    plan_node_t *plan = plan_select(NULL, *bound);
+    assert(plan);
+
+    query_destroy(query);
+    parser_destroy(parser);
+    scanner_destroy(scanner);
+
+    return plan;
+}
+
+static size_t plan_count_rows(const plan_node_t *plan)
+{
+    operator_t *op = plan_compile(NULL, plan);
+    size_t row_num = 0;
+
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state)))
+        row_num += batch->sel_num;
+    op->close(op->state);
+
+    op->destroy(op);
+    return row_num;
+}
+
+/* Sum of values of an attribute over all the rows */
+static uint64_t plan_sum_values(const plan_node_t *plan, const uint16_t attr_i)
+{
+    operator_t *op = plan_compile(NULL, plan);
+    uint64_t sum = 0;
+
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state)))
+        for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++)
+            sum += batch->columns[attr_i][batch->sel[sel_i]];
+    op->close(op->state);
+
+    op->destroy(op);
+    return sum;
+}
+
+static void plan_select_test(void)
+{
+    /* Predicates on attributes not listed end up right above scans */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT attr2 FROM rel1 WHERE attr1 = 3 AND id > 50;", &bound);
+
+        assert(plan->tag == PLAN_PROJECT);
+        assert(plan->attr_num == 1);
+
+        const plan_node_t *select = plan->left;
+        assert(select->tag == PLAN_SELECT);
+        assert(select->as.select.pred_num == 2);
+        assert(select->left->tag == PLAN_SCAN);
+
+        /* 53, 63, 73, 83, 93 */
+        assert(plan_count_rows(plan) == 5);
+
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+        catalogue_destroy(cat);
+    }
+
+    /* Equality predicates turn cross joins into hash joins, join inputs only keep attributes needed */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT attr2 FROM rel1, rel2 WHERE id = id2 AND attr3 < 5 ORDER BY attr2 DESC;", &bound);
+
+        assert(plan->tag == PLAN_SORT);
+        assert(plan->left->tag == PLAN_PROJECT);
+
+        const plan_node_t *join = plan->left->left;
+        assert(join->tag == PLAN_JOIN);
+        assert(join->as.join.is_hash);
+        assert(join->as.join.left_attr.rel_i == 0);
+        assert(join->as.join.right_attr.rel_i == 1);
+
+        /* rel2 is filtered and small, so the hash table is built on the right */
+        assert(!join->as.join.build_left);
+
+        /* rel1: id and attr2 only */
+        assert(join->left->tag == PLAN_PROJECT);
+        assert(join->left->attr_num == 2);
+        assert(join->left->left->tag == PLAN_SCAN);
+
+        /* rel2: id2 only, the predicate is evaluated before narrowing */
+        assert(join->right->tag == PLAN_PROJECT);
+        assert(join->right->attr_num == 1);
+        assert(join->right->left->tag == PLAN_SELECT);
+        assert(join->right->left->left->tag == PLAN_SCAN);
+
+        assert(join->attr_num == 3);
+
+        /* id2 in 0, 3, 6, 9, 12 */
+        assert(plan_count_rows(plan) == 5);
+
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+        catalogue_destroy(cat);
+    }
+
+    /* Predicates spanning both sides of a hash join stay above it */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT id FROM rel1, rel2 WHERE id = id2 AND attr1 > attr3;", &bound);
+
+        assert(plan->tag == PLAN_PROJECT);
+
+        const plan_node_t *select = plan->left;
+        assert(select->tag == PLAN_SELECT);
+        assert(select->as.select.pred_num == 1);
+        assert(select->left->tag == PLAN_JOIN);
+        assert(select->left->as.join.is_hash);
+
+        /* id = id2 = 3 * attr3, attr1 = id % 10 */
+        size_t expected_row_num = 0;
+        for (value_type_t i = 0; i < 10; i++)
+            expected_row_num += (i * 3) % 10 > i;
+        assert(plan_count_rows(plan) == expected_row_num);
+
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+        catalogue_destroy(cat);
+    }
+
+    /* No predicates linking relations: a cross join */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT id, attr3 FROM rel1, rel2 WHERE id < 10;", &bound);
+
+        assert(plan->tag == PLAN_PROJECT);
+
+        const plan_node_t *join = plan->left;
+        assert(join->tag == PLAN_JOIN);
+        assert(!join->as.join.is_hash);
+        assert(join->left->tag == PLAN_PROJECT);
+        assert(join->left->left->tag == PLAN_SELECT);
+
+        assert(plan_count_rows(plan) == 10 * 10);
+
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+        catalogue_destroy(cat);
+    }
+
+    /* A limit over a sort turns the sort into a top-N sort, plain limits stay */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT id FROM rel1 WHERE attr1 = 3 ORDER BY id DESC LIMIT 3 OFFSET 2;", &bound);
+
+        assert(plan->tag == PLAN_LIMIT);
+        assert(plan->as.limit.limit == 3);
+        assert(plan->as.limit.offset == 2);
+
+        const plan_node_t *top_n = plan->left;
+        assert(top_n->tag == PLAN_TOP_N);
+        assert(top_n->as.sort.limit == 5);
+        assert(top_n->as.sort.order == SORT_DESC);
+        assert(top_n->left->tag == PLAN_PROJECT);
+
+        assert(plan_count_rows(plan) == 3);
+
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        plan = plan_for_query(cat, "SELECT id FROM rel1 LIMIT 30 OFFSET 80;", &bound);
+        assert(plan->tag == PLAN_LIMIT);
+        assert(plan->left->tag == PLAN_PROJECT);
+        assert(plan_count_rows(plan) == 20);
+
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+        catalogue_destroy(cat);
+    }
+
+    /* Filtering pipelines over big relations run in parallel */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        const attr_name_t attr_names[] = {"big_id", "big_attr"};
+        relation_t *big = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t big_tuple_num = 3 * MORSEL_SIZE + 1;
+        for (value_type_t i = 0; i < big_tuple_num; i++) {
+            const value_type_t values[] = {i, i % 10};
+            relation_append_values(big, values);
+        }
+        catalogue_add_relation(cat, "big", big);
+
+        const uint16_t worker_num = gather_op_get_worker_num();
+        gather_op_set_worker_num(4);
+
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT big_id FROM big WHERE big_attr = 3;", &bound);
+        assert(plan->tag == PLAN_GATHER);
+        assert(plan->as.gather.is_ordered);
+        assert(plan->as.gather.worker_num == 4);
+        assert(plan->attr_num == 1);
+        assert(plan->left->tag == PLAN_PROJECT);
+        assert(plan->left->left->tag == PLAN_SELECT);
+        assert(plan_count_rows(plan) == big_tuple_num / 10);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Sorts do not care about the order */
+        plan = plan_for_query(cat, "SELECT big_id FROM big WHERE big_attr = 3 ORDER BY big_id;", &bound);
+        assert(plan->tag == PLAN_SORT);
+        assert(plan->left->tag == PLAN_GATHER);
+        assert(!plan->left->as.gather.is_ordered);
+        assert(plan_count_rows(plan) == big_tuple_num / 10);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Plain scans stay serial */
+        plan = plan_for_query(cat, "SELECT big_id FROM big;", &bound);
+        assert(plan->tag == PLAN_PROJECT);
+        assert(plan->left->tag == PLAN_SCAN);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Big relations probe hash tables in parallel, small build sides stay serial */
+        const char *join_query = "SELECT id, big_id FROM rel1, big WHERE id = big_attr AND attr1 = 3;";
+        plan = plan_for_query(cat, join_query, &bound);
+        assert(plan->tag == PLAN_GATHER);
+        assert(plan->left->tag == PLAN_PROJECT);
+        assert(plan->left->left->tag == PLAN_JOIN);
+        assert(plan->left->left->as.join.build_left);
+        assert(plan->left->left->left->tag == PLAN_PROJECT);
+        assert(plan->left->left->right->tag == PLAN_SCAN);
+        const uint32_t join_row_num = plan_count_rows(plan);
+        assert(join_row_num > 0);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* A single worker means no parallelism at all */
+        gather_op_set_worker_num(1);
+        plan = plan_for_query(cat, "SELECT big_id FROM big WHERE big_attr = 3;", &bound);
+        assert(plan->tag == PLAN_PROJECT);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        plan = plan_for_query(cat, join_query, &bound);
+        assert(plan->tag == PLAN_PROJECT);
+        assert(plan_count_rows(plan) == join_row_num);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        gather_op_set_worker_num(worker_num);
+        catalogue_destroy(cat);
+    }
+
+    /* Generated code returns what interpreted operators do */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        const char *queries[] = {
+            "SELECT id, attr1 FROM rel1 WHERE attr1 > 1;",
+            "SELECT attr1 FROM rel1 WHERE id < 4 AND attr1 > id;",
+            "SELECT id, attr3 FROM rel1, rel2 WHERE id = id2 AND attr1 > 1 ORDER BY id DESC;",
+        };
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(queries); query_i++) {
+            bound_select_t *bound = NULL;
+            plan_node_t *plan = plan_for_query(cat, queries[query_i], &bound);
+            const size_t row_num = plan_count_rows(plan);
+            codegen_set_enabled(true);
+            assert(plan_count_rows(plan) == row_num);
+            codegen_set_enabled(false);
+            plan_destroy(plan);
+            bound_select_destroy(bound);
+        }
+        assert(codegen_get_compile_num() > 0);
+        catalogue_destroy(cat);
+    }
+
+    /* Selects over scans of indexed attributes look tuples up in indexes, returning the same rows */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        const char *queries[] = {
+            "SELECT attr2 FROM rel1 WHERE attr1 = 3 AND id > 50;",
+            "SELECT id FROM rel1 WHERE attr1 < 2;",
+            "SELECT id FROM rel1 WHERE id > 10 AND attr1 > 8;",
+            "SELECT id FROM rel1 WHERE attr1 > 1 AND attr1 = 3;",
+            "SELECT id, attr3 FROM rel1, rel2 WHERE id = id2 AND attr1 = 3;",
+        };
+        size_t row_nums[ARRAY_SIZE(queries)];
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(queries); query_i++) {
+            bound_select_t *bound = NULL;
+            plan_node_t *plan = plan_for_query(cat, queries[query_i], &bound);
+            row_nums[query_i] = plan_count_rows(plan);
+            plan_destroy(plan);
+            bound_select_destroy(bound);
+        }
+
+        assert(catalogue_add_index(cat, "rel1_attr1", "rel1", 1, INDEX_BTREE));
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(queries); query_i++) {
+            bound_select_t *bound = NULL;
+            plan_node_t *plan = plan_for_query(cat, queries[query_i], &bound);
+            assert(plan_count_rows(plan) == row_nums[query_i]);
+
+            if (query_i == 0) {
+                /* The rest of predicates stay in the select */
+                const plan_node_t *select = plan->left;
+                assert(select->tag == PLAN_SELECT);
+                assert(select->as.select.pred_num == 1);
+                assert(select->left->tag == PLAN_INDEX_SCAN);
+                assert(select->left->as.scan.index_attr_i == 1);
+                assert(select->left->as.scan.index_op == SELECT_EQ);
+                assert(select->left->as.scan.index_constant == 3);
+            } else if (query_i == 1) {
+                /* Selects left without predicates go away */
+                assert(plan->left->tag == PLAN_INDEX_SCAN);
+                assert(plan->left->as.scan.index_op == SELECT_LT);
+            } else if (query_i == 3) {
+                /* Equality is preferred */
+                assert(plan->left->tag == PLAN_SELECT);
+                assert(plan->left->left->tag == PLAN_INDEX_SCAN);
+                assert(plan->left->left->as.scan.index_op == SELECT_EQ);
+            }
+
+            plan_destroy(plan);
+            bound_select_destroy(bound);
+        }
+        assert(row_nums[0] == 5 && row_nums[1] == 20 && row_nums[4] == 1);
+
+        /* Equality is looked up in hash indexes as well, ranges are not */
+        assert(catalogue_add_index(cat, "rel2_attr3", "rel2", 1, INDEX_HASH));
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT id2 FROM rel2 WHERE attr3 = 4;", &bound);
+        assert(plan->left->tag == PLAN_INDEX_SCAN);
+        assert(plan_count_rows(plan) == 1);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        plan = plan_for_query(cat, "SELECT id2 FROM rel2 WHERE attr3 > 4;", &bound);
+        assert(plan->left->tag == PLAN_SELECT);
+        assert(plan->left->left->tag == PLAN_SCAN);
+        assert(plan_count_rows(plan) == 5);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        catalogue_destroy(cat);
+    }
+
+    /* Joins with a side indexed over the join attribute look tuples up instead of building tables */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        const char *queries[] = {
+            "SELECT id, attr3 FROM rel1, rel2 WHERE id = id2;",
+            "SELECT attr2, attr3 FROM rel1, rel2 WHERE id2 = id AND attr3 > 4;",
+            "SELECT attr1, id2 FROM rel1, rel2 WHERE attr1 = id2;",
+        };
+        size_t row_nums[ARRAY_SIZE(queries)];
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(queries); query_i++) {
+            bound_select_t *bound = NULL;
+            plan_node_t *plan = plan_for_query(cat, queries[query_i], &bound);
+            assert(!plan->left->as.join.is_index);
+            row_nums[query_i] = plan_count_rows(plan);
+            plan_destroy(plan);
+            bound_select_destroy(bound);
+        }
+        assert(row_nums[0] == 10 && row_nums[1] == 5 && row_nums[2] == 40);
+
+        assert(catalogue_add_index(cat, "rel1_id", "rel1", 0, INDEX_HASH));
+        assert(catalogue_add_index(cat, "rel1_attr1", "rel1", 1, INDEX_BTREE));
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(queries); query_i++) {
+            bound_select_t *bound = NULL;
+            plan_node_t *plan = plan_for_query(cat, queries[query_i], &bound);
+            assert(plan_count_rows(plan) == row_nums[query_i]);
+
+            /* The indexed relation is looked up, narrowed down to the attributes required */
+            const plan_node_t *join = plan->left;
+            assert(join->tag == PLAN_JOIN);
+            assert(join->as.join.is_index);
+            assert(join->as.join.build_left);
+            if (query_i == 0)
+                assert(join->left->tag == PLAN_SCAN || join->left->tag == PLAN_PROJECT);
+            if (query_i == 1)
+                assert(join->right->tag == PLAN_SELECT);
+
+            plan_destroy(plan);
+            bound_select_destroy(bound);
+        }
+
+        /* Big outer sides still run in parallel */
+        const attr_name_t attr_names[] = {"big_id", "big_attr"};
+        relation_t *big = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t big_tuple_num = 3 * MORSEL_SIZE + 1;
+        uint32_t join_row_num = 0;
+        for (value_type_t i = 0; i < big_tuple_num; i++) {
+            const value_type_t values[] = {i, i % 200};
+            relation_append_values(big, values);
+            join_row_num += i % 200 < 100;
+        }
+        catalogue_add_relation(cat, "big", big);
+
+        const uint16_t worker_num = gather_op_get_worker_num();
+        gather_op_set_worker_num(4);
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT id, big_id FROM rel1, big WHERE id = big_attr;", &bound);
+        assert(plan->tag == PLAN_GATHER);
+        assert(plan->left->tag == PLAN_PROJECT);
+        assert(plan->left->left->tag == PLAN_JOIN);
+        assert(plan->left->left->as.join.is_index);
+        assert(plan->left->left->right->tag == PLAN_SCAN);
+        assert(plan_count_rows(plan) == join_row_num);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+        gather_op_set_worker_num(worker_num);
+
+        catalogue_destroy(cat);
+    }
+
+    /* Groups are hashed unless tuples come sorted on the group attribute, counts of whole relations
+     * are read from relations */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        bound_select_t *bound = NULL;
+        plan_node_t *plan = plan_for_query(cat, "SELECT attr1, count(*), sum(attr2) FROM rel1 GROUP BY attr1;", &bound);
+        assert(plan->tag == PLAN_PROJECT);
+        plan_node_t *aggregate = plan->left;
+        assert(aggregate->tag == PLAN_AGGREGATE);
+        assert(!aggregate->as.aggregate.is_sorted);
+        assert(!aggregate->as.aggregate.is_tuple_num);
+        assert(aggregate->attr_num == 3);
+        assert(aggregate->left->tag == PLAN_SCAN);
+        assert(plan_count_rows(plan) == 10);
+        assert(plan_sum_values(plan, 0) == 45);
+        assert(plan_sum_values(plan, 1) == 100);
+        assert(plan_sum_values(plan, 2) == 9900);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        plan = plan_for_query(cat, "SELECT count(*) FROM rel1;", &bound);
+        assert(plan->left->tag == PLAN_AGGREGATE);
+        assert(plan->left->as.aggregate.is_tuple_num);
+        assert(plan_count_rows(plan) == 1);
+        assert(plan_sum_values(plan, 0) == 100);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* A single group streams by, whatever the order */
+        plan = plan_for_query(cat, "SELECT max(id), count(*) FROM rel1 WHERE attr1 = 3;", &bound);
+        assert(plan->left->tag == PLAN_AGGREGATE);
+        assert(plan->left->as.aggregate.is_sorted);
+        assert(!plan->left->as.aggregate.is_tuple_num);
+        assert(plan->left->left->tag == PLAN_SELECT);
+        assert(plan_sum_values(plan, 0) == 93);
+        assert(plan_sum_values(plan, 1) == 10);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Filtering out every tuple leaves counts of 0, but no maximum at all */
+        plan = plan_for_query(cat, "SELECT count(*) FROM rel1 WHERE attr1 > 100;", &bound);
+        assert(plan_count_rows(plan) == 1);
+        assert(plan_sum_values(plan, 0) == 0);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        plan = plan_for_query(cat, "SELECT max(id), count(*) FROM rel1 WHERE attr1 > 100;", &bound);
+        assert(plan_count_rows(plan) == 0);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Nothing to count over cross joins, any attribute will do */
+        plan = plan_for_query(cat, "SELECT count(*) FROM rel1, rel2;", &bound);
+        assert(plan->left->left->tag == PLAN_JOIN);
+        assert(plan_sum_values(plan, 0) == 1000);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Index scans return tuples in the order of the indexed attribute, streaming and hashing agree */
+        relation_create_index(catalogue_get_relation(cat, "rel1"), 1);
+        plan = plan_for_query(cat, "SELECT min(id), attr1 FROM rel1 WHERE attr1 > 4 GROUP BY attr1;", &bound);
+        aggregate = plan->left;
+        assert(aggregate->tag == PLAN_AGGREGATE);
+        assert(aggregate->as.aggregate.is_sorted);
+        assert(aggregate->left->tag == PLAN_INDEX_SCAN);
+        assert(plan_count_rows(plan) == 5);
+        assert(plan_sum_values(plan, 0) == 35);
+        assert(plan_sum_values(plan, 1) == 35);
+        aggregate->as.aggregate.is_sorted = false;
+        assert(plan_count_rows(plan) == 5);
+        assert(plan_sum_values(plan, 0) == 35);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Grouping by anything else needs hashing */
+        plan = plan_for_query(cat, "SELECT id, count(*) FROM rel1 WHERE attr1 > 4 GROUP BY id;", &bound);
+        assert(!plan->left->as.aggregate.is_sorted);
+        assert(plan_count_rows(plan) == 50);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+
+        /* Parallel pipelines feed hash aggregates in any order */
+        const attr_name_t attr_names[] = {"big_id", "big_attr"};
+        relation_t *big = relation_create(attr_names, ARRAY_SIZE(attr_names));
+        const uint32_t big_tuple_num = 3 * MORSEL_SIZE + 1;
+        for (value_type_t i = 0; i < big_tuple_num; i++) {
+            const value_type_t values[] = {i, i % 10};
+            relation_append_values(big, values);
+        }
+        catalogue_add_relation(cat, "big", big);
+
+        const uint16_t worker_num = gather_op_get_worker_num();
+        gather_op_set_worker_num(4);
+        plan = plan_for_query(cat, "SELECT big_attr, count(*) FROM big WHERE big_id > 0 GROUP BY big_attr;", &bound);
+        assert(plan->left->tag == PLAN_AGGREGATE);
+        assert(plan->left->left->tag == PLAN_GATHER);
+        assert(!plan->left->left->as.gather.is_ordered);
+        assert(plan_count_rows(plan) == 10);
+        assert(plan_sum_values(plan, 1) == big_tuple_num - 1);
+        plan_destroy(plan);
+        bound_select_destroy(bound);
+        gather_op_set_worker_num(worker_num);
+
+        catalogue_destroy(cat);
+    }
+
+    /* The whole statement lifecycle in an arena, reset between statements */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        arena_t *arena = arena_create();
+
+        for (size_t run_i = 0; run_i < 3; run_i++) {
+            scanner_t *scanner = scanner_create(arena, "SELECT id, attr3 FROM rel1, rel2 WHERE id = id2 ORDER BY id DESC;");
+            parser_t *parser = parser_create(arena);
+            query_t *query = query_create(arena);
+            assert(parser_parse(parser, scanner, query));
+
+            bound_select_t *bound = bind_select(arena, cat, &query->as.select);
+            plan_node_t *plan = plan_select(arena, bound);
+            operator_t *op = plan_compile(arena, plan);
+
+            size_t row_num = 0;
+            op->open(op->state);
+            batch_t *batch = NULL;
+            while ((batch = op->next_batch(op->state)))
+                row_num += batch->sel_num;
+            op->close(op->state);
+            assert(row_num == 10);
+
+            /* Destroy functions only release heap parts here */
+            op->destroy(op);
+            plan_destroy(plan);
+            bound_select_destroy(bound);
+            query_destroy(query);
+            parser_destroy(parser);
+            scanner_destroy(scanner);
+
+            arena_reset(arena);
+        }
+
+        arena_destroy(arena);
+        catalogue_destroy(cat);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    plan_select_test();
+
+    return 0;
+}
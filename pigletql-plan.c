@@ -0,0 +1,969 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "pigletql-plan.h"
+#include "pigletql-codegen.h"
+
+/*
+ * Attribute lists
+ *  */
+
+typedef struct attr_list_t {
+    arena_t *arena;
+    bound_attr_t *attrs;
+    uint16_t attr_num;
+} attr_list_t;
+
+static uint16_t attrs_pos(const bound_attr_t *attrs, const uint16_t attr_num, const bound_attr_t attr)
+{
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        if (bound_attr_eq(attrs[attr_i], attr))
+            return attr_i;
+    return ATTR_NOT_FOUND;
+}
+
+static bool attrs_contain(const bound_attr_t *attrs, const uint16_t attr_num, const bound_attr_t attr)
+{
+    return attrs_pos(attrs, attr_num, attr) != ATTR_NOT_FOUND;
+}
+
+static void attr_list_add(attr_list_t *list, const bound_attr_t attr)
+{
+    if (attrs_contain(list->attrs, list->attr_num, attr))
+        return;
+    list->attrs = arena_realloc(list->arena, list->attrs, list->attr_num * sizeof(bound_attr_t),
+                                (list->attr_num + 1) * sizeof(bound_attr_t));
+    assert(list->attrs);
+    list->attrs[list->attr_num++] = attr;
+}
+
+static attr_list_t attr_list_create(arena_t *arena, const bound_attr_t *attrs, const uint16_t attr_num)
+{
+    attr_list_t list = { .arena = arena };
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        attr_list_add(&list, attrs[attr_i]);
+    return list;
+}
+
+static void attr_list_add_predicate(attr_list_t *list, const bound_predicate_t *predicate)
+{
+    attr_list_add(list, predicate->left_attr);
+    if (predicate->tag == SELECT_ATTR_ATTR)
+        attr_list_add(list, predicate->as.right_attr);
+}
+
+static void attr_list_destroy(attr_list_t *list)
+{
+    arena_free(list->arena, list->attrs);
+}
+
+/*
+ * Plan nodes
+ *  */
+
+static plan_node_t *plan_node_create(arena_t *arena, const plan_node_tag tag, plan_node_t *left, plan_node_t *right)
+{
+    plan_node_t *node = arena_calloc(arena, 1, sizeof(*node));
+    assert(node);
+
+    node->arena = arena;
+    node->tag = tag;
+    node->left = left;
+    node->right = right;
+
+    return node;
+}
+
+static void plan_node_set_attrs(plan_node_t *node, const bound_attr_t *attrs, const uint16_t attr_num)
+{
+    arena_free(node->arena, node->attrs);
+    node->attrs = arena_calloc(node->arena, attr_num, sizeof(bound_attr_t));
+    assert(node->attrs || attr_num == 0);
+    memcpy(node->attrs, attrs, attr_num * sizeof(bound_attr_t));
+    node->attr_num = attr_num;
+}
+
+void plan_destroy(plan_node_t *plan)
+{
+    if (!plan)
+        return;
+
+    plan_destroy(plan->left);
+    plan_destroy(plan->right);
+
+    if (plan->tag == PLAN_SELECT)
+        arena_free(plan->arena, plan->as.select.predicates);
+    arena_free(plan->arena, plan->attrs);
+    arena_free(plan->arena, plan);
+}
+
+static plan_node_t *plan_scan_create(arena_t *arena, relation_t *rel, const uint16_t rel_i)
+{
+    plan_node_t *node = plan_node_create(arena, PLAN_SCAN, NULL, NULL);
+    node->as.scan.rel = rel;
+    node->as.scan.rel_i = rel_i;
+
+    /* Scans produce all the attributes of a relation */
+    node->attr_num = relation_get_attr_num(rel);
+    node->attrs = arena_calloc(arena, node->attr_num, sizeof(bound_attr_t));
+    assert(node->attrs);
+    for (uint16_t attr_i = 0; attr_i < node->attr_num; attr_i++)
+        node->attrs[attr_i] = (bound_attr_t){ .rel_i = rel_i, .attr_i = attr_i };
+
+    return node;
+}
+
+static void plan_select_add_predicate(plan_node_t *node, const bound_predicate_t *predicate)
+{
+    const uint16_t pred_num = node->as.select.pred_num;
+    node->as.select.predicates = arena_realloc(node->arena, node->as.select.predicates,
+                                               pred_num * sizeof(bound_predicate_t),
+                                               (pred_num + 1) * sizeof(bound_predicate_t));
+    assert(node->as.select.predicates);
+    node->as.select.predicates[pred_num] = *predicate;
+    node->as.select.pred_num++;
+}
+
+static plan_node_t *plan_select_create(plan_node_t *child, const bound_predicate_t *predicate)
+{
+    plan_node_t *node = plan_node_create(child->arena, PLAN_SELECT, child, NULL);
+    plan_select_add_predicate(node, predicate);
+    return node;
+}
+
+/* A projection keeping child attributes listed, in the child order */
+static plan_node_t *plan_project_create(plan_node_t *child, const attr_list_t *attrs)
+{
+    plan_node_t *node = plan_node_create(child->arena, PLAN_PROJECT, child, NULL);
+    attr_list_t project_attrs = { .arena = child->arena };
+    for (uint16_t attr_i = 0; attr_i < child->attr_num; attr_i++)
+        if (attrs_contain(attrs->attrs, attrs->attr_num, child->attrs[attr_i]))
+            attr_list_add(&project_attrs, child->attrs[attr_i]);
+    node->attrs = project_attrs.attrs;
+    node->attr_num = project_attrs.attr_num;
+    return node;
+}
+
+static bool plan_has_rel(const plan_node_t *node, const uint16_t rel_i)
+{
+    if (node->tag == PLAN_SCAN || node->tag == PLAN_INDEX_SCAN)
+        return node->as.scan.rel_i == rel_i;
+    return (node->left && plan_has_rel(node->left, rel_i))
+        || (node->right && plan_has_rel(node->right, rel_i));
+}
+
+/* Does the subtree provide all the attributes a predicate needs? */
+static bool plan_has_predicate_rels(const plan_node_t *node, const bound_predicate_t *predicate)
+{
+    if (!plan_has_rel(node, predicate->left_attr.rel_i))
+        return false;
+    if (predicate->tag == SELECT_ATTR_ATTR && !plan_has_rel(node, predicate->as.right_attr.rel_i))
+        return false;
+    return true;
+}
+
+/* Can a predicate become join attributes of a join? */
+static bool plan_join_can_hash(const plan_node_t *node, const bound_predicate_t *predicate)
+{
+    return !node->as.join.is_hash && predicate->tag == SELECT_ATTR_ATTR && predicate->op == SELECT_EQ;
+}
+
+/*
+ * Canonical plan: scans, a left-deep tree of cross joins, a single select, an aggregate, a projection,
+ * a sort and a limit
+ *  */
+
+static plan_node_t *plan_aggregate_create(plan_node_t *child, const bound_select_t *query)
+{
+    plan_node_t *node = plan_node_create(child->arena, PLAN_AGGREGATE, child, NULL);
+    node->as.aggregate.aggregates = query->aggregates;
+    node->as.aggregate.aggregate_num = query->aggregate_num;
+    node->as.aggregate.group_attr_num = query->group_attr_num;
+
+    /* Aggregates are referred to by their index in the query */
+    const uint16_t attr_num = query->group_attr_num + query->aggregate_num;
+    bound_attr_t attrs[attr_num + 1];
+    memcpy(attrs, query->group_attrs, query->group_attr_num * sizeof(bound_attr_t));
+    for (uint16_t aggregate_i = 0; aggregate_i < query->aggregate_num; aggregate_i++)
+        attrs[query->group_attr_num + aggregate_i] = (bound_attr_t){ .rel_i = AGGREGATE_REL_I, .attr_i = aggregate_i };
+    plan_node_set_attrs(node, attrs, attr_num);
+    return node;
+}
+
+static plan_node_t *plan_canonical(arena_t *arena, const bound_select_t *query)
+{
+    plan_node_t *root = plan_scan_create(arena, query->rels[0], 0);
+    for (uint16_t rel_i = 1; rel_i < query->rel_num; rel_i++)
+        root = plan_node_create(arena, PLAN_JOIN, root, plan_scan_create(arena, query->rels[rel_i], rel_i));
+
+    if (query->pred_num > 0) {
+        root = plan_node_create(arena, PLAN_SELECT, root, NULL);
+        for (uint16_t pred_i = 0; pred_i < query->pred_num; pred_i++)
+            plan_select_add_predicate(root, &query->predicates[pred_i]);
+    }
+
+    if (query->has_groups)
+        root = plan_aggregate_create(root, query);
+
+    root = plan_node_create(arena, PLAN_PROJECT, root, NULL);
+    plan_node_set_attrs(root, query->attrs, query->attr_num);
+
+    if (query->has_order) {
+        root = plan_node_create(arena, PLAN_SORT, root, NULL);
+        root->as.sort.attr = query->order_by_attr;
+        root->as.sort.order = query->order_type;
+    }
+
+    if (query->has_limit) {
+        root = plan_node_create(arena, PLAN_LIMIT, root, NULL);
+        root->as.limit.limit = query->limit;
+        root->as.limit.offset = query->offset;
+    }
+
+    return root;
+}
+
+/*
+ * Rule: push predicates down to the lowest node providing all the predicate attributes; equality
+ * predicates on attributes of both sides of a cross join turn it into a hash join
+ *  */
+
+static plan_node_t *plan_push_predicate(plan_node_t *node, const bound_predicate_t *predicate)
+{
+    switch (node->tag) {
+    case PLAN_SCAN:
+    case PLAN_INDEX_SCAN:
+        return plan_select_create(node, predicate);
+    case PLAN_SELECT: {
+        plan_node_t *child = node->left;
+        if (child->tag == PLAN_JOIN &&
+            (plan_has_predicate_rels(child->left, predicate) ||
+             plan_has_predicate_rels(child->right, predicate) ||
+             plan_join_can_hash(child, predicate))) {
+            node->left = plan_push_predicate(child, predicate);
+            return node;
+        }
+        plan_select_add_predicate(node, predicate);
+        return node;
+    }
+    case PLAN_JOIN:
+        if (plan_has_predicate_rels(node->left, predicate)) {
+            node->left = plan_push_predicate(node->left, predicate);
+            return node;
+        }
+        if (plan_has_predicate_rels(node->right, predicate)) {
+            node->right = plan_push_predicate(node->right, predicate);
+            return node;
+        }
+        if (plan_join_can_hash(node, predicate)) {
+            const bool left_first = plan_has_rel(node->left, predicate->left_attr.rel_i);
+            node->as.join.is_hash = true;
+            node->as.join.left_attr = left_first ? predicate->left_attr : predicate->as.right_attr;
+            node->as.join.right_attr = left_first ? predicate->as.right_attr : predicate->left_attr;
+            return node;
+        }
+        return plan_select_create(node, predicate);
+    case PLAN_PROJECT:
+    case PLAN_AGGREGATE:
+    case PLAN_SORT:
+    case PLAN_TOP_N:
+    case PLAN_LIMIT:
+    case PLAN_GATHER:
+        break;
+    }
+    assert(false);
+}
+
+static plan_node_t *rule_push_down_predicates(plan_node_t *node)
+{
+    switch (node->tag) {
+    case PLAN_PROJECT:
+    case PLAN_AGGREGATE:
+    case PLAN_SORT:
+    case PLAN_TOP_N:
+    case PLAN_LIMIT:
+        node->left = rule_push_down_predicates(node->left);
+        return node;
+    case PLAN_SELECT: {
+        /* Replace the select with predicates pushed into its child */
+        plan_node_t *child = node->left;
+        for (uint16_t pred_i = 0; pred_i < node->as.select.pred_num; pred_i++)
+            child = plan_push_predicate(child, &node->as.select.predicates[pred_i]);
+        node->left = NULL;
+        plan_destroy(node);
+        return child;
+    }
+    case PLAN_SCAN:
+    case PLAN_INDEX_SCAN:
+    case PLAN_JOIN:
+        return node;
+    case PLAN_GATHER:
+        break;
+    }
+    assert(false);
+}
+
+/*
+ * Rule: selects over scans of relations with an index over an attribute compared to a constant scan
+ * the index instead, equality predicates are preferred to ranges
+ *  */
+
+static bool predicate_has_index(const relation_t *rel, const bound_predicate_t *predicate)
+{
+    if (predicate->tag != SELECT_ATTR_CONST)
+        return false;
+    /* Hash indexes only help with equality */
+    const uint16_t attr_i = predicate->left_attr.attr_i;
+    return relation_get_index(rel, attr_i) || (predicate->op == SELECT_EQ && relation_get_hash_index(rel, attr_i));
+}
+
+static plan_node_t *rule_index_scans(plan_node_t *node)
+{
+    if (node->left)
+        node->left = rule_index_scans(node->left);
+    if (node->right)
+        node->right = rule_index_scans(node->right);
+    if (node->tag != PLAN_SELECT || node->left->tag != PLAN_SCAN)
+        return node;
+
+    plan_node_t *scan = node->left;
+    uint16_t index_pred_i = MAX_PRED_NUM;
+    for (uint16_t pred_i = 0; pred_i < node->as.select.pred_num; pred_i++) {
+        const bound_predicate_t *predicate = &node->as.select.predicates[pred_i];
+        if (!predicate_has_index(scan->as.scan.rel, predicate))
+            continue;
+        if (index_pred_i == MAX_PRED_NUM ||
+            (predicate->op == SELECT_EQ && node->as.select.predicates[index_pred_i].op != SELECT_EQ))
+            index_pred_i = pred_i;
+    }
+    if (index_pred_i == MAX_PRED_NUM)
+        return node;
+
+    /* Scans return all the relation attributes, so the attribute index is the relation one */
+    const bound_predicate_t *index_predicate = &node->as.select.predicates[index_pred_i];
+    scan->tag = PLAN_INDEX_SCAN;
+    scan->as.scan.index_attr_i = index_predicate->left_attr.attr_i;
+    scan->as.scan.index_op = index_predicate->op;
+    scan->as.scan.index_constant = index_predicate->as.right_constant;
+    scan->as.scan.index_param = index_predicate->right_param;
+
+    /* The index scan applies the predicate, the select keeps the rest of them */
+    node->as.select.pred_num--;
+    memmove(&node->as.select.predicates[index_pred_i], &node->as.select.predicates[index_pred_i + 1],
+            (node->as.select.pred_num - index_pred_i) * sizeof(bound_predicate_t));
+    if (node->as.select.pred_num > 0)
+        return node;
+
+    node->left = NULL;
+    plan_destroy(node);
+    return scan;
+}
+
+/*
+ * Rule: only keep attributes required by nodes above, narrowing join inputs with projections
+ *  */
+
+static plan_node_t *rule_push_down_projections(plan_node_t *node, const attr_list_t *required, const bool narrow)
+{
+    switch (node->tag) {
+    case PLAN_SCAN:
+    case PLAN_INDEX_SCAN:
+        break;
+    case PLAN_SELECT: {
+        attr_list_t child_required = attr_list_create(node->arena, required->attrs, required->attr_num);
+        for (uint16_t pred_i = 0; pred_i < node->as.select.pred_num; pred_i++)
+            attr_list_add_predicate(&child_required, &node->as.select.predicates[pred_i]);
+        node->left = rule_push_down_projections(node->left, &child_required, false);
+        attr_list_destroy(&child_required);
+
+        plan_node_set_attrs(node, node->left->attrs, node->left->attr_num);
+        break;
+    }
+    case PLAN_JOIN: {
+        attr_list_t child_required = attr_list_create(node->arena, required->attrs, required->attr_num);
+        if (node->as.join.is_hash) {
+            attr_list_add(&child_required, node->as.join.left_attr);
+            attr_list_add(&child_required, node->as.join.right_attr);
+        }
+        node->left = rule_push_down_projections(node->left, &child_required, true);
+        node->right = rule_push_down_projections(node->right, &child_required, true);
+        attr_list_destroy(&child_required);
+
+        /* Joined tuples have all the left attributes followed by all the right attributes */
+        attr_list_t attrs = attr_list_create(node->arena, node->left->attrs, node->left->attr_num);
+        for (uint16_t attr_i = 0; attr_i < node->right->attr_num; attr_i++)
+            attr_list_add(&attrs, node->right->attrs[attr_i]);
+        arena_free(node->arena, node->attrs);
+        node->attrs = attrs.attrs;
+        node->attr_num = attrs.attr_num;
+        break;
+    }
+    case PLAN_PROJECT: {
+        /* Projections choose attributes themselves */
+        attr_list_t child_required = attr_list_create(node->arena, node->attrs, node->attr_num);
+        node->left = rule_push_down_projections(node->left, &child_required, false);
+        attr_list_destroy(&child_required);
+        return node;
+    }
+    case PLAN_AGGREGATE: {
+        /* Group attributes and attributes aggregated, counts need none */
+        attr_list_t child_required = attr_list_create(node->arena, node->attrs, node->as.aggregate.group_attr_num);
+        for (uint16_t aggregate_i = 0; aggregate_i < node->as.aggregate.aggregate_num; aggregate_i++) {
+            const bound_aggregate_t *aggregate = &node->as.aggregate.aggregates[aggregate_i];
+            if (aggregate->func != AGGREGATE_COUNT)
+                attr_list_add(&child_required, aggregate->attr);
+        }
+        node->left = rule_push_down_projections(node->left, &child_required, false);
+        attr_list_destroy(&child_required);
+        return node;
+    }
+    case PLAN_SORT:
+    case PLAN_TOP_N: {
+        attr_list_t child_required = attr_list_create(node->arena, required->attrs, required->attr_num);
+        attr_list_add(&child_required, node->as.sort.attr);
+        node->left = rule_push_down_projections(node->left, &child_required, narrow);
+        attr_list_destroy(&child_required);
+
+        plan_node_set_attrs(node, node->left->attrs, node->left->attr_num);
+        return node;
+    }
+    case PLAN_LIMIT:
+        node->left = rule_push_down_projections(node->left, required, narrow);
+        plan_node_set_attrs(node, node->left->attrs, node->left->attr_num);
+        return node;
+    case PLAN_GATHER:
+        assert(false);
+    }
+
+    /* Tuples with no attributes cannot be returned, counting them takes whatever attributes there are */
+    if (!narrow || required->attr_num == 0)
+        return node;
+
+    /* Anything not required? Project it out */
+    for (uint16_t attr_i = 0; attr_i < node->attr_num; attr_i++)
+        if (!attrs_contain(required->attrs, required->attr_num, node->attrs[attr_i]))
+            return plan_project_create(node, required);
+    return node;
+}
+
+/*
+ * Rule: build hash tables on the join side with fewer tuples expected. Sides scanning a relation with
+ * an index over the join attribute need no table at all, the bigger of them gets looked up.
+ *  */
+
+/* Scan of a join side, possibly narrowed by a projection, indexed over the join attribute */
+static const plan_node_t *plan_join_index_scan(const plan_node_t *node, const bound_attr_t attr)
+{
+    const plan_node_t *scan = node->tag == PLAN_PROJECT ? node->left : node;
+    if (scan->tag != PLAN_SCAN)
+        return NULL;
+    const relation_t *rel = scan->as.scan.rel;
+    if (!relation_get_hash_index(rel, attr.attr_i) && !relation_get_index(rel, attr.attr_i))
+        return NULL;
+    return scan;
+}
+
+static double predicate_selectivity(const select_predicate_op op)
+{
+    /* Just a guess: equality is more selective than comparisons */
+    return op == SELECT_EQ ? 0.1 : 0.3;
+}
+
+static double rule_choose_build_sides(plan_node_t *node)
+{
+    switch (node->tag) {
+    case PLAN_SCAN:
+        return relation_get_tuple_num(node->as.scan.rel);
+    case PLAN_INDEX_SCAN:
+        return relation_get_tuple_num(node->as.scan.rel) * predicate_selectivity(node->as.scan.index_op);
+    case PLAN_SELECT: {
+        double tuple_num = rule_choose_build_sides(node->left);
+        for (uint16_t pred_i = 0; pred_i < node->as.select.pred_num; pred_i++)
+            tuple_num *= predicate_selectivity(node->as.select.predicates[pred_i].op);
+        return tuple_num;
+    }
+    case PLAN_PROJECT:
+    case PLAN_AGGREGATE:
+    case PLAN_SORT:
+    case PLAN_TOP_N:
+    case PLAN_LIMIT:
+    case PLAN_GATHER:
+        return rule_choose_build_sides(node->left);
+    case PLAN_JOIN: {
+        const double left_tuple_num = rule_choose_build_sides(node->left);
+        const double right_tuple_num = rule_choose_build_sides(node->right);
+        if (!node->as.join.is_hash)
+            return left_tuple_num * right_tuple_num;
+
+        const bool is_left_indexed = plan_join_index_scan(node->left, node->as.join.left_attr);
+        const bool is_right_indexed = plan_join_index_scan(node->right, node->as.join.right_attr);
+        node->as.join.is_index = is_left_indexed || is_right_indexed;
+        if (is_left_indexed && is_right_indexed)
+            node->as.join.build_left = left_tuple_num > right_tuple_num;
+        else if (node->as.join.is_index)
+            node->as.join.build_left = is_left_indexed;
+        else
+            node->as.join.build_left = left_tuple_num < right_tuple_num;
+        return left_tuple_num > right_tuple_num ? left_tuple_num : right_tuple_num;
+    }
+    }
+    assert(false);
+}
+
+/*
+ * Rule: a limit over a sort only needs the first limit + offset sorted tuples, i.e. a top-N sort
+ *  */
+
+static plan_node_t *rule_top_n(plan_node_t *node)
+{
+    if (node->tag != PLAN_LIMIT || node->left->tag != PLAN_SORT)
+        return node;
+
+    /* The limit still skips offset tuples */
+    const uint64_t limit = (uint64_t)node->as.limit.limit + node->as.limit.offset;
+    plan_node_t *sort = node->left;
+    sort->tag = PLAN_TOP_N;
+    sort->as.sort.limit = limit > UINT32_MAX ? UINT32_MAX : (uint32_t)limit;
+    return node;
+}
+
+/*
+ * Rule: aggregate groups as they stream by if the input is sorted on the group attribute, i.e. comes
+ * from an index scan over it, or there's a single group of all the tuples. Counts of all the tuples
+ * of a relation need no scan at all.
+ *  */
+
+static bool plan_is_sorted_on(const plan_node_t *node, const bound_attr_t attr)
+{
+    while (node->tag == PLAN_SELECT || node->tag == PLAN_PROJECT)
+        node = node->left;
+    return node->tag == PLAN_INDEX_SCAN && node->as.scan.rel_i == attr.rel_i &&
+        node->as.scan.index_attr_i == attr.attr_i;
+}
+
+static plan_node_t *rule_aggregate(plan_node_t *node)
+{
+    if (node->left)
+        node->left = rule_aggregate(node->left);
+    if (node->tag != PLAN_AGGREGATE)
+        return node;
+
+    const uint16_t group_attr_num = node->as.aggregate.group_attr_num;
+    node->as.aggregate.is_sorted = group_attr_num == 0 ||
+        (group_attr_num == 1 && plan_is_sorted_on(node->left, node->attrs[0]));
+
+    bool is_count_only = true;
+    for (uint16_t aggregate_i = 0; aggregate_i < node->as.aggregate.aggregate_num; aggregate_i++)
+        is_count_only &= node->as.aggregate.aggregates[aggregate_i].func == AGGREGATE_COUNT;
+    node->as.aggregate.is_tuple_num = group_attr_num == 0 && is_count_only && node->left->tag == PLAN_SCAN;
+    return node;
+}
+
+/*
+ * Rule: run pipelines filtering or joining scans of relations having more than a morsel of tuples in
+ * parallel. Hash joins probe their tables within pipelines, build sides are pipelines of their own.
+ * Sorts, hash tables and hash aggregates do not need tuples in the relation order.
+ *  */
+
+/* Child a hash join builds its table on, or the one an index join looks up */
+static plan_node_t **plan_join_build_child(plan_node_t *node)
+{
+    return node->as.join.build_left ? &node->left : &node->right;
+}
+
+static plan_node_t **plan_join_probe_child(plan_node_t *node)
+{
+    return node->as.join.build_left ? &node->right : &node->left;
+}
+
+/* Scan of a pipeline, NULL if the node is not a pipeline */
+static const plan_node_t *plan_pipeline_scan(const plan_node_t *node)
+{
+    switch (node->tag) {
+    case PLAN_SCAN:
+        return node;
+    case PLAN_SELECT:
+    case PLAN_PROJECT:
+        return plan_pipeline_scan(node->left);
+    case PLAN_JOIN:
+        if (!node->as.join.is_hash)
+            return NULL;
+        return plan_pipeline_scan(*plan_join_probe_child((plan_node_t *)node));
+    case PLAN_INDEX_SCAN:
+    case PLAN_AGGREGATE:
+    case PLAN_SORT:
+    case PLAN_TOP_N:
+    case PLAN_LIMIT:
+    case PLAN_GATHER:
+        return NULL;
+    }
+    assert(false);
+}
+
+/* Scanning alone is just copying, a pipeline should filter or join something to be worth running in
+ * parallel */
+static bool plan_pipeline_has_work(const plan_node_t *node)
+{
+    if (node->tag == PLAN_PROJECT)
+        return plan_pipeline_has_work(node->left);
+    return node->tag == PLAN_SELECT || node->tag == PLAN_JOIN;
+}
+
+static plan_node_t *rule_parallelize(plan_node_t *node, const uint16_t worker_num, const bool is_ordered);
+
+static void rule_parallelize_builds(plan_node_t *node, const uint16_t worker_num)
+{
+    switch (node->tag) {
+    case PLAN_SELECT:
+    case PLAN_PROJECT:
+        rule_parallelize_builds(node->left, worker_num);
+        return;
+    case PLAN_JOIN: {
+        /* Index joins build nothing */
+        plan_node_t **build_child = plan_join_build_child(node);
+        if (!node->as.join.is_index)
+            *build_child = rule_parallelize(*build_child, worker_num, false);
+        rule_parallelize_builds(*plan_join_probe_child(node), worker_num);
+        return;
+    }
+    case PLAN_SCAN:
+    case PLAN_INDEX_SCAN:
+    case PLAN_AGGREGATE:
+    case PLAN_SORT:
+    case PLAN_TOP_N:
+    case PLAN_LIMIT:
+    case PLAN_GATHER:
+        return;
+    }
+    assert(false);
+}
+
+static plan_node_t *rule_parallelize(plan_node_t *node, const uint16_t worker_num, const bool is_ordered)
+{
+    const plan_node_t *scan = plan_pipeline_scan(node);
+    if (scan) {
+        rule_parallelize_builds(node, worker_num);
+        if (!plan_pipeline_has_work(node) || relation_get_tuple_num(scan->as.scan.rel) <= MORSEL_SIZE)
+            return node;
+
+        plan_node_t *gather = plan_node_create(node->arena, PLAN_GATHER, node, NULL);
+        plan_node_set_attrs(gather, node->attrs, node->attr_num);
+        gather->as.gather.is_ordered = is_ordered;
+        gather->as.gather.worker_num = worker_num;
+        return gather;
+    }
+
+    /* Aggregates only need their input in order when streaming groups */
+    bool is_child_ordered = is_ordered && node->tag != PLAN_SORT && node->tag != PLAN_TOP_N;
+    if (node->tag == PLAN_AGGREGATE)
+        is_child_ordered = node->as.aggregate.is_sorted && node->as.aggregate.group_attr_num > 0;
+    if (node->left)
+        node->left = rule_parallelize(node->left, worker_num, is_child_ordered);
+    if (node->right)
+        node->right = rule_parallelize(node->right, worker_num, is_child_ordered);
+    return node;
+}
+
+plan_node_t *plan_select(arena_t *arena, const bound_select_t *query)
+{
+    plan_node_t *plan = plan_canonical(arena, query);
+
+    plan = rule_push_down_predicates(plan);
+
+    plan = rule_index_scans(plan);
+
+    attr_list_t required = { .arena = arena };
+    plan = rule_push_down_projections(plan, &required, false);
+
+    plan = rule_aggregate(plan);
+
+    plan = rule_top_n(plan);
+
+    rule_choose_build_sides(plan);
+
+    const uint16_t worker_num = gather_op_get_worker_num();
+    if (worker_num > 1)
+        plan = rule_parallelize(plan, worker_num, true);
+
+    return plan;
+}
+
+/*
+ * Plan compilation
+ *  */
+
+static uint16_t plan_attr_pos(const plan_node_t *node, const bound_attr_t attr)
+{
+    const uint16_t pos = attrs_pos(node->attrs, node->attr_num, attr);
+    assert(pos != ATTR_NOT_FOUND);
+    return pos;
+}
+
+/* A pipeline compiled for a gather worker */
+typedef struct plan_pipeline_t {
+    /* Scan operator at the bottom of the pipeline */
+    operator_t *scan_op;
+    /* Tables shared by workers, probed by hash joins in the order they are compiled */
+    join_table_t *const *join_tables;
+    uint16_t next_join_table_i;
+} plan_pipeline_t;
+
+static operator_t *plan_compile_node(arena_t *arena, const plan_node_t *plan, plan_pipeline_t *pipeline);
+
+/* Tables of hash joins within a pipeline, in the order pipelines compile hash joins */
+static void plan_compile_join_tables(arena_t *arena, const plan_node_t *plan, join_table_t **join_tables,
+                                     uint16_t *join_table_num)
+{
+    switch (plan->tag) {
+    case PLAN_SELECT:
+    case PLAN_PROJECT:
+        plan_compile_join_tables(arena, plan->left, join_tables, join_table_num);
+        return;
+    case PLAN_JOIN: {
+        if (plan->as.join.is_index) {
+            plan_compile_join_tables(arena, *plan_join_probe_child((plan_node_t *)plan), join_tables, join_table_num);
+            return;
+        }
+
+        const plan_node_t *build_child = *plan_join_build_child((plan_node_t *)plan);
+        const bound_attr_t build_attr = plan->as.join.build_left ? plan->as.join.left_attr : plan->as.join.right_attr;
+        join_table_t *table = join_table_create(arena, plan_compile(arena, build_child),
+                                                plan_attr_pos(build_child, build_attr));
+        assert(table);
+        join_tables[(*join_table_num)++] = table;
+        plan_compile_join_tables(arena, *plan_join_probe_child((plan_node_t *)plan), join_tables, join_table_num);
+        return;
+    }
+    case PLAN_SCAN:
+        return;
+    case PLAN_INDEX_SCAN:
+    case PLAN_AGGREGATE:
+    case PLAN_SORT:
+    case PLAN_TOP_N:
+    case PLAN_LIMIT:
+    case PLAN_GATHER:
+        break;
+    }
+    assert(false);
+}
+
+static uint16_t plan_pipeline_join_num(const plan_node_t *plan)
+{
+    if (plan->tag == PLAN_SCAN)
+        return 0;
+    if (plan->tag == PLAN_JOIN)
+        return !plan->as.join.is_index + plan_pipeline_join_num(*plan_join_probe_child((plan_node_t *)plan));
+    return plan_pipeline_join_num(plan->left);
+}
+
+/* Selections and projections over a scan fused into generated code, NULL if the node is not such a
+ * pipeline or the code could not be compiled */
+static operator_t *plan_compile_codegen(arena_t *arena, const plan_node_t *plan)
+{
+    const plan_node_t *scan = plan;
+    uint16_t predicate_num = 0;
+    while (scan->tag == PLAN_SELECT || scan->tag == PLAN_PROJECT) {
+        if (scan->tag == PLAN_SELECT)
+            predicate_num += scan->as.select.pred_num;
+        scan = scan->left;
+    }
+    if (scan->tag != PLAN_SCAN)
+        return NULL;
+
+    /* Scans return all the relation attributes, so scan positions are relation attribute indices */
+    codegen_predicate_t predicates[predicate_num + 1];
+    value_type_t constants[predicate_num + 1];
+    const value_type_t *params[predicate_num + 1];
+    uint16_t pred_i = 0;
+    for (const plan_node_t *node = plan; node != scan; node = node->left) {
+        if (node->tag != PLAN_SELECT)
+            continue;
+        for (uint16_t node_pred_i = 0; node_pred_i < node->as.select.pred_num; node_pred_i++) {
+            const bound_predicate_t *predicate = &node->as.select.predicates[node_pred_i];
+            const bool is_attr_attr = predicate->tag == SELECT_ATTR_ATTR;
+            predicates[pred_i] = (codegen_predicate_t) {
+                .tag = predicate->tag,
+                .op = predicate->op,
+                .left_attr_i = plan_attr_pos(scan, predicate->left_attr),
+                .right_attr_i = is_attr_attr ? plan_attr_pos(scan, predicate->as.right_attr) : 0,
+            };
+            constants[pred_i] = is_attr_attr ? 0 : predicate->as.right_constant;
+            params[pred_i] = is_attr_attr ? NULL : predicate->right_param;
+            pred_i++;
+        }
+    }
+
+    uint16_t out_attr_is[plan->attr_num + 1];
+    for (uint16_t attr_i = 0; attr_i < plan->attr_num; attr_i++)
+        out_attr_is[attr_i] = plan_attr_pos(scan, plan->attrs[attr_i]);
+
+    const compiled_pipeline_fn pipeline_fn = codegen_pipeline(predicates, predicate_num, out_attr_is, plan->attr_num);
+    if (!pipeline_fn)
+        return NULL;
+    operator_t *op = compiled_op_create(arena, scan->as.scan.rel, pipeline_fn, constants, predicate_num,
+                                        out_attr_is, plan->attr_num);
+    assert(op);
+    for (pred_i = 0; pred_i < predicate_num; pred_i++)
+        if (params[pred_i])
+            compiled_op_set_param(op, pred_i, params[pred_i]);
+    return op;
+}
+
+/* Pipelines get scan operators compiled and probe join tables instead of building their own */
+static operator_t *plan_compile_node(arena_t *arena, const plan_node_t *plan, plan_pipeline_t *pipeline)
+{
+    /* Gather workers scan ranges of relations, so their pipelines are always interpreted */
+    if (!pipeline && codegen_is_enabled() && (plan->tag == PLAN_SELECT || plan->tag == PLAN_PROJECT)) {
+        operator_t *op = plan_compile_codegen(arena, plan);
+        if (op)
+            return op;
+    }
+
+    switch (plan->tag) {
+    case PLAN_SCAN: {
+        operator_t *op = scan_op_create(arena, plan->as.scan.rel);
+        if (pipeline)
+            pipeline->scan_op = op;
+        return op;
+    }
+    case PLAN_INDEX_SCAN: {
+        operator_t *op = index_scan_op_create(arena, plan->as.scan.rel, plan->as.scan.index_attr_i,
+                                              plan->as.scan.index_op, plan->as.scan.index_constant);
+        if (plan->as.scan.index_param)
+            index_scan_op_set_param(op, plan->as.scan.index_param);
+        return op;
+    }
+    case PLAN_SELECT: {
+        operator_t *source_op = plan_compile_node(arena, plan->left, pipeline);
+        operator_t *op = select_op_create(arena, source_op);
+        /* Scans right below skip zones constant predicates cannot hold in */
+        const bool is_over_scan = plan->left->tag == PLAN_SCAN;
+        for (uint16_t pred_i = 0; pred_i < plan->as.select.pred_num; pred_i++) {
+            const bound_predicate_t *predicate = &plan->as.select.predicates[pred_i];
+            const uint16_t left_attr_i = plan_attr_pos(plan->left, predicate->left_attr);
+            if (predicate->tag == SELECT_ATTR_ATTR) {
+                const uint16_t right_attr_i = plan_attr_pos(plan->left, predicate->as.right_attr);
+                select_op_add_attr_attr_predicate(op, left_attr_i, predicate->op, right_attr_i);
+            } else if (predicate->right_param) {
+                select_op_add_attr_param_predicate(op, left_attr_i, predicate->op, predicate->right_param);
+                if (is_over_scan)
+                    scan_op_add_zone_param_predicate(source_op, left_attr_i, predicate->op, predicate->right_param);
+            } else {
+                select_op_add_attr_const_predicate(op, left_attr_i, predicate->op, predicate->as.right_constant);
+                if (is_over_scan)
+                    scan_op_add_zone_predicate(source_op, left_attr_i, predicate->op, predicate->as.right_constant);
+            }
+        }
+        return op;
+    }
+    case PLAN_PROJECT: {
+        uint16_t source_attr_is[plan->attr_num];
+        for (uint16_t attr_i = 0; attr_i < plan->attr_num; attr_i++)
+            source_attr_is[attr_i] = plan_attr_pos(plan->left, plan->attrs[attr_i]);
+        return proj_op_create(arena, plan_compile_node(arena, plan->left, pipeline), source_attr_is, plan->attr_num);
+    }
+    case PLAN_JOIN: {
+        if (plan->as.join.is_index) {
+            /* Inner tuples are read from the relation directly, the scan itself is never compiled */
+            const plan_node_t *inner_child = *plan_join_build_child((plan_node_t *)plan);
+            const plan_node_t *outer_child = *plan_join_probe_child((plan_node_t *)plan);
+            const bound_attr_t inner_attr = plan->as.join.build_left ? plan->as.join.left_attr : plan->as.join.right_attr;
+            const bound_attr_t outer_attr = plan->as.join.build_left ? plan->as.join.right_attr : plan->as.join.left_attr;
+            const plan_node_t *scan = plan_join_index_scan(inner_child, inner_attr);
+            assert(scan);
+
+            uint16_t inner_attr_is[inner_child->attr_num];
+            for (uint16_t attr_i = 0; attr_i < inner_child->attr_num; attr_i++)
+                inner_attr_is[attr_i] = plan_attr_pos(scan, inner_child->attrs[attr_i]);
+            return index_join_op_create(arena, plan_compile_node(arena, outer_child, pipeline), scan->as.scan.rel,
+                                        plan_attr_pos(outer_child, outer_attr), plan_attr_pos(scan, inner_attr),
+                                        inner_attr_is, inner_child->attr_num, plan->as.join.build_left);
+        }
+
+        if (pipeline && plan->as.join.is_hash) {
+            join_table_t *table = pipeline->join_tables[pipeline->next_join_table_i++];
+            const plan_node_t *probe_child = *plan_join_probe_child((plan_node_t *)plan);
+            const bound_attr_t probe_attr = plan->as.join.build_left ? plan->as.join.right_attr : plan->as.join.left_attr;
+            return hash_probe_op_create(arena, plan_compile_node(arena, probe_child, pipeline), table,
+                                        plan_attr_pos(probe_child, probe_attr), plan->as.join.build_left);
+        }
+
+        operator_t *left_op = plan_compile(arena, plan->left);
+        operator_t *right_op = plan_compile(arena, plan->right);
+        if (!plan->as.join.is_hash)
+            return join_op_create(arena, left_op, right_op);
+
+        const uint16_t left_attr_i = plan_attr_pos(plan->left, plan->as.join.left_attr);
+        const uint16_t right_attr_i = plan_attr_pos(plan->right, plan->as.join.right_attr);
+        return hash_join_op_create(arena, left_op, right_op, left_attr_i, right_attr_i, plan->as.join.build_left);
+    }
+    case PLAN_AGGREGATE: {
+        const uint16_t group_attr_num = plan->as.aggregate.group_attr_num;
+        const uint16_t aggregate_num = plan->as.aggregate.aggregate_num;
+        const bound_aggregate_t *bound_aggregates = plan->as.aggregate.aggregates;
+        if (plan->as.aggregate.is_tuple_num) {
+            const char *names[aggregate_num + 1];
+            for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++)
+                names[aggregate_i] = bound_aggregates[aggregate_i].name;
+            return count_op_create(arena, plan->left->as.scan.rel, names, aggregate_num);
+        }
+
+        uint16_t group_attr_is[group_attr_num + 1];
+        for (uint16_t attr_i = 0; attr_i < group_attr_num; attr_i++)
+            group_attr_is[attr_i] = plan_attr_pos(plan->left, plan->attrs[attr_i]);
+        aggregate_t aggregates[aggregate_num + 1];
+        for (uint16_t aggregate_i = 0; aggregate_i < aggregate_num; aggregate_i++) {
+            const bound_aggregate_t *aggregate = &bound_aggregates[aggregate_i];
+            aggregates[aggregate_i] = (aggregate_t) {
+                .func = aggregate->func,
+                .attr_i = aggregate->func == AGGREGATE_COUNT ? 0 : plan_attr_pos(plan->left, aggregate->attr),
+                .name = aggregate->name,
+            };
+        }
+
+        operator_t *source_op = plan_compile(arena, plan->left);
+        if (plan->as.aggregate.is_sorted)
+            return stream_aggregate_op_create(arena, source_op, group_attr_is, group_attr_num, aggregates, aggregate_num);
+        return hash_aggregate_op_create(arena, source_op, group_attr_is, group_attr_num, aggregates, aggregate_num);
+    }
+    case PLAN_SORT: {
+        const uint16_t sort_attr_i = plan_attr_pos(plan->left, plan->as.sort.attr);
+        return sort_op_create(arena, plan_compile(arena, plan->left), sort_attr_i, plan->as.sort.order);
+    }
+    case PLAN_TOP_N: {
+        const uint16_t sort_attr_i = plan_attr_pos(plan->left, plan->as.sort.attr);
+        return top_n_op_create(arena, plan_compile(arena, plan->left), sort_attr_i, plan->as.sort.order,
+                               plan->as.sort.limit);
+    }
+    case PLAN_LIMIT:
+        return limit_op_create(arena, plan_compile(arena, plan->left), plan->as.limit.limit, plan->as.limit.offset);
+    case PLAN_GATHER: {
+        /* Join tables are shared, so their build sides get compiled once */
+        join_table_t *join_tables[plan_pipeline_join_num(plan->left) + 1];
+        uint16_t join_table_num = 0;
+        plan_compile_join_tables(arena, plan->left, join_tables, &join_table_num);
+
+        /* Workers allocate batches as they go, so pipelines live on the heap */
+        const uint16_t worker_num = plan->as.gather.worker_num;
+        operator_t *pipelines[worker_num], *scan_ops[worker_num];
+        for (uint16_t worker_i = 0; worker_i < worker_num; worker_i++) {
+            plan_pipeline_t pipeline = { .join_tables = join_tables };
+            pipelines[worker_i] = plan_compile_node(NULL, plan->left, &pipeline);
+            scan_ops[worker_i] = pipeline.scan_op;
+        }
+
+        operator_t *op = gather_op_create(arena, plan_pipeline_scan(plan->left)->as.scan.rel, pipelines, scan_ops,
+                                          worker_num, plan->as.gather.is_ordered);
+        for (uint16_t table_i = 0; table_i < join_table_num; table_i++)
+            gather_op_add_join_table(op, join_tables[table_i]);
+        return op;
+    }
+    }
+    assert(false);
+}
+
+operator_t *plan_compile(arena_t *arena, const plan_node_t *plan)
+{
+    return plan_compile_node(arena, plan, NULL);
+}
@@ -0,0 +1,125 @@
+#ifndef PIGLETQL_PLAN_H
+#define PIGLETQL_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+#include "pigletql-eval.h"
+#include "pigletql-bind.h"
+
+/*
+ * A logical plan is a tree of relational operations over bound attribute references. A bound query
+ * is first turned into a canonical plan (scans, cross joins, select, aggregate, project, sort, limit)
+ * which is then rewritten by a number of rules before being compiled into an operator tree.
+ *
+ * Pipelines of selects, projections and hash join probes over scans of big relations are put under
+ * gather nodes, run in parallel over morsels of the relation. Hash tables probed are built once by
+ * the same workers and shared.
+ *
+ * Selects over scans of relations with an index over an attribute compared to a constant look tuples
+ * up in the index instead of scanning the whole relation. Joins with a side scanning a relation
+ * indexed over the join attribute look that side up in the index for every tuple of the other one
+ * instead of building a hash table.
+ *
+ * Aggregates are computed by hash aggregation, unless the input arrives sorted on the group attribute
+ * from an index scan or there are no groups at all: then groups are aggregated as they stream by.
+ * Counts of all the tuples of a relation are read from the relation itself.
+ *
+ * Plans never depend on constant values, so operator trees compiled for prepared statements read
+ * constants from parameters of the bound query every time they are opened.
+ * */
+
+typedef enum plan_node_tag {
+    PLAN_SCAN,
+    PLAN_INDEX_SCAN,
+    PLAN_SELECT,
+    PLAN_PROJECT,
+    PLAN_JOIN,
+    PLAN_AGGREGATE,
+    PLAN_SORT,
+    PLAN_TOP_N,
+    PLAN_LIMIT,
+    PLAN_GATHER,
+} plan_node_tag;
+
+typedef struct plan_node_t plan_node_t;
+
+struct plan_node_t {
+    /* Arena the node is allocated in, NULL for the heap */
+    arena_t *arena;
+
+    plan_node_tag tag;
+
+    /* Attributes of tuples produced by the node */
+    bound_attr_t *attrs;
+    uint16_t attr_num;
+
+    /* Child nodes, unary nodes only use the left one */
+    plan_node_t *left;
+    plan_node_t *right;
+
+    union {
+        /* Scans and index scans */
+        struct {
+            relation_t *rel;
+            uint16_t rel_i;
+            /* Index scans: the indexed attribute compared to a constant */
+            uint16_t index_attr_i;
+            select_predicate_op index_op;
+            value_type_t index_constant;
+            /* Parameter of a prepared statement to read the constant from, NULL if it's fixed */
+            const value_type_t *index_param;
+        } scan;
+        struct {
+            bound_predicate_t *predicates;
+            uint16_t pred_num;
+        } select;
+        struct {
+            /* Cross joins have no join attributes */
+            bool is_hash;
+            bound_attr_t left_attr;
+            bound_attr_t right_attr;
+            /* Hash joins: build the hash table on the left side */
+            bool build_left;
+            /* Index joins are hash joins looking the build side up in an index of its relation */
+            bool is_index;
+        } join;
+        /* Aggregates: attributes are group attributes followed by aggregates */
+        struct {
+            const bound_aggregate_t *aggregates;
+            uint16_t aggregate_num;
+            uint16_t group_attr_num;
+            /* Is the input sorted on group attributes? */
+            bool is_sorted;
+            /* Counts of all the tuples of a scanned relation only */
+            bool is_tuple_num;
+        } aggregate;
+        /* Sorts and top-N sorts */
+        struct {
+            bound_attr_t attr;
+            sort_order_t order;
+            /* Top-N: number of tuples to keep */
+            uint32_t limit;
+        } sort;
+        struct {
+            uint32_t limit;
+            uint32_t offset;
+        } limit;
+        struct {
+            /* Do nodes above need tuples in the relation order? */
+            bool is_ordered;
+            uint16_t worker_num;
+        } gather;
+    } as;
+};
+
+/* Build a plan for a bound query and apply all the rewrite rules */
+plan_node_t *plan_select(arena_t *arena, const bound_select_t *query);
+
+/* Compile a plan into an operator tree, operator states are allocated in the arena given */
+operator_t *plan_compile(arena_t *arena, const plan_node_t *plan);
+
+void plan_destroy(plan_node_t *plan);
+
+#endif //PIGLETQL_PLAN_H
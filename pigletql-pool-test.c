@@ -0,0 +1,111 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "pigletql-pool.h"
+
+typedef struct test_task_t {
+    uint32_t task_i;
+    uint64_t sum;
+    uint16_t worker_i;
+} test_task_t;
+
+static void test_task_run(void *arg, const uint16_t worker_i)
+{
+    test_task_t *task = arg;
+    /* Some work to let other workers steal */
+    for (uint32_t i = 0; i <= task->task_i % 100 * 100; i++)
+        task->sum += i;
+    task->worker_i = worker_i;
+}
+
+/* Tasks submitting more tasks, a binary tree of them */
+typedef struct test_tree_task_t {
+    pool_t *pool;
+    uint32_t depth;
+    uint32_t *run_num;
+} test_tree_task_t;
+
+static void test_tree_task_run(void *arg, const uint16_t worker_i)
+{
+    (void) worker_i;
+    test_tree_task_t *task = arg;
+    __atomic_add_fetch(task->run_num, 1, __ATOMIC_RELAXED);
+    if (task->depth == 0) {
+        free(task);
+        return;
+    }
+    for (int child_i = 0; child_i < 2; child_i++) {
+        test_tree_task_t *child = malloc(sizeof(*child));
+        assert(child);
+        *child = (test_tree_task_t){ .pool = task->pool, .depth = task->depth - 1, .run_num = task->run_num };
+        pool_submit(task->pool, test_tree_task_run, child);
+    }
+    free(task);
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    assert(pool_cpu_num() > 0);
+
+    /* Every task submitted runs exactly once, on one of the workers */
+    for (uint16_t worker_num = 1; worker_num <= 8; worker_num *= 2) {
+        pool_t *pool = pool_create(worker_num);
+        assert(pool);
+        assert(pool_get_worker_num(pool) == worker_num);
+
+        const uint32_t task_num = 10000;
+        test_task_t *tasks = calloc(task_num, sizeof(test_task_t));
+        assert(tasks);
+
+        /* The pool is reused after waiting */
+        for (int round = 0; round < 2; round++) {
+            for (uint32_t task_i = 0; task_i < task_num; task_i++) {
+                tasks[task_i] = (test_task_t){ .task_i = task_i, .worker_i = UINT16_MAX };
+                pool_submit(pool, test_task_run, &tasks[task_i]);
+            }
+            pool_wait(pool);
+
+            for (uint32_t task_i = 0; task_i < task_num; task_i++) {
+                const uint64_t n = task_i % 100 * 100;
+                assert(tasks[task_i].sum == n * (n + 1) / 2);
+                assert(tasks[task_i].worker_i < worker_num);
+            }
+        }
+
+        /* Destroying waits for tasks left */
+        for (uint32_t task_i = 0; task_i < task_num; task_i++) {
+            tasks[task_i] = (test_task_t){ .task_i = task_i, .worker_i = UINT16_MAX };
+            pool_submit(pool, test_task_run, &tasks[task_i]);
+        }
+        pool_destroy(pool);
+        for (uint32_t task_i = 0; task_i < task_num; task_i++)
+            assert(tasks[task_i].worker_i < worker_num);
+
+        free(tasks);
+    }
+
+    /* Tasks submitted by tasks are waited for too */
+    for (uint16_t worker_num = 1; worker_num <= 8; worker_num *= 2) {
+        pool_t *pool = pool_create(worker_num);
+        uint32_t run_num = 0;
+        test_tree_task_t *root = malloc(sizeof(*root));
+        assert(root);
+        *root = (test_tree_task_t){ .pool = pool, .depth = 12, .run_num = &run_num };
+        pool_submit(pool, test_tree_task_run, root);
+        pool_wait(pool);
+        assert(__atomic_load_n(&run_num, __ATOMIC_RELAXED) == (1u << 13) - 1);
+        pool_destroy(pool);
+    }
+
+    /* No tasks at all */
+    {
+        pool_t *pool = pool_create(4);
+        pool_wait(pool);
+        pool_destroy(pool);
+    }
+
+    return 0;
+}
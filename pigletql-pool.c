@@ -0,0 +1,293 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pigletql-pool.h"
+
+/* Deques start with this number of task slots and grow twice as needed */
+#define POOL_DEQUE_MIN_SLOT_NUM 64
+
+typedef struct pool_task_t {
+    pool_task_fn fn;
+    void *arg;
+} pool_task_t;
+
+/* A ring buffer of tasks, the owner takes tasks from the head, thieves from the tail */
+typedef struct pool_deque_t {
+    pthread_mutex_t lock;
+    pool_task_t *tasks;
+    uint32_t slot_num;
+    uint32_t head;
+    uint32_t task_num;
+} pool_deque_t;
+
+typedef struct pool_worker_t {
+    pool_t *pool;
+    uint16_t worker_i;
+    pthread_t thread;
+} pool_worker_t;
+
+struct pool_t {
+    pool_worker_t *workers;
+    /* A deque per worker, and one more for tasks submitted from outside of the pool */
+    pool_deque_t *deques;
+    uint16_t worker_num;
+
+    /* Counters are atomic, so tasks only take deque locks on their way through the pool. Tasks
+     * sitting in deques: */
+    uint32_t queued_num;
+    /* Tasks submitted but not finished yet */
+    uint32_t pending_num;
+    /* Workers parked or about to park */
+    uint32_t parked_num;
+
+    /* The pool lock only guards parking, waiting and stopping */
+    pthread_mutex_t lock;
+    /* Signalled when tasks are queued to parked workers or the pool is stopping */
+    pthread_cond_t work_cond;
+    /* Signalled when all the tasks submitted are finished */
+    pthread_cond_t idle_cond;
+    bool is_stopping;
+};
+
+/* The worker running on this thread, NULL outside of pools */
+static __thread pool_worker_t *pool_current_worker;
+
+/*
+ * Deques
+ *  */
+
+/* Deques count tasks queued while holding their locks, so a worker finding all the deques empty
+ * knows that nothing it missed is counted */
+static void pool_deque_push(pool_t *pool, pool_deque_t *deque, const pool_task_t task)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->task_num == deque->slot_num) {
+        /* Unroll the ring into a bigger buffer */
+        const uint32_t slot_num = deque->slot_num ? deque->slot_num * 2 : POOL_DEQUE_MIN_SLOT_NUM;
+        pool_task_t *tasks = calloc(slot_num, sizeof(pool_task_t));
+        assert(tasks);
+        for (uint32_t task_i = 0; task_i < deque->task_num; task_i++)
+            tasks[task_i] = deque->tasks[(deque->head + task_i) % deque->slot_num];
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->slot_num = slot_num;
+        deque->head = 0;
+    }
+
+    deque->tasks[(deque->head + deque->task_num) % deque->slot_num] = task;
+    deque->task_num++;
+    __atomic_add_fetch(&pool->queued_num, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/* Owners take the oldest task, so tasks submitted in order mostly start in order */
+static bool pool_deque_take(pool_t *pool, pool_deque_t *deque, pool_task_t *task)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    const bool has_task = deque->task_num > 0;
+    if (has_task) {
+        *task = deque->tasks[deque->head];
+        deque->head = (deque->head + 1) % deque->slot_num;
+        deque->task_num--;
+        __atomic_sub_fetch(&pool->queued_num, 1, __ATOMIC_SEQ_CST);
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return has_task;
+}
+
+/* Thieves take the newest task, staying away from the owner */
+static bool pool_deque_steal(pool_t *pool, pool_deque_t *deque, pool_task_t *task)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    const bool has_task = deque->task_num > 0;
+    if (has_task) {
+        deque->task_num--;
+        *task = deque->tasks[(deque->head + deque->task_num) % deque->slot_num];
+        __atomic_sub_fetch(&pool->queued_num, 1, __ATOMIC_SEQ_CST);
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return has_task;
+}
+
+/*
+ * Workers
+ *  */
+
+/* The worker's own tasks first, then tasks from outside of the pool in submission order, then
+ * tasks stolen from other workers */
+static bool pool_find_task(pool_t *pool, const uint16_t worker_i, pool_task_t *task)
+{
+    if (pool_deque_take(pool, &pool->deques[worker_i], task))
+        return true;
+    if (pool_deque_take(pool, &pool->deques[pool->worker_num], task))
+        return true;
+
+    for (uint16_t victim_shift = 1; victim_shift < pool->worker_num; victim_shift++) {
+        const uint16_t victim_i = (worker_i + victim_shift) % pool->worker_num;
+        if (pool_deque_steal(pool, &pool->deques[victim_i], task))
+            return true;
+    }
+
+    return false;
+}
+
+/* Sleep until tasks get queued, false if the pool is stopping instead. Parking workers are counted
+ * before checking for tasks, and submitters count tasks before checking for parked workers, so either
+ * the worker sees the task or the submitter sees the worker and wakes it up. */
+static bool pool_park(pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->parked_num, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&pool->queued_num, __ATOMIC_SEQ_CST) == 0 && !pool->is_stopping)
+        pthread_cond_wait(&pool->work_cond, &pool->lock);
+    __atomic_sub_fetch(&pool->parked_num, 1, __ATOMIC_SEQ_CST);
+    const bool has_work = __atomic_load_n(&pool->queued_num, __ATOMIC_SEQ_CST) > 0;
+    pthread_mutex_unlock(&pool->lock);
+    return has_work;
+}
+
+static void *pool_worker_run(void *arg)
+{
+    pool_worker_t *worker = arg;
+    pool_t *pool = worker->pool;
+    pool_current_worker = worker;
+
+    pool_task_t task;
+    while (true) {
+        if (!pool_find_task(pool, worker->worker_i, &task)) {
+            if (!pool_park(pool))
+                break;
+            continue;
+        }
+
+        task.fn(task.arg, worker->worker_i);
+
+        if (__atomic_sub_fetch(&pool->pending_num, 1, __ATOMIC_SEQ_CST) == 0) {
+            pthread_mutex_lock(&pool->lock);
+            pthread_cond_broadcast(&pool->idle_cond);
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Pool
+ *  */
+
+pool_t *pool_create(const uint16_t worker_num)
+{
+    assert(worker_num > 0);
+
+    pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        goto pool_fail;
+
+    pool->worker_num = worker_num;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+
+    pool->deques = calloc(worker_num + 1, sizeof(pool_deque_t));
+    if (!pool->deques)
+        goto deques_fail;
+    for (uint16_t deque_i = 0; deque_i <= worker_num; deque_i++)
+        pthread_mutex_init(&pool->deques[deque_i].lock, NULL);
+
+    pool->workers = calloc(worker_num, sizeof(pool_worker_t));
+    if (!pool->workers)
+        goto workers_fail;
+    for (uint16_t worker_i = 0; worker_i < worker_num; worker_i++) {
+        pool_worker_t *worker = &pool->workers[worker_i];
+        worker->pool = pool;
+        worker->worker_i = worker_i;
+        const int res = pthread_create(&worker->thread, NULL, pool_worker_run, worker);
+        assert(res == 0);
+    }
+
+    return pool;
+
+workers_fail:
+    free(pool->deques);
+deques_fail:
+    free(pool);
+pool_fail:
+    return NULL;
+}
+
+uint16_t pool_get_worker_num(const pool_t *pool)
+{
+    return pool->worker_num;
+}
+
+void pool_submit(pool_t *pool, pool_task_fn fn, void *arg)
+{
+    /* Workers keep tasks they submit, other threads share a deque of their own */
+    const pool_worker_t *worker = pool_current_worker;
+    const uint16_t deque_i = worker && worker->pool == pool ? worker->worker_i : pool->worker_num;
+
+    /* Tasks are pending before workers can see them, so pool_wait can't miss them */
+    __atomic_add_fetch(&pool->pending_num, 1, __ATOMIC_SEQ_CST);
+    pool_deque_push(pool, &pool->deques[deque_i], (pool_task_t){ .fn = fn, .arg = arg });
+
+    /* Busy workers find the task themselves, parked ones have to be woken up */
+    if (__atomic_load_n(&pool->parked_num, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        assert(!pool->is_stopping);
+        pthread_cond_signal(&pool->work_cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+void pool_wait(pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (__atomic_load_n(&pool->pending_num, __ATOMIC_SEQ_CST) > 0)
+        pthread_cond_wait(&pool->idle_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(pool_t *pool)
+{
+    if (!pool)
+        return;
+
+    pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->is_stopping = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Workers might look into any deque until they stop */
+    for (uint16_t worker_i = 0; worker_i < pool->worker_num; worker_i++)
+        pthread_join(pool->workers[worker_i].thread, NULL);
+    for (uint16_t deque_i = 0; deque_i <= pool->worker_num; deque_i++) {
+        pthread_mutex_destroy(&pool->deques[deque_i].lock);
+        free(pool->deques[deque_i].tasks);
+    }
+
+    pthread_cond_destroy(&pool->idle_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+}
+
+uint16_t pool_cpu_num(void)
+{
+    const long cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_num < 1)
+        return 1;
+    return cpu_num > UINT16_MAX ? UINT16_MAX : (uint16_t)cpu_num;
+}
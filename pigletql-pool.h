@@ -0,0 +1,35 @@
+#ifndef PIGLETQL_POOL_H
+#define PIGLETQL_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A pool of worker threads running tasks. Every worker has a deque of tasks, tasks submitted by a
+ * worker go to its own deque, tasks submitted from outside of the pool go to a deque shared by
+ * workers. Workers take tasks from their own deques in submission order, then from the shared deque,
+ * and steal from the other end of deques of other workers when there's nothing else to do. Workers
+ * with nothing to do at all park until tasks get submitted.
+ * */
+
+typedef struct pool_t pool_t;
+
+/* A task gets its argument and the index of the worker running it */
+typedef void (*pool_task_fn)(void *arg, const uint16_t worker_i);
+
+pool_t *pool_create(const uint16_t worker_num);
+
+uint16_t pool_get_worker_num(const pool_t *pool);
+
+void pool_submit(pool_t *pool, pool_task_fn fn, void *arg);
+
+/* Wait for all the tasks submitted to finish */
+void pool_wait(pool_t *pool);
+
+/* Waits for tasks submitted, then stops workers */
+void pool_destroy(pool_t *pool);
+
+/* Number of CPUs online, a reasonable default number of workers */
+uint16_t pool_cpu_num(void);
+
+#endif //PIGLETQL_POOL_H
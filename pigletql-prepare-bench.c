@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pigletql-prepare.h"
+#include "pigletql-validate.h"
+#include "pigletql-plan.h"
+
+/*
+ * Short queries: point lookups per second when every query is scanned, parsed, validated, bound,
+ * planned and compiled the way the REPL does it, versus executing a prepared statement reusing its
+ * operator tree.
+ *  */
+
+#define BENCH_TUPLE_NUM (1000 * 1000)
+#define BENCH_QUERY_NUM (200 * 1000)
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static catalogue_t *bench_catalogue(void)
+{
+    catalogue_t *cat = catalogue_create();
+    const char *attr_names[] = {"id", "val"};
+    relation_t *rel = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+    if (!cat || !rel) {
+        fprintf(stderr, "Error: failed to create the relation\n");
+        exit(1);
+    }
+    for (value_type_t tuple_i = 0; tuple_i < BENCH_TUPLE_NUM; tuple_i++)
+        relation_append_values(rel, (value_type_t[]){tuple_i, tuple_i * 7});
+    relation_create_index(rel, 0);
+    catalogue_add_relation(cat, "rel1", rel);
+    return cat;
+}
+
+/* Run a tree, returning the sum of the first attribute values */
+static uint64_t run_op(operator_t *op)
+{
+    uint64_t sum = 0;
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state)))
+        for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++)
+            sum += batch->columns[0][batch->sel[sel_i]];
+    op->close(op->state);
+    return sum;
+}
+
+static query_t *parse(arena_t *arena, catalogue_t *cat, const char *line)
+{
+    scanner_t *scanner = scanner_create(arena, line);
+    parser_t *parser = parser_create(arena);
+    query_t *query = query_create(arena);
+    if (!parser_parse(parser, scanner, query) || !validate(cat, query)) {
+        fprintf(stderr, "Error: failed to parse '%s'\n", line);
+        exit(1);
+    }
+    return query;
+}
+
+static double bench_adhoc(catalogue_t *cat, uint64_t *sum)
+{
+    arena_t *arena = arena_create();
+    char line[128];
+    *sum = 0;
+    const double start = now_seconds();
+    for (uint32_t query_i = 0; query_i < BENCH_QUERY_NUM; query_i++) {
+        snprintf(line, sizeof(line), "select val from rel1 where id = %u;", query_i * 5 % BENCH_TUPLE_NUM);
+        query_t *query = parse(arena, cat, line);
+        bound_select_t *bound_query = bind_select(arena, cat, &query->as.select);
+        plan_node_t *plan = plan_select(arena, bound_query);
+        operator_t *root_op = plan_compile(arena, plan);
+        plan_destroy(plan);
+        *sum += run_op(root_op);
+        root_op->destroy(root_op);
+        bound_select_destroy(bound_query);
+        arena_reset(arena);
+    }
+    const double seconds = now_seconds() - start;
+    arena_destroy(arena);
+    return BENCH_QUERY_NUM / seconds;
+}
+
+static double bench_prepared(catalogue_t *cat, uint64_t *sum)
+{
+    arena_t *arena = arena_create();
+    prepare_cache_t *cache = prepare_cache_create();
+    query_t *query = parse(arena, cat, "prepare lookup as select val from rel1 where id = ?;");
+    if (!cache || !prepare_cache_add(cache, cat, query->as.prepare.name, &query->as.prepare.select)) {
+        fprintf(stderr, "Error: failed to prepare\n");
+        exit(1);
+    }
+    arena_destroy(arena);
+
+    *sum = 0;
+    const double start = now_seconds();
+    for (uint32_t query_i = 0; query_i < BENCH_QUERY_NUM; query_i++) {
+        const value_type_t param = query_i * 5 % BENCH_TUPLE_NUM;
+        *sum += run_op(prepare_cache_get_op(cache, "lookup", &param));
+    }
+    const double seconds = now_seconds() - start;
+    prepare_cache_destroy(cache);
+    return BENCH_QUERY_NUM / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    catalogue_t *cat = bench_catalogue();
+
+    printf("%10s %14s %10s\n", "query", "queries/s", "speedup");
+
+    uint64_t adhoc_sum = 0;
+    const double adhoc_rate = bench_adhoc(cat, &adhoc_sum);
+    printf("%10s %14.0f %10.2f\n", "ad hoc", adhoc_rate, 1.0);
+
+    uint64_t prepared_sum = 0;
+    const double prepared_rate = bench_prepared(cat, &prepared_sum);
+    printf("%10s %14.0f %10.2f\n", "prepared", prepared_rate, prepared_rate / adhoc_rate);
+
+    if (adhoc_sum != prepared_sum) {
+        fprintf(stderr, "Error: results differ\n");
+        return 1;
+    }
+
+    catalogue_destroy(cat);
+
+    return 0;
+}
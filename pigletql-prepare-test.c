@@ -0,0 +1,180 @@
+#include <assert.h>
+#include <string.h>
+
+#include "pigletql-prepare.h"
+#include "pigletql-validate.h"
+#include "pigletql-codegen.h"
+
+#define TUPLE_NUM (5 * MORSEL_SIZE + 17)
+#define DISTINCT_NUM 100
+
+static catalogue_t *catalogue_create_for_test(void)
+{
+    catalogue_t *cat = catalogue_create();
+    assert(cat);
+
+    {
+        const char *attr_names[] = {"id", "val"};
+        relation_t *rel1 = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_COLUMNS);
+        for (value_type_t tuple_i = 0; tuple_i < TUPLE_NUM; tuple_i++)
+            relation_append_values(rel1, (value_type_t[]){tuple_i, tuple_i % DISTINCT_NUM});
+        catalogue_add_relation(cat, "rel1", rel1);
+    }
+
+    {
+        const char *attr_names[] = {"id2", "name"};
+        relation_t *rel2 = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), LAYOUT_ROWS);
+        for (value_type_t tuple_i = 0; tuple_i < DISTINCT_NUM; tuple_i++)
+            relation_append_values(rel2, (value_type_t[]){tuple_i, tuple_i * 2});
+        catalogue_add_relation(cat, "rel2", rel2);
+    }
+
+    return cat;
+}
+
+/* Parse, validate and keep a PREPARE statement */
+static bool prepare(prepare_cache_t *cache, catalogue_t *cat, const char *query_str)
+{
+    scanner_t *scanner = scanner_create(NULL, query_str);
+    parser_t *parser = parser_create(NULL);
+    query_t *query = query_create(NULL);
+    assert(parser_parse(parser, scanner, query));
+    assert(query->tag == QUERY_PREPARE);
+    assert(validate(cat, query));
+
+    const bool is_added = prepare_cache_add(cache, cat, query->as.prepare.name, &query->as.prepare.select);
+
+    query_destroy(query);
+    parser_destroy(parser);
+    scanner_destroy(scanner);
+    return is_added;
+}
+
+/* Run a statement, returning the number of tuples and the sum of the first attribute values */
+static uint32_t execute(prepare_cache_t *cache, const char *name, const value_type_t *params, uint64_t *sum)
+{
+    operator_t *op = prepare_cache_get_op(cache, name, params);
+    assert(op);
+
+    uint32_t tuple_num = 0;
+    *sum = 0;
+    op->open(op->state);
+    batch_t *batch = NULL;
+    while ((batch = op->next_batch(op->state))) {
+        for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++)
+            *sum += batch->columns[0][batch->sel[sel_i]];
+        tuple_num += batch->sel_num;
+    }
+    op->close(op->state);
+    return tuple_num;
+}
+
+/* Range and join statements give the same results however they get planned */
+static void check_statements(prepare_cache_t *cache)
+{
+    for (value_type_t low = 0; low < TUPLE_NUM; low += TUPLE_NUM / 7) {
+        for (value_type_t val = 0; val < DISTINCT_NUM; val += 33) {
+            uint32_t expected_num = 0;
+            uint64_t expected_sum = 0;
+            for (value_type_t tuple_i = low + 1; tuple_i < TUPLE_NUM; tuple_i++) {
+                if (tuple_i % DISTINCT_NUM != val)
+                    continue;
+                expected_num++;
+                expected_sum += tuple_i;
+            }
+
+            uint64_t sum = 0;
+            assert(execute(cache, "range", (value_type_t[]){low, val}, &sum) == expected_num);
+            assert(sum == expected_sum);
+        }
+    }
+
+    for (value_type_t val = 0; val < DISTINCT_NUM + 1; val += 25) {
+        uint64_t sum = 0;
+        const uint32_t expected_num = val < DISTINCT_NUM ? TUPLE_NUM / DISTINCT_NUM + (val < TUPLE_NUM % DISTINCT_NUM) : 0;
+        assert(execute(cache, "join", (value_type_t[]){val}, &sum) == expected_num);
+        assert(sum == (uint64_t)expected_num * val * 2);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* The same trees are reopened with new parameters until something changes plans */
+    {
+        catalogue_t *cat = catalogue_create_for_test();
+        prepare_cache_t *cache = prepare_cache_create();
+        assert(cache);
+        gather_op_set_worker_num(1);
+
+        assert(prepare(cache, cat, "PREPARE range AS SELECT id FROM rel1 WHERE id > ? AND val = ?;"));
+        assert(prepare(cache, cat, "PREPARE join AS SELECT name, val FROM rel1, rel2 WHERE val = id2 AND id2 = ?;"));
+        assert(prepare(cache, cat, "PREPARE fixed AS SELECT id FROM rel1 WHERE id < 10;"));
+        assert(!prepare(cache, cat, "PREPARE fixed AS SELECT id FROM rel1;"));
+
+        assert(prepare_cache_has(cache, "range"));
+        assert(!prepare_cache_has(cache, "other"));
+        assert(prepare_cache_get_param_num(cache, "range") == 2);
+        assert(prepare_cache_get_param_num(cache, "join") == 1);
+        assert(prepare_cache_get_param_num(cache, "fixed") == 0);
+
+        /* Nothing is compiled until executed, then only once */
+        assert(prepare_cache_get_compile_num(cache) == 0);
+        check_statements(cache);
+        assert(prepare_cache_get_compile_num(cache) == 2);
+        check_statements(cache);
+        assert(prepare_cache_get_compile_num(cache) == 2);
+
+        uint64_t sum = 0;
+        assert(execute(cache, "fixed", NULL, &sum) == 10);
+        assert(sum == 45);
+        assert(prepare_cache_get_compile_num(cache) == 3);
+
+        /* Indexes turn scans into index scans and joins into index joins */
+        prepare_cache_invalidate(cache);
+        relation_create_index(catalogue_get_relation(cat, "rel1"), 0);
+        relation_create_hash_index(catalogue_get_relation(cat, "rel2"), 0);
+        check_statements(cache);
+        assert(prepare_cache_get_compile_num(cache) == 5);
+
+        /* Parallel scans */
+        prepare_cache_invalidate(cache);
+        gather_op_set_worker_num(4);
+        check_statements(cache);
+        assert(prepare_cache_get_compile_num(cache) == 7);
+        gather_op_set_worker_num(1);
+
+        /* Generated code, or operators if there's no compiler */
+        prepare_cache_invalidate(cache);
+        codegen_set_enabled(true);
+        check_statements(cache);
+        assert(prepare_cache_get_compile_num(cache) == 9);
+        codegen_set_enabled(false);
+
+        /* Relations growing a lot get planned again, tuples appended are found either way */
+        relation_t *rel1 = catalogue_get_relation(cat, "rel1");
+        relation_append_values(rel1, (value_type_t[]){TUPLE_NUM + 1, 1});
+        assert(execute(cache, "fixed", NULL, &sum) == 10);
+        assert(prepare_cache_get_compile_num(cache) == 10);
+        for (value_type_t tuple_i = 0; tuple_i < 2 * TUPLE_NUM; tuple_i++)
+            relation_append_values(rel1, (value_type_t[]){TUPLE_NUM + 1, 1});
+        assert(execute(cache, "fixed", NULL, &sum) == 10);
+        assert(prepare_cache_get_compile_num(cache) == 11);
+        assert(execute(cache, "range", (value_type_t[]){TUPLE_NUM, 1}, &sum) == 2 * TUPLE_NUM + 1);
+        assert(prepare_cache_get_compile_num(cache) == 12);
+
+        /* Removed statements are gone, names can be taken again */
+        assert(prepare_cache_remove(cache, "range"));
+        assert(!prepare_cache_remove(cache, "range"));
+        assert(!prepare_cache_has(cache, "range"));
+        assert(prepare(cache, cat, "PREPARE range AS SELECT val FROM rel1 WHERE id = ?;"));
+        assert(execute(cache, "range", (value_type_t[]){5}, &sum) == 1);
+        assert(sum == 5);
+
+        prepare_cache_destroy(cache);
+        catalogue_destroy(cat);
+    }
+
+    return 0;
+}
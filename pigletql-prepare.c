@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "pigletql-prepare.h"
+#include "pigletql-plan.h"
+
+typedef struct statement_t {
+    rel_name_t name;
+    /* Bound on the heap, parameters are set before the tree gets opened */
+    bound_select_t *query;
+    /* Operator tree on the heap, NULL until executed or after invalidation */
+    operator_t *root_op;
+    /* Tuples of query relations when the tree was compiled */
+    uint32_t *compiled_tuple_nums;
+    struct statement_t *next;
+} statement_t;
+
+typedef struct prepare_cache_t {
+    statement_t *statement_list;
+    uint32_t compile_num;
+} prepare_cache_t;
+
+prepare_cache_t *prepare_cache_create(void)
+{
+    prepare_cache_t *cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return NULL;
+
+    return cache;
+}
+
+static void statement_drop_op(statement_t *statement)
+{
+    if (!statement->root_op)
+        return;
+    statement->root_op->destroy(statement->root_op);
+    statement->root_op = NULL;
+}
+
+static void statement_destroy(statement_t *statement)
+{
+    statement_drop_op(statement);
+    bound_select_destroy(statement->query);
+    free(statement->compiled_tuple_nums);
+    free(statement);
+}
+
+void prepare_cache_destroy(prepare_cache_t *cache)
+{
+    for (statement_t *this = cache->statement_list; this;) {
+        statement_t *next = this->next;
+        statement_destroy(this);
+        this = next;
+    }
+    free(cache);
+}
+
+static statement_t **prepare_cache_find(prepare_cache_t *cache, const rel_name_t name)
+{
+    statement_t **this = &cache->statement_list;
+    for (; *this; this = &(*this)->next)
+        if (0 == strncmp((*this)->name, name, MAX_REL_NAME_LEN))
+            break;
+    return this;
+}
+
+static statement_t *prepare_cache_get(prepare_cache_t *cache, const rel_name_t name)
+{
+    statement_t *statement = *prepare_cache_find(cache, name);
+    assert(statement);
+    return statement;
+}
+
+bool prepare_cache_add(prepare_cache_t *cache, catalogue_t *cat, const rel_name_t name,
+                       const query_select_t *query)
+{
+    statement_t **tail = prepare_cache_find(cache, name);
+    if (*tail)
+        goto name_fail;
+
+    statement_t *statement = calloc(1, sizeof(*statement));
+    if (!statement)
+        goto statement_fail;
+    strncpy(statement->name, name, MAX_REL_NAME_LEN - 1);
+
+    /* Bound queries outlive statement arenas */
+    statement->query = bind_select(NULL, cat, query);
+    if (!statement->query)
+        goto query_fail;
+
+    statement->compiled_tuple_nums = calloc(query->rel_num, sizeof(uint32_t));
+    if (!statement->compiled_tuple_nums)
+        goto tuple_nums_fail;
+
+    *tail = statement;
+    return true;
+
+tuple_nums_fail:
+    bound_select_destroy(statement->query);
+query_fail:
+    free(statement);
+statement_fail:
+name_fail:
+    return false;
+}
+
+bool prepare_cache_remove(prepare_cache_t *cache, const rel_name_t name)
+{
+    statement_t **this = prepare_cache_find(cache, name);
+    statement_t *statement = *this;
+    if (!statement)
+        return false;
+
+    *this = statement->next;
+    statement_destroy(statement);
+    return true;
+}
+
+bool prepare_cache_has(prepare_cache_t *cache, const rel_name_t name)
+{
+    return *prepare_cache_find(cache, name) != NULL;
+}
+
+uint16_t prepare_cache_get_param_num(prepare_cache_t *cache, const rel_name_t name)
+{
+    return prepare_cache_get(cache, name)->query->param_num;
+}
+
+/* Has a relation grown so much since compiling that the plan might be a poor fit? */
+static bool statement_is_stale(const statement_t *statement)
+{
+    const bound_select_t *query = statement->query;
+    for (uint16_t rel_i = 0; rel_i < query->rel_num; rel_i++) {
+        const uint64_t compiled_tuple_num = statement->compiled_tuple_nums[rel_i];
+        if (relation_get_tuple_num(query->rels[rel_i]) > compiled_tuple_num * PREPARE_REPLAN_GROWTH)
+            return true;
+    }
+    return false;
+}
+
+static void statement_compile(prepare_cache_t *cache, statement_t *statement)
+{
+    const bound_select_t *query = statement->query;
+    for (uint16_t rel_i = 0; rel_i < query->rel_num; rel_i++)
+        statement->compiled_tuple_nums[rel_i] = relation_get_tuple_num(query->rels[rel_i]);
+
+    /* Trees are reopened by statements to come, so nothing goes to arenas */
+    plan_node_t *plan = plan_select(NULL, query);
+    statement->root_op = plan_compile(NULL, plan);
+    plan_destroy(plan);
+    assert(statement->root_op);
+
+    cache->compile_num++;
+}
+
+operator_t *prepare_cache_get_op(prepare_cache_t *cache, const rel_name_t name, const value_type_t *params)
+{
+    statement_t *statement = prepare_cache_get(cache, name);
+
+    if (statement->root_op && statement_is_stale(statement))
+        statement_drop_op(statement);
+    if (!statement->root_op)
+        statement_compile(cache, statement);
+
+    /* Operators read parameters when opened */
+    if (statement->query->param_num > 0)
+        memcpy(statement->query->params, params, statement->query->param_num * sizeof(value_type_t));
+    return statement->root_op;
+}
+
+void prepare_cache_invalidate(prepare_cache_t *cache)
+{
+    for (statement_t *this = cache->statement_list; this; this = this->next)
+        statement_drop_op(this);
+}
+
+uint32_t prepare_cache_get_compile_num(prepare_cache_t *cache)
+{
+    return cache->compile_num;
+}
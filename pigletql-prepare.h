@@ -0,0 +1,56 @@
+#ifndef PIGLETQL_PREPARE_H
+#define PIGLETQL_PREPARE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+#include "pigletql-eval.h"
+#include "pigletql-catalogue.h"
+#include "pigletql-parser.h"
+#include "pigletql-bind.h"
+
+/*
+ * Prepared statements are selects validated and bound once, kept under a name along with the
+ * operator tree compiled for them. Executing a statement sets parameter values of the bound query and
+ * reopens the same tree, operators read constants from parameters when opened. Scanning, parsing,
+ * binding, planning and generating code are skipped altogether.
+ *
+ * Plans depend on indexes, settings and relation sizes, so trees get compiled again after indexes are
+ * created or settings change (see prepare_cache_invalidate()), and once a relation a tree reads grows
+ * PREPARE_REPLAN_GROWTH times bigger than it was when the tree was compiled.
+ * */
+
+#define PREPARE_REPLAN_GROWTH 2
+
+typedef struct prepare_cache_t prepare_cache_t;
+
+prepare_cache_t *prepare_cache_create(void);
+
+/* Destroys all the statements and their operator trees */
+void prepare_cache_destroy(prepare_cache_t *cache);
+
+/* Bind a validated select and keep it under the name given, false if the name is taken. Statement
+ * names share the length limit of relation names. */
+bool prepare_cache_add(prepare_cache_t *cache, catalogue_t *cat, const rel_name_t name,
+                       const query_select_t *query);
+
+/* Forget a statement, false if there's no such statement */
+bool prepare_cache_remove(prepare_cache_t *cache, const rel_name_t name);
+
+bool prepare_cache_has(prepare_cache_t *cache, const rel_name_t name);
+
+/* Number of parameter values a statement should be executed with */
+uint16_t prepare_cache_get_param_num(prepare_cache_t *cache, const rel_name_t name);
+
+/* The operator tree of a statement with parameter values set, compiled if needed. The tree is owned
+ * by the cache: callers open, consume and close it, and should not destroy it. */
+operator_t *prepare_cache_get_op(prepare_cache_t *cache, const rel_name_t name, const value_type_t *params);
+
+/* Drop all the operator trees, statements get compiled again when executed next */
+void prepare_cache_invalidate(prepare_cache_t *cache);
+
+/* Number of operator trees compiled so far, useful for checking the cache */
+uint32_t prepare_cache_get_compile_num(prepare_cache_t *cache);
+
+#endif //PIGLETQL_PREPARE_H
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pigletql-eval.h"
+
+/*
+ * ORDER BY throughput: rows per second sorted by sorting whole rows with qsort, the way relations
+ * used to be sorted, and by relation_order_by for both relation layouts.
+ *  */
+
+#define BENCH_ATTR_NUM 4
+#define BENCH_ROUND_NUM 3
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int cmp_rows(const void *leftp, const void *rightp)
+{
+    const value_type_t left = *(const value_type_t *)leftp, right = *(const value_type_t *)rightp;
+    return (left > right) - (left < right);
+}
+
+static double bench_qsort(const value_type_t *table, const uint32_t row_num)
+{
+    const size_t size = (size_t)row_num * BENCH_ATTR_NUM * sizeof(value_type_t);
+    value_type_t *rows = malloc(size);
+
+    double best_seconds = 0;
+    for (size_t round_i = 0; round_i < BENCH_ROUND_NUM; round_i++) {
+        memcpy(rows, table, size);
+        const double start = now_seconds();
+        qsort(rows, row_num, BENCH_ATTR_NUM * sizeof(value_type_t), cmp_rows);
+        const double seconds = now_seconds() - start;
+        if (round_i == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+    }
+
+    free(rows);
+    return best_seconds;
+}
+
+static double bench_order_by(const value_type_t *table, const uint32_t row_num, const relation_layout_t layout)
+{
+    const char *attr_names[BENCH_ATTR_NUM] = {"key", "attr1", "attr2", "attr3"};
+
+    double best_seconds = 0;
+    for (size_t round_i = 0; round_i < BENCH_ROUND_NUM; round_i++) {
+        relation_t *rel = relation_create_with_layout(attr_names, BENCH_ATTR_NUM, layout);
+        relation_fill_from_table(rel, table, row_num);
+        const double start = now_seconds();
+        relation_order_by(rel, 0, SORT_ASC);
+        const double seconds = now_seconds() - start;
+        if (round_i == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+        relation_destroy(rel);
+    }
+
+    return best_seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    const uint32_t row_nums[] = {100, 10 * 1000, 1000 * 1000, 10 * 1000 * 1000};
+    const uint32_t max_row_num = row_nums[ARRAY_SIZE(row_nums) - 1];
+
+    value_type_t *table = calloc((size_t)max_row_num * BENCH_ATTR_NUM, sizeof(value_type_t));
+    if (!table) {
+        fprintf(stderr, "Error: failed to allocate a table\n");
+        return 1;
+    }
+
+    srand(42);
+    for (size_t value_i = 0; value_i < (size_t)max_row_num * BENCH_ATTR_NUM; value_i++)
+        table[value_i] = (value_type_t)rand() ^ ((value_type_t)rand() << 16);
+
+    printf("%10s %14s %14s %14s\n", "rows", "qsort r/s", "rows r/s", "columns r/s");
+    for (size_t size_i = 0; size_i < ARRAY_SIZE(row_nums); size_i++) {
+        const uint32_t row_num = row_nums[size_i];
+        printf("%10u %14.3e %14.3e %14.3e\n", row_num,
+               row_num / bench_qsort(table, row_num),
+               row_num / bench_order_by(table, row_num, LAYOUT_ROWS),
+               row_num / bench_order_by(table, row_num, LAYOUT_COLUMNS));
+    }
+
+    free(table);
+
+    return 0;
+}
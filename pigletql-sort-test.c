@@ -0,0 +1,86 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "pigletql-sort.h"
+
+static void check_sorted(const value_type_t *keys, const size_t key_stride, const uint32_t row_num,
+                         const sort_order_t order)
+{
+    uint32_t *ids = calloc(row_num, sizeof(uint32_t));
+    bool *seen = calloc(row_num, sizeof(bool));
+    assert(ids && seen);
+
+    sort_ids_by_keys(keys, key_stride, row_num, order, ids);
+
+    for (uint32_t row_i = 0; row_i < row_num; row_i++) {
+        assert(ids[row_i] < row_num);
+        assert(!seen[ids[row_i]]);
+        seen[ids[row_i]] = true;
+        if (row_i == 0)
+            continue;
+
+        const value_type_t prev = keys[ids[row_i - 1] * key_stride], cur = keys[ids[row_i] * key_stride];
+        assert(order == SORT_ASC ? prev <= cur : prev >= cur);
+        /* Stable */
+        assert(prev != cur || ids[row_i - 1] < ids[row_i]);
+    }
+
+    free(seen);
+    free(ids);
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* Small inputs, keys above INT_MAX included */
+    {
+        const value_type_t keys[] = {5, UINT32_MAX, 0, 2147483648u, 5, 7, 2147483647u};
+        const uint32_t row_num = ARRAY_SIZE(keys);
+        uint32_t ids[ARRAY_SIZE(keys)];
+
+        sort_ids_by_keys(keys, 1, row_num, SORT_ASC, ids);
+        const uint32_t asc_ids[] = {2, 0, 4, 5, 6, 3, 1};
+        for (uint32_t row_i = 0; row_i < row_num; row_i++)
+            assert(ids[row_i] == asc_ids[row_i]);
+
+        sort_ids_by_keys(keys, 1, row_num, SORT_DESC, ids);
+        const uint32_t desc_ids[] = {1, 3, 6, 5, 0, 4, 2};
+        for (uint32_t row_i = 0; row_i < row_num; row_i++)
+            assert(ids[row_i] == desc_ids[row_i]);
+    }
+
+    /* Radix sorted inputs: random keys, few distinct keys, keys in rows of several values */
+    {
+        const uint32_t row_num = 100000;
+        value_type_t *keys = calloc((size_t)row_num * 3, sizeof(value_type_t));
+        assert(keys);
+
+        srand(42);
+        for (uint32_t row_i = 0; row_i < row_num * 3; row_i++)
+            keys[row_i] = (value_type_t)rand() ^ ((value_type_t)rand() << 16);
+        check_sorted(keys, 1, row_num, SORT_ASC);
+        check_sorted(keys, 1, row_num, SORT_DESC);
+        check_sorted(&keys[1], 3, row_num, SORT_ASC);
+
+        for (uint32_t row_i = 0; row_i < row_num; row_i++)
+            keys[row_i] = (value_type_t)(rand() % 3) << 24;
+        check_sorted(keys, 1, row_num, SORT_ASC);
+        check_sorted(keys, 1, row_num, SORT_DESC);
+
+        free(keys);
+    }
+
+    /* Sizes around the radix threshold */
+    {
+        value_type_t keys[SORT_RADIX_MIN_ROW_NUM + 1];
+        for (uint32_t row_i = 0; row_i < ARRAY_SIZE(keys); row_i++)
+            keys[row_i] = (row_i * 7919u) % 101;
+        check_sorted(keys, 1, SORT_RADIX_MIN_ROW_NUM - 1, SORT_ASC);
+        check_sorted(keys, 1, SORT_RADIX_MIN_ROW_NUM, SORT_ASC);
+        check_sorted(keys, 1, SORT_RADIX_MIN_ROW_NUM + 1, SORT_DESC);
+    }
+
+    return 0;
+}
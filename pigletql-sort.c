@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "pigletql-sort.h"
+
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_BUCKET_NUM (1 << SORT_RADIX_BITS)
+#define SORT_RADIX_PASS_NUM (sizeof(value_type_t) * 8 / SORT_RADIX_BITS)
+
+/* Pairs keep the key in higher bits and the row id in lower bits, so comparing pairs compares keys
+ * first and row ids second */
+static inline uint64_t sort_pair(const value_type_t key, const uint32_t id, const sort_order_t order)
+{
+    /* Descending order is ascending order of inverted keys */
+    const value_type_t sort_key = order == SORT_ASC ? key : ~key;
+    return (uint64_t)sort_key << 32 | id;
+}
+
+static int sort_pair_cmp(const void *leftp, const void *rightp)
+{
+    const uint64_t left = *(const uint64_t *)leftp, right = *(const uint64_t *)rightp;
+    return (left > right) - (left < right);
+}
+
+/* Sort pairs by their keys, returns the buffer holding the result, either pairs or tmp */
+static uint64_t *sort_pairs_radix(uint64_t *pairs, uint64_t *tmp, const uint32_t pair_num)
+{
+    /* Histograms of all the digits are collected in a single pass */
+    uint32_t counts[SORT_RADIX_PASS_NUM][SORT_RADIX_BUCKET_NUM] = {0};
+    for (uint32_t pair_i = 0; pair_i < pair_num; pair_i++) {
+        const uint64_t key = pairs[pair_i] >> 32;
+        for (size_t pass_i = 0; pass_i < SORT_RADIX_PASS_NUM; pass_i++)
+            counts[pass_i][(key >> (pass_i * SORT_RADIX_BITS)) & (SORT_RADIX_BUCKET_NUM - 1)]++;
+    }
+
+    uint64_t *from = pairs, *to = tmp;
+    for (size_t pass_i = 0; pass_i < SORT_RADIX_PASS_NUM; pass_i++) {
+        uint32_t *count = counts[pass_i];
+        const unsigned shift = 32 + (unsigned)pass_i * SORT_RADIX_BITS;
+
+        /* All keys share the digit, nothing to move */
+        if (count[(from[0] >> shift) & (SORT_RADIX_BUCKET_NUM - 1)] == pair_num)
+            continue;
+
+        /* Bucket counts become bucket offsets */
+        uint32_t offset = 0;
+        for (size_t bucket_i = 0; bucket_i < SORT_RADIX_BUCKET_NUM; bucket_i++) {
+            const uint32_t bucket_count = count[bucket_i];
+            count[bucket_i] = offset;
+            offset += bucket_count;
+        }
+
+        for (uint32_t pair_i = 0; pair_i < pair_num; pair_i++) {
+            const uint64_t pair = from[pair_i];
+            to[count[(pair >> shift) & (SORT_RADIX_BUCKET_NUM - 1)]++] = pair;
+        }
+
+        uint64_t *swap = from;
+        from = to;
+        to = swap;
+    }
+
+    return from;
+}
+
+void sort_ids_by_keys(const value_type_t *keys, const size_t key_stride, const uint32_t row_num,
+                      const sort_order_t order, uint32_t *ids)
+{
+    if (row_num == 0)
+        return;
+
+    uint64_t *pairs = calloc(row_num, sizeof(uint64_t));
+    assert(pairs);
+    for (uint32_t row_i = 0; row_i < row_num; row_i++)
+        pairs[row_i] = sort_pair(keys[row_i * key_stride], row_i, order);
+
+    uint64_t *sorted = pairs;
+    uint64_t *tmp = NULL;
+    if (row_num < SORT_RADIX_MIN_ROW_NUM) {
+        /* Not worth clearing histograms for, row ids make equal keys unique */
+        qsort(pairs, row_num, sizeof(uint64_t), sort_pair_cmp);
+    } else {
+        tmp = calloc(row_num, sizeof(uint64_t));
+        assert(tmp);
+        sorted = sort_pairs_radix(pairs, tmp, row_num);
+    }
+
+    for (uint32_t row_i = 0; row_i < row_num; row_i++)
+        ids[row_i] = (uint32_t)sorted[row_i];
+
+    free(tmp);
+    free(pairs);
+}
@@ -0,0 +1,22 @@
+#ifndef PIGLETQL_SORT_H
+#define PIGLETQL_SORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "pigletql-def.h"
+
+/*
+ * Sorting produces a permutation of row ids ordered by row keys, rows are then gathered by callers
+ * in a single pass. Larger inputs are sorted with an LSD radix sort over (key, row id) pairs, small
+ * inputs with a comparison sort. Both are stable: rows with equal keys keep their original order.
+ * */
+
+/* Inputs smaller than this are sorted with a comparison sort */
+#define SORT_RADIX_MIN_ROW_NUM 256
+
+/* Fill ids with row ids sorted by keys, the key of row i is keys[i * key_stride] */
+void sort_ids_by_keys(const value_type_t *keys, const size_t key_stride, const uint32_t row_num,
+                      const sort_order_t order, uint32_t *ids);
+
+#endif //PIGLETQL_SORT_H
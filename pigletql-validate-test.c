@@ -10,9 +10,9 @@ static void create_validate_test(void)
         const char *query_str = "CREATE TABLE rel1 (a1, a2);";
 
         catalogue_t *cat = catalogue_create();
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -32,9 +32,9 @@ static void create_validate_test(void)
         const char *query_str = "CREATE TABLE rel1 (a1, a1);";
 
         catalogue_t *cat = catalogue_create();
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -61,9 +61,9 @@ static void create_validate_test(void)
             catalogue_add_relation(cat, "rel1", rel1);
         }
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -86,9 +86,9 @@ static void insert_validate_test(void)
         const char *query_str = "INSERT INTO rel1 VALUES (1, 2);";
 
         catalogue_t *cat = catalogue_create();
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -115,9 +115,9 @@ static void insert_validate_test(void)
             catalogue_add_relation(cat, "rel1", rel1);
         }
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -132,6 +132,41 @@ static void insert_validate_test(void)
         catalogue_destroy(cat);
     }
 
+    /* Many tuples are checked at once */
+    {
+        const char *query_str = "INSERT INTO rel1 VALUES (1, 2, 3), (4, 5, 6);";
+        const char *short_query_str = "INSERT INTO rel1 VALUES (1, 2), (4, 5);";
+
+        catalogue_t *cat = catalogue_create();
+        {
+            const attr_name_t attr_names[] = {"id", "attr1", "attr2"};
+            const size_t attr_num = ARRAY_SIZE(attr_names);
+            relation_t *rel1 = relation_create(attr_names, attr_num);
+            catalogue_add_relation(cat, "rel1", rel1);
+        }
+
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        scanner_t *short_scanner = scanner_create(NULL, short_query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        query_t *short_query = query_create(NULL);
+        assert(scanner && short_scanner);
+        assert(parser);
+        assert(query && short_query);
+        assert(parser_parse(parser, scanner, query));
+        assert(parser_parse(parser, short_scanner, short_query));
+
+        assert(validate(cat, query));
+        assert(!validate(cat, short_query));
+
+        query_destroy(short_query);
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(short_scanner);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
     /* Insert into a table with a different number of columns */
     {
         const char *query_str = "INSERT INTO rel1 VALUES (2, 3);";
@@ -144,9 +179,9 @@ static void insert_validate_test(void)
             catalogue_add_relation(cat, "rel1", rel1);
         }
 
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -163,6 +198,52 @@ static void insert_validate_test(void)
 
 }
 
+static void create_index_validate_test(void)
+{
+    /* Index names and attributes indexed should be unique, relations and attributes should exist */
+    {
+        const struct {
+            const char *query_str;
+            bool is_valid;
+        } cases[] = {
+            { "CREATE INDEX idx2 ON rel1 (attr2);", true },
+            { "CREATE INDEX idx1 ON rel1 (attr2);", false },
+            { "CREATE INDEX idx2 ON rel1 (attr1);", false },
+            { "CREATE INDEX idx2 ON rel1 (attr1) HASH;", true },
+            { "CREATE INDEX idx2 ON rel2 (attr2);", false },
+            { "CREATE INDEX idx2 ON rel1 (attr3);", false },
+        };
+
+        catalogue_t *cat = catalogue_create();
+        assert(cat);
+        {
+            const attr_name_t attr_names[] = {"id", "attr1", "attr2"};
+            const size_t attr_num = ARRAY_SIZE(attr_names);
+            relation_t *rel1 = relation_create(attr_names, attr_num);
+            catalogue_add_relation(cat, "rel1", rel1);
+            assert(catalogue_add_index(cat, "idx1", "rel1", 1, INDEX_BTREE));
+        }
+
+        for (size_t case_i = 0; case_i < ARRAY_SIZE(cases); case_i++) {
+            scanner_t *scanner = scanner_create(NULL, cases[case_i].query_str);
+            parser_t *parser = parser_create(NULL);
+            query_t *query = query_create(NULL);
+            assert(scanner);
+            assert(parser);
+            assert(query);
+            assert(parser_parse(parser, scanner, query));
+
+            assert(validate(cat, query) == cases[case_i].is_valid);
+
+            query_destroy(query);
+            parser_destroy(parser);
+            scanner_destroy(scanner);
+        }
+
+        catalogue_destroy(cat);
+    }
+}
+
 static void select_validate_test(void)
 {
     /* Select from a non-existing table */
@@ -170,9 +251,9 @@ static void select_validate_test(void)
         const char *query_str = "SELECT a1 FROM rel1;";
 
         catalogue_t *cat = catalogue_create();
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -198,9 +279,9 @@ static void select_validate_test(void)
             relation_t *rel1 = relation_create(attr_names, attr_num);
             catalogue_add_relation(cat, "rel1", rel1);
         }
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -226,9 +307,9 @@ static void select_validate_test(void)
             relation_t *rel1 = relation_create(attr_names, attr_num);
             catalogue_add_relation(cat, "rel1", rel1);
         }
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -243,7 +324,7 @@ static void select_validate_test(void)
         catalogue_destroy(cat);
     }
 
-    /* Predicates should only use attributes listed */
+    /* Predicates should only use attributes of relations listed */
     {
         const char *query_str = "SELECT attr1 FROM rel1 WHERE n1=10;";
 
@@ -254,9 +335,9 @@ static void select_validate_test(void)
             relation_t *rel1 = relation_create(attr_names, attr_num);
             catalogue_add_relation(cat, "rel1", rel1);
         }
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -271,6 +352,34 @@ static void select_validate_test(void)
         catalogue_destroy(cat);
     }
 
+    /* Predicates may use attributes not listed */
+    {
+        const char *query_str = "SELECT attr1 FROM rel1 WHERE id=10;";
+
+        catalogue_t *cat = catalogue_create();
+        {
+            const attr_name_t attr_names[] = {"id", "attr1", "attr2"};
+            const size_t attr_num = ARRAY_SIZE(attr_names);
+            relation_t *rel1 = relation_create(attr_names, attr_num);
+            catalogue_add_relation(cat, "rel1", rel1);
+        }
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
     /* A correct query */
     {
         const char *query_str = "SELECT attr1 FROM rel1 WHERE attr1=10 ORDER BY attr1 DESC;";
@@ -282,9 +391,9 @@ static void select_validate_test(void)
             relation_t *rel1 = relation_create(attr_names, attr_num);
             catalogue_add_relation(cat, "rel1", rel1);
         }
-        scanner_t *scanner = scanner_create(query_str);
-        parser_t *parser = parser_create();
-        query_t *query = query_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
         assert(cat);
         assert(scanner);
         assert(parser);
@@ -300,6 +409,302 @@ static void select_validate_test(void)
     }
 }
 
+static void copy_validate_test(void)
+{
+    /* Copy into a non-existing table, files are not checked here */
+    {
+        const char *query_str = "COPY rel1 FROM 'rel1.csv';";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(!validate(cat, query));
+
+        {
+            const attr_name_t attr_names[] = {"id", "attr1"};
+            relation_t *rel1 = relation_create(attr_names, ARRAY_SIZE(attr_names));
+            catalogue_add_relation(cat, "rel1", rel1);
+        }
+        assert(validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+}
+
+static void prepare_validate_test(void)
+{
+    /* Parameters are for prepared selects only, prepared ones are checked like the rest */
+    {
+        catalogue_t *cat = catalogue_create();
+        assert(cat);
+        {
+            const attr_name_t attr_names[] = {"id", "attr1"};
+            relation_t *rel1 = relation_create(attr_names, ARRAY_SIZE(attr_names));
+            catalogue_add_relation(cat, "rel1", rel1);
+        }
+
+        const char *query_strs[] = {
+            "SELECT id FROM rel1 WHERE attr1 = ?;",
+            "PREPARE q AS SELECT id FROM rel1 WHERE attr1 = ?;",
+            "PREPARE q AS SELECT id FROM rel1 WHERE attr2 = ?;",
+            "PREPARE q AS SELECT id FROM rel2 WHERE id = ?;",
+            "EXECUTE q (1);",
+        };
+        const bool is_valid[] = {false, true, false, false, true};
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(query_strs); query_i++) {
+            scanner_t *scanner = scanner_create(NULL, query_strs[query_i]);
+            parser_t *parser = parser_create(NULL);
+            query_t *query = query_create(NULL);
+            assert(parser_parse(parser, scanner, query));
+
+            assert(validate(cat, query) == is_valid[query_i]);
+
+            query_destroy(query);
+            parser_destroy(parser);
+            scanner_destroy(scanner);
+        }
+
+        catalogue_destroy(cat);
+    }
+}
+
+static void aggregate_validate_test(void)
+{
+    /* Attributes aggregated and grouped by should exist, attributes listed should be grouped by */
+    {
+        catalogue_t *cat = catalogue_create();
+        assert(cat);
+        {
+            const attr_name_t attr_names[] = {"id", "attr1", "attr2"};
+            relation_t *rel1 = relation_create(attr_names, ARRAY_SIZE(attr_names));
+            catalogue_add_relation(cat, "rel1", rel1);
+        }
+
+        const char *query_strs[] = {
+            "SELECT count(*) FROM rel1;",
+            "SELECT attr1, sum(id), max(attr2) FROM rel1 GROUP BY attr1 ORDER BY attr1;",
+            "SELECT attr1 FROM rel1 GROUP BY attr1, attr2;",
+            "SELECT min(attr3) FROM rel1;",
+            "SELECT count(*) FROM rel1 GROUP BY attr3;",
+            "SELECT attr1 FROM rel1 GROUP BY attr1, attr1;",
+            "SELECT attr1, count(*) FROM rel1;",
+            "SELECT attr1, attr2 FROM rel1 GROUP BY attr1;",
+            "SELECT attr1, count(*) FROM rel1 GROUP BY attr1 ORDER BY attr2;",
+        };
+        const bool is_valid[] = {true, true, true, false, false, false, false, false, false};
+        for (size_t query_i = 0; query_i < ARRAY_SIZE(query_strs); query_i++) {
+            scanner_t *scanner = scanner_create(NULL, query_strs[query_i]);
+            parser_t *parser = parser_create(NULL);
+            query_t *query = query_create(NULL);
+            assert(parser_parse(parser, scanner, query));
+
+            assert(validate(cat, query) == is_valid[query_i]);
+
+            query_destroy(query);
+            parser_destroy(parser);
+            scanner_destroy(scanner);
+        }
+
+        catalogue_destroy(cat);
+    }
+}
+
+static void set_validate_test(void)
+{
+    /* A known setting */
+    {
+        const char *query_str = "SET sort_memory_kb = 1024;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Sort memory too small to hold more than a batch or so */
+    {
+        const char *query_str = "SET sort_memory_kb = 1;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(!validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Parallel workers */
+    {
+        const char *query_str = "SET parallel_workers = 8;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* No workers at all */
+    {
+        const char *query_str = "SET parallel_workers = 0;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(!validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Code generation is either on or off */
+    {
+        const char *query_str = "SET codegen = 1;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Nothing in between */
+    {
+        const char *query_str = "SET codegen = 2;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(!validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* Asynchronous commit delays are capped */
+    {
+        const char *query_str = "SET async_commit_delay_us = 10000;";
+        const char *too_long_query_str = "SET async_commit_delay_us = 2000000;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        scanner_t *too_long_scanner = scanner_create(NULL, too_long_query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        query_t *too_long_query = query_create(NULL);
+        assert(cat);
+        assert(scanner && too_long_scanner);
+        assert(parser);
+        assert(query && too_long_query);
+        assert(parser_parse(parser, scanner, query));
+        assert(parser_parse(parser, too_long_scanner, too_long_query));
+
+        assert(validate(cat, query));
+        assert(!validate(cat, too_long_query));
+
+        query_destroy(too_long_query);
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(too_long_scanner);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+
+    /* An unknown setting */
+    {
+        const char *query_str = "SET memory = 1024;";
+
+        catalogue_t *cat = catalogue_create();
+        scanner_t *scanner = scanner_create(NULL, query_str);
+        parser_t *parser = parser_create(NULL);
+        query_t *query = query_create(NULL);
+        assert(cat);
+        assert(scanner);
+        assert(parser);
+        assert(query);
+        assert(parser_parse(parser, scanner, query));
+
+        assert(!validate(cat, query));
+
+        query_destroy(query);
+        parser_destroy(parser);
+        scanner_destroy(scanner);
+        catalogue_destroy(cat);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     (void) argc; (void) argv;
@@ -311,7 +716,12 @@ int main(int argc, char *argv[])
 
     create_validate_test();
     insert_validate_test();
+    create_index_validate_test();
     select_validate_test();
+    set_validate_test();
+    copy_validate_test();
+    prepare_validate_test();
+    aggregate_validate_test();
 
     /* Get back normal stderr */
     dup2(stderr_fd, 2);
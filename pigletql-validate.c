@@ -1,6 +1,6 @@
 #include "pigletql-validate.h"
 
-static bool attr_in_attr_names(const attr_name_t attr_name, const attr_name_t *attr_names, const uint16_t attr_num)
+static bool attr_in_attr_names(const char *attr_name, const char *const *attr_names, const uint16_t attr_num)
 {
     for (size_t attr_i = 0; attr_i < attr_num; attr_i++) {
         if (0 != strncmp(attr_names[attr_i], attr_name, MAX_ATTR_NAME_LEN))
@@ -11,7 +11,15 @@ static bool attr_in_attr_names(const attr_name_t attr_name, const attr_name_t *a
 
 }
 
-static bool attr_names_unique(const attr_name_t *attr_names, const uint16_t attr_num)
+static bool attr_in_relations(const char *attr_name, relation_t *const *rels, const uint16_t rel_num)
+{
+    for (size_t rel_i = 0; rel_i < rel_num; rel_i++)
+        if (relation_has_attr(rels[rel_i], attr_name))
+            return true;
+    return false;
+}
+
+static bool attr_names_unique(const char *const *attr_names, const uint16_t attr_num)
 {
     for (size_t self_i = 0; self_i < attr_num; self_i++)
         for (size_t other_i = 0; other_i < attr_num; other_i++) {
@@ -28,7 +36,7 @@ static bool attr_names_unique(const attr_name_t *attr_names, const uint16_t attr
     return true;
 }
 
-static bool rel_names_unique(const rel_name_t *rel_names, const uint16_t rel_num)
+static bool rel_names_unique(const char *const *rel_names, const uint16_t rel_num)
 {
     for (size_t self_i = 0; self_i < rel_num; self_i++)
         for (size_t other_i = 0; other_i < rel_num; other_i++) {
@@ -47,9 +55,11 @@ static bool rel_names_unique(const rel_name_t *rel_names, const uint16_t rel_num
 
 static bool validate_select(catalogue_t *cat, const query_select_t *query)
 {
-    /* All the relations should exist */
+    /* All the relations should exist, each is looked up once */
+    relation_t *rels[query->rel_num];
     for (size_t rel_i = 0; rel_i < query->rel_num; rel_i++) {
-        if (catalogue_get_relation(cat, query->rel_names[rel_i]))
+        rels[rel_i] = catalogue_get_relation(cat, query->rel_names[rel_i]);
+        if (rels[rel_i])
             continue;
 
         fprintf(stderr, "Error: relation '%s' does not exist\n", query->rel_names[rel_i]);
@@ -66,15 +76,7 @@ static bool validate_select(catalogue_t *cat, const query_select_t *query)
 
     /* Attributes should be present in relations listed */
     for (size_t attr_i = 0; attr_i < query->attr_num; attr_i++) {
-        bool attr_found = false;
-        for (size_t rel_i = 0; rel_i < query->rel_num; rel_i++) {
-            relation_t *rel = catalogue_get_relation(cat, query->rel_names[rel_i]);
-            if (!relation_has_attr(rel, query->attr_names[attr_i]))
-                continue;
-            attr_found = true;
-            break;
-        }
-        if (attr_found)
+        if (attr_in_relations(query->attr_names[attr_i], rels, query->rel_num))
             continue;
 
         const char *msg = "Error: unknown attribute name '%s'\n";
@@ -82,6 +84,42 @@ static bool validate_select(catalogue_t *cat, const query_select_t *query)
         return false;
     }
 
+    /* Aggregated attributes should be present in relations listed */
+    for (size_t aggregate_i = 0; aggregate_i < query->aggregate_num; aggregate_i++) {
+        const query_aggregate_t *aggregate = &query->aggregates[aggregate_i];
+        if (!aggregate->attr_name || attr_in_relations(aggregate->attr_name, rels, query->rel_num))
+            continue;
+
+        const char *msg = "Error: unknown attribute name '%s' in aggregate %s\n";
+        fprintf(stderr, msg, aggregate->attr_name, aggregate->name);
+        return false;
+    }
+
+    /* Group attributes should be unique and present in relations listed */
+    if (!attr_names_unique(query->group_attr_names, query->group_attr_num))
+        return false;
+
+    for (size_t attr_i = 0; attr_i < query->group_attr_num; attr_i++) {
+        if (attr_in_relations(query->group_attr_names[attr_i], rels, query->rel_num))
+            continue;
+
+        const char *msg = "Error: unknown group by attribute name '%s'\n";
+        fprintf(stderr, msg, query->group_attr_names[attr_i]);
+        return false;
+    }
+
+    /* Groups only have values of group attributes and aggregates */
+    if (query->group_attr_num > 0 || query->aggregate_num > 0) {
+        for (size_t attr_i = 0; attr_i < query->attr_num; attr_i++) {
+            if (attr_in_attr_names(query->attr_names[attr_i], query->group_attr_names, query->group_attr_num))
+                continue;
+
+            const char *msg = "Error: attribute '%s' should be grouped by or aggregated\n";
+            fprintf(stderr, msg, query->attr_names[attr_i]);
+            return false;
+        }
+    }
+
     /* Order by attribute should be available in the list of attributes chosen */
     if (query->has_order) {
         if (!attr_in_attr_names(query->order_by_attr, query->attr_names, query->attr_num)) {
@@ -91,7 +129,8 @@ static bool validate_select(catalogue_t *cat, const query_select_t *query)
         }
     }
 
-    /* Predicate attributes should be available in the list of attributes projected */
+    /* Predicate attributes should be present in relations listed, the planner makes sure they are
+     * available where predicates get evaluated */
     for (size_t pred_i = 0; pred_i < query->pred_num; pred_i++) {
         const query_predicate_t *predicate = &query->predicates[pred_i];
 
@@ -101,7 +140,7 @@ static bool validate_select(catalogue_t *cat, const query_select_t *query)
             char attr_name_buf[512] = {0};
             strncpy(attr_name_buf, token.start, (size_t)token.length);
 
-            if (!attr_in_attr_names(attr_name_buf, query->attr_names, query->attr_num)) {
+            if (!attr_in_relations(attr_name_buf, rels, query->rel_num)) {
                 const char *msg = "Error: unknown left-hand side attribute name '%s' in predicate %zu\n";
                 fprintf(stderr, msg, attr_name_buf, pred_i);
                 return false;
@@ -115,7 +154,7 @@ static bool validate_select(catalogue_t *cat, const query_select_t *query)
                 char attr_name_buf[512] = {0};
                 strncpy(attr_name_buf, token.start, (size_t)token.length);
 
-                if (!attr_in_attr_names(attr_name_buf, query->attr_names, query->attr_num)) {
+                if (!attr_in_relations(attr_name_buf, rels, query->rel_num)) {
                     const char *msg = "Error: unknown right-hand side attribute name '%s' in predicate %zu\n";
                     fprintf(stderr, msg, attr_name_buf, pred_i);
                     return false;
@@ -127,6 +166,12 @@ static bool validate_select(catalogue_t *cat, const query_select_t *query)
     return true;
 }
 
+static bool validate_prepare(catalogue_t *cat, const query_prepare_t *query)
+{
+    /* Relations and attributes are bound right away, so everything but parameter values gets checked */
+    return validate_select(cat, &query->select);
+}
+
 static bool validate_create_table(catalogue_t *cat, const query_create_table_t *query)
 {
     /* A relation should not exists */
@@ -142,6 +187,38 @@ static bool validate_create_table(catalogue_t *cat, const query_create_table_t *
     return true;
 }
 
+static bool validate_create_index(catalogue_t *cat, const query_create_index_t *query)
+{
+    /* An index should not exist */
+    if (catalogue_has_index(cat, query->index_name)) {
+        fprintf(stderr, "Error: index '%s' already exists\n", query->index_name);
+        return false;
+    }
+
+    /* A relation should exist */
+    relation_t *rel = catalogue_get_relation(cat, query->rel_name);
+    if (!rel) {
+        fprintf(stderr, "Error: relation '%s' does not exist\n", query->rel_name);
+        return false;
+    }
+
+    /* The attribute should be present in the relation */
+    const uint16_t attr_i = relation_attr_i_by_name(rel, query->attr_name);
+    if (attr_i == ATTR_NOT_FOUND) {
+        fprintf(stderr, "Error: unknown attribute name '%s'\n", query->attr_name);
+        return false;
+    }
+
+    /* An attribute has at most one index of each type */
+    if (catalogue_has_attr_index(cat, query->rel_name, attr_i, query->type)) {
+        fprintf(stderr, "Error: attribute '%s' of relation '%s' is already indexed\n", query->attr_name,
+                query->rel_name);
+        return false;
+    }
+
+    return true;
+}
+
 static bool validate_insert(catalogue_t *cat, const query_insert_t *query)
 {
     /* A relation should exists */
@@ -151,9 +228,10 @@ static bool validate_insert(catalogue_t *cat, const query_insert_t *query)
         return false;
     }
 
-    /* Number of attribute values to be inserted should be correct */
+    /* Number of attribute values to be inserted should be correct, parsing made sure all the tuples
+     * have as many values */
     uint16_t rel_attr_num = relation_get_attr_num(target_rel);
-    uint16_t query_attr_num = query->value_num;
+    uint16_t query_attr_num = query->attr_num;
     if (rel_attr_num != query_attr_num) {
         fprintf(stderr, "Error: relation '%s' has %"PRIu16" attributes, only %"PRIu16" supplied\n",
                 query->rel_name, rel_attr_num, query_attr_num);
@@ -163,15 +241,82 @@ static bool validate_insert(catalogue_t *cat, const query_insert_t *query)
     return true;
 }
 
+static bool validate_copy(catalogue_t *cat, const query_copy_t *query)
+{
+    /* Files are only read when the query is run, but the relation should exist by then */
+    if (!catalogue_get_relation(cat, query->rel_name)) {
+        fprintf(stderr, "Error: relation '%s' does not exist\n", query->rel_name);
+        return false;
+    }
+
+    return true;
+}
+
+static bool validate_set(const query_set_t *query)
+{
+    if (0 == strncmp(query->name, SETTING_SORT_MEMORY_KB, MAX_ATTR_NAME_LEN)) {
+        if (query->value < MIN_SORT_MEMORY_KB) {
+            fprintf(stderr, "Error: sort memory should be at least %d kilobytes\n", MIN_SORT_MEMORY_KB);
+            return false;
+        }
+        return true;
+    }
+
+    if (0 == strncmp(query->name, SETTING_PARALLEL_WORKERS, MAX_ATTR_NAME_LEN)) {
+        if (query->value == 0 || query->value > MAX_PARALLEL_WORKERS) {
+            fprintf(stderr, "Error: number of workers should be from 1 to %d\n", MAX_PARALLEL_WORKERS);
+            return false;
+        }
+        return true;
+    }
+
+    if (0 == strncmp(query->name, SETTING_CODEGEN, MAX_ATTR_NAME_LEN)) {
+        if (query->value > 1) {
+            fprintf(stderr, "Error: code generation is either on (1) or off (0)\n");
+            return false;
+        }
+        return true;
+    }
+
+    if (0 == strncmp(query->name, SETTING_ASYNC_COMMIT_DELAY_US, MAX_ATTR_NAME_LEN)) {
+        if (query->value > MAX_ASYNC_COMMIT_DELAY_US) {
+            fprintf(stderr, "Error: asynchronous commit delay should be at most %d microseconds\n", MAX_ASYNC_COMMIT_DELAY_US);
+            return false;
+        }
+        return true;
+    }
+
+    /* Only known settings can be changed */
+    fprintf(stderr, "Error: unknown setting '%s'\n", query->name);
+    return false;
+}
+
 bool validate(catalogue_t *cat, const query_t *query)
 {
     switch (query->tag) {
     case QUERY_SELECT:
+        /* Only prepared selects get parameter values */
+        if (query->as.select.param_num > 0) {
+            fprintf(stderr, "Error: parameters are only allowed in prepared statements\n");
+            return false;
+        }
         return validate_select(cat, &query->as.select);
     case QUERY_CREATE_TABLE:
         return validate_create_table(cat, &query->as.create_table);
+    case QUERY_CREATE_INDEX:
+        return validate_create_index(cat, &query->as.create_index);
     case QUERY_INSERT:
         return validate_insert(cat, &query->as.insert);
+    case QUERY_SET:
+        return validate_set(&query->as.set);
+    case QUERY_COPY:
+        return validate_copy(cat, &query->as.copy);
+    case QUERY_PREPARE:
+        return validate_prepare(cat, &query->as.prepare);
+    case QUERY_EXECUTE:
+    case QUERY_DEALLOCATE:
+        /* Prepared statements are not in the catalogue, they are looked up when evaluated */
+        return true;
     }
     assert(false);
 }
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "pigletql-wal.h"
+
+/*
+ * Commits: single-tuple inserts committed one at a time, syncing every commit, by threads sharing
+ * syncs, and asynchronously. Replay: opening a log of many single-tuple inserts.
+ *  */
+
+#define BENCH_COMMIT_NUM 2000
+#define BENCH_THREAD_NUM 8
+#define BENCH_ASYNC_COMMIT_DELAY_US 1000
+#define BENCH_REPLAY_RECORD_NUM (1000 * 1000)
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void remove_dir(const char *dir)
+{
+    DIR *dir_stream = opendir(dir);
+    if (!dir_stream)
+        return;
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir_stream))) {
+        if (0 == strcmp(entry->d_name, ".") || 0 == strcmp(entry->d_name, ".."))
+            continue;
+        char path[strlen(dir) + strlen(entry->d_name) + 2];
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        unlink(path);
+    }
+    closedir(dir_stream);
+    rmdir(dir);
+}
+
+typedef struct bench_thread_t {
+    wal_t *wal;
+    char rel_name[16];
+    uint32_t commit_num;
+} bench_thread_t;
+
+static void *bench_thread_run(void *arg)
+{
+    bench_thread_t *thread = arg;
+    for (value_type_t tuple_i = 0; tuple_i < thread->commit_num; tuple_i++) {
+        const value_type_t values[] = {tuple_i, tuple_i};
+        wal_commit(thread->wal, wal_log_insert(thread->wal, thread->rel_name, tuple_i, values, 2, 1));
+    }
+    return NULL;
+}
+
+/* Commits per second of threads committing to relations of their own */
+static double bench_commit(const char *dir, const uint16_t thread_num, const uint32_t delay_us,
+                           uint64_t *sync_num)
+{
+    catalogue_t *cat = catalogue_create();
+    wal_t *wal = wal_open(dir, cat);
+    if (!wal) {
+        fprintf(stderr, "Error: failed to open the log in '%s'\n", dir);
+        exit(1);
+    }
+    wal_set_async_commit_delay(wal, delay_us);
+
+    const char *attr_names[] = {"a1", "a2"};
+    bench_thread_t threads[BENCH_THREAD_NUM];
+    for (uint16_t thread_i = 0; thread_i < thread_num; thread_i++) {
+        threads[thread_i] = (bench_thread_t) { .wal = wal, .commit_num = BENCH_COMMIT_NUM / thread_num };
+        snprintf(threads[thread_i].rel_name, sizeof(threads[thread_i].rel_name), "rel%u", thread_i);
+        wal_log_create_table(wal, threads[thread_i].rel_name, attr_names, 2, LAYOUT_ROWS);
+    }
+
+    const uint64_t first_sync_num = wal_get_sync_num(wal);
+    const double start = now_seconds();
+    pthread_t thread_ids[BENCH_THREAD_NUM];
+    for (uint16_t thread_i = 0; thread_i < thread_num; thread_i++)
+        pthread_create(&thread_ids[thread_i], NULL, bench_thread_run, &threads[thread_i]);
+    for (uint16_t thread_i = 0; thread_i < thread_num; thread_i++)
+        pthread_join(thread_ids[thread_i], NULL);
+    const double seconds = now_seconds() - start;
+    *sync_num = wal_get_sync_num(wal) - first_sync_num;
+
+    wal_close(wal);
+    catalogue_destroy(cat);
+    remove_dir(dir);
+
+    return BENCH_COMMIT_NUM / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    char dir[] = "/tmp/pigletql-wal-bench-XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Error: failed to create a directory\n");
+        return 1;
+    }
+
+    printf("%24s %14s %10s %10s\n", "commits", "commits/s", "syncs", "speedup");
+
+    uint64_t sync_num = 0;
+    const double sync_rate = bench_commit(dir, 1, 0, &sync_num);
+    printf("%24s %14.0f %10lu %10.2f\n", "sync each", sync_rate, (unsigned long)sync_num, 1.0);
+
+    const double group_rate = bench_commit(dir, BENCH_THREAD_NUM, 0, &sync_num);
+    printf("%21u th %14.0f %10lu %10.2f\n", BENCH_THREAD_NUM, group_rate, (unsigned long)sync_num,
+           group_rate / sync_rate);
+
+    const double delay_rate = bench_commit(dir, 1, BENCH_ASYNC_COMMIT_DELAY_US, &sync_num);
+    printf("%21u us %14.0f %10lu %10.2f\n", BENCH_ASYNC_COMMIT_DELAY_US, delay_rate, (unsigned long)sync_num,
+           delay_rate / sync_rate);
+
+    /* A log of single-tuple inserts, as left by a crash */
+    {
+        catalogue_t *cat = catalogue_create();
+        wal_t *wal = wal_open(dir, cat);
+        const char *attr_names[] = {"a1", "a2", "a3"};
+        wal_log_create_table(wal, "rel1", attr_names, 3, LAYOUT_COLUMNS);
+        for (value_type_t tuple_i = 0; tuple_i < BENCH_REPLAY_RECORD_NUM; tuple_i++) {
+            const value_type_t values[] = {tuple_i, tuple_i * 2, tuple_i * 3};
+            wal_log_insert(wal, "rel1", tuple_i, values, 3, 1);
+        }
+        const uint64_t log_size = wal_get_size(wal);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        const double start = now_seconds();
+        cat = catalogue_create();
+        wal = wal_open(dir, cat);
+        const double seconds = now_seconds() - start;
+        printf("replayed %u records (%.1f MB) into %u tuples in %.3f s, %.0f records/s\n",
+               BENCH_REPLAY_RECORD_NUM, (double)log_size / 1e6,
+               relation_get_tuple_num(catalogue_get_relation(cat, "rel1")), seconds,
+               BENCH_REPLAY_RECORD_NUM / seconds);
+        wal_close(wal);
+        catalogue_destroy(cat);
+    }
+
+    remove_dir(dir);
+
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pigletql-wal.h"
+
+#define THREAD_NUM 8
+#define THREAD_INSERT_NUM 200
+
+/* What running statements does: change the catalogue, then log and commit the change */
+static void create_table(catalogue_t *cat, wal_t *wal, const char *rel_name, const relation_layout_t layout)
+{
+    const char *attr_names[] = {"id", "attr1"};
+    relation_t *rel = relation_create_with_layout(attr_names, ARRAY_SIZE(attr_names), layout);
+    assert(catalogue_add_relation(cat, rel_name, rel));
+    wal_commit(wal, wal_log_create_table(wal, rel_name, attr_names, ARRAY_SIZE(attr_names), layout));
+}
+
+static void insert(catalogue_t *cat, wal_t *wal, const char *rel_name, const value_type_t first_id,
+                   const uint32_t tuple_num)
+{
+    relation_t *rel = catalogue_get_relation(cat, rel_name);
+    value_type_t *table = calloc(tuple_num * 2, sizeof(value_type_t));
+    assert(table);
+    for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+        table[tuple_i * 2] = first_id + tuple_i;
+        table[tuple_i * 2 + 1] = (first_id + tuple_i) % 7;
+    }
+    const uint32_t first_tuple_i = relation_get_tuple_num(rel);
+    relation_append_table(rel, table, tuple_num);
+    wal_commit(wal, wal_log_insert(wal, rel_name, first_tuple_i, table, 2, tuple_num));
+    free(table);
+}
+
+/* Tuples should have ids from 0 up in order */
+static void check_relation(catalogue_t *cat, const char *rel_name, const uint32_t tuple_num)
+{
+    relation_t *rel = catalogue_get_relation(cat, rel_name);
+    assert(rel);
+    assert(relation_get_tuple_num(rel) == tuple_num);
+    for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++) {
+        assert(relation_get_value(rel, tuple_i, 0) == tuple_i);
+        assert(relation_get_value(rel, tuple_i, 1) == tuple_i % 7);
+    }
+}
+
+static void remove_dir(const char *dir)
+{
+    DIR *dir_stream = opendir(dir);
+    assert(dir_stream);
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir_stream))) {
+        if (0 == strcmp(entry->d_name, ".") || 0 == strcmp(entry->d_name, ".."))
+            continue;
+        char path[strlen(dir) + strlen(entry->d_name) + 2];
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        assert(unlink(path) == 0);
+    }
+    closedir(dir_stream);
+    assert(rmdir(dir) == 0);
+}
+
+static off_t file_size(const char *dir, const char *name)
+{
+    char path[strlen(dir) + strlen(name) + 2];
+    sprintf(path, "%s/%s", dir, name);
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    return st.st_size;
+}
+
+typedef struct thread_args_t {
+    wal_t *wal;
+    char rel_name[16];
+} thread_args_t;
+
+/* Every thread logs its own relation, committing every record */
+static void *thread_run(void *arg)
+{
+    thread_args_t *args = arg;
+    for (value_type_t id = 0; id < THREAD_INSERT_NUM; id++) {
+        const value_type_t values[] = {id, id % 7};
+        wal_commit(args->wal, wal_log_insert(args->wal, args->rel_name, id, values, 2, 1));
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc; (void) argv;
+
+    /* Changes not checkpointed come back from the log */
+    {
+        char dir[] = "/tmp/pigletql-wal-test-XXXXXX";
+        assert(mkdtemp(dir));
+
+        catalogue_t *cat = catalogue_open(dir);
+        wal_t *wal = wal_open(dir, cat);
+        assert(wal);
+        assert(wal_get_size(wal) == 0);
+
+        create_table(cat, wal, "rel1", LAYOUT_ROWS);
+        create_table(cat, wal, "rel2", LAYOUT_COLUMNS);
+        insert(cat, wal, "rel1", 0, 1);
+        insert(cat, wal, "rel1", 1, 5000);
+        assert(catalogue_add_index(cat, "idx1", "rel1", 1, INDEX_HASH));
+        wal_commit(wal, wal_log_create_index(wal, "idx1", "rel1", 1, INDEX_HASH));
+        for (value_type_t id = 0; id < 100; id++)
+            insert(cat, wal, "rel2", id, 1);
+        insert(cat, wal, "rel1", 5001, 10);
+        assert(wal_get_size(wal) > 0);
+        assert(wal_get_sync_num(wal) > 0);
+
+        /* A crash: the catalogue is never saved */
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        for (int run = 0; run < 2; run++) {
+            cat = catalogue_open(dir);
+            wal = wal_open(dir, cat);
+            assert(wal);
+            check_relation(cat, "rel1", 5011);
+            check_relation(cat, "rel2", 100);
+            assert(relation_get_layout(catalogue_get_relation(cat, "rel2")) == LAYOUT_COLUMNS);
+            assert(catalogue_has_attr_index(cat, "rel1", 1, INDEX_HASH));
+            assert(hash_index_get_entry_num(relation_get_hash_index(catalogue_get_relation(cat, "rel1"), 1)) == 5011);
+            wal_close(wal);
+            catalogue_destroy(cat);
+        }
+
+        remove_dir(dir);
+    }
+
+    /* Checkpoints truncate the log, replaying skips whatever got saved before a crash */
+    {
+        char dir[] = "/tmp/pigletql-wal-test-XXXXXX";
+        assert(mkdtemp(dir));
+
+        catalogue_t *cat = catalogue_open(dir);
+        wal_t *wal = wal_open(dir, cat);
+        create_table(cat, wal, "rel1", LAYOUT_COLUMNS);
+        insert(cat, wal, "rel1", 0, 1000);
+        const off_t empty_log_size = file_size(dir, "wal") - (off_t)wal_get_size(wal);
+        assert(wal_checkpoint(wal, cat));
+        assert(wal_get_size(wal) == 0);
+        assert(file_size(dir, "wal") == empty_log_size);
+
+        insert(cat, wal, "rel1", 1000, 10);
+        create_table(cat, wal, "rel2", LAYOUT_ROWS);
+        insert(cat, wal, "rel2", 0, 20);
+
+        /* Saved, but crashed before the log got truncated */
+        assert(catalogue_save(cat, dir));
+        insert(cat, wal, "rel1", 1010, 5);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        cat = catalogue_open(dir);
+        check_relation(cat, "rel1", 1010);
+        wal = wal_open(dir, cat);
+        assert(wal);
+        check_relation(cat, "rel1", 1015);
+        check_relation(cat, "rel2", 20);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        remove_dir(dir);
+    }
+
+    /* A record torn by a crash is dropped along with whatever follows it */
+    {
+        char dir[] = "/tmp/pigletql-wal-test-XXXXXX";
+        assert(mkdtemp(dir));
+
+        catalogue_t *cat = catalogue_open(dir);
+        wal_t *wal = wal_open(dir, cat);
+        create_table(cat, wal, "rel1", LAYOUT_ROWS);
+        insert(cat, wal, "rel1", 0, 10);
+        insert(cat, wal, "rel1", 10, 10);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        char path[sizeof(dir) + 8];
+        snprintf(path, sizeof(path), "%s/wal", dir);
+        const off_t torn_size = file_size(dir, "wal") - 3;
+        assert(truncate(path, torn_size) == 0);
+        FILE *file = fopen(path, "a");
+        assert(file);
+        fputs("garbage", file);
+        fclose(file);
+
+        cat = catalogue_open(dir);
+        wal = wal_open(dir, cat);
+        assert(wal);
+        check_relation(cat, "rel1", 10);
+        assert(file_size(dir, "wal") < torn_size);
+
+        /* The log goes on after the last good record */
+        insert(cat, wal, "rel1", 10, 5);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        cat = catalogue_open(dir);
+        wal = wal_open(dir, cat);
+        check_relation(cat, "rel1", 15);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        /* Not a log at all */
+        file = fopen(path, "w");
+        assert(file);
+        fputs("definitely not a write-ahead log", file);
+        fclose(file);
+        cat = catalogue_open(dir);
+        assert(!wal_open(dir, cat));
+        catalogue_destroy(cat);
+
+        remove_dir(dir);
+    }
+
+    /* Commits running concurrently share syncs, asynchronous commits are synced in the
+     * background */
+    {
+        char dir[] = "/tmp/pigletql-wal-test-XXXXXX";
+        assert(mkdtemp(dir));
+
+        catalogue_t *cat = catalogue_open(dir);
+        wal_t *wal = wal_open(dir, cat);
+        thread_args_t args[THREAD_NUM];
+        for (size_t thread_i = 0; thread_i < THREAD_NUM; thread_i++) {
+            args[thread_i].wal = wal;
+            snprintf(args[thread_i].rel_name, sizeof(args[thread_i].rel_name), "rel%zu", thread_i);
+            create_table(cat, wal, args[thread_i].rel_name, LAYOUT_ROWS);
+        }
+
+        const uint64_t sync_num = wal_get_sync_num(wal);
+        pthread_t threads[THREAD_NUM];
+        for (size_t thread_i = 0; thread_i < THREAD_NUM; thread_i++)
+            assert(pthread_create(&threads[thread_i], NULL, thread_run, &args[thread_i]) == 0);
+        for (size_t thread_i = 0; thread_i < THREAD_NUM; thread_i++)
+            pthread_join(threads[thread_i], NULL);
+        assert(wal_get_sync_num(wal) - sync_num <= THREAD_NUM * THREAD_INSERT_NUM);
+
+        /* Consecutive asynchronous commits within the delay are not synced one by one */
+        create_table(cat, wal, "rel_delayed", LAYOUT_COLUMNS);
+        wal_set_async_commit_delay(wal, 100 * 1000);
+        const uint64_t delayed_sync_num = wal_get_sync_num(wal);
+        for (value_type_t id = 0; id < 1000; id++)
+            insert(cat, wal, "rel_delayed", id, 1);
+        assert(wal_get_sync_num(wal) - delayed_sync_num < 10);
+        wal_set_async_commit_delay(wal, 0);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        cat = catalogue_open(dir);
+        wal = wal_open(dir, cat);
+        assert(wal);
+        for (size_t thread_i = 0; thread_i < THREAD_NUM; thread_i++)
+            check_relation(cat, args[thread_i].rel_name, THREAD_INSERT_NUM);
+        check_relation(cat, "rel_delayed", 1000);
+        wal_close(wal);
+        catalogue_destroy(cat);
+
+        remove_dir(dir);
+    }
+
+    return 0;
+}
@@ -0,0 +1,631 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pigletql-wal.h"
+#include "pigletql-names.h"
+
+#define WAL_FILE_NAME "wal"
+#define WAL_FILE_MAGIC "PIGLTWAL"
+#define WAL_FILE_VERSION 1
+
+typedef struct wal_file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} wal_file_header_t;
+
+typedef enum wal_record_type_t {
+    WAL_RECORD_CREATE_TABLE = 1,
+    WAL_RECORD_CREATE_INDEX,
+    WAL_RECORD_INSERT,
+} wal_record_type_t;
+
+/* Payloads are sequences of 32-bit words, names being a length followed by characters padded to a
+ * whole word, so values of insert records can be used straight from the file */
+typedef struct wal_record_header_t {
+    uint32_t type;
+    uint32_t size;              /* payload bytes */
+    uint32_t checksum;          /* of the type, the size and the payload */
+} wal_record_header_t;
+
+struct wal_t {
+    char *dir;
+    int fd;
+
+    pthread_mutex_t lock;
+    /* Broadcast after every sync */
+    pthread_cond_t synced;
+
+    /* Records appended but not written to the file yet */
+    uint8_t *buf;
+    size_t buf_size;
+    size_t buf_slots;
+
+    /* Log positions are bytes appended since the log was opened */
+    uint64_t appended_lsn;
+    uint64_t synced_lsn;
+    bool is_syncing;
+    uint64_t sync_num;
+
+    /* Bytes of records since the last checkpoint */
+    uint64_t size;
+
+    /* Asynchronous commits do not wait for their sync, a background thread syncs them */
+    uint32_t async_commit_delay_us;
+    uint64_t committed_lsn;
+    pthread_cond_t committed;
+    pthread_t syncer;
+    bool has_syncer;
+    bool is_closing;
+};
+
+/* Losing the log means losing commits acknowledged already, there's no way to carry on */
+static void wal_fail(const char *what)
+{
+    fprintf(stderr, "Error: failed to %s the log: %s\n", what, strerror(errno));
+    abort();
+}
+
+static uint32_t wal_checksum(const wal_record_header_t *header, const uint8_t *payload)
+{
+    /* FNV-1a over whole words */
+    uint32_t hash = FNV1A_BASIS;
+    hash = fnv1a_step(hash, header->type);
+    hash = fnv1a_step(hash, header->size);
+    const uint32_t *words = (const uint32_t *)payload;
+    for (size_t word_i = 0; word_i < header->size / sizeof(uint32_t); word_i++)
+        hash = fnv1a_step(hash, words[word_i]);
+    return hash;
+}
+
+static bool wal_write_all(const int fd, const void *data, size_t size)
+{
+    const uint8_t *pos = data;
+    while (size > 0) {
+        const ssize_t written = write(fd, pos, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        pos += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+/* Renames and new files only survive a crash once their directory is synced */
+static bool wal_sync_dir(const char *dir)
+{
+    const int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0)
+        return false;
+    const bool is_synced = fsync(dir_fd) == 0;
+    close(dir_fd);
+    return is_synced;
+}
+
+/*
+ * Appending records, the lock is held
+ *  */
+
+static void wal_write_buffer(wal_t *wal)
+{
+    if (!wal_write_all(wal->fd, wal->buf, wal->buf_size))
+        wal_fail("write");
+    wal->buf_size = 0;
+}
+
+static size_t wal_name_size(const char *name)
+{
+    return sizeof(uint32_t) + (strnlen(name, MAX_REL_NAME_LEN - 1) + 3) / 4 * 4;
+}
+
+static uint8_t *wal_put_u32(uint8_t *pos, const uint32_t value)
+{
+    memcpy(pos, &value, sizeof(value));
+    return pos + sizeof(value);
+}
+
+static uint8_t *wal_put_name(uint8_t *pos, const char *name)
+{
+    const size_t name_size = wal_name_size(name) - sizeof(uint32_t);
+    const uint32_t name_len = (uint32_t)strnlen(name, MAX_REL_NAME_LEN - 1);
+    pos = wal_put_u32(pos, name_len);
+    memcpy(pos, name, name_len);
+    memset(pos + name_len, 0, name_size - name_len);
+    return pos + name_size;
+}
+
+/* Start a record at the end of the buffer, the payload is written by the caller */
+static uint8_t *wal_record_begin(wal_t *wal, const wal_record_type_t type, const size_t payload_size)
+{
+    assert(payload_size % sizeof(uint32_t) == 0 && payload_size <= UINT32_MAX);
+
+    const size_t record_size = sizeof(wal_record_header_t) + payload_size;
+    if (wal->buf_size + record_size > wal->buf_slots) {
+        size_t buf_slots = wal->buf_slots ? wal->buf_slots : WAL_BUFFER_SIZE;
+        while (buf_slots < wal->buf_size + record_size)
+            buf_slots *= 2;
+        wal->buf = realloc(wal->buf, buf_slots);
+        assert(wal->buf);
+        wal->buf_slots = buf_slots;
+    }
+
+    const wal_record_header_t header = { .type = type, .size = (uint32_t)payload_size };
+    memcpy(&wal->buf[wal->buf_size], &header, sizeof(header));
+    return &wal->buf[wal->buf_size + sizeof(header)];
+}
+
+/* Seal the record started last and return its end position */
+static uint64_t wal_record_end(wal_t *wal)
+{
+    uint8_t *record = &wal->buf[wal->buf_size];
+    wal_record_header_t header;
+    memcpy(&header, record, sizeof(header));
+    header.checksum = wal_checksum(&header, record + sizeof(header));
+    memcpy(record, &header, sizeof(header));
+
+    const size_t record_size = sizeof(header) + header.size;
+    wal->buf_size += record_size;
+    wal->appended_lsn += record_size;
+    wal->size += record_size;
+
+    if (wal->buf_size >= WAL_BUFFER_SIZE)
+        wal_write_buffer(wal);
+    return wal->appended_lsn;
+}
+
+uint64_t wal_log_create_table(wal_t *wal, const rel_name_t rel_name, const char *const *attr_names,
+                              const uint16_t attr_num, const relation_layout_t layout)
+{
+    size_t payload_size = wal_name_size(rel_name) + 2 * sizeof(uint32_t);
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        payload_size += wal_name_size(attr_names[attr_i]);
+
+    pthread_mutex_lock(&wal->lock);
+    uint8_t *pos = wal_record_begin(wal, WAL_RECORD_CREATE_TABLE, payload_size);
+    pos = wal_put_name(pos, rel_name);
+    pos = wal_put_u32(pos, layout);
+    pos = wal_put_u32(pos, attr_num);
+    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++)
+        pos = wal_put_name(pos, attr_names[attr_i]);
+    const uint64_t lsn = wal_record_end(wal);
+    pthread_mutex_unlock(&wal->lock);
+
+    return lsn;
+}
+
+uint64_t wal_log_create_index(wal_t *wal, const rel_name_t index_name, const rel_name_t rel_name,
+                              const uint16_t attr_i, const index_type_t type)
+{
+    const size_t payload_size = wal_name_size(index_name) + wal_name_size(rel_name) + 2 * sizeof(uint32_t);
+
+    pthread_mutex_lock(&wal->lock);
+    uint8_t *pos = wal_record_begin(wal, WAL_RECORD_CREATE_INDEX, payload_size);
+    pos = wal_put_name(pos, index_name);
+    pos = wal_put_name(pos, rel_name);
+    pos = wal_put_u32(pos, attr_i);
+    pos = wal_put_u32(pos, type);
+    const uint64_t lsn = wal_record_end(wal);
+    pthread_mutex_unlock(&wal->lock);
+
+    return lsn;
+}
+
+uint64_t wal_log_insert(wal_t *wal, const rel_name_t rel_name, const uint32_t first_tuple_i,
+                        const value_type_t *table, const uint16_t attr_num, const uint32_t tuple_num)
+{
+    const size_t values_size = (size_t)tuple_num * attr_num * sizeof(value_type_t);
+    const size_t payload_size = wal_name_size(rel_name) + 3 * sizeof(uint32_t) + values_size;
+
+    pthread_mutex_lock(&wal->lock);
+    uint8_t *pos = wal_record_begin(wal, WAL_RECORD_INSERT, payload_size);
+    pos = wal_put_name(pos, rel_name);
+    pos = wal_put_u32(pos, first_tuple_i);
+    pos = wal_put_u32(pos, tuple_num);
+    pos = wal_put_u32(pos, attr_num);
+    memcpy(pos, table, values_size);
+    const uint64_t lsn = wal_record_end(wal);
+    pthread_mutex_unlock(&wal->lock);
+
+    return lsn;
+}
+
+/*
+ * Group commit
+ *  */
+
+/* Wait until records up to the position given are durable, the lock is held. The first thread to
+ * find no sync running leads the next one, covering everything appended by then, while threads
+ * committing meanwhile wait for it or the sync after it. */
+static void wal_sync(wal_t *wal, const uint64_t lsn)
+{
+    while (wal->synced_lsn < lsn) {
+        if (wal->is_syncing) {
+            pthread_cond_wait(&wal->synced, &wal->lock);
+            continue;
+        }
+
+        wal_write_buffer(wal);
+        const uint64_t sync_lsn = wal->appended_lsn;
+        wal->is_syncing = true;
+
+        /* Others keep appending while the file syncs */
+        pthread_mutex_unlock(&wal->lock);
+        const int sync_res = fdatasync(wal->fd);
+        pthread_mutex_lock(&wal->lock);
+        if (sync_res != 0)
+            wal_fail("sync");
+
+        wal->is_syncing = false;
+        wal->synced_lsn = sync_lsn;
+        wal->sync_num++;
+        pthread_cond_broadcast(&wal->synced);
+    }
+}
+
+static void *wal_syncer_run(void *arg)
+{
+    wal_t *wal = arg;
+
+    pthread_mutex_lock(&wal->lock);
+    while (!wal->is_closing) {
+        if (wal->committed_lsn <= wal->synced_lsn || wal->async_commit_delay_us == 0) {
+            pthread_cond_wait(&wal->committed, &wal->lock);
+            continue;
+        }
+
+        /* Let commits coming within the delay share the sync */
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        const uint64_t deadline_ns = (uint64_t)deadline.tv_nsec + (uint64_t)wal->async_commit_delay_us * 1000;
+        deadline.tv_sec += (time_t)(deadline_ns / 1000000000);
+        deadline.tv_nsec = (long)(deadline_ns % 1000000000);
+        while (!wal->is_closing && pthread_cond_timedwait(&wal->committed, &wal->lock, &deadline) != ETIMEDOUT)
+            ;
+
+        wal_sync(wal, wal->committed_lsn);
+    }
+    pthread_mutex_unlock(&wal->lock);
+
+    return NULL;
+}
+
+void wal_commit(wal_t *wal, const uint64_t lsn)
+{
+    pthread_mutex_lock(&wal->lock);
+    if (wal->async_commit_delay_us == 0) {
+        wal_sync(wal, lsn);
+    } else {
+        if (lsn > wal->committed_lsn)
+            wal->committed_lsn = lsn;
+        if (!wal->has_syncer) {
+            if (pthread_create(&wal->syncer, NULL, wal_syncer_run, wal) != 0)
+                wal_fail("start syncing");
+            wal->has_syncer = true;
+        }
+        pthread_cond_signal(&wal->committed);
+    }
+    pthread_mutex_unlock(&wal->lock);
+}
+
+void wal_set_async_commit_delay(wal_t *wal, const uint32_t delay_us)
+{
+    pthread_mutex_lock(&wal->lock);
+    wal->async_commit_delay_us = delay_us;
+    /* Commits waiting for the syncer are not delayed any longer */
+    if (delay_us == 0)
+        wal_sync(wal, wal->committed_lsn);
+    pthread_cond_signal(&wal->committed);
+    pthread_mutex_unlock(&wal->lock);
+}
+
+uint64_t wal_get_size(wal_t *wal)
+{
+    pthread_mutex_lock(&wal->lock);
+    const uint64_t size = wal->size;
+    pthread_mutex_unlock(&wal->lock);
+    return size;
+}
+
+uint64_t wal_get_sync_num(wal_t *wal)
+{
+    pthread_mutex_lock(&wal->lock);
+    const uint64_t sync_num = wal->sync_num;
+    pthread_mutex_unlock(&wal->lock);
+    return sync_num;
+}
+
+bool wal_checkpoint(wal_t *wal, catalogue_t *cat)
+{
+    pthread_mutex_lock(&wal->lock);
+
+    /* Records synced first, so a crash at any point leaves the catalogue recoverable */
+    wal_sync(wal, wal->appended_lsn);
+    while (wal->is_syncing)
+        pthread_cond_wait(&wal->synced, &wal->lock);
+
+    bool is_done = catalogue_save(cat, wal->dir) && wal_sync_dir(wal->dir);
+    if (is_done) {
+        is_done = ftruncate(wal->fd, sizeof(wal_file_header_t)) == 0 &&
+            lseek(wal->fd, sizeof(wal_file_header_t), SEEK_SET) >= 0 &&
+            fdatasync(wal->fd) == 0;
+        if (!is_done)
+            wal_fail("truncate");
+        wal->size = 0;
+    }
+
+    pthread_mutex_unlock(&wal->lock);
+    return is_done;
+}
+
+/*
+ * Replay
+ *  */
+
+typedef struct wal_reader_t {
+    const uint8_t *pos;
+    const uint8_t *end;
+} wal_reader_t;
+
+static bool wal_get_u32(wal_reader_t *reader, uint32_t *value)
+{
+    if ((size_t)(reader->end - reader->pos) < sizeof(*value))
+        return false;
+    memcpy(value, reader->pos, sizeof(*value));
+    reader->pos += sizeof(*value);
+    return true;
+}
+
+/* Names are copied into fixed-size strings of relation or attribute names */
+static bool wal_get_name(wal_reader_t *reader, char *name)
+{
+    uint32_t name_len = 0;
+    if (!wal_get_u32(reader, &name_len) || name_len >= MAX_REL_NAME_LEN || name_len == 0)
+        return false;
+    const size_t name_size = (name_len + 3) / 4 * 4;
+    if ((size_t)(reader->end - reader->pos) < name_size)
+        return false;
+    memcpy(name, reader->pos, name_len);
+    name[name_len] = '\0';
+    reader->pos += name_size;
+    return true;
+}
+
+static bool wal_replay_create_table(catalogue_t *cat, wal_reader_t *reader)
+{
+    rel_name_t rel_name = {0};
+    uint32_t layout = 0, attr_num = 0;
+    if (!wal_get_name(reader, rel_name) || !wal_get_u32(reader, &layout) || !wal_get_u32(reader, &attr_num))
+        return false;
+    if ((layout != LAYOUT_ROWS && layout != LAYOUT_COLUMNS) || attr_num == 0 || attr_num > MAX_ATTR_NUM)
+        return false;
+
+    /* Saved by a checkpoint already */
+    if (catalogue_get_relation(cat, rel_name))
+        return true;
+
+    attr_name_t *attr_names = calloc(attr_num, sizeof(*attr_names));
+    const char **attr_name_ptrs = calloc(attr_num, sizeof(*attr_name_ptrs));
+    bool is_replayed = attr_names && attr_name_ptrs;
+    for (uint32_t attr_i = 0; is_replayed && attr_i < attr_num; attr_i++) {
+        is_replayed = wal_get_name(reader, attr_names[attr_i]);
+        attr_name_ptrs[attr_i] = attr_names[attr_i];
+    }
+
+    relation_t *rel = NULL;
+    if (is_replayed)
+        rel = relation_create_with_layout(attr_name_ptrs, (uint16_t)attr_num, layout);
+    if (rel && !catalogue_add_relation(cat, rel_name, rel)) {
+        relation_destroy(rel);
+        rel = NULL;
+    }
+
+    free(attr_name_ptrs);
+    free(attr_names);
+    return rel != NULL;
+}
+
+static bool wal_replay_create_index(catalogue_t *cat, wal_reader_t *reader)
+{
+    rel_name_t index_name = {0}, rel_name = {0};
+    uint32_t attr_i = 0, type = 0;
+    if (!wal_get_name(reader, index_name) || !wal_get_name(reader, rel_name) ||
+        !wal_get_u32(reader, &attr_i) || !wal_get_u32(reader, &type))
+        return false;
+    if (type != INDEX_BTREE && type != INDEX_HASH)
+        return false;
+
+    if (catalogue_has_index(cat, index_name))
+        return true;
+
+    relation_t *rel = catalogue_get_relation(cat, rel_name);
+    if (!rel || attr_i >= relation_get_attr_num(rel))
+        return false;
+    return catalogue_add_index(cat, index_name, rel_name, (uint16_t)attr_i, type);
+}
+
+static bool wal_replay_insert(catalogue_t *cat, wal_reader_t *reader)
+{
+    rel_name_t rel_name = {0};
+    uint32_t first_tuple_i = 0, tuple_num = 0, attr_num = 0;
+    if (!wal_get_name(reader, rel_name) || !wal_get_u32(reader, &first_tuple_i) ||
+        !wal_get_u32(reader, &tuple_num) || !wal_get_u32(reader, &attr_num))
+        return false;
+
+    relation_t *rel = catalogue_get_relation(cat, rel_name);
+    if (!rel || attr_num != relation_get_attr_num(rel))
+        return false;
+    if ((size_t)(reader->end - reader->pos) != (size_t)tuple_num * attr_num * sizeof(value_type_t))
+        return false;
+
+    /* Tuples saved by a checkpoint are skipped, a gap means records are missing */
+    const uint32_t rel_tuple_num = relation_get_tuple_num(rel);
+    if (first_tuple_i > rel_tuple_num)
+        return false;
+    const uint32_t skip_num = rel_tuple_num - first_tuple_i;
+    if (skip_num >= tuple_num)
+        return true;
+
+    /* Values are word-aligned in the log, so they go straight into the relation */
+    const value_type_t *table = (const value_type_t *)reader->pos;
+    relation_append_table(rel, &table[(size_t)skip_num * attr_num], tuple_num - skip_num);
+    return true;
+}
+
+/* Apply records one by one, stopping at the first torn one. Returns the end of the last record
+ * applied, 0 if a record does not match the catalogue. */
+static size_t wal_replay(catalogue_t *cat, const uint8_t *data, const size_t data_size)
+{
+    size_t record_start = sizeof(wal_file_header_t);
+    while (data_size - record_start >= sizeof(wal_record_header_t)) {
+        wal_record_header_t header;
+        memcpy(&header, &data[record_start], sizeof(header));
+        const uint8_t *payload = &data[record_start + sizeof(header)];
+        if (header.size % sizeof(uint32_t) != 0 || header.size > data_size - record_start - sizeof(header))
+            break;
+        if (header.checksum != wal_checksum(&header, payload))
+            break;
+
+        wal_reader_t reader = { .pos = payload, .end = payload + header.size };
+        bool is_replayed = false;
+        switch ((wal_record_type_t)header.type) {
+        case WAL_RECORD_CREATE_TABLE:
+            is_replayed = wal_replay_create_table(cat, &reader);
+            break;
+        case WAL_RECORD_CREATE_INDEX:
+            is_replayed = wal_replay_create_index(cat, &reader);
+            break;
+        case WAL_RECORD_INSERT:
+            is_replayed = wal_replay_insert(cat, &reader);
+            break;
+        }
+        if (!is_replayed)
+            return 0;
+
+        record_start += sizeof(header) + header.size;
+    }
+    return record_start;
+}
+
+/* Replay whatever the log file has and cut off a torn tail, returning the end of the log or 0 */
+static size_t wal_recover(const int fd, catalogue_t *cat)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return 0;
+
+    const size_t file_size = (size_t)st.st_size;
+    size_t log_end = sizeof(wal_file_header_t);
+    if (file_size < sizeof(wal_file_header_t)) {
+        /* A new log, or one torn while being created */
+        const wal_file_header_t header = { .magic = WAL_FILE_MAGIC, .version = WAL_FILE_VERSION };
+        if (ftruncate(fd, 0) != 0 || !wal_write_all(fd, &header, sizeof(header)))
+            return 0;
+    } else {
+        uint8_t *data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            return 0;
+        const wal_file_header_t *header = (const wal_file_header_t *)data;
+        if (memcmp(header->magic, WAL_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+            header->version == WAL_FILE_VERSION)
+            log_end = wal_replay(cat, data, file_size);
+        else
+            log_end = 0;
+        munmap(data, file_size);
+        if (log_end == 0 || (log_end < file_size && ftruncate(fd, (off_t)log_end) != 0))
+            return 0;
+    }
+
+    if (fdatasync(fd) != 0 || lseek(fd, (off_t)log_end, SEEK_SET) < 0)
+        return 0;
+    return log_end;
+}
+
+static int wal_open_file(const char *dir)
+{
+    char path[strlen(dir) + sizeof("/" WAL_FILE_NAME)];
+    sprintf(path, "%s/" WAL_FILE_NAME, dir);
+    const int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd >= 0 && !wal_sync_dir(dir)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+wal_t *wal_open(const char *dir, catalogue_t *cat)
+{
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+        goto dir_fail;
+
+    wal_t *wal = calloc(1, sizeof(*wal));
+    if (!wal)
+        goto alloc_fail;
+
+    wal->dir = strdup(dir);
+    if (!wal->dir)
+        goto dir_name_fail;
+
+    wal->fd = wal_open_file(dir);
+    if (wal->fd < 0)
+        goto file_fail;
+
+    const size_t log_end = wal_recover(wal->fd, cat);
+    if (log_end == 0)
+        goto recover_fail;
+    wal->size = log_end - sizeof(wal_file_header_t);
+
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->synced, NULL);
+    pthread_cond_init(&wal->committed, NULL);
+
+    return wal;
+
+recover_fail:
+    close(wal->fd);
+
+file_fail:
+    free(wal->dir);
+
+dir_name_fail:
+    free(wal);
+
+alloc_fail:
+dir_fail:
+    return NULL;
+}
+
+void wal_close(wal_t *wal)
+{
+    if (!wal)
+        return;
+
+    pthread_mutex_lock(&wal->lock);
+    wal->is_closing = true;
+    pthread_cond_signal(&wal->committed);
+    pthread_mutex_unlock(&wal->lock);
+    if (wal->has_syncer)
+        pthread_join(wal->syncer, NULL);
+
+    pthread_mutex_lock(&wal->lock);
+    wal_sync(wal, wal->appended_lsn);
+    pthread_mutex_unlock(&wal->lock);
+
+    pthread_cond_destroy(&wal->committed);
+    pthread_cond_destroy(&wal->synced);
+    pthread_mutex_destroy(&wal->lock);
+    close(wal->fd);
+    free(wal->buf);
+    free(wal->dir);
+    free(wal);
+}
@@ -0,0 +1,67 @@
+#ifndef PIGLETQL_WAL_H
+#define PIGLETQL_WAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pigletql-def.h"
+#include "pigletql-eval.h"
+#include "pigletql-catalogue.h"
+
+/*
+ * A write-ahead log keeps changes to a catalogue durable between checkpoints. Statements append binary
+ * records of tables and indexes created and tuples inserted, and commit them. A single sync covers all
+ * the records appended by the time it starts, so commits running concurrently share syncs (group
+ * commit). Commits of a single thread only share syncs with asynchronous commit: commits return without
+ * waiting, a background thread syncs the log at most a delay after a commit, and a crash loses what was
+ * committed in the last delay.
+ *
+ * A checkpoint saves the catalogue, see catalogue_save(), and truncates the log. Opening the log
+ * replays its records over the catalogue saved last. Insert records carry positions of their tuples,
+ * so records that made it into the catalogue before a crash are skipped.
+ * */
+
+/* The log is checkpointed once it grows past this many bytes */
+#define WAL_CHECKPOINT_SIZE (64 * 1024 * 1024)
+
+/* Records are written out without syncing once this many bytes are buffered */
+#define WAL_BUFFER_SIZE (1024 * 1024)
+
+typedef struct wal_t wal_t;
+
+/* Open the log in a data directory, creating it if needed, and replay it over the catalogue opened
+ * from the same directory. A record torn by a crash ends the log. NULL if the log cannot be opened or
+ * does not match the catalogue. */
+wal_t *wal_open(const char *dir, catalogue_t *cat);
+
+/* Sync records left and close the log */
+void wal_close(wal_t *wal);
+
+/* Records are appended to the log, returning the log position to commit up to */
+uint64_t wal_log_create_table(wal_t *wal, const rel_name_t rel_name, const char *const *attr_names,
+                              const uint16_t attr_num, const relation_layout_t layout);
+
+uint64_t wal_log_create_index(wal_t *wal, const rel_name_t index_name, const rel_name_t rel_name,
+                              const uint16_t attr_i, const index_type_t type);
+
+/* Tuples appended to a relation starting at the position given, values of a tuple next to each other */
+uint64_t wal_log_insert(wal_t *wal, const rel_name_t rel_name, const uint32_t first_tuple_i,
+                        const value_type_t *table, const uint16_t attr_num, const uint32_t tuple_num);
+
+/* Make records up to the position given durable, waiting for a sync unless commits are asynchronous */
+void wal_commit(wal_t *wal, const uint64_t lsn);
+
+/* Make commits asynchronous, synced at most the delay given in microseconds after they return. 0 makes
+ * every commit wait for its sync again. */
+void wal_set_async_commit_delay(wal_t *wal, const uint32_t delay_us);
+
+/* Save the catalogue to the data directory and truncate the log */
+bool wal_checkpoint(wal_t *wal, catalogue_t *cat);
+
+/* Bytes of records in the log since the last checkpoint */
+uint64_t wal_get_size(wal_t *wal);
+
+/* Number of syncs done so far */
+uint64_t wal_get_sync_num(wal_t *wal);
+
+#endif //PIGLETQL_WAL_H
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <inttypes.h>
@@ -7,6 +8,12 @@
 #include "pigletql-eval.h"
 #include "pigletql-catalogue.h"
 #include "pigletql-validate.h"
+#include "pigletql-bind.h"
+#include "pigletql-plan.h"
+#include "pigletql-codegen.h"
+#include "pigletql-wal.h"
+#include "pigletql-copy.h"
+#include "pigletql-prepare.h"
 
 void dump_predicate(const query_predicate_t *predicate)
 {
@@ -25,25 +32,44 @@ void dump_select(const query_select_t *query)
 
     for (size_t i = 0; i < query->attr_num; ++i)
         printf("  %s,\n", query->attr_names[i]);
+    for (size_t i = 0; i < query->aggregate_num; ++i)
+        printf("  %s,\n", query->aggregates[i].name);
 
     printf("FROM\n");
     for (size_t i = 0; i < query->rel_num; ++i)
         printf("  %s,\n", query->rel_names[i]);
 
     if (!query->pred_num)
-        goto order;
+        goto group;
 
     printf("WHERE\n");
     for (size_t i = 0; i < query->pred_num; ++i)
         dump_predicate(&query->predicates[i]);
 
+group:
+    if (!query->group_attr_num)
+        goto order;
+
+    printf("GROUP BY\n");
+    for (size_t i = 0; i < query->group_attr_num; ++i)
+        printf("  %s,\n", query->group_attr_names[i]);
+
 order:
     if (!query->has_order)
-        return;
+        goto limit;
 
     printf("ORDER BY\n");
     printf("  %s\n", query->order_by_attr);
     printf(query->order_type == SORT_ASC ? "  ASC\n" : "  DESC\n");
+
+limit:
+    if (!query->has_limit)
+        return;
+
+    printf("LIMIT\n");
+    printf("  %"PRI_VALUE"\n", query->limit);
+    printf("OFFSET\n");
+    printf("  %"PRI_VALUE"\n", query->offset);
 }
 
 void dump_create_table(const query_create_table_t *query)
@@ -58,18 +84,67 @@ void dump_create_table(const query_create_table_t *query)
     printf("\n)\n");
 }
 
+void dump_create_index(const query_create_index_t *query)
+{
+    printf("CREATE INDEX \n");
+
+    printf("  %s\n", query->index_name);
+
+    printf("ON\n");
+    printf("  %s (%s)\n", query->rel_name, query->attr_name);
+    if (query->type == INDEX_HASH)
+        printf("HASH\n");
+}
+
 void dump_insert(const query_insert_t *query)
 {
     printf("INSERT INTO \n");
 
     printf("  %s\n", query->rel_name);
 
+    for (size_t tuple_i = 0; tuple_i < query->tuple_num; ++tuple_i) {
+        printf("(\n  ");
+        for (size_t attr_i = 0; attr_i < query->attr_num; ++attr_i)
+            printf("%"PRI_VALUE",", query->values[tuple_i * query->attr_num + attr_i]);
+        printf("\n)\n");
+    }
+}
+
+void dump_set(const query_set_t *query)
+{
+    printf("SET\n");
+    printf("  %s = %"PRI_VALUE"\n", query->name, query->value);
+}
+
+void dump_copy(const query_copy_t *query)
+{
+    printf("COPY\n");
+    printf("  %s FROM '%s'\n", query->rel_name, query->path);
+}
+
+void dump_prepare(const query_prepare_t *query)
+{
+    printf("PREPARE\n");
+    printf("  %s AS\n", query->name);
+    dump_select(&query->select);
+}
+
+void dump_execute(const query_execute_t *query)
+{
+    printf("EXECUTE\n");
+    printf("  %s\n", query->name);
+
     printf("(\n  ");
     for (size_t i = 0; i < query->value_num; ++i)
         printf("%"PRI_VALUE",", query->values[i]);
     printf("\n)\n");
 }
 
+void dump_deallocate(const query_deallocate_t *query)
+{
+    printf("DEALLOCATE\n");
+    printf("  %s\n", query->name);
+}
 
 void dump(const query_t *query)
 {
@@ -80,99 +155,46 @@ void dump(const query_t *query)
     case QUERY_CREATE_TABLE:
         dump_create_table(&query->as.create_table);
         break;
+    case QUERY_CREATE_INDEX:
+        dump_create_index(&query->as.create_index);
+        break;
     case QUERY_INSERT:
         dump_insert(&query->as.insert);
         break;
+    case QUERY_SET:
+        dump_set(&query->as.set);
+        break;
+    case QUERY_COPY:
+        dump_copy(&query->as.copy);
+        break;
+    case QUERY_PREPARE:
+        dump_prepare(&query->as.prepare);
+        break;
+    case QUERY_EXECUTE:
+        dump_execute(&query->as.execute);
+        break;
+    case QUERY_DEALLOCATE:
+        dump_deallocate(&query->as.deallocate);
+        break;
     }
 }
 
-operator_t *compile_select(catalogue_t *cat, const query_select_t *query)
+operator_t *compile_select(arena_t *arena, const bound_select_t *query)
 {
-    /* Current root operator */
-    operator_t *root_op = NULL;
-
-    /* 1. Scan ops */
-    /* 2. Join ops*/
-
-    {
-        size_t rel_i = 0;
-        relation_t *rel = catalogue_get_relation(cat, query->rel_names[rel_i]);
-        root_op = scan_op_create(rel);
-        rel_i += 1;
-
-        for (; rel_i < query->rel_num; rel_i++) {
-            rel = catalogue_get_relation(cat, query->rel_names[rel_i]);
-            operator_t *scan_op = scan_op_create(rel);
-            root_op = join_op_create(root_op, scan_op);
-        }
-    }
-
-    /* 3. Project */
-    root_op = proj_op_create(root_op, query->attr_names, query->attr_num);
-
-    /* 4. Select */
-    if (query->pred_num > 0) {
-        operator_t *select_op = select_op_create(root_op);
-        for (size_t pred_i = 0; pred_i < query->pred_num; pred_i++) {
-            query_predicate_t predicate = query->predicates[pred_i];
-
-            /* On the left we always get an identifier */
-            assert(predicate.left.type == TOKEN_IDENT);
-
-            attr_name_t left_attr_name = {0};
-            strncpy(left_attr_name, predicate.left.start, (size_t)predicate.left.length);
-
-            select_predicate_op pred_op = 0;
-            switch (predicate.op.type) {
-            case TOKEN_GREATER:
-                pred_op = SELECT_GT;
-                break;
-            case TOKEN_LESS:
-                pred_op = SELECT_LT;
-                break;
-            case TOKEN_EQUAL:
-                pred_op = SELECT_EQ;
-                break;
-            default:
-                /* Uknown predicate type */
-                assert(false);
-            }
-
-            /* On the right it's either a constant or another identifier */
-            if (predicate.right.type == TOKEN_IDENT) {
-                attr_name_t right_attr_name = {0};
-                strncpy(right_attr_name, predicate.right.start, (size_t)predicate.right.length);
-
-                select_op_add_attr_attr_predicate(select_op, left_attr_name, pred_op, right_attr_name);
-            } else if (predicate.right.type == TOKEN_NUMBER) {
-                char buf[128] = {0};
-                strncpy(buf, predicate.right.start, (size_t)predicate.right.length);
-
-                value_type_t right_const = 0;
-                sscanf(buf, "%" SCN_VALUE, &right_const);
-
-                select_op_add_attr_const_predicate(select_op, left_attr_name, pred_op, right_const);
-            } else {
-                /* Invalid token */
-                assert(false);
-            }
-        }
-        root_op = select_op;
-    }
-
-    /* 5. Sort */
-    if (query->has_order)
-        root_op = sort_op_create(root_op, query->order_by_attr, query->order_type);
+    /* Plan the query, then turn the plan into an operator tree */
+    plan_node_t *plan = plan_select(arena, query);
+    operator_t *root_op = plan_compile(arena, plan);
+    plan_destroy(plan);
 
     return root_op;
 }
 
-void dump_tuple_header(tuple_t *tuple)
+void dump_batch_header(batch_t *batch)
 {
-    const uint16_t attr_num = tuple_get_attr_num(tuple);
+    const uint16_t attr_num = batch->attr_num;
 
     for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++) {
-        const char *attr_name = tuple_get_attr_name_by_i(tuple, attr_i);
+        const char *attr_name = batch->attr_names[attr_i];
         if (attr_i != attr_num - 1)
             printf("%s ", attr_name);
         else
@@ -180,61 +202,124 @@ void dump_tuple_header(tuple_t *tuple)
     }
 }
 
-void dump_tuple(tuple_t *tuple)
+void dump_batch(batch_t *batch)
+{
+    const uint16_t attr_num = batch->attr_num;
+
+    /* attribute values for all rows alive */
+    for (uint16_t sel_i = 0; sel_i < batch->sel_num; sel_i++) {
+        const uint16_t row_i = batch->sel[sel_i];
+        for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++) {
+            uint64_t attr_val = batch_get_value(batch, attr_i, row_i);
+            if (attr_i != attr_num - 1)
+                printf("%"PRIu64" ", attr_val);
+            else
+                printf("%"PRIu64"\n", attr_val);
+        }
+    }
+}
+
+/* Eval the tree a batch at a time, false if an operator failed on the way */
+bool eval_op(operator_t *root_op)
 {
-    const uint16_t attr_num = tuple_get_attr_num(tuple);
+    eval_clear_error();
+    root_op->open(root_op->state);
 
-    /* attribute values for all rows */
-    for (uint16_t attr_i = 0; attr_i < attr_num; attr_i++) {
-        value_type_t attr_val = tuple_get_attr_value_by_i(tuple, attr_i);
-        if (attr_i != attr_num - 1)
-            printf("%u ", attr_val);
-        else
-            printf("%u\n", attr_val);
+    size_t tuples_received = 0;
+    batch_t *batch = NULL;
+    while((batch = root_op->next_batch(root_op->state))) {
+        if (batch->sel_num == 0)
+            continue;
+
+        /* attribute list for the first row only */
+        if (tuples_received == 0)
+            dump_batch_header(batch);
+
+        /* A table of tuples */
+        dump_batch(batch);
+
+        tuples_received += batch->sel_num;
     }
+    root_op->close(root_op->state);
+
+    /* Rows printed are not all of the result */
+    const char *error = eval_get_error();
+    if (error) {
+        fprintf(stderr, "Error: %s\n", error);
+        return false;
+    }
+    printf("rows: %zu\n", tuples_received);
+
+    return true;
 }
 
-bool eval_select(catalogue_t *cat, const query_select_t *query)
+bool eval_select(catalogue_t *cat, arena_t *arena, const query_select_t *query)
 {
+    /* Bind attribute names to attribute references: */
+    bound_select_t *bound_query = bind_select(arena, cat, query);
+    if (!bound_query)
+        return false;
+
     /* Compile the operator tree:  */
-    operator_t *root_op = compile_select(cat, query);
+    operator_t *root_op = compile_select(arena, bound_query);
 
+    const bool is_evaluated = eval_op(root_op);
 
-    /* Eval the tree: */
-    {
-        root_op->open(root_op->state);
+    root_op->destroy(root_op);
+    bound_select_destroy(bound_query);
 
-        size_t tuples_received = 0;
-        tuple_t *tuple = NULL;
-        while((tuple = root_op->next(root_op->state))) {
-            /* attribute list for the first row only */
-            if (tuples_received == 0)
-                dump_tuple_header(tuple);
+    return is_evaluated;
+}
 
-            /* A table of tuples */
-            dump_tuple(tuple);
+bool eval_prepare(catalogue_t *cat, prepare_cache_t *cache, const query_prepare_t *query)
+{
+    if (prepare_cache_has(cache, query->name)) {
+        fprintf(stderr, "Error: prepared statement '%s' already exists\n", query->name);
+        return false;
+    }
+    return prepare_cache_add(cache, cat, query->name, &query->select);
+}
 
-            tuples_received++;
-        }
-        printf("rows: %zu\n", tuples_received);
+bool eval_execute(prepare_cache_t *cache, const query_execute_t *query)
+{
+    if (!prepare_cache_has(cache, query->name)) {
+        fprintf(stderr, "Error: prepared statement '%s' does not exist\n", query->name);
+        return false;
+    }
 
-        root_op->close(root_op->state);
+    const uint16_t param_num = prepare_cache_get_param_num(cache, query->name);
+    if (query->value_num != param_num) {
+        fprintf(stderr, "Error: prepared statement '%s' has %"PRIu16" parameters, %"PRIu16" supplied\n",
+                query->name, param_num, query->value_num);
+        return false;
     }
 
-    root_op->destroy(root_op);
+    /* The tree compiled before is reopened with new parameters */
+    return eval_op(prepare_cache_get_op(cache, query->name, query->values));
+}
 
+bool eval_deallocate(prepare_cache_t *cache, const query_deallocate_t *query)
+{
+    if (!prepare_cache_remove(cache, query->name)) {
+        fprintf(stderr, "Error: prepared statement '%s' does not exist\n", query->name);
+        return false;
+    }
     return true;
 }
 
-bool eval_create_table(catalogue_t *cat, const query_create_table_t *query)
+bool eval_create_table(catalogue_t *cat, wal_t *wal, const query_create_table_t *query)
 {
-    relation_t *rel = relation_create(query->attr_names, query->attr_num);
+    relation_t *rel = relation_create_with_layout(query->attr_names, query->attr_num, query->layout);
     if (!rel)
         goto rel_err;
 
     if (!catalogue_add_relation(cat, query->rel_name, rel))
         goto cat_err;
 
+    if (wal)
+        wal_commit(wal, wal_log_create_table(wal, query->rel_name, query->attr_names, query->attr_num,
+                                             query->layout));
+
     return true;
 
 cat_err:
@@ -244,39 +329,142 @@ rel_err:
     return false;
 }
 
-bool eval_insert(catalogue_t *cat, const query_insert_t *query)
+bool eval_create_index(catalogue_t *cat, wal_t *wal, prepare_cache_t *cache, const query_create_index_t *query)
+{
+    relation_t *rel = catalogue_get_relation(cat, query->rel_name);
+    assert(rel);                /* should be validated by now */
+
+    const uint16_t attr_i = relation_attr_i_by_name(rel, query->attr_name);
+    if (!catalogue_add_index(cat, query->index_name, query->rel_name, attr_i, query->type))
+        return false;
+
+    /* Prepared statements might look the index up now */
+    prepare_cache_invalidate(cache);
+
+    if (wal)
+        wal_commit(wal, wal_log_create_index(wal, query->index_name, query->rel_name, attr_i, query->type));
+
+    return true;
+}
+
+bool eval_insert(catalogue_t *cat, wal_t *wal, const query_insert_t *query)
+{
+    relation_t *rel = catalogue_get_relation(cat, query->rel_name);
+    assert(rel);                /* should be validated by now */
+
+    /* All the tuples in one go, reserving space once */
+    const uint32_t first_tuple_i = relation_get_tuple_num(rel);
+    relation_append_table(rel, query->values, query->tuple_num);
+
+    if (wal)
+        wal_commit(wal, wal_log_insert(wal, query->rel_name, first_tuple_i, query->values, query->attr_num,
+                                       query->tuple_num));
+
+    return true;
+}
+
+/* Bulk loads into a copy of the tuples in the log, unless there are so many that a checkpoint is
+ * cheaper */
+static void eval_copy_log(catalogue_t *cat, wal_t *wal, const query_copy_t *query, const uint32_t first_tuple_i)
+{
+    relation_t *rel = catalogue_get_relation(cat, query->rel_name);
+    const uint16_t attr_num = relation_get_attr_num(rel);
+    const uint32_t tuple_num = relation_get_tuple_num(rel) - first_tuple_i;
+    if ((uint64_t)tuple_num * attr_num * sizeof(value_type_t) > WAL_CHECKPOINT_SIZE) {
+        if (!wal_checkpoint(wal, cat))
+            fprintf(stderr, "Error: failed to checkpoint the tuples copied\n");
+        return;
+    }
+
+    value_type_t *table = calloc((size_t)tuple_num * attr_num, sizeof(value_type_t));
+    assert(table);
+    for (uint32_t tuple_i = 0; tuple_i < tuple_num; tuple_i++)
+        memcpy(&table[(size_t)tuple_i * attr_num], relation_tuple_values_by_id(rel, first_tuple_i + tuple_i),
+               attr_num * sizeof(value_type_t));
+    wal_commit(wal, wal_log_insert(wal, query->rel_name, first_tuple_i, table, attr_num, tuple_num));
+    free(table);
+}
+
+bool eval_copy(catalogue_t *cat, wal_t *wal, const query_copy_t *query)
 {
     relation_t *rel = catalogue_get_relation(cat, query->rel_name);
     assert(rel);                /* should be validated by now */
 
-    relation_append_values(rel, query->values);
+    const uint32_t first_tuple_i = relation_get_tuple_num(rel);
+    copy_result_t result;
+    if (!copy_from_file(rel, query->path, gather_op_get_pool(), &result)) {
+        if (result.error_line)
+            fprintf(stderr, "Error: line %"PRIu64" of '%s' should have %"PRIu16" integer values\n",
+                    result.error_line, query->path, relation_get_attr_num(rel));
+        else
+            fprintf(stderr, "Error: failed to copy '%s'\n", query->path);
+        return false;
+    }
+
+    if (wal && result.tuple_num > 0)
+        eval_copy_log(cat, wal, query, first_tuple_i);
 
+    printf("rows: %"PRIu64"\n", result.tuple_num);
     return true;
 }
 
-bool eval(catalogue_t *cat, const query_t *query)
+bool eval_set(wal_t *wal, prepare_cache_t *cache, const query_set_t *query)
+{
+    /* Settings should be validated by now */
+    if (0 == strncmp(query->name, SETTING_SORT_MEMORY_KB, MAX_ATTR_NAME_LEN))
+        sort_op_set_memory_budget((size_t)query->value * 1024);
+    else if (0 == strncmp(query->name, SETTING_PARALLEL_WORKERS, MAX_ATTR_NAME_LEN))
+        gather_op_set_worker_num((uint16_t)query->value);
+    else if (0 == strncmp(query->name, SETTING_CODEGEN, MAX_ATTR_NAME_LEN))
+        codegen_set_enabled(query->value != 0);
+    else if (0 == strncmp(query->name, SETTING_ASYNC_COMMIT_DELAY_US, MAX_ATTR_NAME_LEN)) {
+        if (wal)
+            wal_set_async_commit_delay(wal, query->value);
+    } else
+        assert(false);
+
+    /* Settings change plans and operators compiled from them */
+    prepare_cache_invalidate(cache);
+
+    return true;
+}
+
+bool eval(catalogue_t *cat, wal_t *wal, prepare_cache_t *cache, arena_t *arena, const query_t *query)
 {
      switch (query->tag) {
      case QUERY_SELECT:
-         return eval_select(cat, &query->as.select);
+         return eval_select(cat, arena, &query->as.select);
      case QUERY_CREATE_TABLE:
-         return eval_create_table(cat, &query->as.create_table);
+         return eval_create_table(cat, wal, &query->as.create_table);
+     case QUERY_CREATE_INDEX:
+         return eval_create_index(cat, wal, cache, &query->as.create_index);
      case QUERY_INSERT:
-         return eval_insert(cat, &query->as.insert);
+         return eval_insert(cat, wal, &query->as.insert);
+     case QUERY_SET:
+         return eval_set(wal, cache, &query->as.set);
+     case QUERY_COPY:
+         return eval_copy(cat, wal, &query->as.copy);
+     case QUERY_PREPARE:
+         return eval_prepare(cat, cache, &query->as.prepare);
+     case QUERY_EXECUTE:
+         return eval_execute(cache, &query->as.execute);
+     case QUERY_DEALLOCATE:
+         return eval_deallocate(cache, &query->as.deallocate);
      }
      assert(false);
  }
 
-void run(catalogue_t *cat, const char *query_str)
+void run(catalogue_t *cat, wal_t *wal, prepare_cache_t *cache, arena_t *arena, const char *query_str)
 {
-    scanner_t *scanner = scanner_create(query_str);
-    parser_t *parser = parser_create();
-    query_t *query = query_create();
+    /* Everything living as long as the statement goes to the arena */
+    scanner_t *scanner = scanner_create(arena, query_str);
+    parser_t *parser = parser_create(arena);
+    query_t *query = query_create(arena);
 
     if (parser_parse(parser, scanner, query)) {
         /* dump(query); */
         if (validate(cat, query))
-            eval(cat, query);
+            eval(cat, wal, cache, arena, query);
     }
 
     scanner_destroy(scanner);
@@ -286,27 +474,63 @@ void run(catalogue_t *cat, const char *query_str)
 
 int main(int argc, char *argv[])
 {
-    (void) argc; (void) argv;
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [data directory]\n", argv[0]);
+        return 1;
+    }
 
-    catalogue_t *cat = catalogue_create();
+    /* Relations live in memory only unless there's a directory to keep them in */
+    const char *data_dir = argc == 2 ? argv[1] : NULL;
+    catalogue_t *cat = data_dir ? catalogue_open(data_dir) : catalogue_create();
+    if (!cat) {
+        fprintf(stderr, "Error: failed to open the catalogue in '%s'\n", data_dir);
+        return 1;
+    }
 
-    while (true) {
-        char line[1024];
+    /* Changes since the last checkpoint are in the log */
+    wal_t *wal = data_dir ? wal_open(data_dir, cat) : NULL;
+    if (data_dir && !wal) {
+        fprintf(stderr, "Error: failed to replay the log in '%s'\n", data_dir);
+        catalogue_destroy(cat);
+        return 1;
+    }
+    arena_t *arena = arena_create();
+    prepare_cache_t *cache = prepare_cache_create();
 
+    /* Lines grow as needed, inserts of many tuples are long */
+    char *line = NULL;
+    size_t line_size = 0;
+    while (true) {
         printf("> ");
 
-        if (!fgets(line, sizeof(line), stdin)) {
+        const ssize_t line_len = getline(&line, &line_size, stdin);
+        if (line_len < 0) {
             printf("\n");
             break;
         }
 
         /* strip a newline at the end of the line */
-        line[strlen(line) - 1] = '\0';
+        if (line_len > 0 && line[line_len - 1] == '\n')
+            line[line_len - 1] = '\0';
 
-        run(cat, line);
+        run(cat, wal, cache, arena, line);
+
+        /* Statement memory is released all at once */
+        arena_reset(arena);
+
+        if (wal && wal_get_size(wal) > WAL_CHECKPOINT_SIZE && !wal_checkpoint(wal, cat))
+            fprintf(stderr, "Error: failed to checkpoint to '%s'\n", data_dir);
     }
 
+    free(line);
+    prepare_cache_destroy(cache);
+    arena_destroy(arena);
+
+    const bool is_saved = !wal || wal_checkpoint(wal, cat);
+    if (!is_saved)
+        fprintf(stderr, "Error: failed to save the catalogue to '%s'\n", data_dir);
+    wal_close(wal);
     catalogue_destroy(cat);
 
-    return 0;
+    return is_saved ? 0 : 1;
 }